@@ -0,0 +1,98 @@
+/* P1P2Checksum.h: checksum policies of the supported bus protocols, selected at compile time
+ *
+ * Copyright (c) 2019-2024 Arnold Niessen, arnold.niessen-at-gmail-dot-com - licensed under CC BY-NC-ND 4.0 with exceptions (see LICENSE.md)
+ *
+ * Each policy computes the checksum byte of a packet, byte by byte:
+ *   P1P2ChecksumCRC<gen, feed>  CRC-8, LSB first, generator gen, initial value feed (Daikin P1/P2: 0xD9, 0x00)
+ *   P1P2ChecksumSum             sum of all bytes (MHI X-Y)
+ *   P1P2ChecksumXor<skip, ack>  XOR of all bytes except the first skip bytes (Hitachi H-link2: 1);
+ *                               a 2-byte packet with ack as second byte is an acknowledgement without checksum byte (0: none)
+ *   P1P2ChecksumNone            no checksum byte
+ * P1P2Checksum is the policy of the bus protocol of this build (*_SERIES), used by readpacket()/writepacket() and
+ * the pseudo-packet writers, so each of them compiles to the loop of this protocol only.
+ * Interface of a policy C:
+ *   C::enabled               whether packets end with a checksum byte
+ *   C::bare(b, n)            whether packet b of n bytes has no checksum byte (even if enabled)
+ *   C c; c.add(i, b[i])      adds byte i of the packet, for i = 0, 1, ...
+ *   c.value()                checksum byte of the bytes added
+ *   P1P2ChecksumOf<C>(b, n)  checksum byte of the first n bytes of b
+ *
+ * The P1P2MQTT-bridge is built without the P1P2MQTT library and has an identical copy of this file (P1P2_Checksum.h);
+ * make check of its host build (examples/P1P2MQTT-bridge/host) fails if the two differ.
+ *
+ * Version history
+ * 20250601 v0.9.58 initial version, replacing CRC_GEN/CRC_CS_FEED/CS_GEN code per series
+ */
+
+#ifndef P1P2Checksum_h
+#define P1P2Checksum_h
+
+#include <inttypes.h>
+
+template <uint8_t gen, uint8_t feed>
+class P1P2ChecksumCRC {
+  public:
+    static const bool enabled = true;
+    static bool bare(const uint8_t* b, uint8_t n) { return false; }
+    P1P2ChecksumCRC() : v(feed) {}
+    void add(uint8_t i, uint8_t c) {
+      for (uint8_t k = 0; k < 8; k++) {
+        v = ((v ^ c) & 0x01) ? ((v >> 1) ^ gen) : (v >> 1);
+        c >>= 1;
+      }
+    }
+    uint8_t value(void) const { return v; }
+  private:
+    uint8_t v;
+};
+
+class P1P2ChecksumSum {
+  public:
+    static const bool enabled = true;
+    static bool bare(const uint8_t* b, uint8_t n) { return false; }
+    P1P2ChecksumSum() : v(0) {}
+    void add(uint8_t i, uint8_t c) { v += c; }
+    uint8_t value(void) const { return v; }
+  private:
+    uint8_t v;
+};
+
+template <uint8_t skip, uint8_t ack>
+class P1P2ChecksumXor {
+  public:
+    static const bool enabled = true;
+    static bool bare(const uint8_t* b, uint8_t n) { return ack && (n == 2) && (b[1] == ack); }
+    P1P2ChecksumXor() : v(0) {}
+    void add(uint8_t i, uint8_t c) { if (i >= skip) v ^= c; }
+    uint8_t value(void) const { return v; }
+  private:
+    uint8_t v;
+};
+
+class P1P2ChecksumNone {
+  public:
+    static const bool enabled = false;
+    static bool bare(const uint8_t* b, uint8_t n) { return true; }
+    void add(uint8_t i, uint8_t c) {}
+    uint8_t value(void) const { return 0; }
+};
+
+template <class C>
+uint8_t P1P2ChecksumOf(const uint8_t* b, uint8_t n)
+{
+  C c;
+  for (uint8_t i = 0; i < n; i++) c.add(i, b[i]);
+  return c.value();
+}
+
+#if defined MHI_SERIES
+typedef P1P2ChecksumSum P1P2Checksum;
+#elif defined H_SERIES
+typedef P1P2ChecksumXor<1, 0x06> P1P2Checksum;
+#elif (defined E_SERIES || defined F_SERIES || defined W_SERIES)
+typedef P1P2ChecksumCRC<0xD9, 0x00> P1P2Checksum; // these values work at least for the Daikin hybrid
+#else /* MHI_SERIES */
+typedef P1P2ChecksumNone P1P2Checksum;            // F1/F2, Toshiba, Mitsubishi (checksum not known yet)
+#endif /* MHI_SERIES */
+
+#endif /* P1P2Checksum_h */
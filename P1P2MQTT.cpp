@@ -3,6 +3,7 @@
  * Copyright (c) 2019-2024 Arnold Niessen, arnold.niessen-at-gmail-dot-com - licensed under CC BY-NC-ND 4.0 with exceptions (see LICENSE.md)
  *
  * Version history
+ * 20250601 v0.9.58 MHI trio conversion by lookup tables, per trio in readpacket(), optional compact read buffer (MHI_RX_COMPACT)
  * 20240512 v0.9.46 Mitsubishi Heavy Industries (MHI) with increased TX_BUFFER_SIZE/RX_BUFFER_SIZE and data-conversion, error mask
  * 20230604 v0.9.38 H-link branch merged into main branch
  * 20230604 v0.9.37 Support for V1.2 hardware
@@ -78,6 +79,13 @@
 // related interrupts:
 //              ICP    PB0
 
+#if F_CPU <= 8000000L
+// Assume we are on P1P2-ESP-interface with LED_ERROR on PD3, overrules the LED_BUILTIN defines below
+#define LED_ERROR PD3
+#define DIGITAL_SET_LED_ERROR           (PORTD |= 0x1C)
+#define DIGITAL_RESET_LED_ERROR         (PORTD &= 0xE3)
+#endif /* F_CPU */
+
 #ifdef __AVR_ATmega2560__
 
 #error ATmega2560 code has not been tested, use with caution.
@@ -116,10 +124,11 @@
 #define COMPARE_W_INTERRUPT             TIMER5_COMPA_vect
 
 // use LED_BUILTIN on PB7 on ATmega2560
+#ifndef LED_ERROR
 #define LED_ERROR                       LED_BUILTIN
 #define DIGITAL_RESET_LED_ERROR         (PORTB &= 0x7F)
-#define DIGITAL_WRITE_LED_ERROR(val)    ((val) ? (PORTB |= 0x80) : (PORTB &= 0x7F))
 #define DIGITAL_SET_LED_ERROR           (PORTB |= 0x80)
+#endif /* LED_ERROR */
 
 #elif ((defined __AVR_ATmega328P__) || (defined __AVR_ATmega328PB__))
 
@@ -157,23 +166,16 @@
 #define COMPARE_W_INTERRUPT             TIMER1_COMPA_vect
 
 // use LED_BUILTIN (on PB5) on Arduino Uno
+#ifndef LED_ERROR
 #define LED_ERROR                       LED_BUILTIN
-#define DIGITAL_WRITE_LED_ERROR(val)    ((val) ? (PORTB |= 0x20) : (PORTB &= 0xDF)) // assume PB5 on Arduino Uno
-#define DIGITAL_SET_LED_ERROR           (PORTB |= 0x20)
+#define DIGITAL_SET_LED_ERROR           (PORTB |= 0x20) // assume PB5 on Arduino Uno
 #define DIGITAL_RESET_LED_ERROR         (PORTB &= 0xDF)
+#endif /* LED_ERROR */
 
 #else /* __AVR_ATmega2560__ */
 #error Only ATmega328P or ATmega2560 supported
 #endif /* __AVR_ATmega2560__ */
 
-#if F_CPU <= 8000000L
-// Assume we are on P1P2-ESP-interface with LED_ERROR on PD3, overrule earlier defines
-#define LED_ERROR PD3
-#define DIGITAL_SET_LED_ERROR           (PORTD |= 0x1C)
-#define DIGITAL_RESET_LED_ERROR         (PORTD &= 0xE3)
-#define DIGITAL_WRITE_LED_ERROR(val)    ((val) ? (PORTD |= 0x1C) : (PORTD &= 0xE3))
-#endif /* F_CPU */
-
 // 4 leds:        on   P1P2-ESP-interface   /   Arduino ATmega250     / Arduino Uno
 // LED_POWER (white) on     PC2             /         pin 35          /    pin A2
 // LED_READ  (green) on     PD6             /          n/a            /    pin  6
@@ -232,10 +234,10 @@ volatile uint8_t irq_ovf = 0, irq_busy = 0;
 // assume 8MHz: TODO for 16MHz, use >> 4
 //
 #define IRQ_START { irq_start_time = GET_TIMER_W_COUNT(); }
-#define IRQ_STOP  { irq_time += (GET_TIMER_W_COUNT() - irq_start_time) >> 3; }
+#define IRQ_STOP  { irq_time += (uint16_t) (GET_TIMER_W_COUNT() - irq_start_time) >> 3; }
 #define IRQ_BEGIN { irq_time = 0; irq_start = GET_TIMER_W_COUNT(); irq_ovf = 0; TIFR1 = (1 << TOV1); irq_busy = 1; };
-#define IRQ_END_R { irq_r = irq_time;  irq_w = 0; irq_lapsed_r = ((GET_TIMER_W_COUNT() - irq_start) >> 3) + ((irq_ovf + ((TIFR1 & (1 << TOV1)) ? 1 : 0)) << 13); irq_busy = 0; };
-#define IRQ_END_W { irq_w = irq_time;  irq_r = 0; irq_lapsed_w = ((GET_TIMER_W_COUNT() - irq_start) >> 3) + ((irq_ovf + ((TIFR1 & (1 << TOV1)) ? 1 : 0)) << 13); irq_busy = 0; };
+#define IRQ_END_R { irq_r = irq_time;  irq_w = 0; irq_lapsed_r = ((uint16_t) (GET_TIMER_W_COUNT() - irq_start) >> 3) + ((irq_ovf + ((TIFR1 & (1 << TOV1)) ? 1 : 0)) << 13); irq_busy = 0; };
+#define IRQ_END_W { irq_w = irq_time;  irq_r = 0; irq_lapsed_w = ((uint16_t) (GET_TIMER_W_COUNT() - irq_start) >> 3) + ((irq_ovf + ((TIFR1 & (1 << TOV1)) ? 1 : 0)) << 13); irq_busy = 0; };
 
 // (share range range = 0 .. 255, perhaps even 256?)
 
@@ -287,20 +289,31 @@ static uint32_t V1sum = 0x00;
 #define ADC_INT_DISABLE                 (ADCSRA = 0x86)
 #define ADC_INT_ENABLE                  (ADCSRA = 0x8E)
 
+#ifdef SIGNAL_QUALITY
+static inline void sq_trigger(void);
+static inline void sq_sample(uint16_t V);
+#define SQ_TRIGGER sq_trigger()
+#define SQ_SAMPLE(V) sq_sample(V)
+#else /* SIGNAL_QUALITY */
+#define SQ_TRIGGER {}
+#define SQ_SAMPLE(V) {}
+#endif /* SIGNAL_QUALITY */
+
 ISR(ADC_vect) {
   static bool ADC0used = true;
   uint16_t V = ADC_VALUE;
   if (ADC0used) {
     ADC0used = false;
     ADC_ADC1;
+    SQ_SAMPLE(V);
     V0cnt ++;
     V0sum0 += V;
-    if (!(V0cnt << (16 - ADC_AVG_SHIFT))) { // sum (avg) a few samples before min/max check
+    if (!((uint16_t) (V0cnt << (16 - ADC_AVG_SHIFT)))) { // sum (avg) a few samples before min/max check
       V0sum += V0sum0;
       if (V0sum0 < V0min) V0min = V0sum0;
       if (V0sum0 > V0max) V0max = V0sum0;
       V0sum0 = 0;
-      if (!(V0cnt << ADC_CNT_SHIFT)) {
+      if (!((uint16_t) (V0cnt << ADC_CNT_SHIFT))) {
         // sum 4k samples for average calculation approximately every second
         V0avg = V0sum;
         V0sum = 0;
@@ -311,16 +324,17 @@ ISR(ADC_vect) {
     ADC_ADC0;
     V1cnt ++;
     V1sum0 += V;
-    if (!(V1cnt << (16 - ADC_AVG_SHIFT))) { // sum samples (16 samples if ADC_AVG_SHIFT1 == 4)
+    if (!((uint16_t) (V1cnt << (16 - ADC_AVG_SHIFT)))) { // sum samples (16 samples if ADC_AVG_SHIFT1 == 4)
       V1sum += V1sum0;
       if (V1sum0 < V1min) V1min = V1sum0;
       if (V1sum0 > V1max) V1max = V1sum0;
       V1sum0 = 0;
-      if (!(V1cnt << ADC_CNT_SHIFT)) {
+      if (!((uint16_t) (V1cnt << ADC_CNT_SHIFT))) {
         V1avg = V1sum;
         V1sum = 0;
       }
     }
+    SQ_TRIGGER; // next conversion is V0
   }
   ADC_TRIGGER;
 }
@@ -372,6 +386,57 @@ static uint16_t Rticks_suppression = 0;
 static uint16_t Wticks_per_semibit = 0;
 static uint16_t Wticks_per_bit_and_semibit = 0;
 
+#ifdef BIT_CALIBRATION
+// Calibration: the falling edges of data/parity bits are matched against the start bit edge of their byte; for matching edges
+// (within 1/4 bit of the expected position) the distance and the # bits are summed, giving the average bit period of the sender.
+// The pause between the end of a byte (11 bits after its start bit edge) and the next start bit within a packet is recorded as well.
+static volatile uint8_t cal_mode = 0;        // 0 off, 1 one-shot (Allow opened up to max during measurement), 2 continuous
+static volatile uint32_t cal_sum_ticks = 0;
+static volatile uint16_t cal_sum_bits = 0;
+static volatile uint16_t cal_max_pause = 0;  // in ticks
+static uint16_t cal_byte_start;
+static uint16_t cal_frame_ticks;
+static uint16_t cal_tolerance;
+static uint16_t Rticks_nominal = 0;
+static uint8_t cal_allow_saved;
+
+#define CAL_EDGE(capture, state) \
+    if (cal_mode) { \
+      uint16_t cal_d = capture - cal_byte_start; \
+      if ((uint16_t) (cal_d - (state - 1) * Rticks_per_bit + cal_tolerance) <= (cal_tolerance << 1)) { \
+        cal_sum_ticks += cal_d; \
+        cal_sum_bits += state - 1; \
+      } \
+    }
+
+#define CAL_START(capture, state) \
+    if (cal_mode) { \
+      if (state == 1) { \
+        uint16_t cal_p = capture - (uint16_t) (cal_byte_start + cal_frame_ticks); \
+        if ((cal_p <= (uint16_t) ~Rticks_per_bit) && (cal_p > cal_max_pause)) cal_max_pause = cal_p; \
+      } \
+      cal_byte_start = capture; \
+    }
+#else /* BIT_CALIBRATION */
+#define CAL_EDGE(capture, state) {};
+#define CAL_START(capture, state) {};
+#endif /* BIT_CALIBRATION */
+
+static void setReadTiming(uint16_t t)
+{
+  uint8_t sreg = SREG;
+  cli();
+  Rticks_per_bit = t;
+  Rticks_per_semibit = Rticks_per_bit / 2;
+  Rticks_per_bit_and_semibit = Rticks_per_bit + Rticks_per_semibit;
+  Rticks_suppression = Rticks_per_semibit + Rticks_per_semibit / 4; // to avoid early ISR capture (spike, bouncing rising edge) may lead to very long while loop behaviour and loss of sync.
+#ifdef BIT_CALIBRATION
+  cal_frame_ticks = 11 * Rticks_per_bit;
+  cal_tolerance = Rticks_per_bit / 4;
+#endif /* BIT_CALIBRATION */
+  SREG = sreg;
+}
+
 static uint8_t rx_state;
 static uint8_t rx_byte;
 static uint8_t rx_paritycheck;
@@ -409,10 +474,10 @@ void P1P2MQTT::begin(uint32_t baud, bool use_ADC /* = false */, uint8_t ADC_pin0
 {
   uint32_t cycles_per_bit = ((ALTSS_BASE_FREQ + baud / 2) / baud); // 833 cycles at 8MHz
 
-  Rticks_per_bit = cycles_per_bit;
-  Rticks_per_semibit = Rticks_per_bit / 2;
-  Rticks_per_bit_and_semibit = Rticks_per_bit + Rticks_per_semibit;
-  Rticks_suppression = Rticks_per_semibit + Rticks_per_semibit / 4; // to avoid early ISR capture (spike, bouncing rising edge) may lead to very long while loop behaviour and loss of sync.
+  setReadTiming(cycles_per_bit);
+#ifdef BIT_CALIBRATION
+  Rticks_nominal = cycles_per_bit;
+#endif /* BIT_CALIBRATION */
 
   Wticks_per_semibit = cycles_per_bit / 2;
   Wticks_per_bit_and_semibit = 3 * Wticks_per_semibit;
@@ -460,6 +525,9 @@ void P1P2MQTT::begin(uint32_t baud, bool use_ADC /* = false */, uint8_t ADC_pin0
   // start ADC measurements on pins ADC_pin0 and ADC_pin1 if use_ADC is true
   _use_ADC = use_ADC;
   if (_use_ADC) {
+#ifdef SIGNAL_QUALITY
+    signalQualityReset();
+#endif /* SIGNAL_QUALITY */
     ADMUX0 = 0xC0 | ADC_pin0; // 1.1V reference
     ADMUX1 = 0xC0 | ADC_pin1; // 1.1V reference
     DIDR0 = ((1 << ADC_pin0) | (1 << ADC_pin1)) & 0x3F; // disable digital input on analog pins
@@ -510,7 +578,39 @@ ISR(S_TIMER_COMP_vect)
 static uint16_t tx_setdelaytimeout = 2500;
 #ifdef MHI_SERIES
 static volatile uint8_t mhiConvert = 1;
-#endif
+
+// MHI trio format: each byte is sent as 3 bus bytes, each with a single 0 bit at the position given by 3 bits of the byte (lsb first)
+// many thanks to HamdiOlgun for reverse engineering byte encoding in MHI protocol (https://community.openhab.org/t/mitsubishi-heavy-x-y-line-protocol/82898/9)
+static const uint8_t mhiTrioEncode[8] PROGMEM = { 0xFE, 0xFD, 0xFB, 0xF7, 0xEF, 0xDF, 0xBF, 0x7F };
+// 3-bit value of inverted bus byte b: bit 2 if (b & 0xF0), bit 1 if (b & 0xCC), bit 0 if (b & 0xAA), looked up per nibble
+static const uint8_t mhiTrioDecodeLo[16] PROGMEM = { 0, 0, 1, 1, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3 };
+static const uint8_t mhiTrioDecodeHi[16] PROGMEM = { 0, 4, 5, 5, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7 };
+
+static inline uint8_t mhiTrioDecode(uint8_t b)
+{
+  b = ~b;
+  return pgm_read_byte(&mhiTrioDecodeHi[b >> 4]) | pgm_read_byte(&mhiTrioDecodeLo[b & 0x0F]);
+}
+
+static inline uint8_t mhiTrioPart(uint8_t b, uint8_t pos)
+// returns contribution of bus byte b at position pos (0..2) of a trio to the converted byte
+{
+  uint8_t v = mhiTrioDecode(b);
+  if (pos == 0) return v;
+  if (pos == 1) return v << 3;
+  return (v & 0x03) << 6; // third bus byte carries 2 bits (b & 0xF0 should be 0)
+}
+
+#ifdef MHI_RX_COMPACT
+#define RX_TRIO_OPEN rx_trio_pos
+// trio being received (or echoed) into the read buffer; rx_trio_head is only added to the read buffer (rx_buffer_head) when complete or at end of packet
+static volatile uint8_t rx_trio_pos = 0;         // position (0..2) of next bus byte in trio
+static volatile uint8_t rx_trio_head = NO_HEAD2; // read buffer position of trio, or NO_HEAD2 if not stored (buffer overrun)
+#endif /* MHI_RX_COMPACT */
+#endif /* MHI_SERIES */
+#ifndef RX_TRIO_OPEN
+#define RX_TRIO_OPEN 0
+#endif /* RX_TRIO_OPEN */
 #ifdef SW_SCOPE
 volatile byte sw_scope = 0;
 volatile byte sw_scope_next = 0;
@@ -522,7 +622,72 @@ volatile uint16_t sws_capture[SWS_MAX];
 volatile uint16_t sws_count[SWS_MAX];
 volatile uint8_t sws_cnt = 0;
 
+#ifdef SW_SCOPE_STREAM
+volatile uint8_t sws_stream[2][SW_SCOPE_STREAM];
+volatile uint8_t sws_stream_len[2] = { 0, 0 };
+volatile uint8_t sws_stream_full = 0;
+volatile uint8_t sws_stream_fill = 0;
+volatile uint16_t sws_stream_lost = 0;
+static uint16_t sws_stream_prev;
+static uint8_t sws_stream_first = 1;
+
+#if F_CPU > 8000000L
+#define SWS_STREAM_SHIFT 4 // 16 MHz, 1us resolution
+#else
+#define SWS_STREAM_SHIFT 3 // 8 MHz, 1us resolution
+#endif
+
+static inline void sws_stream_put(uint16_t capture, uint8_t event)
+// called from ISR only; appends one event to the half being filled, switches halves if full,
+// drops the event if both halves are full (first interval after a loss is reported as 0)
+{
+  uint16_t v = sws_stream_first ? 0 : ((uint16_t) (capture - sws_stream_prev)) >> SWS_STREAM_SHIFT;
+  sws_stream_prev = capture;
+  sws_stream_first = 0;
+  if (v > 0x1FFF) v = 0x1FFF;
+  v = (v << 3) | (event >> 5);
+  uint8_t enc[5];
+  uint8_t n = 0;
+  while (v >= 0x20) {
+    enc[n++] = '0' + (v & 0x1F);
+    v >>= 5;
+  }
+  enc[n++] = 'P' + v;
+  if ((event >> 5) == 7) enc[n++] = 'P' + (event & 0x1F);
+  uint8_t h = sws_stream_fill;
+  if (sws_stream_len[h] + n > SW_SCOPE_STREAM) {
+    if (sws_stream_full & (1 << (h ^ 1))) {
+      if (sws_stream_lost < 0xFFFF) sws_stream_lost++;
+      sws_stream_first = 1;
+      return;
+    }
+    sws_stream_full |= (1 << h);
+    h ^= 1;
+    sws_stream_fill = h;
+  }
+  for (uint8_t i = 0; i < n; i++) sws_stream[h][sws_stream_len[h]++] = enc[i];
+}
+
+#define SW_SCOPE_STREAM_EVENT(capture, event) \
+    if (sw_scope == 2) { \
+      sws_stream_put(capture, event); \
+    } else
+
+#define SW_SCOPE_STREAM_START \
+    if (sw_scope == 2) { \
+      sws_stream_first = 1; \
+      sws_stream_put(0, SWS_EVENT_LOOP); \
+    }
+
+#else /* SW_SCOPE_STREAM */
+
+#define SW_SCOPE_STREAM_EVENT(capture, event)
+#define SW_SCOPE_STREAM_START
+
+#endif /* SW_SCOPE_STREAM */
+
 #define SW_SCOPE_LOG_EVENT(capture, event)  \
+    SW_SCOPE_STREAM_EVENT(capture, event) \
     if (sw_scope && (sws_errorcount || !sws_error)) { \
       sws_capture[sws_cnt] = capture; \
       sws_event[sws_cnt] = event; \
@@ -531,6 +696,7 @@ volatile uint8_t sws_cnt = 0;
     }
 
 #define SW_SCOPE_LOG_ERROR(capture, event)  \
+    SW_SCOPE_STREAM_EVENT(capture, event) \
     if (sw_scope && (sws_errorcount || !sws_error)) { \
       if (!sws_error) { \
         sws_error = 1; \
@@ -546,7 +712,8 @@ volatile uint8_t sws_cnt = 0;
         sws_block = 1; \
         sws_cnt = 0; \
         sws_event[SWS_MAX - 1] = SWS_EVENT_LOOP; \
-        sws_error = 0; };
+        sws_error = 0; \
+        SW_SCOPE_STREAM_START };
 
 #else /* SW_SCOPE */
 
@@ -586,7 +753,7 @@ ISR(MS_TIMER_COMP_vect)
       // if P1P2Monitor is still processing sws_event data (sws_block), do not start writing new events
 #ifdef SW_SCOPE
       // if P1P2Monitor is ready reading data (sws_block = 0), start new log operation in write mode (if sw_scope_next)
-      sw_scope = sw_scope_next && !sws_block;
+      sw_scope = sws_block ? 0 : sw_scope_next;
       if (sw_scope) {
         SW_SCOPE_START_LOG;
         // keep INT_INPUT_CAPTURE enabled
@@ -665,11 +832,9 @@ void P1P2MQTT::write(uint8_t b)
 #ifdef MHI_SERIES
 {
   if (mhiConvert) {
-    writebyte(~(1<< (b & 0x07)));
-    b >>= 3;
-    writebyte(~(1<< (b & 0x07)));
-    b >>= 3;
-    writebyte(~(1<< (b & 0x07)));
+    writebyte(pgm_read_byte(&mhiTrioEncode[b & 0x07]));
+    writebyte(pgm_read_byte(&mhiTrioEncode[(b >> 3) & 0x07]));
+    writebyte(pgm_read_byte(&mhiTrioEncode[b >> 6]));
   } else {
     writebyte(b);
   }
@@ -721,7 +886,8 @@ static volatile uint8_t errorMask = ERROR_MASK;
 ISR(COMPARE_W_INTERRUPT)
 {
   IRQ_START;
-  uint8_t state, bit, bit_input, errorhead, head, tail;
+  uint8_t state, bit, bit_input, errorhead, tail;
+  uint8_t head = rx_buffer_head; // end of packet is signalled on the last byte stored, also without Echo
   uint16_t delay;
   state = tx_state;
   // state indicates in which part of data pattern we are when entering this ISR
@@ -850,19 +1016,49 @@ ISR(COMPARE_W_INTERRUPT)
   }
   // store transmitted byte as it it were received (if buffer space available, and if Echo), and check/store errors
   if (Echo) {
+#ifdef MHI_RX_COMPACT
+    if (rx_trio_pos) {
+      // 2nd or 3rd byte of trio, add to converted byte, which is added to read buffer when trio is complete
+      head = rx_trio_head;
+      if (head != NO_HEAD2) {
+        rx_buffer[head] |= mhiTrioPart(tx_byte_verify, rx_trio_pos);
+        error_buffer[head] |= tx_rx_readbackerror;
+      } else {
+        head = rx_buffer_head;
+      }
+      if (++rx_trio_pos > 2) {
+        rx_trio_pos = 0;
+        rx_buffer_head = head;
+      }
+    } else {
+#endif /* MHI_RX_COMPACT */
     head = rx_buffer_head + 1;
     if (head >= RX_BUFFER_SIZE) head = 0;
     if (head != rx_buffer_tail) {
       rx_buffer[head] = tx_byte_verify; // cheat, transmitted byte
       delta_buffer[head] = startbit_delta;
       error_buffer[head] = tx_rx_readbackerror;
+#ifdef MHI_RX_COMPACT
+      if (mhiConvert) {
+        rx_buffer[head] = mhiTrioPart(tx_byte_verify, 0);
+        rx_trio_head = head;
+        rx_trio_pos = 1;
+      } else
+#endif /* MHI_RX_COMPACT */
       rx_buffer_head = head;
     } else {
       // signal buffer overrun for *previous* byte
       head = rx_buffer_head;
       error_buffer[head] |= ERROR_OR;
       DIGITAL_SET_LED_ERROR;
+#ifdef MHI_RX_COMPACT
+      rx_trio_head = NO_HEAD2;
+      if (mhiConvert) rx_trio_pos = 1;
+#endif /* MHI_RX_COMPACT */
     }
+#ifdef MHI_RX_COMPACT
+    }
+#endif /* MHI_RX_COMPACT */
   }
   // more data to write?
   errorhead = head;
@@ -904,6 +1100,16 @@ ISR(COMPARE_W_INTERRUPT)
   DISABLE_INT_COMPARE_W();
   CONFIG_CAPTURE_FALLING_EDGE(); // should not be needed, just in case
   ENABLE_INT_INPUT_CAPTURE();
+#ifdef MHI_RX_COMPACT
+  if (rx_trio_pos) {
+    // end of packet within trio (write buffer emptied after read-back error)
+    rx_trio_pos = 0;
+    if (rx_trio_head != NO_HEAD2) {
+      error_buffer[rx_trio_head] |= ERROR_INCOMPLETE;
+      rx_buffer_head = errorhead = rx_trio_head;
+    }
+  }
+#endif /* MHI_RX_COMPACT */
   error_buffer[errorhead] |= SIGNAL_EOP;
   DIGITAL_RESET_LED_WRITE;
   IRQ_STOP;
@@ -930,6 +1136,22 @@ void P1P2MQTT::setScope(byte b)
 {
   sw_scope_next = b;
 }
+
+#ifdef SW_SCOPE_STREAM
+void P1P2MQTT::scopeStreamFlush()
+// Hand over a partially filled stream half to P1P2Monitor (if the other half is free),
+// so the tail of a packet is output without waiting for the next packet
+{
+  uint8_t sreg = SREG;
+  cli();
+  uint8_t h = sws_stream_fill;
+  if (sws_stream_len[h] && !(sws_stream_full & (1 << (h ^ 1)))) {
+    sws_stream_full |= (1 << h);
+    sws_stream_fill = h ^ 1;
+  }
+  SREG = sreg;
+}
+#endif /* SW_SCOPE_STREAM */
 #endif /* SW_SCOPE */
 
 
@@ -958,6 +1180,65 @@ void P1P2MQTT::setAllow(uint8_t b)
   Allow = b;
 }
 
+#ifdef BIT_CALIBRATION
+void P1P2MQTT::calibrate(uint8_t mode)
+// Start or stop bit timing calibration
+// mode 0: stop, return to nominal read timing (and to the previous Allow if a one-shot calibration was in progress)
+// mode 1: one-shot: measure with Allow at its maximum, then apply bit period and Allow (never below previous Allow), and stop
+// mode 2: continuous: apply bit period after each window, raise Allow if observed pauses come close to it
+{
+  uint8_t sreg = SREG;
+  cli();
+  if (cal_mode == 1) Allow = cal_allow_saved;
+  cal_sum_ticks = 0;
+  cal_sum_bits = 0;
+  cal_max_pause = 0;
+  cal_mode = mode;
+  if (mode == 1) {
+    cal_allow_saved = Allow;
+    Allow = 65535 / Rticks_per_bit - 2;
+  }
+  SREG = sreg;
+  if (!mode) setReadTiming(Rticks_nominal);
+}
+
+uint8_t P1P2MQTT::calibrationUpdate(uint16_t &ticksPerBit, uint16_t &nominalTicksPerBit, uint8_t &maxPause, uint8_t &allow)
+// To be called regularly from loop(); returns 0 if no new calibration result is available,
+// 1 if bit period was measured and applied, 2 if measured bit period was out of range and not applied.
+// Timer ticks are F_CPU cycles.
+{
+  if (!cal_mode || (cal_sum_bits < CALIBRATION_WINDOW_BITS)) return 0;
+  uint8_t sreg = SREG;
+  cli();
+  uint32_t sum_ticks = cal_sum_ticks;
+  uint16_t sum_bits = cal_sum_bits;
+  uint16_t max_pause = cal_max_pause;
+  cal_sum_ticks = 0;
+  cal_sum_bits = 0;
+  cal_max_pause = 0;
+  SREG = sreg;
+  ticksPerBit = (sum_ticks + (sum_bits >> 1)) / sum_bits;
+  nominalTicksPerBit = Rticks_nominal;
+  uint8_t result = 1;
+  if ((ticksPerBit > Rticks_nominal + Rticks_nominal / CALIBRATION_MAX_DEVIATION) || (ticksPerBit < Rticks_nominal - Rticks_nominal / CALIBRATION_MAX_DEVIATION)) {
+    result = 2;
+  } else {
+    setReadTiming(ticksPerBit);
+  }
+  maxPause = (max_pause + Rticks_per_bit - 1) / Rticks_per_bit;
+  uint8_t allowMax = 65535 / Rticks_per_bit - 2;
+  uint8_t a = (maxPause + CALIBRATION_ALLOW_MARGIN < allowMax) ? maxPause + CALIBRATION_ALLOW_MARGIN : allowMax;
+  if (cal_mode == 1) {
+    Allow = (a > cal_allow_saved) ? a : cal_allow_saved;
+    cal_mode = 0;
+  } else if (a > Allow) {
+    Allow = a;
+  }
+  allow = Allow;
+  return result;
+}
+#endif /* BIT_CALIBRATION */
+
 void P1P2MQTT::setEcho(uint8_t b)
 // Set echo mode (verify and read back written data) on or off
 // off: no read-back, no verification or bus collission detection
@@ -968,6 +1249,159 @@ void P1P2MQTT::setEcho(uint8_t b)
 }
 
 static uint16_t prev_edge_capture;  // previous capture of edge
+
+#ifdef SIGNAL_QUALITY
+// Signal-quality profiler: as the ADC ISR alternates between V0 and V1, the bus voltage V0 is sampled roughly once per bit.
+// At the start of each V0 conversion the timer, rx_state and the last falling edge are recorded. Upon completion, the sample is
+// classified by its distance to the last falling edge: low half-bit (within the first semibit, excluding 1/4 semibit around
+// the edges), high (after the first semibit plus margin), or idle (no reception); samples during own transmission or within
+// 1/4 semibit of an edge or of any later bit boundary are ignored. Samples are thus taken at random bit phases, and the
+// statistics build up over many packets.
+// Low/high statistics are kept per packet source (first byte of the packet); the first byte of each packet itself is not attributed.
+#define SQ_SH_TICKS 96     // ADC sample-and-hold occurs 1.5 ADC clocks (1.5 * 64 cycles) after conversion start
+#define SQ_NO_SLOT 0xFF
+#define SQ_FIRST_BYTE 0xFE // packet started, source not yet known
+static uint8_t sq_src[SIGNAL_QUALITY];
+static uint8_t sq_used = 0;
+static uint8_t sq_slot = SQ_NO_SLOT;
+static sq_stat_t sq_idle;
+static sq_stat_t sq_low[SIGNAL_QUALITY];
+static sq_stat_t sq_high[SIGNAL_QUALITY];
+static uint16_t sq_hist[3][SQ_HIST_BINS];
+static uint16_t sq_t;
+static uint16_t sq_edge;
+static uint8_t sq_rx;
+static uint8_t sq_t_slot;
+
+static inline void sq_trigger(void)
+{
+  sq_t = GET_TIMER_R_COUNT();
+  sq_rx = tx_state ? 0xFF : rx_state;
+  sq_edge = prev_edge_capture;
+  sq_t_slot = sq_slot;
+}
+
+static void sq_add(sq_stat_t* st, uint16_t V)
+{
+  if (st->cnt >= SIGNAL_QUALITY_MAX_CNT) {
+    st->cnt >>= 1;
+    st->sum >>= 1;
+    st->sumsq >>= 1;
+  }
+  st->cnt++;
+  st->sum += V;
+  st->sumsq += (uint32_t) V * V;
+  if (V < st->min) st->min = V;
+  if (V > st->max) st->max = V;
+}
+
+static inline void sq_sample(uint16_t V)
+{
+  uint8_t c;
+  if (sq_rx == 0xFF) return;
+  if (sq_rx) {
+    uint16_t d = sq_t + SQ_SH_TICKS - sq_edge;
+    uint16_t guard = Rticks_per_semibit >> 2;
+    uint16_t p = d;
+    while (p >= Rticks_per_bit) p -= Rticks_per_bit; // d % Rticks_per_bit, d spans at most a byte
+    if ((p < guard) || (p > Rticks_per_bit - guard)) return; // close to a bit boundary, where an edge may not have been captured yet
+    if (d <= Rticks_per_semibit - guard) {
+      c = SQ_LOW;
+    } else if (d >= Rticks_per_semibit + guard) {
+      c = SQ_HIGH;
+    } else {
+      return;
+    }
+  } else {
+    c = SQ_IDLE;
+  }
+  uint16_t* h = sq_hist[c];
+  if (++h[V >> SIGNAL_QUALITY_HIST_SHIFT] == 0xFFFF) {
+    for (uint8_t i = 0; i < SQ_HIST_BINS; i++) h[i] >>= 1;
+  }
+  if (c == SQ_IDLE) {
+    sq_add(&sq_idle, V);
+  } else if (sq_t_slot < SIGNAL_QUALITY) {
+    sq_add((c == SQ_LOW) ? &sq_low[sq_t_slot] : &sq_high[sq_t_slot], V);
+  }
+}
+
+static inline void sq_source(uint8_t src)
+// called upon reception of first byte of a packet
+{
+  for (uint8_t i = 0; i < sq_used; i++) {
+    if (sq_src[i] == src) {
+      sq_slot = i;
+      return;
+    }
+  }
+  if (sq_used < SIGNAL_QUALITY) {
+    sq_src[sq_used] = src;
+    sq_slot = sq_used++;
+  } else {
+    sq_slot = SQ_NO_SLOT;
+  }
+}
+
+static void sq_clear(sq_stat_t* st)
+{
+  st->cnt = 0;
+  st->sum = 0;
+  st->sumsq = 0;
+  st->min = 0xFFFF;
+  st->max = 0;
+}
+
+void P1P2MQTT::signalQualityReset(void)
+{
+  uint8_t sreg = SREG;
+  cli();
+  sq_clear(&sq_idle);
+  for (uint8_t i = 0; i < SIGNAL_QUALITY; i++) {
+    sq_clear(&sq_low[i]);
+    sq_clear(&sq_high[i]);
+  }
+  for (uint8_t i = 0; i < SQ_HIST_BINS; i++) sq_hist[SQ_IDLE][i] = sq_hist[SQ_LOW][i] = sq_hist[SQ_HIGH][i] = 0;
+  sq_used = 0;
+  sq_slot = SQ_NO_SLOT;
+  SREG = sreg;
+}
+
+bool P1P2MQTT::signalQuality(uint8_t slot, uint8_t &src, sq_stat_t &low, sq_stat_t &high)
+// returns statistics (in ADC counts) of low and high half-bit samples of packets from source slot, false if slot unused
+{
+  if (!_use_ADC || (slot >= sq_used)) return false;
+  ADC_INT_DISABLE;
+  src = sq_src[slot];
+  low = sq_low[slot];
+  high = sq_high[slot];
+  ADC_INT_ENABLE;
+  return true;
+}
+
+void P1P2MQTT::signalQualityIdle(sq_stat_t &idle)
+{
+  ADC_INT_DISABLE;
+  idle = sq_idle;
+  ADC_INT_ENABLE;
+}
+
+void P1P2MQTT::signalQualityHistogram(uint8_t sqClass, uint16_t* hist)
+// copies SQ_HIST_BINS bins of class SQ_IDLE, SQ_LOW or SQ_HIGH (all sources)
+{
+  ADC_INT_DISABLE;
+  for (uint8_t i = 0; i < SQ_HIST_BINS; i++) hist[i] = sq_hist[sqClass][i];
+  ADC_INT_ENABLE;
+}
+
+#define SQ_PACKET_START if (!state) sq_slot = SQ_FIRST_BYTE;
+#define SQ_BYTE(b) if (sq_slot == SQ_FIRST_BYTE) sq_source(b);
+#define SQ_EOP sq_slot = SQ_NO_SLOT;
+#else /* SIGNAL_QUALITY */
+#define SQ_PACKET_START {};
+#define SQ_BYTE(b) {};
+#define SQ_EOP {};
+#endif /* SIGNAL_QUALITY */
 #ifdef H_SERIES
 static byte firstbyteUncertainty = 0; // 1 signals 11/12 bit uncertainty
 #endif /* H_SERIES */
@@ -1008,7 +1442,7 @@ ISR(CAPTURE_INTERRUPT)
   }
   if (state) {
     // detect/suppress oscillations or spurious spikes (except when expecting new start pulse, where comparison may fail due to 16-bit limitation)
-    if (capture - prev_edge_capture < Rticks_suppression) {
+    if ((uint16_t) (capture - prev_edge_capture) < Rticks_suppression) {
       // log spike
       SW_SCOPE_LOG_EVENT(capture, SWS_EVENT_EDGE_SPIKE | state);
 #ifdef SUPPRESS_OSCILLATION
@@ -1024,10 +1458,13 @@ ISR(CAPTURE_INTERRUPT)
                   firstbyteUncertainty = SIGNAL_UC;
 #endif /* H_SERIES */
                   // this is first falling edge, it must be start pulse. First confirm received byte, if any (!NO_HEAD2), without SIGNAL_EOP
-                  if (rx_buffer_head2 != NO_HEAD2) {
+                  // (for MHI_RX_COMPACT, only once its trio is complete)
+                  if ((rx_buffer_head2 != NO_HEAD2) && !RX_TRIO_OPEN) {
                     rx_buffer_head = rx_buffer_head2;
                     rx_buffer_head2 = NO_HEAD2;
                   }
+                  CAL_START(capture, state);
+                  SQ_PACKET_START;
                   startbit_delta = time_msec;
                   // time_msec = 0; // to prevent a write start to reduce bus collision risk, not needed as MS_TIMER is disabled anyway
                   DISABLE_MS_TIMER();
@@ -1047,6 +1484,7 @@ ISR(CAPTURE_INTERRUPT)
                   break;
     case 2 ... 9: // data bits (except for H-link2 and state=2, in which case this is a 0 data bit OR a 2nd 0 start bit,
                   //            for now assume it is data bit and correct later if assumption is wrong)
+                  CAL_EDGE(capture, state);
                   rx_byte >>= 1;
                   rx_target += Rticks_per_bit; // set target time to (one semibit after) next possible falling edge
                   SET_COMPARE_R(rx_target);
@@ -1054,6 +1492,7 @@ ISR(CAPTURE_INTERRUPT)
                   rx_state = state + 1;
                   break;
     case 10     : // state=10: parity bit (in case of H-link2: parity bit OR data bit)
+                  CAL_EDGE(capture, state);
 #ifdef H_SERIES
                   if (firstbyteUncertainty) {
                     // not sure yet regular 11-bit or double-start-bit pattern; we can shift one more time, shifting 0 out of rx_byte
@@ -1139,11 +1578,18 @@ ISR(COMPARE_R_INTERRUPT)
     case  1     : // no new start bit detected within expected time frame; thus pause in received data detected; register SIGNAL_EOP and quit rx mode
                   DISABLE_INT_COMPARE_R();
                   rx_state = 0;
+                  SQ_EOP;
                   if (rx_buffer_head2 != NO_HEAD2) {
                     rx_buffer_head = rx_buffer_head2;
+#ifdef MHI_RX_COMPACT
+                    if (rx_trio_pos) error_buffer[rx_buffer_head] |= ERROR_INCOMPLETE;
+#endif /* MHI_RX_COMPACT */
                     error_buffer[rx_buffer_head] |= SIGNAL_EOP;
                     rx_buffer_head2 = NO_HEAD2;
                   }
+#ifdef MHI_RX_COMPACT
+                  rx_trio_pos = 0;
+#endif /* MHI_RX_COMPACT */
                   DIGITAL_RESET_LED_READ;
                   IRQ_STOP;
                   IRQ_END_R;
@@ -1202,10 +1648,33 @@ ISR(COMPARE_R_INTERRUPT)
                   SET_COMPARE_R(rx_target + Rticks_per_bit * (1 + (stopBit ? 0 : 1) + Allow));
 #endif /* H_SERIES */
                   rx_state = 1;
+#ifdef MHI_RX_COMPACT
+                  if (rx_trio_pos) {
+                    // 2nd or 3rd byte of trio, add to converted byte (rx_buffer_head2 is confirmed when trio is complete)
+                    head = rx_trio_head;
+                    if (head != NO_HEAD2) {
+                      rx_buffer[head] |= mhiTrioPart(rx_byte, rx_trio_pos);
+                      if (rx_paritycheck) {
+                        error_buffer[head] |= ERROR_PE;
+                        SW_SCOPE_LOG_ERROR(capture, SWS_EVENT_ERR_PE);
+                      }
+                    }
+                    if (++rx_trio_pos > 2) rx_trio_pos = 0;
+                  } else {
+#endif /* MHI_RX_COMPACT */
                   head = rx_buffer_head + 1;
                   if (head >= RX_BUFFER_SIZE) head = 0;
                   if (head != rx_buffer_tail) {
+#ifdef MHI_RX_COMPACT
+                    if (mhiConvert) {
+                      rx_buffer[head] = mhiTrioPart(rx_byte, 0);
+                      rx_trio_pos = 1;
+                    } else
+#endif /* MHI_RX_COMPACT */
                     rx_buffer[head] = rx_byte;
+#ifdef MHI_RX_COMPACT
+                    rx_trio_head = head;
+#endif /* MHI_RX_COMPACT */
                     delta_buffer[head] = startbit_delta; // time from previous byte
 #ifndef H_SERIES
                     error_buffer[head] = 0;
@@ -1227,10 +1696,18 @@ ISR(COMPARE_R_INTERRUPT)
                     error_buffer[rx_buffer_head] |= ERROR_OR;
                     DIGITAL_SET_LED_ERROR;
                     rx_buffer_head2 = rx_buffer_head; // so SIGNAL_EOP can be added
+#ifdef MHI_RX_COMPACT
+                    rx_trio_head = NO_HEAD2;
+                    if (mhiConvert) rx_trio_pos = 1;
+#endif /* MHI_RX_COMPACT */
                   }
+#ifdef MHI_RX_COMPACT
+                  }
+#endif /* MHI_RX_COMPACT */
 #ifdef H_SERIES
                   firstbyteUncertainty = 0;
 #endif /* H_SERIES */
+                  SQ_BYTE(rx_byte);
                   PRESET_ENABLE_MS_TIMER();
                   break;
     case 0      :
@@ -1267,7 +1744,7 @@ errorbuf_t P1P2MQTT::read_error(void)
   tail = rx_buffer_tail;
   if (head == tail) return 0;
   if (++tail >= RX_BUFFER_SIZE) tail = 0;
-#ifdef MHI_SERIES
+#if defined MHI_SERIES && !defined MHI_RX_COMPACT
   if (mhiConvert) {
     out = error_buffer[tail];
     if (head == tail) return (out | ERROR_INCOMPLETE);
@@ -1287,28 +1764,47 @@ errorbuf_t P1P2MQTT::read_error(void)
 
 uint8_t  P1P2MQTT::read(void)
 #ifdef MHI_SERIES
-// many thanks to HamdiOlgun for reverse engineering byte encoding in MHI protocol (https://community.openhab.org/t/mitsubishi-heavy-x-y-line-protocol/82898/9)
 {
+#ifndef MHI_RX_COMPACT
   if (mhiConvert) {
-    uint8_t b = ~readbyte();
-    uint8_t out = 0x00;
-    if (b & 0xF0) out += 0x04;
-    if (b & 0xCC) out += 0x02;
-    if (b & 0xAA) out += 0x01;
+    uint8_t out = mhiTrioPart(readbyte(), 0);
     if (!available()) return out;
-    b = ~readbyte();
-    if (b & 0xF0) out += 0x20;
-    if (b & 0xCC) out += 0x10;
-    if (b & 0xAA) out += 0x08;
+    out |= mhiTrioPart(readbyte(), 1);
     if (!available()) return out;
-    b = ~readbyte();
-    // if (b & 0xF0) error, should be 0
-    if (b & 0xCC) out += 0x80;
-    if (b & 0xAA) out += 0x40;
-    return out;
-  } else {
-    return readbyte();
+    return out | mhiTrioPart(readbyte(), 2);
+  }
+#endif /* MHI_RX_COMPACT */
+  return readbyte();
+}
+
+uint8_t P1P2MQTT::readtrio(errorbuf_t &error)
+// reads one converted byte (trio) and its error code in one pass over the read buffer
+// should only be called if available()==1; otherwise, returns 0
+{
+  uint8_t head, tail, out;
+
+  head = rx_buffer_head;
+  tail = rx_buffer_tail;
+  if (head == tail) return 0;
+  if (++tail >= RX_BUFFER_SIZE) tail = 0;
+  error = error_buffer[tail];
+  out = rx_buffer[tail];
+#ifndef MHI_RX_COMPACT
+  if (mhiConvert) {
+    out = mhiTrioPart(out, 0);
+    for (uint8_t pos = 1; pos < 3; pos++) {
+      if (head == tail) {
+        error |= ERROR_INCOMPLETE;
+        break;
+      }
+      if (++tail >= RX_BUFFER_SIZE) tail = 0;
+      error |= error_buffer[tail];
+      out |= mhiTrioPart(rx_buffer[tail], pos);
+    }
   }
+#endif /* MHI_RX_COMPACT */
+  rx_buffer_tail = tail;
+  return out;
 }
 
 uint8_t P1P2MQTT::readbyte(void)
@@ -1354,11 +1850,7 @@ void P1P2MQTT::flushInput(void)
   rx_buffer_head = rx_buffer_tail;
 }
 
-#ifdef MHI_SERIES
-uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t cs_gen)
-#else /* MHI_SERIES */
-uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t crc_gen, uint8_t crc_feed)
-#endif
+uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t checksum)
 {
 // Reads one packet (in blocking mode)
 // To avoid blocking, only call this function if packetavailable()
@@ -1368,18 +1860,11 @@ uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* err
 // reading continues in case of error
 // stores maximum of maxlen bytes of error codes into errorbuf (unless errorbuf = NULL),
 // returns timing information (pause on bus before this package) in parameter delta
-// If crc_gen is not zero, verifies last byte as CRC byte; CRC byte is also stored and is counted in return value if space is available
-// If cs_gen is not zero, verifies last byte as checksum (sum % 256) byte; checksum byte is also stored and is counted in return value if space is available
+// If checksum is not zero, verifies last byte as checksum byte of the bus protocol (P1P2Checksum, CRC for Daikin, sum for MHI, XOR for H-link2);
+// checksum byte is also stored and is counted in return value if space is available
   uint8_t EOP = 0;
   uint8_t bytecnt = 0;
-#ifdef MHI_SERIES
-  uint8_t mhicnt = 0;
-  uint8_t cs = 0;
-#elif defined H_SERIES
-  uint8_t cxor = 0;
-#else /* MHI_SERIES, H_SERIES */
-  uint8_t crc = crc_feed;
-#endif
+  P1P2Checksum cs;
 #ifdef H_SERIES
   uint8_t expectedLength = 0xFF; // split H-link2 packets based on 3rd byte
 #endif /* H_SERIES */
@@ -1390,7 +1875,13 @@ uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* err
   while (!EOP && (expectedLength > bytecnt)) {
 #endif /* H_SERIES */
     if (available()) {
+#ifdef MHI_SERIES
+      errorbuf_t error = 0;
+      if (!bytecnt) delta = read_delta();
+      uint8_t c = readtrio(error);
+#else /* MHI_SERIES */
       errorbuf_t error = read_error();
+#endif /* MHI_SERIES */
       EOP = (error & SIGNAL_EOP);
       if (errorbuf) {
         if (bytecnt < maxlen) {
@@ -1399,68 +1890,31 @@ uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* err
           errorbuf[maxlen - 1] |= (error & errorMask);
         }
       }
+#ifndef MHI_SERIES
       if (!bytecnt) delta = read_delta();
       uint8_t c = read();
-#ifdef MHI_SERIES
-      if ((EOP == 0) || (cs_gen == 0)) {
-        if (bytecnt < maxlen) {
-          readbuf[bytecnt] = c;
-        }
-        if (cs_gen != 0) cs += c;
-      } else {
-        // EOP, cs in use, check cs
-        if (bytecnt < maxlen) {
-          readbuf[bytecnt] = c;
-          if (c != cs) {
-            if (bytecnt < maxlen) {
-              errorbuf[bytecnt] |= ERROR_CRC_CS;
-            } else {
-              errorbuf[maxlen - 1] |= ERROR_CRC_CS;
-            }
-            DIGITAL_SET_LED_ERROR;
-          }
-        }
-      }
-#elif defined H_SERIES
+#endif /* MHI_SERIES */
       if (bytecnt < maxlen) {
         readbuf[bytecnt] = c;
       }
-      if (!EOP && (expectedLength > bytecnt + 1)) { // not yet EOP
-        if (bytecnt > 0) cxor ^= c; // XOR calculation exclude the first byte
-      } else { // EOP
-        if (c != cxor && (bytecnt != 1 || c != 0x06)) { // wrong XOR and not a valid Ack
+#ifdef H_SERIES
+      if (expectedLength <= bytecnt + 1) EOP = 1;
+#endif /* H_SERIES */
+      if (!P1P2Checksum::enabled || !checksum) {
+        // no checksum
+      } else if (!EOP) {
+        cs.add(bytecnt, c);
+      } else if ((c != cs.value()) && ((bytecnt >= maxlen) || !P1P2Checksum::bare(readbuf, bytecnt + 1))) {
+        // EOP, checksum in use, wrong checksum (and not a packet without checksum, such as an H-link2 Ack)
+        if (errorbuf) {
           if (bytecnt < maxlen) {
             errorbuf[bytecnt] |= ERROR_CRC_CS;
           } else {
             errorbuf[maxlen - 1] |= ERROR_CRC_CS;
           }
-          DIGITAL_SET_LED_ERROR;
-        }
-      }
-#else /* MHI_SERIES, H_SERIES */
-      if ((EOP == 0) || (crc_gen == 0)) {
-        if (bytecnt < maxlen) {
-          readbuf[bytecnt] = c;
-        }
-        if (crc_gen != 0) for (uint8_t i = 0; i < 8; i++) {
-          crc = (((crc ^ c) & 0x01) ? ((crc >> 1) ^ crc_gen) : (crc >> 1));
-          c >>= 1;
-        }
-      } else {
-        // EOP, crc in use, check crc
-        if (bytecnt < maxlen) {
-          readbuf[bytecnt] = c;
-          if (c != crc) {
-            if (bytecnt < maxlen) {
-              errorbuf[bytecnt] |= ERROR_CRC_CS;
-            } else {
-              errorbuf[maxlen - 1] |= ERROR_CRC_CS;
-            }
-            DIGITAL_SET_LED_ERROR;
-          }
         }
+        DIGITAL_SET_LED_ERROR;
       }
-#endif
       bytecnt++;
 #ifdef H_SERIES
       if (bytecnt == 3) expectedLength = readbuf[2];
@@ -1470,47 +1924,19 @@ uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* err
   return bytecnt;
 }
 
-#ifdef MHI_SERIES
-void P1P2MQTT::writepacket(uint8_t* writebuf, uint8_t l, uint16_t t, uint8_t cs_gen)
-#else /* MHI_SERIES */
-void P1P2MQTT::writepacket(uint8_t* writebuf, uint8_t l, uint16_t t, uint8_t crc_gen, uint8_t crc_feed)
-#endif
+void P1P2MQTT::writepacket(uint8_t* writebuf, uint8_t l, uint16_t t, uint8_t checksum)
 {
 // Writes one packet of l bytes, t ms after last bus action;
-// If crc_gen is not zero, adds CRC byte to packet
-// If cs_gen is not zero, adds CS byte to packet
+// If checksum is not zero, adds the checksum byte of the bus protocol (P1P2Checksum) to the packet
 // Note that t=0 or t=1 increases risk of bus collisions, don't use it if not needed (t<2 will be changed to t=2 in new library).
   setDelay(t);
-#ifdef MHI_SERIES
-  uint8_t cs = 0;
-#elif defined H_SERIES
-  uint8_t cxor = 0;
-#else /* MHI_SERIES, H_SERIES */
-  uint8_t crc = crc_feed;
-#endif
+  P1P2Checksum cs;
   for (uint8_t i = 0; i < l; i++) {
     uint8_t c = writebuf[i];
     write(c);
-#ifdef MHI_SERIES
-    if (cs_gen != 0) cs += c;
-#elif defined H_SERIES
-    if (i > 0) cxor ^= c; // XOR calculation exclude the first byte
-#else /* MHI_SERIES, H_SERIES */
-    if (crc_gen != 0) for (uint8_t i = 0; i < 8; i++) {
-      crc = ((crc ^ c) & 0x01 ? ((crc >> 1) ^ crc_gen) : (crc >> 1));
-      c >>= 1;
-    }
-#endif
+    if (P1P2Checksum::enabled) cs.add(i, c);
   }
-#ifdef MHI_SERIES
-  if (cs_gen) write(cs);
-#elif defined H_SERIES
-  if (l != 2 || cxor != 0x06) { // don't add XOR for ACK
-    write(cxor); // Add XOR checksum as the last byte
-  }
-#else /* MHI_SERIES, H_SERIES */
-  if (crc_gen) write(crc);
-#endif
+  if (P1P2Checksum::enabled && checksum && !P1P2Checksum::bare(writebuf, l)) write(cs.value()); // no checksum for an H-link2 Ack
 }
 
 int32_t P1P2MQTT::uptime_sec(void)
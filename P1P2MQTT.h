@@ -3,6 +3,7 @@
  * Copyright (c) 2019-2024 Arnold Niessen, arnold.niessen-at-gmail-dot-com - licensed under CC BY-NC-ND 4.0 with exceptions (see LICENSE.md)
  *
  * Version history
+ * 20250601 v0.9.58 MHI trio conversion by lookup tables, per trio in readpacket(), optional compact read buffer (MHI_RX_COMPACT)
  * 20240512 v0.9.46 Mitsubishi Heavy Industries (MHI) with increased TX_BUFFER_SIZE/RX_BUFFER_SIZE and data-conversion
  * 20230618 v0.9.39 H-link2 fix buf size
  * 20230604 v0.9.38 H-link2 branch merged into main branch
@@ -68,10 +69,15 @@
 
 #include <inttypes.h>
 #include "Arduino.h"
+#include "P1P2Checksum.h"
 
 // Configuration options
 //#define MEASURE_LOAD                // measures irq processing time
 #define SW_SCOPE                    // records timing info of P1/P2 bus falling edges of start of the packets
+//#define SW_SCOPE_STREAM 48        // scope mode 2: streams all edge intervals of all packets via a double buffer of 2x48 bytes (uncomment to enable, ~110 bytes RAM)
+#ifndef SW_SCOPE
+#undef SW_SCOPE_STREAM
+#endif /* SW_SCOPE */
 #define SWS_FAKE_ERR_CNT 3000       // one fake error generated (per error type) per SWS_FAKE_ERR_CNT checks
 #ifdef H_SERIES
 #define ALLOW_PAUSE_BETWEEN_BYTES 20 // If there is a pause between bytes on the bus which is longer than a 1/4 bit time,
@@ -87,6 +93,14 @@
                                     //  (65536 / Rticks_per_bit) - 2; for 16MHz at most ~37
                                     //  (65536 / Rticks_per_bit) - 2; for  8MHz at most ~76
                                     //   value can be changed with X command on MHI/Toshiba/Hitachi systems
+#define BIT_CALIBRATION             // measures bit period and inter-byte pauses of received traffic to adjust read timing and Allow (see calibrate())
+#define CALIBRATION_WINDOW_BITS 20000 // # of matched bit periods per calibration result (~20s of Daikin traffic)
+#define CALIBRATION_ALLOW_MARGIN 2  // Allow is set to max observed inter-byte pause plus this margin (bits)
+#define CALIBRATION_MAX_DEVIATION 25 // measured bit period is only applied if within 1/25 (4%) of nominal
+//#define SIGNAL_QUALITY 4          // ADC bus signal-quality profiler: bus voltage samples are classified as idle, low or high half-bit,
+                                    // low/high statistics are kept for this many packet source addresses (uncomment to enable, ~350 bytes RAM)
+#define SIGNAL_QUALITY_HIST_SHIFT 6 // histogram bin width in ADC counts (2^6 = 64, 16 bins for 10-bit ADC)
+#define SIGNAL_QUALITY_MAX_CNT 2048 // sample counts/sums are halved at this count, so results follow recent traffic (keeps sum of squares within 32 bits)
 #define S_TIMER                     // support for uptime_sec() in new library, but monopolizes TIMER0, so millis() cannot be used.
                                     // if undefined, TIMER0 is not used, and millis() can be used
                                     // if S_TIMER is undefined, the write budget (and error budget) will not increase over time TODO fix this
@@ -104,8 +118,14 @@
 #define TX_BUFFER_SIZE 65 // write buffer size (1 more than max size needed)
 #define RX_BUFFER_SIZE 65 // read buffer (1 more than max size needed), should be <=254
 #elif defined MHI_SERIES
+//#define MHI_RX_COMPACT    // MHI: the receive ISR converts each trio to one byte in the read buffer (if setMHI(1)), reducing RX_BUFFER_SIZE and
+                            // RAM use by ~320 bytes; without conversion (setMHI(0)) only 40 bus bytes per packet can then be stored
 #define TX_BUFFER_SIZE 121 // write buffer size (1 more than max size needed)
+#ifdef MHI_RX_COMPACT
+#define RX_BUFFER_SIZE 41  // read buffer (1 more than max size needed), holds converted bytes (1 per trio)
+#else /* MHI_RX_COMPACT */
 #define RX_BUFFER_SIZE 121 // read buffer (1 more than max size needed), should be <=254
+#endif /* MHI_RX_COMPACT */
 #elif defined F1F2_SERIES
 #define TX_BUFFER_SIZE 81  // write buffer size (1 more than max size needed)
 #define RX_BUFFER_SIZE 81  // read buffer (1 more than max size needed), should be <=254
@@ -176,12 +196,37 @@ extern volatile uint8_t irq_busy;
 
 #define errorbuf_t uint8_t
 
+#ifdef SIGNAL_QUALITY
+#define SQ_IDLE 0
+#define SQ_LOW  1
+#define SQ_HIGH 2
+#define SQ_HIST_BINS (1024 >> SIGNAL_QUALITY_HIST_SHIFT)
+
+typedef struct {
+  uint16_t cnt;
+  uint16_t min;
+  uint16_t max;
+  uint32_t sum;
+  uint32_t sumsq;
+} sq_stat_t;
+#endif /* SIGNAL_QUALITY */
+
 extern volatile uint16_t sws_capture[SWS_MAX];
 extern volatile uint8_t sws_event[SWS_MAX];
 extern volatile uint8_t sws_cnt;
 extern volatile uint8_t sws_overflow;
 extern volatile byte sws_block;
 extern volatile byte sw_scope;
+#ifdef SW_SCOPE_STREAM
+// scope mode 2: each event is stored as a printable varint, value = (interval_us << 3) | (event >> 5),
+// 5 bits per character, least significant group first, '0'..'O' continue and 'P'..'o' end a value;
+// events with (event >> 5) == 7 (errors, and SWS_EVENT_LOOP at the start of each packet) carry a 2nd value event & 0x1F
+extern volatile uint8_t sws_stream[2][SW_SCOPE_STREAM];
+extern volatile uint8_t sws_stream_len[2];
+extern volatile uint8_t sws_stream_full; // bit h set: half h is full and waits to be drained
+extern volatile uint8_t sws_stream_fill; // half currently being filled
+extern volatile uint16_t sws_stream_lost; // # events lost because both halves were full
+#endif /* SW_SCOPE_STREAM */
 //extern volatile uint16_t count;
 //extern volatile uint16_t capture;
 
@@ -205,27 +250,38 @@ public:
 	static void setDelayTimeout(uint16_t t);
 #ifdef SW_SCOPE
         static void setScope(byte b);
+#ifdef SW_SCOPE_STREAM
+        static void scopeStreamFlush();
+#endif /* SW_SCOPE_STREAM */
 #endif /* SW_SCOPE */
 	static void setEcho(uint8_t b);
         static void setAllow(uint8_t b);
+#ifdef BIT_CALIBRATION
+        static void calibrate(uint8_t mode);
+        static uint8_t calibrationUpdate(uint16_t &ticksPerBit, uint16_t &nominalTicksPerBit, uint8_t &maxPause, uint8_t &allow);
+#endif /* BIT_CALIBRATION */
         static void setErrorMask(uint8_t b);
+        uint16_t readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t checksum = 1);
+        void writepacket(uint8_t* writebuf, uint8_t l, uint16_t t, uint8_t checksum = 1);
 #ifdef MHI_SERIES
-        uint16_t readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t cs_gen = 0);
-        void writepacket(uint8_t* writebuf, uint8_t l, uint16_t t, uint8_t cs_gen = 0);
         static void setMHI(uint8_t b);
-#else /* MHI_SERIES */
-	uint16_t readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t crc_gen = 0, uint8_t crc_feed = 0);
-	void writepacket(uint8_t* writebuf, uint8_t l, uint16_t t, uint8_t crc_gen = 0, uint8_t crc_feed = 0);
-#endif
+#endif /* MHI_SERIES */
         int32_t uptime_sec(void);
         int32_t uptime_millisec(void);
         void ADC_results(uint16_t &V0_min, uint16_t &V0_max, uint32_t &V0_avg, uint16_t &V1_min, uint16_t &V1_max, uint32_t &V1_avg);
+#ifdef SIGNAL_QUALITY
+        bool signalQuality(uint8_t slot, uint8_t &src, sq_stat_t &low, sq_stat_t &high);
+        void signalQualityIdle(sq_stat_t &idle);
+        void signalQualityHistogram(uint8_t sqClass, uint16_t* hist);
+        static void signalQualityReset(void);
+#endif /* SIGNAL_QUALITY */
         void ledPower(bool ledOn);
         void ledError(bool ledOn);
 #ifdef MHI_SERIES
 private:
        static void writebyte(uint8_t byte);
        uint8_t readbyte();
+       uint8_t readtrio(errorbuf_t &error);
 #endif /* MHI_SERIES */
 };
 #endif /* P1P2MQTT_h */
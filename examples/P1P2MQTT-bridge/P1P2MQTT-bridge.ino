@@ -55,6 +55,7 @@
 
 #include "ESPTelnet.h"
 #include "P1P2_Config.h"
+#include "P1P2_Checksum.h"
 #include "P1P2_NetworkParams.h"
 #include "P1P2_HomeAssistant.h"
 #include "P1P2_System.h"
@@ -109,6 +110,18 @@ char sprint_value[ SPRINT_VALUE_LEN + 29 ] = "* [ESP]                     ";
 #define Serial_println(...) {};
 #endif /* DEBUG_OVER_SERIAL */
 
+// prototypes of functions used before their definition (generated by the Arduino IDE, not by other compilers such as for host/)
+void process_for_mqtt(byte* rb, int n, uint32_t fields = 0xFFFFFFFF);
+void mqttSubscribe();
+void buildMqttTopic();
+void reconnectMQTT();
+void configTZ(void);
+void reportState(void);
+void printWelcome(bool includeParams);
+#ifdef CMD_ACK
+void cmdReset(void);
+#endif /* CMD_ACK */
+
 char mqtt_value[ MQTT_VALUE_LEN ] = "\0";
 
 typedef struct EEPROMSettings {
@@ -207,7 +220,7 @@ bool factoryReset = 0;
 
 #define PARAM_MAX_LEN 81      // max of *_LEN below
 #define PARAM_MAX_LEN_TXT "81"
-#define PARAM_NR (sizeof(paramName) / 4)  // nr of configurable items below
+#define PARAM_NR (sizeof(paramName) / sizeof(paramName[0]))  // nr of configurable items below
 #define PARAM_JMASK 19       // param nr of outputMode
 #define PARAM_DEVICE_NAME 13 // param nr of deviceName
 #define PARAM_BRIDGE_NAME 14 // param nr of bridgeName
@@ -780,7 +793,7 @@ uint16_t snprintfLengthMax = 0;
   if (snprintfLength > snprintfLengthMax) snprintfLengthMax = snprintfLength; \
   Serial_println(sprint_value);\
   clientPublishMqttChar('S', MQTT_QOS_SIGNAL, MQTT_RETAIN_SIGNAL, sprint_value);\
-  clientPublishTelnet(0, sprint_value + 2, false);\
+  clientPublishTelnet(nullptr, sprint_value + 2, false);\
 };
 
 #define printfTopicS_MON(formatstring, ...) { \
@@ -791,7 +804,7 @@ uint16_t snprintfLengthMax = 0;
   if (snprintfLength > snprintfLengthMax) snprintfLengthMax = snprintfLength; \
   Serial_println(sprint_value);\
   clientPublishMqttChar('S', MQTT_QOS_SIGNAL, MQTT_RETAIN_SIGNAL, sprint_value);\
-  clientPublishTelnet(0, sprint_value + 2, false);\
+  clientPublishTelnet(nullptr, sprint_value + 2, false);\
   strncpy(sprint_value + 3, "ESP", 3);\
 };
 
@@ -803,7 +816,7 @@ uint16_t snprintfLengthMax = 0;
   }; \
   if (snprintfLength > snprintfLengthMax) snprintfLengthMax = snprintfLength; \
   Serial_println(sprint_value);\
-  clientPublishTelnet(0, sprint_value + 2, false);\
+  clientPublishTelnet(nullptr, sprint_value + 2, false);\
   strncpy(sprint_value + 3, "ESP", 3);\
 };
 
@@ -908,51 +921,44 @@ ESP8266AVRISP* avrprog;
 bool telnetConnected = false;
 char mqttTopic[ MQTT_TOPIC_LEN ];
 byte mqttTopicChar;
-byte mqttSlashChar;
 byte mqttTopicCatChar;
 byte mqttTopicSrcChar;
 byte mqttTopicPrefixLength;
 
-// P1P2/ <topicChar /P1P2MQTT/bridge0 <slashchar> [/ or /a]
-#define topicCharGeneric(x)       { mqttTopic[mqttTopicChar - 1] = '/'; mqttTopic[mqttTopicChar] = x;   mqttTopic[mqttTopicChar + 1] = '\0'; }
-#define topicCharGenericHash(x)   { mqttTopic[mqttTopicChar - 1] = '/'; mqttTopic[mqttTopicChar] = x;   mqttTopic[mqttTopicChar + 1] = '/'; mqttTopic[mqttTopicChar + 2] = '#'; mqttTopic[mqttTopicChar + 3] = '\0';}
-#define topicCharSpecific(x)      { mqttTopic[mqttTopicChar - 1] = '/'; mqttTopic[mqttTopicChar] = x;   mqttTopic[mqttTopicChar + 1] = '/'; mqttTopic[mqttSlashChar] = '\0';                                  }
-#define topicCharSpecificSlash(x) { mqttTopic[mqttTopicChar - 1] = '/'; mqttTopic[mqttTopicChar] = x;   mqttTopic[mqttTopicChar + 1] = '/'; mqttTopic[mqttSlashChar] = '/';                                       mqttTopic[mqttSlashChar + 2] = '/'; }
-
-#define topicCharBin(x)           { mqttTopic[mqttTopicChar - 1] = '/'; mqttTopic[mqttTopicChar] = 'M'; mqttTopic[mqttTopicChar + 1] = '/'; mqttTopic[mqttSlashChar] = '/';     mqttTopic[mqttSlashChar + 1] = x; mqttTopic[mqttSlashChar + 2] = '\0';} // overwrites topic, acceptable in main functions only
-
-byte saveTopicCharPrev = '_';
-byte saveTopicChar = '_';
-byte saveTopicCharNext = '_';
-byte saveTopicCharNext2 = '_';
-byte saveTopicCharNext3 = '_';
-byte saveSlashChar = '_';
-byte saveSlashCharNext = '_';
-byte saveSlashCharNext2 = '_';
-
-void saveTopic() {
-  saveTopicCharPrev = mqttTopic[mqttTopicChar - 1];
-  saveTopicChar = mqttTopic[mqttTopicChar];
-  saveTopicCharNext = mqttTopic[mqttTopicChar + 1];
-  saveTopicCharNext2 = mqttTopic[mqttTopicChar + 2];
-  saveTopicCharNext3 = mqttTopic[mqttTopicChar + 3];
-  saveSlashChar = mqttTopic[mqttSlashChar];
-  saveSlashCharNext = mqttTopic[mqttSlashChar + 1];
-  saveSlashCharNext2 = mqttTopic[mqttSlashChar + 2];
+char mqttTopicShort[ MQTT_TOPIC_LEN ];
+char mqttTopicBin[ MQTT_TOPIC_LEN ];
+byte mqttTopicBinChar;
+
+// mqttTopic      P1P2/P[/deviceName][/bridgeName]/C/S/<entityname>, only C (CAT_*), S (SRC) and entityname (KEY) change
+// mqttTopicShort P1P2/X[/deviceName][/bridgeName], only X changes (topicShort)
+// mqttTopicBin   P1P2/M[/deviceName][/bridgeName]/x, only x changes (topicBin)
+// all three are built once in buildMqttTopic(); call-back routines only compare against them (topicMatch*),
+// so mqttTopic no longer needs to be saved/restored around publishing of S/L/R/W topics or in call-backs
+
+const char* topicShort(char x) {
+  mqttTopicShort[mqttTopicChar] = x;
+  return mqttTopicShort;
+}
+
+const char* topicBin(char x) {
+  mqttTopicBin[mqttTopicBinChar] = x;
+  return mqttTopicBin;
 }
 
-void restoreTopic() {
-  mqttTopic[mqttTopicChar - 1] = saveTopicCharPrev;
-  mqttTopic[mqttTopicChar] = saveTopicChar;
-  mqttTopic[mqttTopicChar + 1] = saveTopicCharNext;
-  mqttTopic[mqttTopicChar + 2] = saveTopicCharNext2;
-  mqttTopic[mqttTopicChar + 3] = saveTopicCharNext3;
-  mqttTopic[mqttSlashChar] = saveSlashChar;
-  mqttTopic[mqttSlashChar + 1] = saveSlashCharNext;
-  mqttTopic[mqttSlashChar + 2] = saveSlashCharNext2;
+bool topicMatchShort(const char* topic, char x) {
+  // P1P2/X[/deviceName][/bridgeName]
+  return (!strncmp(topic, mqttTopicShort, mqttTopicChar)) && (topic[mqttTopicChar] == x) && !strcmp(topic + mqttTopicChar + 1, mqttTopicShort + mqttTopicChar + 1);
 }
 
-#define topicWrite { topicCharSpecific('W'); }
+bool topicMatchGeneric(const char* topic, char x) {
+  // P1P2/X
+  return (!strncmp(topic, mqttTopicShort, mqttTopicChar)) && (topic[mqttTopicChar] == x) && (topic[mqttTopicChar + 1] == '\0');
+}
+
+bool topicMatchBin(const char* topic, char x) {
+  // P1P2/M[/deviceName][/bridgeName]/x
+  return (!strncmp(topic, mqttTopicBin, mqttTopicBinChar)) && (topic[mqttTopicBinChar] == x) && (topic[mqttTopicBinChar + 1] == '\0');
+}
 
 #ifdef TELNET
 ESPTelnet telnet;
@@ -1074,11 +1080,10 @@ bool clientPublishMqtt(const char* key, uint8_t qos, bool retain, const char* va
 }
 
 bool clientPublishMqttChar(const char key, uint8_t qos, bool retain, const char* value = nullptr) {
-  topicCharSpecific(key);
-  return clientPublishMqtt(mqttTopic, qos, retain, value);
+  return clientPublishMqtt(topicShort(key), qos, retain, value);
 }
 
-void clientPublishTelnet(bool includeTopic, const char* value, bool addDate = true) {
+void clientPublishTelnet(const char* topic, const char* value, bool addDate = true) {
   if (telnetConnected) {
     if (!telnetUnlock) {
       // telnet.println(F("locked"));
@@ -1088,8 +1093,8 @@ void clientPublishTelnet(bool includeTopic, const char* value, bool addDate = tr
       sprint_value[ TZ_PREFIX_LEN - 1 ] = '\0';
       telnet.print(sprint_value + 2);
     }
-    if (includeTopic) {
-      telnet.print(mqttTopic);
+    if (topic) {
+      telnet.print(topic);
       telnet.print(F(" "));
     }
     telnet.println(value);
@@ -1098,8 +1103,7 @@ void clientPublishTelnet(bool includeTopic, const char* value, bool addDate = tr
 
 void clientPublishTelnetChar(const char key, const char* value) {
   if (key) {
-    topicCharSpecific(key);
-    clientPublishTelnet(1, /*mqttTopic, */value);
+    clientPublishTelnet(topicShort(key), value);
   } else {
     // should not happen
   }
@@ -1113,56 +1117,111 @@ static byte pseudo0E = 0;
 static byte pseudo0F = 9;
 byte mqttDeleting = 0;
 uint32_t mqttUnsubscribeTime = 0;
+static byte throttle = 1;
+static byte throttleValue = THROTTLE_VALUE;
+static uint32_t throttleStepTime = 0;
 
 
 #define MAXRH 23
 #define PWB (23 * 2 + 36) // max pseudopacket 23 bytes (excl CRC byte), 33 bytes for timestamp-prefix, 1 byte for terminating null, 2 for CRC byte
 
+// typed setters for pseudo packet payload fields (big-endian, as decoded by the *_LE value macros)
+// each setter records where its field ends, so that writePseudoPacket can decode only the fields that changed
+static uint32_t pseudoFieldEnds = 0;
+
+static inline void pseudoPut8(byte* WB, byte i, uint8_t v) {
+  WB[i] = v;
+  pseudoFieldEnds |= (1UL << i);
+}
+
+static inline void pseudoPut16(byte* WB, byte i, uint16_t v) {
+  WB[i]     = (v >> 8) & 0xFF;
+  WB[i + 1] = v & 0xFF;
+  pseudoFieldEnds |= (1UL << (i + 1));
+}
+
+static inline void pseudoPut32(byte* WB, byte i, uint32_t v) {
+  WB[i]     = (v >> 24) & 0xFF;
+  WB[i + 1] = (v >> 16) & 0xFF;
+  WB[i + 2] = (v >> 8) & 0xFF;
+  WB[i + 3] = v & 0xFF;
+  pseudoFieldEnds |= (1UL << (i + 3));
+}
+
+static inline void pseudoHeader(byte* WB, byte packetType) {
+  WB[0] = 0x40;
+  WB[1] = 0x00;
+  WB[2] = packetType;
+  pseudoFieldEnds = 0;
+}
+
+// last decoded content of bridge pseudo packets 40000B-40000F, for change detection
+static byte pseudoLast[5][MAXRH];
+static byte pseudoLastLen[5] = { 0 };
+static byte pseudoSkipped[5] = { 0 };
+
+void pseudoCacheReset(void) {
+  for (byte i = 0; i < 5; i++) pseudoLastLen[i] = 0;
+}
+
+uint32_t pseudoChangedFields(byte* WB, byte rh) {
+// returns mask of the bytes of WB to decode: for bridge pseudo packets, the last byte of each field that changed since it was
+// last decoded (0 if none), otherwise all bytes
+  if ((WB[0] != 0x40) || (WB[2] < 0x0B) || (WB[2] > 0x0F)) return 0xFFFFFFFF;
+  byte p = WB[2] - 0x0B;
+  // decoding may be incomplete during throttling, and outputFilter 0 republishes every value
+  if (throttleValue || !EE.outputFilter || !mqttConnected) {
+    pseudoLastLen[p] = 0;
+    return 0xFFFFFFFF;
+  }
+  uint32_t changed = 0xFFFFFFFF;
+  if ((pseudoLastLen[p] == rh) && (!PSEUDO_REFRESH || (++pseudoSkipped[p] < PSEUDO_REFRESH))) {
+    changed = 0;
+    bool fieldChanged = false;
+    for (byte i = 3; i < rh; i++) {
+      if (WB[i] != pseudoLast[p][i]) fieldChanged = true;
+      if ((pseudoFieldEnds & (1UL << i)) || (i == rh - 1)) {
+        if (fieldChanged) changed |= (1UL << i);
+        fieldChanged = false;
+      }
+    }
+  } else {
+    pseudoSkipped[p] = 0;
+  }
+  pseudoLastLen[p] = rh;
+  memcpy(pseudoLast[p], WB, rh);
+  return changed;
+}
+
 void writePseudoPacket(byte* WB, byte rh)
 // rh is pseudo packet size (without CRC or CS byte)
+// hex rendering and checksum are only done if raw output is requested, only changed fields of bridge pseudo packets are decoded
 {
-  char pseudoWriteBuffer[PWB];
   if (rh > MAXRH) {
     printfTopicS("rh > %d", MAXRH);
     return;
   }
-  sprint_value[ TZ_PREFIX_LEN - 1 ] = '\0';
-  snprintf_P(pseudoWriteBuffer, 33, PSTR("R%sP         "), sprint_value + 7);
-#if (defined MHI_SERIES || defined M_SERIES)
-  uint8_t cs = 0;
-#elif defined H_SERIES
-  uint8_t cxor = 0;
-#else /* MHI_SERIES  || M_SERIES || H_SERIES*/
-  uint8_t crc = CRC_FEED;
-#endif /* MHI_SERIES  || M_SERIES || H_SERIES */
-  for (uint8_t i = 0; i < rh; i++) {
-    uint8_t c = WB[i];
-    snprintf(pseudoWriteBuffer + TZ_PREFIX_LEN + 3 + (i << 1), 3, "%02X", c);
-#if (defined MHI_SERIES || defined M_SERIES)
-    if (CS_GEN != 0) cs += c;
-#elif defined H_SERIES
-    if (i > 0) cxor ^= c; // skip first byte for checksum
-#else /* MHI_SERIES  || M_SERIES || H_SERIES */
-    if (CRC_GEN != 0) for (uint8_t i = 0; i < 8; i++) {
-      crc = ((crc ^ c) & 0x01 ? ((crc >> 1) ^ CRC_GEN) : (crc >> 1));
-      c >>= 1;
+  if (EE.outputMode & 0x0014) {
+    char pseudoWriteBuffer[PWB];
+    sprint_value[ TZ_PREFIX_LEN - 1 ] = '\0';
+    // timestamp prefix is TZ_PREFIX_LEN - 8 characters, followed by "P" and padding up to offset TZ_PREFIX_LEN + 3
+    snprintf_P(pseudoWriteBuffer, 33, PSTR("R%.*sP         "), TZ_PREFIX_LEN - 8, sprint_value + 7);
+    P1P2Checksum cs;
+    for (uint8_t i = 0; i < rh; i++) {
+      uint8_t c = WB[i];
+      snprintf(pseudoWriteBuffer + TZ_PREFIX_LEN + 3 + (i << 1), 3, "%02X", c);
+      cs.add(i, c);
     }
-#endif /* MHI_SERIES  || M_SERIES || H_SERIES */
+    WB[rh] = cs.value();
+    if (P1P2Checksum::enabled) snprintf(pseudoWriteBuffer + TZ_PREFIX_LEN + 3 + (rh << 1), 3, "%02X", cs.value());
+    if (EE.outputMode & 0x0004) clientPublishMqttChar('R', MQTT_QOS_HEX, MQTT_RETAIN_HEX, pseudoWriteBuffer);
+    // pseudoWriteBuffer[22] = 'R';
+    if (EE.outputMode & 0x0010) printfTelnet_MON("R %s", pseudoWriteBuffer + 22);
+  }
+  if ((EE.outputMode & 0x0022) && !mqttDeleting) {
+    uint32_t fields = pseudoChangedFields(WB, rh);
+    if (fields) process_for_mqtt(WB, rh, fields);
   }
-#if (defined MHI_SERIES || defined M_SERIES)
-  WB[rh] = cs;
-  if (CS_GEN) snprintf(pseudoWriteBuffer + TZ_PREFIX_LEN + 3 + (rh << 1), 3, "%02X", cs);
-#elif defined H_SERIES
-  WB[rh] = cxor;
-  snprintf(pseudoWriteBuffer + TZ_PREFIX_LEN + 3 + (rh << 1), 3, "%02X", cxor);
-#else /* MHI_SERIES  || M_SERIES || H_SERIES */
-  WB[rh] = crc;
-  if (CRC_GEN) snprintf(pseudoWriteBuffer + TZ_PREFIX_LEN + 3+ (rh << 1), 3, "%02X", crc);
-#endif /* MHI_SERIES  || M_SERIES || H_SERIES */
-  if (EE.outputMode & 0x0004) clientPublishMqttChar('R', MQTT_QOS_HEX, MQTT_RETAIN_HEX, pseudoWriteBuffer);
-  // pseudoWriteBuffer[22] = 'R';
-  if (EE.outputMode & 0x0010) printfTelnet_MON("R %s", pseudoWriteBuffer + 22);
-  if ((EE.outputMode & 0x0022) && !mqttDeleting) process_for_mqtt(WB, rh);
 }
 
 byte readHex[HB];
@@ -1227,12 +1286,10 @@ bool publishHomeAssistantConfig(const char* deviceSubName,
     /* node_id */ EE.bridgeName,
     /* object_id = uniq_id = entity ID */ entityUniqId);
 
-  topicCharSpecific('L');
-
   HACONFIGMESSAGE_ADD("\"name\":\"%s\",\"uniq_id\":\"%s\",\"avty\":[{\"topic\":\"%s\",\"pl_avail\":\"online\",\"pl_not_avail\":\"offline\"}%s],\"avty_mode\":\"all\",\"dev\":{\"name\":\"%s%s\",\"ids\":[\"%s%s\"],\"mf\":\"%s\",\"mdl\":\"%s\",\"sw\":\"%s\"}",
     /* name        */  entityName, //mqttTopic + mqttTopicPrefixLength, useSrcString,
     /* uniq_id */      entityUniqId,
-    /* avty/topic1 */       mqttTopic, // (L)
+    /* avty/topic1 */       topicShort('L'), // (L)
     /* avty/topic2 */       extraAvailabilityString, // (L)
     /* device */
       /* name */         deviceNameHA, /*underscoreSubName,*/ deviceSubName,
@@ -1277,7 +1334,6 @@ bool publishHomeAssistantConfig(const char* deviceSubName,
   }
 
   // status_topic
-  topicCharSpecificSlash('P'); // slash to add entityname
   switch (haDevice) {
     case HA_BINSENSOR  : HACONFIGMESSAGE_ADD(",\"pl_off\":0,\"pl_on\":1");
                          // fall-through
@@ -1361,9 +1417,6 @@ bool bTotalAvailable = false;   // indicates if bTotal is available
 // include file for parameter conversion
 // include here such that printfTopicS() is available in header file code
 
-static byte throttle = 1;
-static byte throttleValue = THROTTLE_VALUE;
-static uint32_t throttleStepTime = 0;
 #ifdef E_SERIES
 byte controlId = 0;
 #endif /* E_SERIES */
@@ -1427,7 +1480,7 @@ void saveRTC(void) {
 void mqttClientPublishHex(uint16_t blockSize, char* blockStart) {
   char mqttStringHex[MQTT_SAVE_BLOCK_SIZE * 2 + 1];
   for (uint16_t i = 0; i < blockSize; i++) snprintf(mqttStringHex + (i << 1), 3, "%02X", blockStart[i]);
-  mqttClient.publish(mqttTopic, 0, 1, mqttStringHex);
+  mqttClient.publish(mqttTopicBin, 0, 1, mqttStringHex);
 }
 
 void saveMQTT() {
@@ -1436,7 +1489,7 @@ void saveMQTT() {
   mqttSaveTopicChar = MQTT_SAVE_TOPIC_CHAR;
   mqttSaveBytesLeft = sizeof(M);
   while (mqttSaveBytesLeft > 0) {
-    topicCharBin(mqttSaveTopicChar);
+    topicBin(mqttSaveTopicChar);
     if (mqttSaveBytesLeft >= MQTT_SAVE_BLOCK_SIZE) {
       mqttClientPublishHex(MQTT_SAVE_BLOCK_SIZE, mqttSaveBlockStart);
       mqttSaveBytesLeft -= MQTT_SAVE_BLOCK_SIZE;
@@ -1488,13 +1541,12 @@ void loadMQTT() {
   mqttSaveTopicChar = MQTT_SAVE_TOPIC_CHAR;
   mqttSaveBytesLeft = sizeof(M);
   while (mqttSaveBytesLeft > 0) {
-    topicCharBin(mqttSaveTopicChar);
-    if (mqttClient.subscribe(mqttTopic, 0)) {
+    if (mqttClient.subscribe(topicBin(mqttSaveTopicChar), 0)) {
       byte i;
       for (i = 0; i < 50; i++) {
         delay(50);
         if (mqttSaveReceived) {
-          mqttClient.unsubscribe(mqttTopic);
+          mqttClient.unsubscribe(mqttTopicBin);
           if (mqttSaveTopicChar == MQTT_SAVE_TOPIC_CHAR) {
             // first block received via MQTT, check length/version of M.R RTC data block
             if ((sizeof(M.R) != M.R.RTCdataLength) || (M.R.RTCversion != RTC_VERSION)) {
@@ -1514,7 +1566,7 @@ void loadMQTT() {
             }
           }
           if (mqttSaveBytesLeft <= MQTT_SAVE_BLOCK_SIZE) {
-            printfTopicS("Mqtt readback OK %s", mqttTopic);
+            printfTopicS("Mqtt readback OK %s", mqttTopicBin);
             return;
           }
           mqttSaveReceived = 0;
@@ -1530,7 +1582,7 @@ void loadMQTT() {
         }
       }
       if (i == 50) {
-        mqttClient.unsubscribe(mqttTopic);
+        mqttClient.unsubscribe(mqttTopicBin);
         printfTopicS("Mqtt readback %c failed (time-out), init data ..", mqttSaveTopicChar);
         resetDataStructures();
         initDataRTC();
@@ -1613,17 +1665,14 @@ void loadData() {
 }
 
 void mqttSubscribe() {
-  saveTopic();
   // subscribe to P1P2/W and P1P2/W/<bridgename>
-  topicCharGeneric('W');
+  char topicGeneric[ MQTT_TOPIC_LEN ];
+  strlcpy(topicGeneric, topicShort('W'), mqttTopicChar + 2);
   int result;
-  result = mqttClient.subscribe(mqttTopic, MQTT_QOS_CONTROL);
-  printfTopicS("Subscribed to %s result %d", mqttTopic, result);
-  topicCharSpecific('W');
-  result = mqttClient.subscribe(mqttTopic, MQTT_QOS_CONTROL);
-  printfTopicS("Subscribed to %s result %d", mqttTopic, result);
-
-  restoreTopic();
+  result = mqttClient.subscribe(topicGeneric, MQTT_QOS_CONTROL);
+  printfTopicS("Subscribed to %s result %d", topicGeneric, result);
+  result = mqttClient.subscribe(topicShort('W'), MQTT_QOS_CONTROL);
+  printfTopicS("Subscribed to %s result %d", mqttTopicShort, result);
 
   // subscribe to homeassistant/status
   result = mqttClient.subscribe("homeassistant/status", MQTT_QOS_CONTROL);
@@ -1687,6 +1736,9 @@ static uint32_t reconnectTime = 0;
 
 void ATmega_dummy_for_serial() {
   // printfTopicS("Two dummy lines to ATmega.");
+#ifdef CMD_ACK
+  cmdReset();
+#endif /* CMD_ACK */
   Serial.print(F(SERIAL_MAGICSTRING));
   Serial.println(F("* Dummy line 1."));
   Serial.print(F(SERIAL_MAGICSTRING));
@@ -1696,6 +1748,452 @@ void ATmega_dummy_for_serial() {
 char readBuffer[RB];
 static char* rb_buffer = readBuffer;
 static uint16_t serial_rb = 0;
+
+#ifdef DELTA_PACKETS
+// copies of last received packets per 3-byte header, to reconstruct delta-encoded X lines:
+// header, packet length, bitmap of changed bytes after header, changed bytes, check byte (CRC-8 of the full packet)
+typedef P1P2ChecksumCRC<0xD9, 0x00> P1P2DeltaCheck;
+static byte deltaHeader[DELTA_PACKETS][3];
+static byte deltaLength[DELTA_PACKETS] = { 0 };
+static byte deltaCopy[DELTA_PACKETS][HB];
+static byte deltaNext = 0;
+static uint32_t deltaResyncTime = 0;
+
+int8_t deltaFind(byte* rb) {
+  for (byte j = 0; j < DELTA_PACKETS; j++) {
+    if (deltaLength[j] && (deltaHeader[j][0] == rb[0]) && (deltaHeader[j][1] == rb[1]) && (deltaHeader[j][2] == rb[2])) return j;
+  }
+  return -1;
+}
+
+void deltaStore(byte* rb, byte n) {
+  if ((n <= 3) || (n > HB)) return;
+  int8_t j = deltaFind(rb);
+  if (j < 0) {
+    j = deltaNext;
+    if (++deltaNext >= DELTA_PACKETS) deltaNext = 0;
+  }
+  for (byte i = 0; i < 3; i++) deltaHeader[j][i] = rb[i];
+  for (byte i = 0; i < n; i++) deltaCopy[j][i] = rb[i];
+  deltaLength[j] = n;
+}
+
+void deltaResync(byte* rb) {
+  // drop copy and ask P1P2Monitor to send keyframes, at most once per second
+  int8_t j = deltaFind(rb);
+  if (j >= 0) deltaLength[j] = 0;
+  if (espUptime != deltaResyncTime) {
+    deltaResyncTime = espUptime;
+    Serial.print(F(SERIAL_MAGICSTRING));
+    Serial.println(F("B9"));
+  }
+}
+
+byte deltaDecode(const char* s) {
+// reconstructs packet from delta-encoded hex string s in readHex, returns packet length, or 0 if no copy is available
+// or the check byte does not match
+  byte db[HB + (HB >> 3) + 5];
+  byte dn = 0;
+  int n, rbtemp;
+  while ((dn < sizeof(db)) && (sscanf(s, "%2x%n", &rbtemp, &n) == 1)) {
+    db[dn++] = rbtemp;
+    s += n;
+  }
+  if (dn < 4) return 0;
+  byte len = db[3];
+  int8_t j = deltaFind(db);
+  if ((j < 0) || (deltaLength[j] != len)) {
+    deltaResync(db);
+    return 0;
+  }
+  byte k = 4 + ((len - 3 + 7) >> 3);
+  for (byte i = 0; i < len; i++) {
+    readHex[i] = deltaCopy[j][i];
+    if ((i >= 3) && (db[4 + ((i - 3) >> 3)] & (1 << ((i - 3) & 0x07)))) {
+      if (k >= dn) {
+        deltaResync(db);
+        return 0;
+      }
+      readHex[i] = db[k++];
+    }
+  }
+  if ((k + 1 != dn) || (db[k] != P1P2ChecksumOf<P1P2DeltaCheck>(readHex, len))) {
+    deltaResync(db);
+    return 0;
+  }
+  return len;
+}
+#endif /* DELTA_PACKETS */
+
+#ifdef BUS_STATS
+// last bus statistics exported by P1P2Monitor in pseudo packets 00000D (one per src/type header):
+// index, # headers, bus utilisation (per mille, u16), src, type, count (u16), min gap (ms), min reply latency (ms), 6 gap histogram bins
+#define BUS_STATS_BINS 6
+typedef struct {
+  byte src;
+  byte packetType;
+  uint16_t count;
+  byte minGap;
+  byte minReply;
+  byte hist[BUS_STATS_BINS];
+} busStatsEntry;
+busStatsEntry busStats[BUS_STATS];
+byte busStatsUsed = 0;
+uint16_t busStatsBusy = 0;
+uint32_t busStatsTime = 0;
+
+void busStatsStore(byte* rb, byte n) {
+  if ((n < 13 + BUS_STATS_BINS) || (rb[3] >= BUS_STATS)) return;
+  byte j = rb[3];
+  busStatsUsed = (rb[4] < BUS_STATS) ? rb[4] : BUS_STATS;
+  busStatsBusy = (rb[5] << 8) | rb[6];
+  busStatsTime = espUptime;
+  busStats[j].src = rb[7];
+  busStats[j].packetType = rb[8];
+  busStats[j].count = (rb[9] << 8) | rb[10];
+  busStats[j].minGap = rb[11];
+  busStats[j].minReply = rb[12];
+  for (byte b = 0; b < BUS_STATS_BINS; b++) busStats[j].hist[b] = rb[13 + b];
+}
+
+void busStatsPrint(void) {
+  if (!busStatsUsed) {
+    printfTopicS("No bus statistics received from ATmega yet");
+    return;
+  }
+  printfTopicS("Bus utilisation %i.%i%%, %i headers, age %i s", busStatsBusy / 10, busStatsBusy % 10, busStatsUsed, espUptime - busStatsTime);
+  printfTopicS("Src Tp  count gap>= reply>= gaps(ms) <10 <20 <40 <80 <160 >=160");
+  for (byte j = 0; j < busStatsUsed; j++) {
+    busStatsEntry* e = &busStats[j];
+    char reply[6] = "-";
+    if (e->minReply != 0xFF) snprintf(reply, sizeof(reply), "%i", e->minReply);
+    printfTopicS("%02X  %02X %6u %5i %8s %12i %3i %3i %3i %4i %5i", e->src, e->packetType, e->count, e->minGap, reply, e->hist[0], e->hist[1], e->hist[2], e->hist[3], e->hist[4], e->hist[5]);
+  }
+}
+#endif /* BUS_STATS */
+
+#ifdef COMMAND_TRACE
+// Command tracing: a command "@<id> <command>" (via P1P2/W or telnet) is handled as <command>, and its outcome is published
+// on P1P2/T as JSON, with the latency (ms) of each hop it passed:
+//   mqtt      from reception of the MQTT message until handleCommand() (waiting in mqttBuffer)
+//   esp       from handleCommand() until forwarded over serial to P1P2Monitor
+//   atmega    from reception by P1P2Monitor until the parameter write is queued (or the command is handled)
+//   bus       from queued until written on the bus
+//   confirm   from written until confirmed by the main controller in its next 00F035-00F03D packet (E series)
+//   serial    remainder: serial transfer in both directions and waiting in the serial input of the bridge
+// A forwarded command is sent as "@tt <command>" with an 8-bit tag, reported back by P1P2Monitor in pseudo packet 00000A:
+// tag, status, command character, and ms since reception of queued, written, confirmed (u16, FFFF if not reached) and report.
+#define TRACE_ID_LEN 16
+#define TRACE_CMD_LEN 24
+#define TRACE_FREE 0
+#define TRACE_RECEIVED 1  // MQTT message in mqttBuffer
+#define TRACE_HANDLED 2   // in handleCommand()
+#define TRACE_FORWARDED 3 // waiting for pseudo packet 00000A
+typedef struct {
+  volatile byte state;
+  byte tag;
+  char id[TRACE_ID_LEN];
+  char cmd[TRACE_CMD_LEN];
+  uint32_t received;
+  uint32_t handled;
+  uint32_t forwarded;
+} traceEntry;
+traceEntry traces[COMMAND_TRACE];
+traceEntry* traceActive = NULL; // traced command being handled by handleCommand()
+byte traceTag = 0;
+
+void traceCopy(char* dst, const char* src, byte srcLen, byte dstLen) {
+  // copies srcLen characters (at most dstLen - 1), with characters that would need escaping in JSON replaced by '_'
+  byte i;
+  for (i = 0; (i < srcLen) && (i < dstLen - 1) && src[i]; i++) dst[i] = ((src[i] < ' ') || (src[i] == '"') || (src[i] == '\\')) ? '_' : src[i];
+  dst[i] = '\0';
+}
+
+byte traceIdLen(const char* s) {
+  byte n = 0;
+  while (s[n] && (s[n] != ' ') && (s[n] != '\n') && (n < 0xFF)) n++;
+  return n;
+}
+
+void traceReceived(const char* payload) {
+  // call-back routine: timestamps MQTT message "@<id> ..." before it enters mqttBuffer
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if (traces[j].state == TRACE_FREE) {
+      traceCopy(traces[j].id, payload + 1, traceIdLen(payload + 1), TRACE_ID_LEN);
+      traces[j].received = millis();
+      traces[j].state = TRACE_RECEIVED;
+      return;
+    }
+  }
+}
+
+traceEntry* traceHandle(const char* id, byte idLen, const char* cmd) {
+  // returns trace entry for command id (received via MQTT, or new for telnet), or NULL if all entries in use
+  char id1[TRACE_ID_LEN];
+  traceCopy(id1, id, idLen, TRACE_ID_LEN);
+  traceEntry* t = NULL;
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if ((traces[j].state == TRACE_RECEIVED) && !strcmp(traces[j].id, id1) && (!t || ((int32_t) (traces[j].received - t->received) < 0))) t = &traces[j];
+  }
+  if (!t) {
+    for (byte j = 0; j < COMMAND_TRACE; j++) {
+      if (traces[j].state == TRACE_FREE) {
+        t = &traces[j];
+        strcpy(t->id, id1);
+        t->received = millis();
+        break;
+      }
+    }
+  }
+  if (!t) {
+    printfTopicS("Command trace entries full, %s not traced", id1);
+    return NULL;
+  }
+  t->state = TRACE_HANDLED;
+  t->handled = millis();
+  traceCopy(t->cmd, cmd, TRACE_CMD_LEN, TRACE_CMD_LEN);
+  return t;
+}
+
+byte traceAssign(traceEntry* t) {
+  // assigns tag for command forwarded to P1P2Monitor
+  if (!++traceTag) traceTag++;
+  t->tag = traceTag;
+  t->forwarded = millis();
+  t->state = TRACE_FORWARDED;
+  return t->tag;
+}
+
+void traceForward(traceEntry* t) {
+  // prefix for command forwarded to P1P2Monitor
+  char tagString[5];
+  snprintf(tagString, 5, "@%02X ", traceAssign(t));
+  Serial.print(tagString);
+}
+
+#define TRACE_U16(i) ((rb[i] << 8) | rb[(i) + 1])
+
+void tracePublish(traceEntry* t, const char* status, const byte* rb = NULL) {
+  char json[220];
+  uint32_t now = millis();
+  int len = snprintf(json, sizeof(json), "{\"id\":\"%s\",\"command\":\"%s\",\"status\":\"%s\",\"total_ms\":%u,\"hops\":{\"mqtt\":%u",
+                     t->id, t->cmd, status, (unsigned int) (now - t->received), (unsigned int) (t->handled - t->received));
+  if (t->state == TRACE_FORWARDED) len += snprintf(json + len, sizeof(json) - len, ",\"esp\":%u", (unsigned int) (t->forwarded - t->handled));
+  if (rb) {
+    uint16_t queued = TRACE_U16(6);
+    uint16_t written = TRACE_U16(8);
+    uint16_t confirmed = TRACE_U16(10);
+    uint16_t reported = TRACE_U16(12);
+    uint32_t roundTrip = now - t->forwarded;
+    len += snprintf(json + len, sizeof(json) - len, ",\"atmega\":%u", (queued != 0xFFFF) ? queued : reported);
+    if ((queued != 0xFFFF) && (written != 0xFFFF)) len += snprintf(json + len, sizeof(json) - len, ",\"bus\":%u", written - queued);
+    if ((written != 0xFFFF) && (confirmed != 0xFFFF)) len += snprintf(json + len, sizeof(json) - len, ",\"confirm\":%u", confirmed - written);
+    len += snprintf(json + len, sizeof(json) - len, ",\"serial\":%u", (unsigned int) ((roundTrip > reported) ? roundTrip - reported : 0));
+  }
+  if (len < (int) sizeof(json) - 2) strcpy(json + len, "}}");
+  clientPublishMqttChar('T', MQTT_QOS_SIGNAL, MQTT_RETAIN_SIGNAL, json);
+  clientPublishTelnetChar('T', json);
+  t->state = TRACE_FREE;
+}
+
+void traceStore(byte* rb, byte n) {
+  // pseudo packet 00000A: report of traced command by P1P2Monitor
+  static const char* const traceStatus[] = { "done", "rejected", "queued", "written", "confirmed", "timeout" };
+  if (n < 14) return;
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if ((traces[j].state == TRACE_FORWARDED) && (traces[j].tag == rb[3])) {
+      tracePublish(&traces[j], (rb[4] <= 5) ? traceStatus[rb[4]] : "unknown", rb);
+      return;
+    }
+  }
+}
+
+void traceTimeouts(void) {
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if ((traces[j].state != TRACE_FREE) && (traces[j].state != TRACE_HANDLED) && (millis() - traces[j].received >= COMMAND_TRACE_TIMEOUT * 1000UL)) {
+      if (traces[j].state == TRACE_RECEIVED) traces[j].handled = millis(); // command lost (mqttBuffer overrun)
+      tracePublish(&traces[j], "timeout");
+    }
+  }
+}
+#endif /* COMMAND_TRACE */
+
+#ifdef CMD_ACK
+// Command channel to P1P2Monitor: commands are queued (CMD_ACK entries) and sent as "#ss <command>" with a sequence number
+// ss (01-FF), with no more unacknowledged commands than P1P2Monitor's credits allow: command lines (its window) and
+// parameter writes (its free write slots, limited by its write budget). P1P2Monitor acknowledges each command in pseudo
+// packet 00000B with the sequence number, a reason code, its credits, RS_SIZE and the command character, and announces its
+// credits (sequence number 00) at start-up, when they change, and periodically.
+// A rejected command is reported on P1P2/S. If a command is not acknowledged within CMD_ACK_TIMEOUT ms, the unacknowledged
+// commands are sent again (P1P2Monitor recognizes and only acknowledges those it handled already); after CMD_ACK_RETRIES
+// the unacknowledged commands are dropped (they may or may not have been handled, so they are not sent again) and the
+// remaining commands are sent unacknowledged, one per CMD_ACK_FALLBACK_PACE ms, as for P1P2Monitor versions without
+// acknowledgement, until P1P2Monitor announces its credits again.
+// P1P2Monitor forgets the sequence numbers it handled on the (unsequenced) dummy lines of ATmega_dummy_for_serial(),
+// so a restarted bridge, which starts again at sequence number 01, is not taken for a retransmission.
+#define CMD_LEN 172 // largest RS_SIZE of P1P2Monitor + 2
+#if defined E_SERIES
+#define CMD_IS_WRITE(c) (((c) == 'e') || ((c) == 'E'))
+#elif defined F_SERIES
+#define CMD_IS_WRITE(c) (((c) == 'f') || ((c) == 'F'))
+#else /* E_SERIES */
+#define CMD_IS_WRITE(c) false
+#endif /* E_SERIES */
+typedef struct {
+  char cmd[CMD_LEN];
+  byte seq;
+  byte tries;
+  bool write;
+  uint32_t sent;
+#ifdef COMMAND_TRACE
+  traceEntry* trace;
+  byte tag;
+#endif /* COMMAND_TRACE */
+} cmdEntry;
+cmdEntry cmdQueue[CMD_ACK];
+byte cmdTail = 0;           // oldest command in queue
+byte cmdCount = 0;          // commands in queue
+byte cmdInFlight = 0;       // oldest commands in queue which are sent, but not acknowledged yet
+byte cmdSeq = 0;
+bool cmdAckActive = false;  // P1P2Monitor acknowledges commands
+byte cmdLineCredits = 1;
+byte cmdWriteCredits = 0;
+byte cmdMaxLen = 0;         // RS_SIZE of P1P2Monitor
+static const char* const cmdReasonText[] = { "ok", "not understood", "requires L1", "parameter write buffer full", "invalid arguments", "no write budget left", "line too long" };
+
+void cmdSend(cmdEntry* e) {
+  // sends command, without sequence number if e->seq is 0 (unacknowledged)
+  char seqString[5];
+  snprintf(seqString, 5, "#%02X ", e->seq);
+  Serial.print(F(SERIAL_MAGICSTRING));
+  if (e->seq) Serial.print(seqString);
+  Serial.println(e->cmd);
+#ifdef COMMAND_TRACE
+  if (!e->tries && e->trace && (e->trace->state == TRACE_FORWARDED) && (e->trace->tag == e->tag)) e->trace->forwarded = millis();
+#endif /* COMMAND_TRACE */
+  e->tries++;
+  e->sent = millis();
+}
+
+const char* cmdText(cmdEntry* e) {
+  // command without trace prefix
+#ifdef COMMAND_TRACE
+  if (e->tag) return e->cmd + 4;
+#endif /* COMMAND_TRACE */
+  return e->cmd;
+}
+
+void cmdPop(void) {
+  // removes oldest command from queue
+  if (++cmdTail == CMD_ACK) cmdTail = 0;
+  cmdCount--;
+  if (cmdInFlight) cmdInFlight--;
+}
+
+uint32_t cmdFallbackSent = 0;
+
+void cmdService(void) {
+  if (!cmdCount) return;
+  if (!cmdAckActive) {
+    // acknowledgement failed: remaining commands are sent unacknowledged, paced
+    if (millis() - cmdFallbackSent < CMD_ACK_FALLBACK_PACE) return;
+    cmdQueue[cmdTail].seq = 0;
+    cmdQueue[cmdTail].tries = 0;
+    cmdSend(&cmdQueue[cmdTail]);
+    cmdFallbackSent = millis();
+    cmdPop();
+    return;
+  }
+  if (cmdInFlight && (millis() - cmdQueue[cmdTail].sent >= CMD_ACK_TIMEOUT)) {
+    if (cmdQueue[cmdTail].tries > CMD_ACK_RETRIES) {
+      // drop the unacknowledged commands: they may have been handled, so they are not sent again
+      while (cmdInFlight) {
+        cmdEntry* e = &cmdQueue[cmdTail];
+        printfTopicS("Command %s dropped: no acknowledgement from ATmega", cmdText(e));
+#ifdef COMMAND_TRACE
+        if (e->trace && (e->trace->state == TRACE_FORWARDED) && (e->trace->tag == e->tag)) tracePublish(e->trace, "dropped");
+#endif /* COMMAND_TRACE */
+        cmdPop();
+      }
+      cmdAckActive = false;
+      cmdFallbackSent = millis();
+      printfTopicS("ATmega does not acknowledge commands, sending commands unacknowledged");
+      return;
+    }
+    cmdInFlight = 0; // send all unacknowledged commands again
+  }
+  byte writes = 0;
+  for (byte k = 0; k < cmdInFlight; k++) if (cmdQueue[(cmdTail + k) % CMD_ACK].write) writes++;
+  while ((cmdInFlight < cmdCount) && (cmdInFlight < cmdLineCredits)) {
+    cmdEntry* e = &cmdQueue[(cmdTail + cmdInFlight) % CMD_ACK];
+    if (e->write && (writes >= cmdWriteCredits)) break; // wait for free parameter write slot
+    cmdSend(e);
+    if (e->write) writes++;
+    cmdInFlight++;
+  }
+}
+
+void cmdForward(const char* cmdString) {
+  // queues command for P1P2Monitor
+  if (cmdCount == CMD_ACK) {
+    printfTopicS("Command queue full, command %s dropped", cmdString);
+#ifdef COMMAND_TRACE
+    if (traceActive) tracePublish(traceActive, "dropped");
+#endif /* COMMAND_TRACE */
+    return;
+  }
+  cmdEntry* e = &cmdQueue[(cmdTail + cmdCount) % CMD_ACK];
+  byte len = 0;
+#ifdef COMMAND_TRACE
+  e->trace = traceActive;
+  e->tag = 0;
+  if (traceActive) {
+    e->tag = traceAssign(traceActive);
+    len = snprintf(e->cmd, CMD_LEN, "@%02X ", e->tag);
+  }
+#endif /* COMMAND_TRACE */
+  if ((len + strlen(cmdString) >= CMD_LEN) || (cmdMaxLen && (strlen(SERIAL_MAGICSTRING) + 4 + len + strlen(cmdString) >= cmdMaxLen))) {
+    printfTopicS("Command %s dropped: too long for ATmega (max %i characters)", cmdString, (int) ((cmdMaxLen ? cmdMaxLen : CMD_LEN) - strlen(SERIAL_MAGICSTRING) - 5 - len));
+#ifdef COMMAND_TRACE
+    if (traceActive) tracePublish(traceActive, "dropped");
+#endif /* COMMAND_TRACE */
+    return;
+  }
+  strcpy(e->cmd + len, cmdString);
+  if (!++cmdSeq) cmdSeq++;
+  e->seq = cmdSeq;
+  e->tries = 0;
+  e->write = CMD_IS_WRITE(cmdString[0]);
+  cmdCount++;
+  cmdService();
+}
+
+void cmdAckStore(byte* rb, byte n) {
+  // pseudo packet 00000B: acknowledgement or credit announcement by P1P2Monitor
+  if (n < 9) return;
+  if (!cmdAckActive) printfTopicS("ATmega acknowledges commands, window %i", rb[5]);
+  cmdAckActive = true;
+  cmdLineCredits = rb[5] ? rb[5] : 1;
+  cmdWriteCredits = rb[6];
+  cmdMaxLen = rb[7];
+  if (rb[3]) {
+    byte k;
+    for (k = 0; (k < cmdInFlight) && (cmdQueue[(cmdTail + k) % CMD_ACK].seq != rb[3]); k++);
+    if (k < cmdInFlight) {
+      // commands sent before were handled as well (in order), their acknowledgements were lost
+      while (k--) cmdPop();
+      if (rb[4]) printfTopicS("ATmega rejected command %s: %s", cmdText(&cmdQueue[cmdTail]), (rb[4] < sizeof(cmdReasonText) / sizeof(cmdReasonText[0])) ? cmdReasonText[rb[4]] : "unknown reason");
+      cmdPop();
+    }
+  }
+  cmdService();
+}
+
+void cmdReset(void) {
+  // ATmega reset: send unacknowledged commands again
+  cmdInFlight = 0;
+}
+#endif /* CMD_ACK */
 static int c;
 static byte ESP_serial_input_Errors_Data_Short = 0;
 #if (defined MHI_SERIES || defined M_SERIES)
@@ -2058,8 +2556,12 @@ void configMinMax(void) {
 }
 #endif /* F_SERIES */
 
+#ifdef P1P2MQTT_DAEMON
+#define EEPROM_sector 0 // flash file of the bus holds a single sector
+#else /* P1P2MQTT_DAEMON */
 extern "C" uint32_t _EEPROM_start;
 #define EEPROM_sector (((uint32_t)&_EEPROM_start - 0x40200000) / SPI_FLASH_SEC_SIZE)
+#endif /* P1P2MQTT_DAEMON */
 #define EEPROM_size ((sizeof(EE) + 3) & 0xFFFFFFFC)
 
 void saveEEPROM()
@@ -2661,6 +3163,27 @@ void handleCommand(char* cmdString) {
                 default: printfTopicS("Outputfilter illegal state %i", EE.outputFilter); break;
               }
               break;
+#ifdef UNKNOWN_STATS
+    case 'y': // unknown-field statistics
+    case 'Y': if (sscanf((const char*) (cmdString + 1), "%d", &temp) == 1) {
+                if (temp > 0) {
+                  unknownStatsWindow = temp;
+                  unknownStatsDecayTime = espUptime + unknownStatsWindow;
+                  printfTopicS("Unknown-field statistics window set to %i s", unknownStatsWindow);
+                } else {
+                  unknownStatsReset();
+                  printfTopicS("Unknown-field statistics reset");
+                }
+              } else {
+                unknownStatsPrint();
+              }
+              break;
+#endif /* UNKNOWN_STATS */
+#ifdef BUS_STATS
+    case 'r': // bus statistics
+    case 'R': busStatsPrint();
+              break;
+#endif /* BUS_STATS */
     case '?': // reset ATmega
     case 'h': // reset ATmega
     case 'H': printfTopicS("ESP commands:");
@@ -2668,6 +3191,12 @@ void handleCommand(char* cmdString) {
               printfTopicS("J to modify, or print individual, outputMode (J-mask) settings");
               printfTopicS("V to print system information");
               printfTopicS("D to restart, reconnect, save/restore EEPROM settings, or factory reset");
+#ifdef UNKNOWN_STATS
+              printfTopicS("Y to print ranked unknown-field statistics, Y0 to reset, Y<n> to set window to n seconds");
+#endif /* UNKNOWN_STATS */
+#ifdef BUS_STATS
+              printfTopicS("R to print bus utilisation, gap histograms and minimum reply latency per packet type");
+#endif /* BUS_STATS */
 #ifndef W_SERIES
               printfTopicS("");
               printfTopicS("ATmega commands:");
@@ -2680,6 +3209,7 @@ void handleCommand(char* cmdString) {
               printfTopicS("Z send Hitachi command (Hitachi only)");
 #endif /* H_SERIES */
               printfTopicS("W raw packet write command");
+              printfTopicS("B packet deduplication (0 off, 1 D-lines, 2 suppress, 3 D- and delta X-lines, >=10 refresh interval in s)");
               printfTopicS("T write delay");
               printfTopicS("O write timeout");
 #endif /* W_SERIES */
@@ -2801,6 +3331,25 @@ void handleCommand(char* cmdString) {
 #endif /* H_SERIES */
     case '\0':break;
     case '*': break;
+    case '@': // traced command "@<id> <command>"
+              {
+                char* cmd = cmdString + 1;
+                while (*cmd && (*cmd != ' ')) cmd++;
+#ifdef COMMAND_TRACE
+                byte idLen = cmd - cmdString - 1;
+#endif /* COMMAND_TRACE */
+                while (*cmd == ' ') cmd++;
+#ifdef COMMAND_TRACE
+                traceEntry* t = (cmd[0] == '@') ? NULL : traceHandle(cmdString + 1, idLen, cmd);
+                traceActive = t;
+                handleCommand(cmd);
+                traceActive = NULL;
+                if (t && (t->state == TRACE_HANDLED)) tracePublish(t, "done"); // handled by the bridge only
+#else /* COMMAND_TRACE */
+                handleCommand(cmd);
+#endif /* COMMAND_TRACE */
+              }
+              break;
     case 'v':
     case 'V': // command v handled both by P1P2MQTT-bridge and P1P2Monitor
               switch (cmdString[0]) {
@@ -2811,7 +3360,16 @@ void handleCommand(char* cmdString) {
               }
               // fallthrough for 'V' command handled both by P1P2MQTT-bridge and P1P2Monitor
     default : // printfTopicS("To ATmega: ->%s<-", cmdString);
+#ifdef CMD_ACK
+              if ((cmdAckActive || cmdCount) && (cmdString[0] != 'k') && (cmdString[0] != 'K')) { // in order after queued commands
+                cmdForward(cmdString);
+                break;
+              }
+#endif /* CMD_ACK */
               Serial.print(F(SERIAL_MAGICSTRING));
+#ifdef COMMAND_TRACE
+              if (traceActive) traceForward(traceActive);
+#endif /* COMMAND_TRACE */
               Serial.println((char *) cmdString);
               if ((cmdString[0] == 'k') || (cmdString[0] == 'K')) {
                 delay(200);
@@ -2863,12 +3421,8 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
   }
   // continue only for fully received payload which are not too long and/or are to be deleted
 
-  // save current mqttTopic before changing it, restore it before returning!
-  saveTopic();
-
   // handle P1P2/W/devicename/bridgename or P1P2/W
-  topicCharSpecific('W');
-  if ((!strcmp(topic, mqttTopic)) || (!strncmp(topic, mqttTopic, mqttTopicChar + 1) && (topic[ mqttTopicChar + 1 ] == '\0'))) {
+  if (topicMatchShort(topic, 'W') || topicMatchGeneric(topic, 'W')) {
     if (mqttBufferFree < total + 1) {
       // Serial_print(F("* [ESP] mqttBuffer full (W)"));
       if ((mqttBufferFullReported < 2) && (mqttBufferFree >= 3)) {
@@ -2877,13 +3431,14 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
         mqttBuffer_writeChar('\n');
         mqttBufferFullReported = 2;
       }
-      restoreTopic();
       return;
     }
     if (mqttBufferFullReported > 1) mqttBufferFullReported = 1;
+#ifdef COMMAND_TRACE
+    if (MQTT_payload[0] == '@') traceReceived(MQTT_payload);
+#endif /* COMMAND_TRACE */
     mqttBufferWriteString(MQTT_payload, total);
     mqttBuffer_writeChar('\n');
-    restoreTopic();
     return;
   }
 
@@ -2899,7 +3454,6 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
       delayedPrintfTopicS("Detected homeassistant/status offline");
     } else {
     }
-    restoreTopic();
     return;
   }
 
@@ -2908,14 +3462,12 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
     if (mqttBufferFree < strlen(topic) + 2 + MQTT_BUFFER_SPARE2) {
       // No space to buffer, signal buffer overrun so delete action for this topic will be repeated
       mqttDeleteOverrun = 1;
-      restoreTopic();
       return;
     }
     mqttDeleteDetected++;
     mqttBuffer_writeChar('-');
     mqttBufferWriteString(topic, strlen(topic));
     mqttBuffer_writeChar('\n');
-    restoreTopic();
     return;
   }
 
@@ -2929,7 +3481,6 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
     } else {
       delayedPrintfTopicS("Illegal ePower %s", MQTT_payload);
     }
-    restoreTopic();
     return;
   }
 
@@ -2940,7 +3491,6 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
     } else {
       delayedPrintfTopicS("Illegal eTotal %s", MQTT_payload);
     }
-    restoreTopic();
     return;
   }
 
@@ -2952,7 +3502,6 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
     } else {
       delayedPrintfTopicS("Illegal bPower %s", MQTT_payload);
     }
-    restoreTopic();
     return;
   }
 
@@ -2963,19 +3512,16 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
     } else {
       delayedPrintfTopicS("Illegal bTotal %s", MQTT_payload);
     }
-    restoreTopic();
     return;
   }
 #endif /* E_SERIES */
 
   // mqttSaveTopic 'A'-'Z'/'a'-'z'
-  topicCharBin(mqttSaveTopicChar);
-  if (!strcmp(topic, mqttTopic)) {
+  if (topicMatchBin(topic, mqttSaveTopicChar)) {
     if (mqttSaveBytesLeft <= MQTT_SAVE_BLOCK_SIZE) {
       // last block
       if (total != 2 * mqttSaveBytesLeft) {
         delayedPrintfTopicS("Recvd wrong last block size mqttSave %c expected %i", mqttSaveTopicChar, mqttSaveBytesLeft);
-        restoreTopic();
         return;
       }
     } else {
@@ -2983,13 +3529,11 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
       if (total != 2 * MQTT_SAVE_BLOCK_SIZE) {
         delayedPrintfTopicS("Recvd wrong block size mqttSave %c expected %i", mqttSaveTopicChar, MQTT_SAVE_BLOCK_SIZE);
         delayedPrintfTopicS("Recvd mqttSave != bs");
-        restoreTopic();
         return;
       }
     }
     if (mqttSaveReceived) {
       delayedPrintfTopicS("mqttReceived already 1");
-      restoreTopic();
       return;
     }
     uint16_t mpp = 0;
@@ -2998,13 +3542,11 @@ void onMqttMessage(char* topic, char* payload, const AsyncMqttClientMessagePrope
       delayedPrintfTopicS("mqttReceived char %c readback %i expected %i", mqttSaveTopicChar, mpp, (total >> 1));
     }
     mqttSaveReceived = 1;
-    restoreTopic();
     return;
   }
 
   // unknown topic received
   delayedPrintfTopicS("Unknown MQTT topic received %s payload %s", topic, MQTT_payload);
-  restoreTopic();
 }
 
 #ifdef TELNET
@@ -3060,8 +3602,18 @@ void buildMqttTopic() {
   strlcpy(mqttTopic + strlen(mqttTopic), "/M/0/", 6);
   mqttTopicCatChar = strlen(mqttTopic) - 4;
   mqttTopicSrcChar = strlen(mqttTopic) - 2;
-  mqttSlashChar = strlen(mqttTopic) - 5; // location of first slash before M in mqttTopic
+  byte mqttSlashChar = strlen(mqttTopic) - 5; // location of first slash before M in mqttTopic
   mqttTopicPrefixLength = strlen(mqttTopic); // length of P1P2/X[/deviceName][/bridgeName]/M/0/
+
+  // P1P2/X[/deviceName][/bridgeName]
+  strlcpy(mqttTopicShort, mqttTopic, mqttSlashChar + 1);
+  // P1P2/M[/deviceName][/bridgeName]/x
+  strlcpy(mqttTopicBin, mqttTopicShort, MQTT_TOPIC_LEN);
+  mqttTopicBin[mqttTopicChar] = 'M';
+  strlcpy(mqttTopicBin + mqttSlashChar, "/x", 3);
+  mqttTopicBinChar = mqttSlashChar + 1;
+  // mqttTopic stays P1P2/P[/deviceName][/bridgeName]/C/S/<entityname>
+  mqttTopic[mqttTopicChar] = 'P';
 }
 
 void configTZ (void) {
@@ -3358,7 +3910,7 @@ void setup() {
       delayedPrintfTopicS("-------");
       delayedPrintfTopicS("Wrote new WiFiManager-provided MQTT parameters to EEPROM");
       delayedPrintfTopicS("mqttUser/Password %s/%s", EE.mqttUser, EE.mqttPassword);
-      delayedPrintfTopicS("mqtt server %s/%s", EE.mqttServer, EE.mqttPort);
+      delayedPrintfTopicS("mqtt server %s:%i", EE.mqttServer, EE.mqttPort);
       delayedPrintfTopicS("-------");
     }
 #ifdef TELNET
@@ -3377,8 +3929,7 @@ void setup() {
   mqttClient.setClientId(EE.mqttClientName);
   mqttClient.setCredentials((EE.mqttUser[0] == '\0') ? 0 : EE.mqttUser, (EE.mqttPassword[0] == '\0') ? 0 : EE.mqttPassword);
 
-  topicCharSpecific('L');
-  strlcpy(willTopic, mqttTopic, WILL_TOPIC_LEN);
+  strlcpy(willTopic, topicShort('L'), WILL_TOPIC_LEN);
   mqttClient.setWill(willTopic, MQTT_QOS_WILL, MQTT_RETAIN_WILL, "offline");
 
   Serial_print(F("* [ESP] Clientname ")); Serial_println(EE.mqttClientName);
@@ -3578,7 +4129,8 @@ void setup() {
   printWelcome(false);
 }
 
-void process_for_mqtt(byte* rb, int n) {
+void process_for_mqtt(byte* rb, int n, uint32_t fields) {
+// fields: mask of bytes of rb to decode (bytes beyond 31 are always decoded)
   if (!mqttConnected) Mqtt_disconnectSkippedPackets++;
   if (mqttConnected || MQTT_DISCONNECT_CONTINUE) {
 #ifdef EF_SERIES
@@ -3590,6 +4142,7 @@ void process_for_mqtt(byte* rb, int n) {
     for (byte i = 3; i < n; i++)
 #endif /* MHI_SERIES */
     {
+      if ((i < 32) && !(fields & (1UL << i))) continue;
       if (!--throttle) throttle = THROTTLE_VALUE;
       if ((throttle >= throttleValue)
 #ifdef E_SERIES
@@ -3597,6 +4150,9 @@ void process_for_mqtt(byte* rb, int n) {
                                       || ((rb[0] == 0x40) && (rb[2] == 0xB8) && ((rb[3] & 0xFE) == 0x00))        // 0000B800/0000B801 should not be throttled
                                       || ((rb[0] == 0x40) && (rb[2] == 0x0F)                            )        // 40000F  should not be throttled
                                       || ((rb[0] == 0x40) && (rb[2] >= 0x60) && (rb[2] <= 0x8F)         )        // 400060-40008F should not be throttled
+#ifdef SAVESCHEDULE
+                                      || (rb[2] == 0x3E)                                                          // 3E schedule memory transfers are reassembled byte by byte
+#endif /* SAVESCHEDULE */
 #endif /* E_SERIES */
                                                                                                  ) {
 #ifdef MHI_SERIES
@@ -3674,6 +4230,9 @@ void loop() {
   while (milliInc >= 1000) {
     milliInc -= 1000;
     espUptime += 1;
+#ifdef COMMAND_TRACE
+    traceTimeouts();
+#endif /* COMMAND_TRACE */
 
 #ifdef W_SERIES
 
@@ -3743,6 +4302,9 @@ void loop() {
       pseudo0D++;
       pseudo0E++;
       pseudo0F++;
+#ifdef UNKNOWN_STATS
+      unknownStatsDecay();
+#endif /* UNKNOWN_STATS */
 
       if (!fallback && (Mqtt_disconnectTime > MQTT_DISCONNECT_TRY_FALLBACK)) {
         printfTopicS("Attempting fall back to fallback MQTT server");
@@ -3862,6 +4424,9 @@ void loop() {
   }
 
   if (!OTAbusy)  {
+#ifdef CMD_ACK
+    cmdService();
+#endif /* CMD_ACK */
 
     // read serial input OR mqttBuffer input until and including '\n', but do not store '\n'
     // rb_buffer = readBuffer + serial_rb // +20 for timestamp
@@ -3924,7 +4489,7 @@ void loop() {
       *rb_buffer++ = (char) c;
       // for first characters REDCc, insert time stamp
       if (!serial_rb) {
-        if ((c == 'R') || (c == 'E') || (c == 'D') || (c == 'C') || (c == 'c')) {
+        if ((c == 'R') || (c == 'X') || (c == 'E') || (c == 'D') || (c == 'C') || (c == 'c') || (c == 's')) {
           strncpy(readBuffer + 1, sprint_value + 7, 20);
           serial_rb += 20;
           rb_buffer += 20;
@@ -3954,11 +4519,18 @@ void loop() {
         } else {
           if (!serial_rb) {
             // ignore empty line
-          } else if ((readBuffer[0] == 'R') && (serial_rb > 32)){
-            // read hex data, verify CRC or CS
+          } else if (((readBuffer[0] == 'R') || (readBuffer[0] == 'X')) && (serial_rb > 32)){
+            // read hex data (X: delta-encoded, reconstructed from previous copy), verify CRC or CS
             int rbp = 32; // 20-char TZ and 10-char relative time stamp
             int n, rbtemp;
             byte rh = 0;
+            bool deltaMissing = false;
+#ifdef DELTA_PACKETS
+            if (readBuffer[0] == 'X') {
+              rh = deltaDecode(readBuffer + rbp);
+              deltaMissing = !rh;
+            } else
+#endif /* DELTA_PACKETS */
             while (sscanf(readBuffer + rbp, "%2x%n", &rbtemp, &n) == 1) {
               if (rh < HB) readHex[rh] = rbtemp;
               rh++;
@@ -3968,48 +4540,47 @@ void loop() {
               printfTopicS("Unexpected input buffer full/overflow, received %i, ignoring remainder", rh);
               rh = RB;
             }
-#if (defined MHI_SERIES || defined M_SERIES)
-            if ((rh > 1) || (rh == 1) && !CS_GEN)
-#elif defined H_SERIES
-            if (rh > 1)  
-#else /* MHI_SERIES  || M_SERIES || H_SERIES */
-            if ((rh > 1) || (rh == 1) && !CRC_GEN)
-#endif /* MHI_SERIES  || M_SERIES || H_SERIES */
-            {
-#if (defined MHI_SERIES || defined M_SERIES)
-              if (CS_GEN) rh--;
-              // rh is packet length (not counting CS byte readHex[rh])
+#ifdef DELTA_PACKETS
+            byte rhFull = rh;
+#endif /* DELTA_PACKETS */
+            if ((rh > 1) || ((rh == 1) && !P1P2Checksum::enabled)) {
+              bool valid = true;
               uint8_t cs = 0;
-              for (uint8_t i = 0; i < rh; i++) cs += readHex[i];
-              if ((!CS_GEN) || (cs == readHex[rh]))
-#elif defined H_SERIES
-              bool isAck = false;
-              uint8_t cxor = 0;
-              if (rh == 2 && readHex[1] == 0x06) { // Ack packet
-                isAck = true;
-              } else {
+              if (!P1P2Checksum::bare(readHex, rh)) {
+                // rh is packet length (not counting checksum byte readHex[rh])
                 rh--;
-                for (uint8_t i = 1; i < rh; i++) cxor ^= readHex[i]; // First byte is not included in xor
+                cs = P1P2ChecksumOf<P1P2Checksum>(readHex, rh);
+                valid = (cs == readHex[rh]);
               }
-              if (isAck || (cxor == readHex[rh])) // valid Ack packet or valid XOR
-#else /* MHI_SERIES  || M_SERIES || H_SERIES */
-              if (CRC_GEN) rh--;
-              // rh is packet length (not counting CRC byte readHex[rh])
-              uint8_t crc = CRC_FEED;
-              for (uint8_t i = 0; i < rh; i++) {
-                uint8_t c = readHex[i];
-                if (CRC_GEN != 0) for (uint8_t i = 0; i < 8; i++) {
-                  crc = ((crc ^ c) & 0x01 ? ((crc >> 1) ^ CRC_GEN) : (crc >> 1));
-                  c >>= 1;
-                }
-              }
-              if ((!CRC_GEN) || (crc == readHex[rh]))
-#endif /* MHI_SERIES  || M_SERIES || H_SERIES */
-              {
+              if (valid) {
+#ifdef DELTA_PACKETS
+                if (readBuffer[22] != 'P') deltaStore(readHex, rhFull);
+#endif /* DELTA_PACKETS */
                 if (((EE.outputMode & 0x0001) && (readBuffer[22] != 'P')) || ((EE.outputMode & 0x0004) && (readBuffer[22] == 'P')) ) {
                   clientPublishMqttChar('R', MQTT_QOS_HEX, MQTT_RETAIN_HEX, readBuffer);
                 }
                 if (EE.outputMode & 0x0010) printfTelnet_MON("R %s", readBuffer + 22);
+                if ((readBuffer[22] == 'P') && (readHex[0] == 0x00) && (readHex[1] == 0x00) && (readHex[2] == 0x0C)) {
+                  // budget manager state of P1P2Monitor, only in R topic/telnet output, not decoded as entities
+                } else
+                if ((readBuffer[22] == 'P') && (readHex[0] == 0x00) && (readHex[1] == 0x00) && (readHex[2] == 0x09)) {
+                  // write queue report of P1P2Monitor (written/superseded parameter write, queue depth), only in R topic/telnet output
+                } else
+#ifdef BUS_STATS
+                if ((readBuffer[22] == 'P') && (readHex[0] == 0x00) && (readHex[1] == 0x00) && (readHex[2] == 0x0D)) {
+                  busStatsStore(readHex, rh); // bus statistics, not decoded as entities
+                } else
+#endif /* BUS_STATS */
+#ifdef COMMAND_TRACE
+                if ((readBuffer[22] == 'P') && (readHex[0] == 0x00) && (readHex[1] == 0x00) && (readHex[2] == 0x0A)) {
+                  traceStore(readHex, rh); // report of traced command, published on P1P2/T
+                } else
+#endif /* COMMAND_TRACE */
+#ifdef CMD_ACK
+                if ((readBuffer[22] == 'P') && (readHex[0] == 0x00) && (readHex[1] == 0x00) && (readHex[2] == 0x0B)) {
+                  cmdAckStore(readHex, rh); // command acknowledgement
+                } else
+#endif /* CMD_ACK */
                 if ((EE.outputMode & 0x0022) && !mqttDeleting) process_for_mqtt(readHex, rh);
                 if ((readHex[0] == 0x00) && (readHex[1] == 0x00) && (readHex[2] == 0x0E)) pseudo0B = pseudo0C = 9; // Insert pseudo packet 40000B/0C in output serial after 00000E
 #ifndef W_SERIES
@@ -4035,23 +4606,26 @@ void loop() {
 #endif /* W_SERIES */
                 }
               } else {
+#ifdef DELTA_PACKETS
+                if (readBuffer[0] == 'X') deltaResync(readHex);
+#endif /* DELTA_PACKETS */
 #if (defined MHI_SERIES || defined M_SERIES)
                 printfTopicS("Serial input buffer overrun or CS error in R data:%s expected 0x%02X", readBuffer + 1, cs);
                 if (ESP_serial_input_Errors_CS < 0xFF) ESP_serial_input_Errors_CS++;
 #elif defined H_SERIES
-                printfTopicS("Serial input buffer overrun or XOR error in R data:%s expected 0x%02X", readBuffer + 1, cxor);
+                printfTopicS("Serial input buffer overrun or XOR error in R data:%s expected 0x%02X", readBuffer + 1, cs);
                 if (ESP_serial_input_Errors_XOR < 0xFF) ESP_serial_input_Errors_XOR++;
 #else /* MHI_SERIES  || M_SERIES || H_SERIES */
-                printfTopicS("Serial input buffer overrun or CRC error in R data:%s expected 0x%02X", readBuffer + 1, crc);
+                printfTopicS("Serial input buffer overrun or CRC error in R data:%s expected 0x%02X", readBuffer + 1, cs);
                 if (ESP_serial_input_Errors_CRC < 0xFF) ESP_serial_input_Errors_CRC++;
 #endif /* MHI_SERIES  || M_SERIES || H_SERIES */
               }
-            } else {
+            } else if (!deltaMissing) {
               printfTopicS("Not enough readable data in R line: ->%s<-", readBuffer + 1);
               if (ESP_serial_input_Errors_Data_Short < 0xFF) ESP_serial_input_Errors_Data_Short++;
             }
-          } else if ((readBuffer[0] == 'C') || (readBuffer[0] == 'c')) {
-            // timing info
+          } else if ((readBuffer[0] == 'C') || (readBuffer[0] == 'c') || (readBuffer[0] == 's')) {
+            // timing info (s: streaming scope data, decoded off-line by P1P2Monitor/scope_stream.py)
             if (EE.outputMode & 0x0040) printfTelnet_MON("%c %s", readBuffer[0], readBuffer + 22);
             if (EE.outputMode & 0x1000) clientPublishMqttChar('R', MQTT_QOS_HEX, MQTT_RETAIN_HEX, readBuffer);
           } else if (readBuffer[0] == 'D') {
@@ -4099,27 +4673,21 @@ void loop() {
     }
     if (pseudo0E > 5) {
       pseudo0E = 0;
-      readHex[0] = 0x40;
-      readHex[1] = 0x00;
-      readHex[2] = 0x0E;
-      readHex[3]  = SW_MAJOR_VERSION;
-      readHex[4]  = SW_MINOR_VERSION;
-      readHex[5]  = SW_PATCH_VERSION;
-      readHex[6]  = doubleResetData & 0xFF; // nr of ESP restarts
-      readHex[7]  = rebootReason();
-      readHex[8]  = (EE.outputMode >> 24) & 0xFF;
-      readHex[9]  = (EE.outputMode >> 16) & 0xFF;
-      readHex[10] = (EE.outputMode >> 8) & 0xFF;
-      readHex[11] = EE.outputMode & 0xFF;
-      readHex[12] = EE.outputFilter;
-      readHex[13] = EE.ESPhwID;
-      readHex[14] = 0; // dummy for switches and buttons
+      pseudoHeader(readHex, 0x0E);
+      pseudoPut8(readHex, 3, SW_MAJOR_VERSION);
+      pseudoPut8(readHex, 4, SW_MINOR_VERSION);
+      pseudoPut8(readHex, 5, SW_PATCH_VERSION);
+      pseudoPut8(readHex, 6, doubleResetData & 0xFF); // nr of ESP restarts
+      pseudoPut8(readHex, 7, rebootReason());
+      pseudoPut32(readHex, 8, EE.outputMode);
+      pseudoPut8(readHex, 12, EE.outputFilter);
+      pseudoPut8(readHex, 13, EE.ESPhwID);
+      pseudoPut8(readHex, 14, 0); // dummy for switches and buttons
 #ifdef E_SERIES
-      readHex[15] = (EE.RToffset >> 8) & 0xFF;
-      readHex[16] = EE.RToffset & 0xFF;
-      readHex[17] = EE.R1Toffset;
-      readHex[18] = EE.R2Toffset;
-      readHex[19] = EE.R4Toffset;
+      pseudoPut16(readHex, 15, EE.RToffset);
+      pseudoPut8(readHex, 17, EE.R1Toffset);
+      pseudoPut8(readHex, 18, EE.R2Toffset);
+      pseudoPut8(readHex, 19, EE.R4Toffset);
       writePseudoPacket(readHex, 20);
 #else
       writePseudoPacket(readHex, 15);
@@ -4127,41 +4695,31 @@ void loop() {
     }
     if (pseudo0F > 5) {
       pseudo0F = 0;
-      readHex[0]  = 0x40;
-      readHex[1]  = 0x00;
-      readHex[2] = 0x0F;
-      readHex[3]  = (espUptime >> 24) & 0xFF;
-      readHex[4]  = (espUptime >> 16) & 0xFF;
-      readHex[5]  = (espUptime >> 8) & 0xFF;
-      readHex[6]  = espUptime & 0xFF;
-      readHex[7]  = (Mqtt_disconnectTimeTotal >> 8) & 0xFF;
-      readHex[8]  = Mqtt_disconnectTimeTotal & 0xFF;
-      readHex[9]  = (Mqtt_msgSkipNotConnected >> 8) & 0xFF;
-      readHex[10] = Mqtt_msgSkipNotConnected & 0xFF;
-      readHex[11] = ethernetConnected;
-      readHex[12] = telnetConnected;
+      pseudoHeader(readHex, 0x0F);
+      pseudoPut32(readHex, 3, espUptime);
+      pseudoPut16(readHex, 7, Mqtt_disconnectTimeTotal);
+      pseudoPut16(readHex, 9, Mqtt_msgSkipNotConnected);
+      pseudoPut8(readHex, 11, ethernetConnected);
+      pseudoPut8(readHex, 12, telnetConnected);
 #ifdef E_SERIES
-      readHex[13] = (EE_dirty ? 0 : 1) | (factoryReset ? 0x02 : 0x00) | (throttleValue ? 0x20 : 0x00) | (EE.D13 ? 0x04 : 0x00) | (EE.haSetup ? 0x08 : 0x00) | (M.R.heatingOnlyX10 ? 0x10 : 0x00);
+      pseudoPut8(readHex, 13, (EE_dirty ? 0 : 1) | (factoryReset ? 0x02 : 0x00) | (throttleValue ? 0x20 : 0x00) | (EE.D13 ? 0x04 : 0x00) | (EE.haSetup ? 0x08 : 0x00) | (M.R.heatingOnlyX10 ? 0x10 : 0x00));
 #else /* E_SERIES */
-      readHex[13] = (EE_dirty ? 0 : 1) | (factoryReset ? 0x02 : 0x00) | (throttleValue ? 0x20 : 0x00);
+      pseudoPut8(readHex, 13, (EE_dirty ? 0 : 1) | (factoryReset ? 0x02 : 0x00) | (throttleValue ? 0x20 : 0x00));
 #endif /* E_SERIES */
-      readHex[14] = 0;
-      uint16_t m1 = ESP.getMaxFreeBlockSize();
-      readHex[15] = (m1 >> 8) & 0xFF;
-      readHex[16] = m1 & 0xFF;
-      readHex[17] = ESP_serial_input_Errors_Data_Short;
+      pseudoPut8(readHex, 14, 0);
+      pseudoPut16(readHex, 15, ESP.getMaxFreeBlockSize());
+      pseudoPut8(readHex, 17, ESP_serial_input_Errors_Data_Short);
 #if (defined MHI_SERIES || defined M_SERIES)
-      readHex[18] = ESP_serial_input_Errors_CS;
+      pseudoPut8(readHex, 18, ESP_serial_input_Errors_CS);
 #elif defined H_SERIES
-      readHex[18] = ESP_serial_input_Errors_XOR;
+      pseudoPut8(readHex, 18, ESP_serial_input_Errors_XOR);
 #else /* MHI_SERIES  || M_SERIES */
-      readHex[18] = ESP_serial_input_Errors_CRC;
+      pseudoPut8(readHex, 18, ESP_serial_input_Errors_CRC);
 #endif /* MHI_SERIES  || M_SERIES */
-      readHex[19] = WiFi.RSSI() & 0xFF;
-      readHex[20] = WiFi.status() & 0xFF;
-      readHex[21] = (Mqtt_msgSkipLowMem >> 8) & 0xFF;
-      readHex[22] = Mqtt_msgSkipLowMem & 0xFF;
-      writePseudoPacket(readHex, 21);
+      pseudoPut8(readHex, 19, WiFi.RSSI() & 0xFF);
+      pseudoPut8(readHex, 20, WiFi.status() & 0xFF);
+      pseudoPut16(readHex, 21, Mqtt_msgSkipLowMem);
+      writePseudoPacket(readHex, 23);
     }
   }
   saveRTC();
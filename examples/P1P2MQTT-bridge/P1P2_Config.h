@@ -48,6 +48,7 @@
 // Define one of these options below
 //#define P1P2MQTT_BRIDGE    // define this for regular operation of P1P2MQTT bridge (ESP8266 + ATmega328 using 250kBaud)
 //#define ARDUINO_COMBIBOARD // define this for Arduino/ESP8266 combi-board, using 250kBaud between ESP8266 and ATmega328P (no longer supported by library)
+//#define P1P2MQTT_DAEMON    // defined by host/Makefile for the Linux bridge daemon (no OTA, web server or AVRISP, see host/README.md)
 
 // Setting option NOWIFI to 1 (can be changed via 7th parameter of 'B' command) prevents WiFi use
 // Only useful if ethernet adapter is installed, to prevent use of WiFi as fall-back when ethernet fails
@@ -109,6 +110,9 @@
 #define SAVEPARAMS
 #define SAVEPACKETS
 // to save memory to avoid ESP instability (until P1P2MQTT is released): do not #define SAVESCHEDULE // format of schedules will change to JSON format in P1P2MQTT
+//#define UNKNOWN_STATS 48 // keep change statistics for up to 48 unknown bytes/bits/params on the ESP (command Y), costs ~1.4kB RAM
+#define UNKNOWN_STATS_WINDOW 3600 // default window (s) after which change counts are halved, so ranking reflects recent activity
+#define UNKNOWN_STATS_TOP 10 // number of entries in ranked summary
 
 #define WELCOMESTRING "P1P2MQTT bridge v0.9.58rc23"
 #define HA_SW "0.9.58rc23"
@@ -116,9 +120,11 @@
 #define SW_MINOR_VERSION 9
 #define SW_MAJOR_VERSION 0
 
+#ifndef P1P2MQTT_DAEMON
 #define ARDUINO_OTA
 #define WEBSERVER // adds webserver to update firmware of ESP
 #define AVRISP // enables flashing ATmega by ESP on P1P2-ESP-Interface
+#endif /* P1P2MQTT_DAEMON */
 #define SPI_SPEED_0 2e5 // for HSPI, default avrprog speed is 3e5, which is too high to be reliable; 2e5 works
 #define SPI_SPEED_1   0 // for BB-SPI
 
@@ -163,6 +169,16 @@
                                    // Set to 1 to continue (in case you have no mqtt of want to see changes via telnet or so)
 #define MQTT_DISCONNECT_RESTART 150 // Restart ESP if Mqtt disconnect time larger than this value in seconds (because after WiFi interruption, Mqtt may not reconnect reliably)
 
+#define DELTA_PACKETS 16 // number of packets kept to reconstruct delta-encoded X lines from P1P2Monitor (dedup mode 3), HB bytes each
+#define BUS_STATS 16 // number of bus-statistics entries (pseudo packets 00000D from P1P2Monitor) kept for command R
+#define COMMAND_TRACE 8 // number of traced commands ("@<id> <command>" on P1P2/W) in flight, reported on P1P2/T (undefine to save RAM)
+#define COMMAND_TRACE_TIMEOUT 40 // seconds to wait for the report of a traced command from P1P2Monitor (which times out after 30s)
+#define CMD_ACK 8 // number of commands queued for P1P2Monitor, sent with sequence number and acknowledged (undefine for unacknowledged commands only)
+#define CMD_ACK_TIMEOUT 2000 // ms to wait for acknowledgement before commands are sent again
+#define CMD_ACK_RETRIES 2 // number of times a command is sent again before it is dropped (and commands are sent unacknowledged)
+#define CMD_ACK_FALLBACK_PACE 100 // ms between queued commands sent unacknowledged after acknowledgement failed
+#define PSEUDO_REFRESH 10 // fields of bridge pseudo packets 40000B-40000F whose value did not change are not decoded again, except for every PSEUDO_REFRESH-th packet (0: always decode)
+
 #define MQTT_RETAIN_DATA true        // retain parameter value messages
 #define MQTT_RETAIN_WILL true   // retain birth and will messages
 #define MQTT_RETAIN_CONFIG true // retain HA config messages
@@ -199,23 +215,7 @@
 #define SERIAL_MAGICSTRING "1P2P" // Serial input of ATmega should start with SERIAL_MAGICSTRING, otherwise lines line is ignored by P1P2Monitor
 #endif /* SERIAL_MAGICSTRING */
 
-#ifdef M_SERIES
-#define CRC_GEN 0x00    // No CRC check for Mitsubishi
-#define CS_GEN 0x00    // No CS check for Mitsubishi (TODO: for now)
-#endif /* M_SERIES */
-#ifdef TH_SERIES
-#define CRC_GEN 0x00    // No CRC check for Toshiba/Hitachi
-#endif /* TH_SERIES */
-#if defined EF_SERIES
-#define CRC_GEN 0xD9    // Default generator/Feed for CRC check; these values work at least for the Daikin hybrid
-#endif /* EF_SERIES || W_SERIES */
-#ifdef F1F2_SERIES
-#define CRC_GEN 0
-#endif /* F1F2_SERIES */
-#ifdef MHI_SERIES
-#define CS_GEN 1  // Summation checksum on/off
-#endif /* MHI_SERIES */
-#define CRC_FEED 0x00   // Define CRC_GEN to 0x00 means no CRC is checked when reading or added when writing
+// checksum (CRC, sum, xor or none) of each series is selected at compile time in P1P2_Checksum.h
 #define SPRINT_VALUE_LEN 1000 // max message length for informational and debugging output over P1P2/S, telnet, or serial
 #define MQTT_KEY_LEN 100
 #define MQTT_VALUE_LEN 1000
@@ -193,30 +193,27 @@ char timeString2[23] = "Mo 2000-00-00 00:00:00"; // reads time from packet type
 //==================================================================================================================
 
 #define HADEVICE_CLIMATE_TEMPERATURE(temp_stat_topic, temp_min, temp_max, temp_step) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD(  \
     "\"temp_stat_t\":\"%s/%s\"," \
     "\"min_temp\":%1.1f," \
     "\"max_temp\":%1.1f," \
     "\"temp_step\":%1.1f," \
-    , mqttTopic, temp_stat_topic \
+    , topicShort('P'), temp_stat_topic \
     , (float) temp_min, (float) temp_max, (float) temp_step);  \
 }
 
 #define HADEVICE_CLIMATE_TEMPERATURE_CURRENT(curr_temp_topic) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD(  \
   "\"curr_temp_t\":\"%s/%s\"," \
-  , mqttTopic, curr_temp_topic); \
+  , topicShort('P'), curr_temp_topic); \
 }
 
 #define HADEVICE_CLIMATE_MODES(mode_stat_topic, modes, modes_tx) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD( \
     "\"mode_stat_t\":\"%s/%s\"," \
     "\"mode_stat_tpl\":\"{%% set modes={%s} %%}{{ modes[value] if value in modes.keys() else modes['0']}}\"," \
     "\"modes\":[%s]," \
-    , mqttTopic, mode_stat_topic \
+    , topicShort('P'), mode_stat_topic \
     , modes_tx \
     , modes); \
 }
@@ -226,62 +223,55 @@ char timeString2[23] = "Mo 2000-00-00 00:00:00"; // reads time from packet type
 // F-series fan mode
 
 #define HADEVICE_CLIMATE_FAN_MODES(fan_mode_stat_topic, fan_modes, fan_modes_tx) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD( \
     "\"fan_mode_stat_t\":\"%s/%s\"," \
     "\"fan_mode_stat_tpl\":\"{%% set modes={%s} %%}{{ modes[value] if value in modes.keys() else modes['0']}}\"," \
     "\"fan_modes\":[%s]," \
-    , mqttTopic, fan_mode_stat_topic \
+    , topicShort('P'), fan_mode_stat_topic \
     , fan_modes_tx \
     , fan_modes); \
 }
 
 #define HADEVICE_CLIMATE_FAN_MODE_COMMAND_TEMPLATE(fan_mode_cmd_template) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"fan_mode_cmd_t\":\"%s\"," \
     "\"fan_mode_cmd_tpl\":\"%s\"," \
-    , mqttTopic, fan_mode_cmd_template); \
+    , topicShort('W'), fan_mode_cmd_template); \
 }
 
 //==================================================================================================================
 #define HADEVICE_CLIMATE_TEMPERATURE_COMMAND(temp_cmd_template) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"temp_cmd_t\":\"%s\"," \
     "\"temp_cmd_tpl\":\"%s\"," \
-    , mqttTopic, temp_cmd_template); \
+    , topicShort('W'), temp_cmd_template); \
 }
 
 #define HADEVICE_CLIMATE_MODE_COMMAND_TEMPLATE(mode_cmd_template) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"mode_cmd_t\":\"%s\"," \
     "\"mode_cmd_tpl\":\"%s\"," \
-    , mqttTopic, mode_cmd_template); \
+    , topicShort('W'), mode_cmd_template); \
 }
 
 #define HADEVICE_CLIMATE_MODE_POWER_COMMAND_TEMPLATE(mode_pwr_cmd_template) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"power_command_topic\":\"%s\"," \
     "\"power_command_template\":\"%s\"," \
-    , mqttTopic, mode_pwr_cmd_template); \
+    , topicShort('W'), mode_pwr_cmd_template); \
 }
 
 //==================================================================================================================
 
 #define HADEVICE_AVAILABILITY(availability_topic, on_value, off_value) { \
-  topicCharSpecific('P'); \
   EXTRA_AV_STRING_ADD( \
     ",{\"topic\":\"%s/%s\",\"pl_avail\":%i,\"pl_not_avail\":%i}" \
-    , mqttTopic, availability_topic, on_value, off_value); \
+    , topicShort('P'), availability_topic, on_value, off_value); \
 }
 
 //==================================================================================================================
 
 #define HADEVICE_SELECT_OPTIONS(modes, modes_tx) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD( \
     "\"val_tpl\":\"{%% set modes={%s} %%}{{ modes[value] if (value) in modes.keys() else modes['0']}}\"," \
     "\"options\":[%s]," \
@@ -290,11 +280,10 @@ char timeString2[23] = "Mo 2000-00-00 00:00:00"; // reads time from packet type
 }
 
 #define HADEVICE_SELECT_COMMAND_TEMPLATE(select_cmd_template) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"cmd_t\":\"%s\"," \
     "\"cmd_tpl\":\"%s\"," \
-    , mqttTopic, select_cmd_template); \
+    , topicShort('W'), select_cmd_template); \
 }
 
 // not used
@@ -306,7 +295,6 @@ char timeString2[23] = "Mo 2000-00-00 00:00:00"; // reads time from packet type
 //==================================================================================================================
 
 #define HADEVICE_SENSOR_VALUE_TEMPLATE(sensor_val_template) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"val_tpl\":\"%s\"," \
     , sensor_val_template); \
@@ -315,7 +303,6 @@ char timeString2[23] = "Mo 2000-00-00 00:00:00"; // reads time from packet type
 //==================================================================================================================
 
 #define HADEVICE_NUMBER_RANGE(nr_min, nr_max, nr_step) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD(  \
     "\"min\":%f," \
     "\"max\":%f," \
@@ -324,18 +311,16 @@ char timeString2[23] = "Mo 2000-00-00 00:00:00"; // reads time from packet type
 }
 
 #define HADEVICE_NUMBER_MODE(nr_mode) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD(  \
     "\"mode\":\"%s\"," \
     , nr_mode); \
 }
 
 #define HADEVICE_NUMBER_COMMAND_TEMPLATE(number_cmd_template) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"cmd_t\":\"%s\"," \
     "\"cmd_tpl\":\"%s\"," \
-    , mqttTopic, number_cmd_template); \
+    , topicShort('W'), number_cmd_template); \
 }
 
 //==================================================================================================================
@@ -343,31 +328,28 @@ char timeString2[23] = "Mo 2000-00-00 00:00:00"; // reads time from packet type
 
 // update, restart, identify
 #define HADEVICE_BUTTON_CLASS(button_class) { \
-  topicCharSpecific('P'); \
   HACONFIGMESSAGE_ADD(  \
     "\"dev_cla\":\"%s\"," \
     , button_class); \
 }
 
 #define HADEVICE_BUTTON_COMMAND(button_cmd) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"cmd_t\":\"%s\"," \
     "\"cmd_tpl\":\"%s\"," \
-    , mqttTopic, button_cmd); \
+    , topicShort('W'), button_cmd); \
 }
 
 //==================================================================================================================
 
 #define HADEVICE_SWITCH_PAYLOADS(payload_off, payload_on) { \
-  topicWrite; \
   HACONFIGMESSAGE_ADD( \
     "\"stat_off\":0," \
     "\"stat_on\":1," \
     "\"pl_off\":\"%s\"," \
     "\"pl_on\":\"%s\"," \
     "\"cmd_t\":\"%s\"," \
-    , payload_off, payload_on, mqttTopic); \
+    , payload_off, payload_on, topicShort('W')); \
 }
 
 // ====================== define data structures ======================
@@ -439,13 +421,43 @@ const PROGMEM uint32_t bytestart[PCKTP_ARR_SZ]     =
 #define sizePayloadBitsSeen 38
 
 #ifdef SAVESCHEDULE
+// schedule memory SCHEDULE_MEM_START..SCHEDULE_MEM_END-1 is stored densely, per source, with a seen bit per byte: 2 * (1214 + 152)
+// = 2732 bytes, about 4.9 KB less than a seen byte per byte and two text buffers of MQTT_VALUE_LEN + 500 (schedules are rendered
+// on demand into mqtt_value); scheduleSegment[] lists its (contiguous) segments,
+// each entry: (start << 16) | (length << 8) | type, type bits 3-0: moments per day, bits 7-4: SCHEDULE_TYPE_*
+#define SCHEDULE_TYPE_SILENT     0x10
+#define SCHEDULE_TYPE_HC         0x20
+#define SCHEDULE_TYPE_PRICE      0x40
+#define SCHEDULE_TYPE_NOT_WEEKLY 0x80
+#define SCHEDULE_SEGMENTS 20
+const PROGMEM uint32_t scheduleSegment[SCHEDULE_SEGMENTS] = {
+  0x02501C12, 0x026C1C02, 0x02883804, 0x02C03804, 0x02F85406, 0x034C5406, 0x03A05406, 0x03F45406,
+  0x04485426, 0x049C5426, 0x04F05426, 0x05445426, 0x05985406, 0x05EC5406, 0x06405446,
+  0x06940C80, 0x06A00F80, 0x06AF0F80, 0x06BE2380, 0x06E12D80 };
 #define SCHEDULE_MEM_START 0x0250
-#define SCHEDULE_MEM_SIZE 0x048E          // this model uses only 0x0250 - 0x070D
+#define SCHEDULE_MEM_END   0x070E
+#define SCHEDULE_MEM_SIZE  0x04BE         // sum of segment lengths, this model uses 0x0250 - 0x070D
+#if SCHEDULE_MEM_SIZE != SCHEDULE_MEM_END - SCHEDULE_MEM_START
+#error scheduleSegment[] must cover SCHEDULE_MEM_START..SCHEDULE_MEM_END without gaps
+#endif
 uint16_t scheduleMemLoc[2];
+uint16_t scheduleMemStart[2];
 uint8_t scheduleLength[2];
 uint8_t scheduleSeq[2];
-byte scheduleMem[2][SCHEDULE_MEM_SIZE] = {};     // 2 * 1166 = 2332 bytes
-bool scheduleMemSeen[2][SCHEDULE_MEM_SIZE] = {}; // 2 * 1166 = 2332 bytes
+byte scheduleMem[2][SCHEDULE_MEM_SIZE] = {};                   // 2 * 1214 = 2428 bytes
+byte scheduleMemSeen[2][(SCHEDULE_MEM_SIZE + 7) >> 3] = {};    // 2 * 152 = 304 bytes
+
+int16_t scheduleMemIndex(uint16_t memLoc) {
+// returns index in scheduleMem for memLoc, or -1 if memLoc is outside schedule memory
+  if ((memLoc < SCHEDULE_MEM_START) || (memLoc >= SCHEDULE_MEM_END)) return -1;
+  return memLoc - SCHEDULE_MEM_START;
+}
+
+byte scheduleType(uint16_t memLoc) {
+// returns type of segment starting at memLoc; unlisted segments are treated as weekly schedules with 6 moments per day
+  for (byte i = 0; i < SCHEDULE_SEGMENTS; i++) if ((scheduleSegment[i] >> 16) == memLoc) return scheduleSegment[i] & 0xFF;
+  return 0x06;
+}
 #endif /* SAVESCHEDULE */
 
 #elif defined F_SERIES
@@ -1054,9 +1066,7 @@ typedef enum {
 
 void writePseudoSystemPacket0B(void) {
 #ifdef E_SERIES
-  readHex[0] = 0x40;
-  readHex[1] = 0x00;
-  readHex[2] = 0x0B;
+  pseudoHeader(readHex, 0x0B);
   uint16_t COPx1000;
   // COP_before_bridge
   if (EE.electricityConsumedCompressorHeating1 > 0) {
@@ -1064,76 +1074,47 @@ void writePseudoSystemPacket0B(void) {
   } else {
     COPx1000 = 0;
   }
-  readHex[3] = (COPx1000 >> 8) & 0xFF;
-  readHex[4] = COPx1000 & 0xFF;
+  pseudoPut16(readHex, 3, COPx1000);
   // COP_after_bridge
   if ((M.R.electricityConsumedCompressorHeating > EE.electricityConsumedCompressorHeating1) && (EE.electricityConsumedCompressorHeating1 > 0)) {
     COPx1000 = (1000 * (M.R.energyProducedCompressorHeating - EE.energyProducedCompressorHeating1)) / (M.R.electricityConsumedCompressorHeating - EE.electricityConsumedCompressorHeating1);
   } else {
     COPx1000 = 0;
   }
-  readHex[5] = (COPx1000 >> 8) & 0xFF;
-  readHex[6] = COPx1000 & 0xFF;
+  pseudoPut16(readHex, 5, COPx1000);
   // COP_lifetime
   if (M.R.electricityConsumedCompressorHeating > 0) {
     COPx1000 = (1000 * M.R.energyProducedCompressorHeating) / M.R.electricityConsumedCompressorHeating;
   } else {
     COPx1000 = 0;
   }
-  readHex[7] = (COPx1000 >> 8) & 0xFF;
-  readHex[8] = COPx1000 & 0xFF;
+  pseudoPut16(readHex, 7, COPx1000);
 
   writePseudoPacket(readHex, 9);
 #endif /* E_SERIES */
 }
 
 void writePseudoSystemPacket0C(void) {
-  readHex[0] = 0x40;
-  readHex[1] = 0x00;
-  readHex[2] = 0x0C;
+  pseudoHeader(readHex, 0x0C);
 #ifdef E_SERIES
-  readHex[3]  = (M.R.power1 >> 8) & 0xFF;
-  readHex[4]  = M.R.power1 & 0xFF;
-
-  readHex[5]  = (M.R.power2 >> 8) & 0xFF;
-  readHex[6]  = M.R.power2 & 0xFF;
-
-  readHex[7]  = (ePower >> 8) & 0xFF;
-  readHex[8]  = ePower & 0xFF;
-
-  readHex[9]   = (eTotal >> 24) & 0xFF;
-  readHex[10]  = (eTotal >> 16) & 0xFF;
-  readHex[11]  = (eTotal >> 8) & 0xFF;
-  readHex[12]  = eTotal & 0xFF;
-
-  readHex[13] = (M.R.COP_realtime >> 8) & 0xFF;
-  readHex[14] = M.R.COP_realtime & 0xFF;
-
-  readHex[15]  = (bPower >> 8) & 0xFF;
-  readHex[16]  = bPower & 0xFF;
-
-  readHex[17]  = (bTotal >> 24) & 0xFF;
-  readHex[18]  = (bTotal >> 16) & 0xFF;
-  readHex[19]  = (bTotal >> 8) & 0xFF;
-  readHex[20]  = bTotal & 0xFF;
-
+  pseudoPut16(readHex, 3, M.R.power1);
+  pseudoPut16(readHex, 5, M.R.power2);
+  pseudoPut16(readHex, 7, ePower);
+  pseudoPut32(readHex, 9, eTotal);
+  pseudoPut16(readHex, 13, M.R.COP_realtime);
+  pseudoPut16(readHex, 15, bPower);
+  pseudoPut32(readHex, 17, bTotal);
   writePseudoPacket(readHex, 21);
 #endif /* E_SERIES */
 #ifdef W_SERIES
-  readHex[3] = (electricityMeterActivePower >> 8) & 0xFF;
-  readHex[4] =  electricityMeterActivePower       & 0xFF;
-  readHex[5] = (electricityMeterTotal      >> 24) & 0xFF;
-  readHex[6] = (electricityMeterTotal      >> 16) & 0xFF;
-  readHex[7] = (electricityMeterTotal       >> 8) & 0xFF;
-  readHex[8] =  electricityMeterTotal             & 0xFF;
+  pseudoPut16(readHex, 3, electricityMeterActivePower);
+  pseudoPut32(readHex, 5, electricityMeterTotal);
   writePseudoPacket(readHex, 9);
 #endif /* W_SERIES */
 }
 
 void writePseudoSystemPacket0D(void) {
-  readHex[0] = 0x40;
-  readHex[1] = 0x00;
-  readHex[2] = 0x0D;
+  pseudoHeader(readHex, 0x0D);
 #ifdef E_SERIES
   if (M.R.climateModeACH & 0x02) {
     M.R.climateModeC = 1; // cooling (request)
@@ -1150,33 +1131,31 @@ void writePseudoSystemPacket0D(void) {
   } else {
     M.R.climateModeC = 0; // oh ?
   };
-  readHex[3] = M.R.climateModeC;
-  if (M.R.climateModeACH & 0x04) readHex[3] = 2; // auto
-  readHex[4] = M.R.controlRTX10 / 10;
-  readHex[5] = M.R.controlRTX10  ? 1 : 0;
-
-  readHex[6] = M.R.allowModulationX10 / 10;
-  readHex[7] = M.R.modulationMaxX10 / 10;
-  readHex[8] = (M.R.numberOfLWTzonesX10 / 10) + 1;
-
-  readHex[9] = eTotalAvailable;
-  readHex[10] = bTotalAvailable;
-
-  readHex[11] = M.R.overshootX10 / 10;
-  readHex[12] = M.R.quietMode;
-  readHex[13] = M.R.quietLevel;
-  readHex[14] = M.R.presetMode;
-
-  readHex[15] = M.R.heatingComfort;
-  readHex[16] = M.R.heatingEco;
-  readHex[17] = M.R.coolingComfort;
-  readHex[18] = M.R.coolingEco;
+  pseudoPut8(readHex, 3, (M.R.climateModeACH & 0x04) ? 2 : M.R.climateModeC); // 2: auto
+  pseudoPut8(readHex, 4, M.R.controlRTX10 / 10);
+  pseudoPut8(readHex, 5, M.R.controlRTX10  ? 1 : 0);
+
+  pseudoPut8(readHex, 6, M.R.allowModulationX10 / 10);
+  pseudoPut8(readHex, 7, M.R.modulationMaxX10 / 10);
+  pseudoPut8(readHex, 8, (M.R.numberOfLWTzonesX10 / 10) + 1);
+
+  pseudoPut8(readHex, 9, eTotalAvailable);
+  pseudoPut8(readHex, 10, bTotalAvailable);
+
+  pseudoPut8(readHex, 11, M.R.overshootX10 / 10);
+  pseudoPut8(readHex, 12, M.R.quietMode);
+  pseudoPut8(readHex, 13, M.R.quietLevel);
+  pseudoPut8(readHex, 14, M.R.presetMode);
+
+  pseudoPut8(readHex, 15, M.R.heatingComfort);
+  pseudoPut8(readHex, 16, M.R.heatingEco);
+  pseudoPut8(readHex, 17, M.R.coolingComfort);
+  pseudoPut8(readHex, 18, M.R.coolingEco);
   writePseudoPacket(readHex, 19);
 #endif /* E_SERIES */
 }
 
 uint8_t clientPublish(const char* mqtt_value, uint8_t qos) {
-  topicCharSpecificSlash('P'); // slash to add entityname
   if (EE.outputMode & 0x0020) clientPublishTelnet(mqttTopic, mqtt_value);
   if (EE.outputMode & 0x0002) return clientPublishMqtt(mqttTopic, qos, MQTT_RETAIN_DATA, mqtt_value);
   return 1;
@@ -1457,6 +1436,7 @@ void checkSize() {
 
 void resetDataStructures(void) {
   checkSize();
+  pseudoCacheReset();
   M.Mversion = M_VERSION;
   M.MdataLength = sizeof(M);
   for (uint16_t j = 0; j < sizePayloadByteVal; j++) {
@@ -1476,11 +1456,9 @@ void resetDataStructures(void) {
     M.payloadBitsSeen[j] = 0;
   }
 #ifdef SAVESCHEDULE
-  byte i;
-  uint16 j;
-  for (i = 0; i < 2; i++) {
-    for (j = 0; j < SCHEDULE_MEM_SIZE; j++) scheduleMem[i][j] = 0;
-    for (j = 0; j < SCHEDULE_MEM_SIZE; j++) scheduleMemSeen[i][j] = false;
+  for (byte i = 0; i < 2; i++) {
+    for (uint16_t j = 0; j < SCHEDULE_MEM_SIZE; j++) scheduleMem[i][j] = 0;
+    for (uint16_t j = 0; j < ((SCHEDULE_MEM_SIZE + 7) >> 3); j++) scheduleMemSeen[i][j] = 0;
   }
 #endif /* SAVESCHEDULE */
 }
@@ -1532,9 +1510,8 @@ uint16_t newCheckPayloadBytesVal(byte packetSrc, byte packetDst, byte packetType
     if (M.cntByte[pi2] & 0x80) {
       newBits = 1;
       // MQTT discovery
-      topicCharSpecific('P');
       snprintf_P(extraAvailabilityString, EXTRA_AVAILABILITY_STRING_LEN, PSTR(",{\"topic\":\"%s\/A\/8\/Counter_Request_Function\",\"pl_avail\":1,\"pl_not_avail\":0}")
-      , mqttTopic // (P)
+      , topicShort('P') // (P)
       );
     }
     // it's a 3-byte (slow) counter, so sufficient if we look at the 7 least significant bits LSB byte (LE); bit 7 = "!seen"
@@ -1686,9 +1663,152 @@ void registerUnseenBit(byte bcnt, byte bitNr)
 }
 */
 
+#ifdef UNKNOWN_STATS
+// on-device statistics for unknown bytes/bits/params, to rank candidates for reverse engineering without publishing all unknown topics
+// the hint records the known entity which most often changed in the same or previous second (majority vote)
+
+#define UNKNOWN_STATS_BYTE  8
+#define UNKNOWN_STATS_PARAM 9
+
+typedef struct {
+  byte src;
+  byte packetType;
+  uint16_t index;     // payloadIndex, or paramNr
+  byte bitNr;         // 0-7 for bits, UNKNOWN_STATS_BYTE, UNKNOWN_STATS_PARAM
+  byte hintCnt;
+  uint16_t changes;   // decayed change count
+  uint32_t lastVal;
+  uint32_t minVal;
+  uint32_t maxVal;
+  uint32_t lastChange;
+  byte hintSrc;
+  byte hintType;
+  byte hintIndex;
+} unknownStatsEntry;
+
+unknownStatsEntry unknownStats[UNKNOWN_STATS];
+byte unknownStatsUsed = 0;
+uint32_t unknownStatsWindow = UNKNOWN_STATS_WINDOW;
+uint32_t unknownStatsDecayTime = UNKNOWN_STATS_WINDOW;
+byte knownChangeSrc = 0;
+byte knownChangeType = 0;
+byte knownChangeIndex = 0;
+uint32_t knownChangeTime = 0;
+bool knownChangeSeen = false;
+bool unknownDecoded = false; // set by the decoder while handling an unknown byte/bit/param (UNKNOWN_* macros)
+
+void unknownStatsReset(void) {
+  unknownStatsUsed = 0;
+  unknownStatsDecayTime = espUptime + unknownStatsWindow;
+}
+
+void unknownStatsKnown(byte packetSrc, byte packetType, byte payloadIndex) {
+  // published unknown fields are no hint, and pseudo packets 00000x/40000x (uptime etc) would dominate hints
+  if (unknownDecoded) return;
+  if (((packetSrc == 0x00) || (packetSrc == 0x40)) && ((packetType & 0xF8) == 0x08)) return;
+  knownChangeSrc = packetSrc;
+  knownChangeType = packetType;
+  knownChangeIndex = payloadIndex;
+  knownChangeTime = espUptime;
+  knownChangeSeen = true;
+}
+
+void unknownStatsUpdate(byte src, byte packetType, uint16_t index, byte bitNr, uint32_t v) {
+  unknownStatsEntry* e = nullptr;
+  byte i;
+  for (i = 0; i < unknownStatsUsed; i++) {
+    if ((unknownStats[i].index == index) && (unknownStats[i].packetType == packetType) && (unknownStats[i].src == src) && (unknownStats[i].bitNr == bitNr)) {
+      e = &unknownStats[i];
+      break;
+    }
+  }
+  if (!e) {
+    if (unknownStatsUsed < UNKNOWN_STATS) {
+      e = &unknownStats[unknownStatsUsed++];
+    } else {
+      // replace the least recently changed entry which has not changed within the current window
+      for (i = 0; i < UNKNOWN_STATS; i++) if (!unknownStats[i].changes && (!e || (unknownStats[i].lastChange < e->lastChange))) e = &unknownStats[i];
+      if (!e) return;
+    }
+    e->src = src;
+    e->packetType = packetType;
+    e->index = index;
+    e->bitNr = bitNr;
+    e->hintCnt = 0;
+    e->changes = 0;
+    e->lastVal = e->minVal = e->maxVal = v;
+    e->lastChange = espUptime;
+    return;
+  }
+  if (v == e->lastVal) return;
+  e->lastVal = v;
+  if (v < e->minVal) e->minVal = v;
+  if (v > e->maxVal) e->maxVal = v;
+  e->lastChange = espUptime;
+  if (e->changes < 0xFFFF) e->changes++;
+  if (knownChangeSeen && (espUptime - knownChangeTime <= 1)) {
+    if ((e->hintSrc == knownChangeSrc) && (e->hintType == knownChangeType) && (e->hintIndex == knownChangeIndex)) {
+      if (e->hintCnt < 0xFF) e->hintCnt++;
+    } else if (!e->hintCnt) {
+      e->hintSrc = knownChangeSrc;
+      e->hintType = knownChangeType;
+      e->hintIndex = knownChangeIndex;
+      e->hintCnt = 1;
+    } else {
+      e->hintCnt--;
+    }
+  }
+}
+
+void unknownStatsDecay(void) {
+  if (!unknownStatsWindow || (espUptime < unknownStatsDecayTime)) return;
+  unknownStatsDecayTime = espUptime + unknownStatsWindow;
+  for (byte i = 0; i < unknownStatsUsed; i++) unknownStats[i].changes >>= 1;
+}
+
+void unknownStatsPrint(void) {
+  uint32_t printed[(UNKNOWN_STATS + 31) >> 5] = { 0 };
+  printfTopicS("Unknown-field statistics: %i entries, window %i s, top %i", unknownStatsUsed, unknownStatsWindow, UNKNOWN_STATS_TOP);
+  for (byte n = 0; n < UNKNOWN_STATS_TOP; n++) {
+    int16_t best = -1;
+    for (byte i = 0; i < unknownStatsUsed; i++) {
+      if (printed[i >> 5] & (1UL << (i & 0x1F))) continue;
+      if ((best < 0) || (unknownStats[i].changes > unknownStats[best].changes) || ((unknownStats[i].changes == unknownStats[best].changes) && (unknownStats[i].lastChange > unknownStats[best].lastChange))) best = i;
+    }
+    if ((best < 0) || !unknownStats[best].changes) break;
+    printed[best >> 5] |= (1UL << (best & 0x1F));
+    unknownStatsEntry* e = &unknownStats[best];
+    char hint[32] = "";
+    if (e->hintCnt) snprintf(hint, sizeof(hint), " hint 0x%02X/0x%02X/%i (%i)", e->hintSrc, e->hintType, e->hintIndex, e->hintCnt);
+    switch (e->bitNr) {
+      case UNKNOWN_STATS_PARAM : printfTopicS("Src 0x%02X Tp 0x%02X Param 0x%04X chg %u min 0x%X max 0x%X last 0x%X age %i s%s", e->src, e->packetType, e->index, e->changes, e->minVal, e->maxVal, e->lastVal, espUptime - e->lastChange, hint); break;
+      case UNKNOWN_STATS_BYTE  : printfTopicS("Src 0x%02X Tp 0x%02X Byte %i chg %u min 0x%02X max 0x%02X last 0x%02X age %i s%s", e->src, e->packetType, e->index, e->changes, e->minVal, e->maxVal, e->lastVal, espUptime - e->lastChange, hint); break;
+      default                  : printfTopicS("Src 0x%02X Tp 0x%02X Byte %i Bit %i chg %u last %i age %i s%s", e->src, e->packetType, e->index, e->bitNr, e->changes, e->lastVal, espUptime - e->lastChange, hint); break;
+    }
+  }
+}
+
+uint32_t unknownStatsParamValue(byte* payload, byte payloadIndex, byte paramValLength, bool LE) {
+  uint32_t v = 0;
+  for (byte i = 0; i < paramValLength; i++) v = (v << 8) | (LE ? payload[payloadIndex + 1 - paramValLength + i] : payload[payloadIndex - i]);
+  return v;
+}
+
+#define UNKNOWN_STATS_KNOWN unknownStatsKnown(packetSrc, packetType, payloadIndex);
+#define STATS_BYTE          unknownDecoded = true; unknownStatsUpdate(packetSrc, packetType, payloadIndex, UNKNOWN_STATS_BYTE, payload[payloadIndex]);
+#define STATS_BIT           unknownDecoded = true; unknownStatsUpdate(packetSrc, packetType, payloadIndex, bitNr, FN_flag8(payload[payloadIndex], bitNr));
+#define STATS_PARAM(LE)     unknownDecoded = true; unknownStatsUpdate(paramSrc, paramPacketType, paramNr, UNKNOWN_STATS_PARAM, unknownStatsParamValue(payload, payloadIndex, paramValLength, LE));
+#else /* UNKNOWN_STATS */
+#define UNKNOWN_STATS_KNOWN
+#define STATS_BYTE
+#define STATS_BIT
+#define STATS_PARAM(LE)
+#endif /* UNKNOWN_STATS */
+
 #ifdef MHI_SERIES
 uint8_t publishEntityByte(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, const char* mqtt_value, byte length) {
   if (clientPublish(mqtt_value, haQos) && (pi2 >= 0)) {
+    UNKNOWN_STATS_KNOWN;
     M.payloadByteSeen[pi2 >> 3] |= (1 << (pi2 & 0x07));
     uint16_t pi2i = pi2;
     for (int8_t i = payloadIndex; i + length > payloadIndex; i--) {
@@ -1721,6 +1841,7 @@ uint8_t doNotPublishEntityByte(byte packetSrc, byte packetType, byte payloadInde
 #else /* MHI_SERIES */
 uint8_t publishEntityByte(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, const char* mqtt_value, byte length) {
   if (clientPublish(mqtt_value, haQos) && (pi2 >= 0)) {
+    UNKNOWN_STATS_KNOWN;
 #ifdef E_SERIES
     if (packetType == 0xB8) {
       M.cntByte[pi2] = payload[payloadIndex] & 0x7F;
@@ -1766,6 +1887,7 @@ uint8_t doNotPublishEntityByte(byte packetSrc, byte packetType, byte payloadInde
 
 uint8_t publishEntityBits(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, const char* mqtt_value) {
   if (clientPublish(mqtt_value, haQos)) {
+    UNKNOWN_STATS_KNOWN;
     if (bcnt >= sizePayloadBitsSeen) {
       printfTopicS("bcnt %i > size ", bcnt);
       return 0;
@@ -1872,6 +1994,52 @@ uint8_t publishEntityParam(byte paramSrc, byte paramPacketType, uint16_t paramNr
 }
 #endif /* E_SERIES */
 
+// fixed-point formatting of num / den with 0..3 decimals, gives the same output as snprintf "%1.<decimals>f" on (num / den)
+// (including round-half-even on exact ties) without float conversion
+
+const PROGMEM uint32_t pow10tab[4] = { 1, 10, 100, 1000 };
+
+char* fixedPoint(char* s, int64_t num, uint32_t den, byte decimals, bool negativeZero = false) {
+  char t[24];
+  byte i = 0;
+  byte j = 0;
+  uint64_t n = ((num < 0) ? -num : num) * pow10tab[decimals];
+  uint64_t q;
+  uint32_t r;
+  if (n >> 32) {
+    q = n / den;
+    r = n % den;
+  } else {
+    q = ((uint32_t) n) / den;
+    r = ((uint32_t) n) % den;
+  }
+  if ((r > den - r) || ((r == den - r) && (q & 1))) q++;
+  do {
+    t[i++] = '0' + (q % 10);
+    q /= 10;
+    if (decimals && (i == decimals)) t[i++] = '.';
+  } while (q || (i <= decimals + (decimals ? 1 : 0)));
+  if ((num < 0) || negativeZero) s[j++] = '-';
+  while (i) s[j++] = t[--i];
+  s[j] = '\0';
+  return s;
+}
+
+char* fixedPointFloat(char* s, float v, byte decimals) {
+// v * 10^decimals is exact in double for float v, so rounding here matches snprintf
+  double d = (double) v * pow10tab[decimals];
+  if (!((d < 1e15) && (d > -1e15))) {
+    // out of range or nan
+    const char* formats[] = { "%1.0f", "%1.1f", "%1.2f", "%1.3f" };
+    snprintf(s, MQTT_VALUE_LEN, formats[decimals], v);
+    return s;
+  }
+  int64_t n = (int64_t) d;
+  double f = (d < 0) ? (n - d) : (d - n);
+  if ((f > 0.5) || ((f == 0.5) && (n & 1))) n += (d < 0) ? -1 : 1;
+  return fixedPoint(s, n, pow10tab[decimals], decimals, (n == 0) && (copysignf(1.0, v) < 0));
+}
+
 // these conversion functions from payload to (mqtt) value look at the current and often also one or more past byte(s) in the byte array
 
 // hex (1..4 bytes), LE
@@ -1918,22 +2086,22 @@ uint8_t value_s16_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* p
 }
 
 uint8_t value_sdiv100_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value, byte length) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.2f", s_payloadValue_LE(payload + payloadIndex, length) * 0.01);
+  fixedPoint(mqtt_value, s_payloadValue_LE(payload + payloadIndex, length), 100, 2);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, length);
 }
 
 uint8_t value_sdiv10_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value, byte length) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", s_payloadValue_LE(payload + payloadIndex, length) * 0.1);
+  fixedPoint(mqtt_value, s_payloadValue_LE(payload + payloadIndex, length), 10, 1);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, length);
 }
 
 uint8_t value_udiv10(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value, byte length) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", u_payloadValue_LE(payload + payloadIndex, length) * 0.1);
+  fixedPoint(mqtt_value, u_payloadValue_LE(payload + payloadIndex, length), 10, 1);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, length);
 }
 
 uint8_t value_udiv1000_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value, byte length) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.3f", u_payloadValue_LE(payload + payloadIndex, length) * 0.001);
+  fixedPoint(mqtt_value, u_payloadValue_LE(payload + payloadIndex, length), 1000, 3);
   return  publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, length);
 }
 
@@ -1991,14 +2159,14 @@ uint8_t value_s4abs1c(byte packetSrc, byte packetType, byte payloadIndex, byte*
 float FN_u8div10(uint8_t *b)     { return (b[0] * 0.1);}
 
 uint8_t value_u8div10(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", FN_u8div10(&payload[payloadIndex]));
+  fixedPoint(mqtt_value, payload[payloadIndex], 10, 1);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 1);
 }
 
 float FN_u8div2min16(uint8_t *b)     { return (b[0] * 0.5 - 16);}
 
 uint8_t value_u8div2min16(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", FN_u8div2min16(&payload[payloadIndex]));
+  fixedPoint(mqtt_value, payload[payloadIndex] - 32, 2, 1);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 1);
 }
 
@@ -2007,12 +2175,12 @@ float FN_u16div10_LE(uint8_t *b)     { if (b[-1] == 0xFF) return 0; else return
 float FN_u16div100_LE(uint8_t *b)     { if (b[-1] == 0xFF) return 0; else return (b[0] * 0.01 + b[-1] * 2.56);}
 
 uint8_t value_u16div10_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", FN_u16div10_LE(&payload[payloadIndex]));
+  fixedPoint(mqtt_value, (payload[payloadIndex - 1] == 0xFF) ? 0 : u_payloadValue_LE(payload + payloadIndex, 2), 10, 1);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 2);
 }
 
 uint8_t value_u16div100_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.2f", FN_u16div100_LE(&payload[payloadIndex]));
+  fixedPoint(mqtt_value, (payload[payloadIndex - 1] == 0xFF) ? 0 : u_payloadValue_LE(payload + payloadIndex, 2), 100, 2);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 2);
 }
 
@@ -2053,9 +2221,8 @@ uint8_t value_s_nosave(byte packetSrc, byte packetType, byte payloadIndex, byte*
 
 uint8_t value_f(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value, float v, int length = 0) {
   // Format string based on haPrecision (0..3)
-  const char* formats[] = { "%1.0f", "%1.1f", "%1.2f", "%1.3f" };
   byte prec = (haPrecision >= 0 && haPrecision <= 3) ? haPrecision : 3;
-  snprintf(mqtt_value, MQTT_VALUE_LEN, formats[prec], v);
+  fixedPointFloat(mqtt_value, v, prec);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, length);
 }
 
@@ -2066,24 +2233,29 @@ float FN_f8_8_LE(uint8_t *b)                       { return (((int8_t) b[-1]) +
 float FN_s_f8_8_LE(uint8_t *b)  { return (b[-2] ? -1 : 1) * (((int8_t) b[-1]) + (b[0] * 1.0 / 256)); }
 
 uint8_t value_f8_8_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.3f", FN_f8_8_LE(&payload[payloadIndex]));
+  fixedPoint(mqtt_value, (int16_t) u_payloadValue_LE(payload + payloadIndex, 2), 256, 3);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 2);
 }
 
 uint8_t value_s_f8_8_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.3f", FN_s_f8_8_LE(&payload[payloadIndex]));
+  int16_t v = (int16_t) u_payloadValue_LE(payload + payloadIndex, 2);
+  if (payload[payloadIndex - 2]) {
+    fixedPoint(mqtt_value, -v, 256, 3, !v);
+  } else {
+    fixedPoint(mqtt_value, v, 256, 3);
+  }
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 3);
 }
 
 uint8_t value_f8_8_BE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.3f", FN_f8_8_BE(&payload[payloadIndex]));
+  fixedPoint(mqtt_value, (int16_t) u_payloadValue_BE(payload + payloadIndex, 2), 256, 3);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 2);
 }
 
 float FN_f8s8_LE(uint8_t *b)            { return ((float)(int8_t) b[-1]) + ((float) b[0]) /  10;}
 
 uint8_t value_f8s8_LE(byte packetSrc, byte packetType, byte payloadIndex, byte* payload, char* mqtt_value) {
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", FN_f8s8_LE(&payload[payloadIndex]));
+  fixedPoint(mqtt_value, ((int8_t) payload[payloadIndex - 1]) * 10 + payload[payloadIndex], 10, 1);
   return publishEntityByte(packetSrc, packetType, payloadIndex, payload, mqtt_value, 2);
 }
 
@@ -2123,13 +2295,13 @@ uint8_t param_value_u_LE(byte paramSrc, byte paramPacketType, uint16_t paramNr,
 
 uint8_t param_value_udiv2_LE(byte paramSrc, byte paramPacketType, uint16_t paramNr, byte payloadIndex, byte* payload, char* mqtt_value, byte paramValLength) {
   uint32_t v = u_payloadValue_LE(payload + payloadIndex, paramValLength);
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", v * 0.5);
+  fixedPoint(mqtt_value, v, 2, 1);
   return publishEntityParam(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);
 }
 
 uint8_t param_value_udiv2min16_LE(byte paramSrc, byte paramPacketType, uint16_t paramNr, byte payloadIndex, byte* payload, char* mqtt_value, byte paramValLength) {
   uint32_t v = u_payloadValue_LE(payload + payloadIndex, paramValLength);
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", v * 0.5 - 16);
+  fixedPoint(mqtt_value, (int64_t) v - 32, 2, 1);
   return publishEntityParam(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);
 }
 
@@ -2141,7 +2313,7 @@ uint8_t param_value_u16div10_LE(byte paramSrc, byte paramPacketType, uint16_t pa
     return 0;
   }
   uint16_t v = u_payloadValue_LE(payload + payloadIndex, paramValLength);
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", v * 0.1);
+  fixedPoint(mqtt_value, v, 10, 1);
   return publishEntityParam(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);
 }
 */
@@ -2169,7 +2341,7 @@ uint8_t param_value_s16div10_LE(byte paramSrc, byte paramPacketType, uint16_t pa
     return 0;
   }
   int16_t v = (uint16_t) u_payloadValue_LE(payload + payloadIndex, paramValLength);
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", v * 0.1);
+  fixedPoint(mqtt_value, v, 10, 1);
   return publishEntityParam(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);
 }
 
@@ -2205,7 +2377,7 @@ uint8_t param_value_u16div10_BE(byte paramSrc, byte paramPacketType, uint16_t pa
     return 0;
   }
   uint16_t v = u_payloadValue_BE(payload + payloadIndex, paramValLength);
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", v * 0.1);
+  fixedPoint(mqtt_value, v, 10, 1);
   return publishEntityParam(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);
 }
 
@@ -2216,7 +2388,7 @@ uint8_t param_value_u32div100_BE(byte paramSrc, byte paramPacketType, uint16_t p
     return 0;
   }
   uint16_t v = u_payloadValue_BE(payload + payloadIndex, paramValLength);
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.2f", v * 0.01);
+  fixedPoint(mqtt_value, v, 100, 2);
   return publishEntityParam(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);
 }
 
@@ -2227,7 +2399,7 @@ uint8_t param_value_s16div10_BE(byte paramSrc, byte paramPacketType, uint16_t pa
     return 0;
   }
   int16_t v = (uint16_t) u_payloadValue_BE(payload + payloadIndex, paramValLength);
-  snprintf(mqtt_value, MQTT_VALUE_LEN, "%1.1f", v * 0.1);
+  fixedPoint(mqtt_value, v, 10, 1);
   return publishEntityParam(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);
 }
 
@@ -2643,7 +2815,6 @@ uint8_t common_field_setting(byte packetSrc, byte packetType, byte payloadIndex,
 
   if (FSB == 1) return 0;
 
-  topicWrite;
   // Catch Daikin's (new?) use of 10E-1 instead of 1E0 for stepsize
   if (fieldSettingStepExponentSign && (fieldSettingStepMantissa == 10)) {
     fieldSettingStepExponentSign = 0;
@@ -2752,7 +2923,7 @@ uint8_t publishFieldSetting(byte paramNr) {
 #define VALUE_byte_nopub         { value_byte_nopub(packetSrc, packetType, payloadIndex, payload, mqtt_value, 1);                        return 0; }
 #define VALUE_flag8              { if (haDevice == HA_SENSOR) HADEVICE_BINSENSOR; value_flag8(packetSrc, packetType, payloadIndex, payload, mqtt_value, bitNr); return 0; }
 #define VALUE_flag8_inv          { if (haDevice == HA_SENSOR) HADEVICE_BINSENSOR; value_flag8(packetSrc, packetType, payloadIndex, payload, mqtt_value, bitNr, 1); return 0; }
-#define UNKNOWN_BIT              { CAT_UNKNOWN; CHECKBIT; if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownBit(packetSrc, packetType, payloadIndex, payload, mqtt_value, bitNr); return 0; }
+#define UNKNOWN_BIT              { CAT_UNKNOWN; CHECKBIT; STATS_BIT; if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownBit(packetSrc, packetType, payloadIndex, payload, mqtt_value, bitNr); return 0; }
 #define VALUE_u8_add2k           { value_u8_add2k(packetSrc, packetType, payloadIndex, payload, mqtt_value);                             return 0; }
 #define VALUE_s4abs1c            { value_s4abs1c(packetSrc, packetType, payloadIndex, payload, mqtt_value);                              return 0; }
 #define VALUE_u8div10            { value_u8div10(packetSrc, packetType, payloadIndex, payload, mqtt_value);                              return 0; }
@@ -2776,7 +2947,7 @@ uint8_t publishFieldSetting(byte paramNr) {
 #define VALUE_textString(s)      { value_textString(mqtt_value, s);                                                                      return 0; }
 #define VALUE_byte_textStringOnce(s)  { value_byte_textStringOnce(packetSrc, packetType, payloadIndex, payload, mqtt_value, s);                    return 0; }
 #define VALUE_bits_textStringOnce(s)  { value_bits_textStringOnce(packetSrc, packetType, payloadIndex, payload, mqtt_value, s);                    return 0; }
-#define UNKNOWN_BYTE             { CAT_UNKNOWN; CHECK(1); if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownByte(packetSrc, packetType, payloadIndex, payload, mqtt_value); return 0; }
+#define UNKNOWN_BYTE             { CAT_UNKNOWN; CHECK(1); STATS_BYTE; if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownByte(packetSrc, packetType, payloadIndex, payload, mqtt_value); return 0; }
 #define VALUE_header             { value_header(packetSrc, packetType, mqtt_value);                                                      return 0; }
 
 #define PARAM_VALUE_u8           { param_value_u_LE(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);           return 0; }
@@ -2798,8 +2969,8 @@ uint8_t publishFieldSetting(byte paramNr) {
 #define PARAM_VALUE_u24hex_BE    { param_value_hex_BE(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength);         return 0; }
 #define PARAM_FIELD_SETTING      { param_field_setting(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value);                        return 0; }
 
-#define UNKNOWN_PARAM            { CAT_UNKNOWN; CHECKPARAM(paramValLength); if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownParam_BE(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength); return 0; }
-#define UNKNOWN_PARAM_LE         { CAT_UNKNOWN; CHECKPARAM(paramValLength); if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownParam_LE(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength); return 0; }
+#define UNKNOWN_PARAM            { CAT_UNKNOWN; CHECKPARAM(paramValLength); STATS_PARAM(0); if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownParam_BE(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength); return 0; }
+#define UNKNOWN_PARAM_LE         { CAT_UNKNOWN; CHECKPARAM(paramValLength); STATS_PARAM(1); if (pubEntity && (haConfig || (EE.outputMode & 0x0100))) unknownParam_LE(paramSrc, paramPacketType, paramNr, payloadIndex, payload, mqtt_value, paramValLength); return 0; }
 
 #define UNKNOWN_PARAM8 UNKNOWN_PARAM
 #define UNKNOWN_PARAM16 UNKNOWN_PARAM
@@ -3399,9 +3570,110 @@ uint8_t handleParam(byte paramSrc, byte paramPacketType, byte payloadIndex, byte
 }
 
 #ifdef SAVESCHEDULE
-uint16_t mqtt_value_p[2];
-char mqtt_value_schedule[2][MQTT_VALUE_LEN + 500];
 const char weekDay[7][3] = { "Mo", "Tu", "We", "Th", "Fr", "Sa", "Su"};
+
+uint16_t scheduleAppendDec(char* s, uint16_t p, byte v) {
+  if (v >= 100) s[p++] = '0' + v / 100;
+  if (v >= 10) s[p++] = '0' + (v / 10) % 10;
+  s[p++] = '0' + v % 10;
+  return p;
+}
+
+uint16_t scheduleAppendHex(char* s, uint16_t p, byte v, bool twoDigits) {
+  if (twoDigits || (v >> 4)) s[p++] = "0123456789ABCDEF"[v >> 4];
+  s[p++] = "0123456789ABCDEF"[v & 0x0F];
+  return p;
+}
+
+uint16_t scheduleAppendStr(char* s, uint16_t p, const char* t) {
+  while (*t) s[p++] = *t++;
+  return p;
+}
+
+uint16_t scheduleTruncations = 0;
+
+void scheduleRender(byte PS, uint16_t memStart, uint16_t memEnd) {
+// renders schedule memory [memStart, memEnd) directly into mqtt_value
+// A segment of scheduleSegment[] renders to at most 611 characters (84 bytes, 6 moments/day: 7 * "Mo " + 42 * "23:50 Comfort "
+// + 2 quotes), well within MQTT_VALUE_LEN; only a fragment which does not match the table (up to 255 bytes, rendered as
+// weekly schedule with 6 moments/day) can exceed it: its rendering is cut off with marker " ..." and counted in scheduleTruncations.
+#define MAXSECTION 10 // max info length of <hour> or <info for schedule>
+#define SCHEDULE_TRUNCATED " ..."
+  byte type = scheduleType(memStart);
+  byte dailyMoments = type & 0x0F;
+  byte dailyMomentsCounter = 0;
+  byte dayCounter = 0;
+  uint16_t byteLoc2 = memStart;
+  uint16_t p = 0;
+  mqtt_value[p++] = '"';
+  bool truncated = false;
+  for (uint16_t byteLoc = memStart; byteLoc < memEnd; byteLoc++) {
+    if (p + MAXSECTION + 3 + strlen(SCHEDULE_TRUNCATED) >= MQTT_VALUE_LEN) {
+      truncated = true;
+      break;
+    }
+    int16_t i = scheduleMemIndex(byteLoc);
+    if (i < 0) continue;
+    byte b = scheduleMem[PS][i];
+    if (type & SCHEDULE_TYPE_NOT_WEEKLY) {
+      p = scheduleAppendHex(mqtt_value, p, b, true);
+    } else if (b == 0xFF) {
+      // no schedule moment
+    } else if (byteLoc & 0x01) {
+      // 2nd byte: new schedule content
+      if (type & SCHEDULE_TYPE_SILENT) {
+        p = scheduleAppendHex(mqtt_value, p, b, false);
+        mqtt_value[p++] = ' ';
+      } else if (type & SCHEDULE_TYPE_HC) {
+        switch (b) {
+          case 0x00 : p = scheduleAppendStr(mqtt_value, p, "Eco "); break;
+          case 0x01 : p = scheduleAppendStr(mqtt_value, p, "Comfort "); break;
+          case 0x0C : p = scheduleAppendStr(mqtt_value, p, "-10 "); break;
+          case 0x34 : p = scheduleAppendStr(mqtt_value, p, "+10 "); break;
+          default   : p = scheduleAppendStr(mqtt_value, p, "... ");
+        }
+      } else if (type & SCHEDULE_TYPE_PRICE) {
+        switch (b) {
+          case 0x00 : p = scheduleAppendStr(mqtt_value, p, "Low "); break;
+          case 0x01 : p = scheduleAppendStr(mqtt_value, p, "Med "); break;
+          case 0x02 : p = scheduleAppendStr(mqtt_value, p, "High "); break;
+          default   : p = scheduleAppendStr(mqtt_value, p, "... ");
+        }
+      } else {
+        // unknown schedule
+        p = scheduleAppendDec(mqtt_value, p, b);
+        mqtt_value[p++] = ' ';
+      }
+    } else {
+      // 1st byte: time of new schedule moment
+      while (byteLoc >= byteLoc2) {
+        if (!dailyMomentsCounter) {
+          if ((byteLoc == byteLoc2) && (dayCounter < 7)) {
+            p = scheduleAppendStr(mqtt_value, p, weekDay[dayCounter]);
+            mqtt_value[p++] = ' ';
+          }
+          dailyMomentsCounter = dailyMoments;
+          dayCounter++;
+        }
+        dailyMomentsCounter--;
+        byteLoc2 += 2;
+      }
+      p = scheduleAppendDec(mqtt_value, p, b / 6);
+      mqtt_value[p++] = ':';
+      mqtt_value[p++] = '0' + b % 6;
+      mqtt_value[p++] = '0';
+      mqtt_value[p++] = ' ';
+    }
+  }
+  if (mqtt_value[p - 1] == ' ') p--;
+  if (truncated) {
+    p = scheduleAppendStr(mqtt_value, p, SCHEDULE_TRUNCATED);
+    printfTopicS("Warning: 0x3E schedule memory 0x%04X-0x%04X truncated (%u times)", memStart, memEnd - 1, ++scheduleTruncations);
+  }
+  mqtt_value[p++] = '"';
+  mqtt_value[p] = '\0';
+  if (p <= 2) strncpy(mqtt_value, "\"Empty\"", 10);
+}
 #endif /* SAVESCHEDULE */
 
 uint16_t parameterWritesDone = 0; // # writes done by ATmega; perhaps useful for ESP-side queueing
@@ -3420,17 +3692,7 @@ byte bytesbits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte pa
 
 #ifdef E_SERIES
 #ifdef SAVESCHEDULE
-  bool newMem = 0;
   static byte newSched[2];
-  static byte weeklyMomentCounter[2];
-  static byte dailyMomentsCounter[2];
-  static byte dailyMoments[2];
-  static byte dayCounter[2];
-  static bool isWeeklySchedule[2];
-  static bool isSilentSchedule[2];
-  static bool isHCSchedule[2];
-  static bool isElectricityPriceSchedule[2];
-  static uint16_t byteLoc2[2];
 #endif /* SAVESCHEDULE */
 #endif /* E_SERIES */
 
@@ -5024,7 +5286,7 @@ byte bytesbits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte pa
       default :               return 0; // unknown packetSrc
     }
 #ifdef SAVESCHEDULE
-    case 0x3E :
+    case 0x3E : { byte PS = (packetSrc >> 6) & 0x01; // 0: main controller (00F03E), 1: auxiliary controller (40F03E)
                 switch (packetSrc) {
       case 0x00 : // fallthrough
       case 0x40 : switch (payload[0]) {
@@ -5039,7 +5301,7 @@ byte bytesbits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte pa
                       scheduleMemLoc[PS] |= ((uint16_t) (payloadByte << 8));
                       if (scheduleMemLoc[PS] == 0xFFFF) {
                         // dummy padding
-                      } else if (scheduleMemLoc[PS] > SCHEDULE_MEM_START + SCHEDULE_MEM_SIZE) {
+                      } else if (scheduleMemLoc[PS] >= SCHEDULE_MEM_END) {
                         // Warning: scheduleMemloc out of expected range
                         //Sprint("WARNING1 scheduleMemloc out of expected range %x", scheduleMemLoc[PS]);
                       } else if (scheduleMemLoc[PS] < SCHEDULE_MEM_START) {
@@ -5051,44 +5313,12 @@ byte bytesbits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte pa
                       scheduleSeq[PS] = 0;
                       if (scheduleMemLoc[PS] != 0xFFFF) {
                         scheduleLength[PS] = payloadByte;
-                        if (scheduleMemLoc[PS] + scheduleLength[PS] > SCHEDULE_MEM_START + SCHEDULE_MEM_SIZE) {
+                        if (scheduleMemLoc[PS] + scheduleLength[PS] > SCHEDULE_MEM_END) {
                           // WARNING scheduleMemLoc+scheduleLength out of expected range
                         }
                       }
                       newSched[PS] = 0;
-                      weeklyMomentCounter[PS] = 0;
-                      dayCounter[PS] = 0;
-                      dailyMomentsCounter[PS] = 0;
-                      dailyMoments[PS] = 6;
-                      isSilentSchedule[PS] = false;
-                      isHCSchedule[PS] = false;
-                      isElectricityPriceSchedule[PS] = false;
-                      mqtt_value_schedule[PS][0] = ''';
-                      mqtt_value_p[PS] = 1;
-                      byteLoc2[PS] = scheduleMemLoc[PS];
-                      isWeeklySchedule[PS] = true;
-                      switch (scheduleMemLoc[PS]) {
-                        case 0x0250 : dailyMoments[PS] = 2; isSilentSchedule[PS] = true; break;
-                        case 0x026C : dailyMoments[PS] = 2; break;
-                        case 0x0288 : dailyMoments[PS] = 4; break;
-                        case 0x02C0 : dailyMoments[PS] = 4; break;
-                        case 0x02F8 : isWeeklySchedule[PS] = true; break;
-                        case 0x034C : break;
-                        case 0x03A0 : break;
-                        case 0x03F4 : break;
-                        case 0x0448 : isHCSchedule[PS] = true; break;
-                        case 0x049C : isHCSchedule[PS] = true; break;
-                        case 0x04F0 : isHCSchedule[PS] = true; break;
-                        case 0x0544 : isHCSchedule[PS] = true; break;
-                        case 0x0598 : break;
-                        case 0x0640 : isElectricityPriceSchedule[PS] = true; break;
-                        case 0x0694 : isWeeklySchedule[PS] = false; break; // 12 bytes, ??
-                        case 0x06A0 : isWeeklySchedule[PS] = false; break; // 15 bytes, ??
-                        case 0x06AF : isWeeklySchedule[PS] = false; break; // 15 bytes, ??
-                        case 0x06BE : isWeeklySchedule[PS] = false; break; // 35 bytes, could be weekly 7 * 5 ?
-                        case 0x06E1 : isWeeklySchedule[PS] = false; break; // 45 bytes, ??
-                        default : ;
-                      }
+                      scheduleMemStart[PS] = scheduleMemLoc[PS];
                       return 0;
           case    4 : // usually 0x00 (Src=0x00, supported) or 0xFF (Src=0x40, not (yet) supported?)
                       if (payloadByte == 0xFF) scheduleLength[PS] = 0;
@@ -5106,73 +5336,20 @@ byte bytesbits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte pa
                       };
                       return 0;
           default   : // we received one byte from/for the schedule memory
-                      newMem = 0;
                       if (scheduleLength[PS]) {
-                        if ((!scheduleMemSeen[PS][scheduleMemLoc[PS] - SCHEDULE_MEM_START]) || (scheduleMem[PS][scheduleMemLoc[PS] - SCHEDULE_MEM_START] != payloadByte)) {
-                          // new (or first) value for this memory byte
-                          newMem = 1;
-                          newSched[PS] = 1;
-                        };
-                        scheduleMem[PS][scheduleMemLoc[PS] - SCHEDULE_MEM_START] = payloadByte;
-                        scheduleMemSeen[PS][scheduleMemLoc[PS] - SCHEDULE_MEM_START] = 1;
-                        uint16_t byteLoc = scheduleMemLoc[PS];
-#define MAXSECTION 10 // max info length of <hour> or <info for schedule>
-                        if (mqtt_value_p[PS] + MAXSECTION + 3 < MQTT_VALUE_LEN) {
-                          if (isWeeklySchedule[PS]) {
-                            if (byteLoc & 0x01) {
-                              if (payloadByte != 0xFF) {
-                                // 2nd byte: new schedule content
-                                if (isSilentSchedule[PS]) {
-                                  mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MQTT_VALUE_LEN - mqtt_value_p[PS], "%X ", payloadByte);
-                                } else if (isHCSchedule[PS]) {
-                                  switch (payloadByte) {
-                                    case 0x00 : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "Eco "); break;
-                                    case 0x01 : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "Comfort "); break;
-                                    case 0x0C : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "-10 "); break;
-                                    case 0x34 : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "+10 "); break;
-                                    default   : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "... ");
-                                  }
-                                } else if (isElectricityPriceSchedule[PS]) {
-                                  switch (payloadByte) {
-                                    case 0x00 : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "Low "); break;
-                                    case 0x01 : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "Med "); break;
-                                    case 0x02 : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "High "); break;
-                                    default   : mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "... ");
-                                  }
-                                } else {
-                                  // unkown schedule
-                                  mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "%i ", payloadByte);
-                                }
-                              }
-                            } else {
-                              if (payloadByte != 0xFF) {
-                                // 1st byte: time of new schedule moment
-                                while (byteLoc >= byteLoc2[PS]) {
-                                  if (!dailyMomentsCounter[PS]) {
-                                    if (byteLoc == byteLoc2[PS]) {
-                                      mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "%s ", weekDay[dayCounter[PS]]);
-                                    }
-                                    dailyMomentsCounter[PS] = dailyMoments[PS];
-                                    dayCounter[PS]++;
-                                  }
-                                  dailyMomentsCounter[PS]--;
-                                  byteLoc2[PS] += 2;
-                                }
-                                mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "%i:%i0 ", payloadByte / 6, payloadByte % 6);
-                              }
-                            }
-                          } else {
-                            mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], MAXSECTION, "%02X", payloadByte);
-                          }
+                        int16_t i = scheduleMemIndex(scheduleMemLoc[PS]);
+                        if (i >= 0) {
+                          if ((!(scheduleMemSeen[PS][i >> 3] & (1 << (i & 0x07)))) || (scheduleMem[PS][i] != payloadByte)) {
+                            // new (or first) value for this memory byte
+                            newSched[PS] = 1;
+                          };
+                          scheduleMem[PS][i] = payloadByte;
+                          scheduleMemSeen[PS][i >> 3] |= (1 << (i & 0x07));
                         }
                         scheduleMemLoc[PS]++;
                         if (--scheduleLength[PS] == 0) {
                           // Last byte of memory fragment received, so generate mqtt_value for output
-                         if (*(mqtt_value_schedule[PS] + mqtt_value_p[PS] - 1) == ' ') mqtt_value_p[PS]--;
-                         mqtt_value_p[PS] += snprintf(mqtt_value_schedule[PS] + mqtt_value_p[PS], 2, "\"");
-                          strncpy(mqtt_value, mqtt_value_schedule[PS], MQTT_VALUE_LEN);
-                          mqtt_value[MQTT_VALUE_LEN - 1] = '\0';
-                          if (mqtt_value_p[PS] <= 2) strncpy(mqtt_value, "\"Empty\"", 10);
+                          scheduleRender(PS, scheduleMemStart[PS], scheduleMemLoc[PS]);
 
                           switch (scheduleMemLoc[PS]) {
                             case 0x0250 : break; // Warning: at end of read operation, scheduleMemLoc points to start of next memory segment; table thus 1 line shifted versus protocol-doc
@@ -5199,17 +5376,18 @@ byte bytesbits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte pa
                             default : KEY("Memory_Unknown"); break;
                           }
                           CAT_SCHEDULE;
-                          return newSched[PS]; // outdated code
+                          if (newSched[PS]) clientPublish(mqtt_value, haQos); // first or changed contents
+                          return 0;
                         }
                       } else {
                         // Receiving more (padding) bytes than fragment length
                       }
-                      return 0; // return newMem;
+                      return 0;
         }; return 0;
         default   : return 0; // not observed
       }
       default : UNKNOWN_BYTE // unknown source
-    }
+    } }
 #else /* SAVESCHEDULE */
     case 0x3E : return 0;
 #endif /* SAVESCHEDULE */
@@ -6172,7 +6350,7 @@ byte bytesbits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte pa
   SRC(src); // set SRC char in mqttTopic
 
   switch (packetType) {
-#include "P1P2_Pseudo.h"
+#include "P1P2_ParameterConversion/P1P2_Pseudo.h"
     default : return 0; // UNKNOWN_BYTE // unknown PacketByte
   }
 
@@ -6273,6 +6451,9 @@ void unSeen() {
 }
 
 byte bits2keyvalue(byte packetSrc, byte packetDst, byte packetType, byte payloadIndex, byte* payload, byte j) {
+#ifdef UNKNOWN_STATS
+  unknownDecoded = false;
+#endif /* UNKNOWN_STATS */
   byte b = bytesbits2keyvalue(packetSrc, packetDst, packetType, payloadIndex, payload, j) ;
   return b;
 }
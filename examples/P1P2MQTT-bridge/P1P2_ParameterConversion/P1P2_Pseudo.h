@@ -50,6 +50,9 @@
 #ifdef F_SERIES
         case   13 : HACONFIG; KEY1_PUB_CONFIG_CHECK_ENTITY("Model_Suggestion");                                                                                           VALUE_u8;
 #endif /* F_SERIES */
+        case   15 : KEY2_PUB_CONFIG_CHECK_ENTITY("ATmega_Serial_Bytes_Dropped");                               HAEVENTS;                                                  VALUE_u16_LE;
+        case   17 : KEY2_PUB_CONFIG_CHECK_ENTITY("ATmega_Serial_Output_Blocked");                              HAEVENTS;                                                  VALUE_u16_LE;
+        case   18 : KEY1_PUB_CONFIG_CHECK_ENTITY("ATmega_Serial_Output_Peak");                                                                                            VALUE_u8;
         default   : return 0;
       }
       case 0x40 : switch (payloadIndex) {
@@ -0,0 +1,172 @@
+/* Arduino.h: minimal host (Linux) replacement of the ESP8266 Arduino core API used by P1P2MQTT-bridge
+ *
+ * Part of the Linux bridge daemon, see README.md in this directory.
+ * ESP8266 int and long are 32-bit, as on x86_64 Linux int, so (unlike the P1P2Monitor host build) sscanf/printf formats are used as-is.
+ * PROGMEM data is plain data, the _P functions map to their libc counterparts.
+ * Serial is the ATmega serial device (tty or pty), millis() is CLOCK_MONOTONIC, and delay()/yield() service the network (host_esp.cpp).
+ * time() is redirected to host_time(), which follows the virtual clock of the decoder and replay runner.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+#include <time.h>
+#include <string>
+#include <algorithm>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define DEC 10
+#define HEX 16
+
+#define LOW  0
+#define HIGH 1
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+using std::min;
+using std::max;
+
+#define PROGMEM
+#define PSTR(s) (s)
+#define FPSTR(p) (reinterpret_cast<const __FlashStringHelper *>(p))
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+#define pgm_read_byte(p) (*(const uint8_t*) (p))
+#define pgm_read_word(p) (*(const uint16_t*) (p))
+#define pgm_read_dword(p) (*(const uint32_t*) (p))
+#define snprintf_P snprintf
+#define sprintf_P sprintf
+#define strncpy_P strncpy
+#define strcpy_P strcpy
+#define strstr_P strstr
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+// BSD string functions of the ESP8266 core (not in glibc < 2.38)
+size_t host_strlcpy(char* dst, const char* src, size_t size);
+size_t host_strlcat(char* dst, const char* src, size_t size);
+#define strlcpy host_strlcpy
+#define strlcat host_strlcat
+
+unsigned long millis(void);
+unsigned long micros(void);
+void delay(unsigned long ms); // sleeps while servicing MQTT and telnet sockets, as ESP8266 delay() runs the network stack
+void yield(void);
+time_t host_time(time_t* t); // wall clock, on the virtual clock (host_clock_advance()) from a fixed date, for reproducible output
+#define time(t) host_time(t)
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+class String {
+  public:
+    String(const char* s = "") : s(s ? s : "") {}
+    String(const std::string& s) : s(s) {}
+    String(const __FlashStringHelper* s) : s(reinterpret_cast<const char*>(s)) {}
+    String(int n) : s(std::to_string(n)) {}
+    String(unsigned int n) : s(std::to_string(n)) {}
+    String(long n) : s(std::to_string(n)) {}
+    String(unsigned long n) : s(std::to_string(n)) {}
+    const char* c_str(void) const { return s.c_str(); }
+    unsigned int length(void) const { return s.length(); }
+    char operator[](unsigned int i) const { return (i < s.length()) ? s[i] : '\0'; }
+    String& operator+=(const String& t) { s += t.s; return *this; }
+    String& operator+=(const char* t) { s += t; return *this; }
+    String& operator+=(char c) { s += c; return *this; }
+    bool operator==(const String& t) const { return s == t.s; }
+    bool operator==(const char* t) const { return s == t; }
+    bool operator!=(const String& t) const { return s != t.s; }
+    friend String operator+(const String& a, const String& b) { return String(a.s + b.s); }
+    friend String operator+(const String& a, const char* b) { return String(a.s + b); }
+    friend String operator+(const char* a, const String& b) { return String(a + b.s); }
+    friend String operator+(const String& a, char c) { return String(a.s + c); }
+    void trim(void) {
+      size_t b = s.find_first_not_of(" \t\r\n");
+      size_t e = s.find_last_not_of(" \t\r\n");
+      s = (b == std::string::npos) ? "" : s.substr(b, e - b + 1);
+    }
+  private:
+    std::string s;
+};
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t* buf, size_t n) { size_t m = 0; while (n--) m += write(*buf++); return m; }
+    size_t write(const char* s) { return write(reinterpret_cast<const uint8_t*>(s), strlen(s)); }
+    size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+    size_t print(const String& s) { return write(s.c_str()); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+    size_t print(int n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(double d, int digits = 2) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.*f", digits, d);
+      return write(buf);
+    }
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(T v, int base) { size_t n = print(v, base); return n + println(); }
+    size_t println(void) { return write("\r\n"); }
+    size_t printf(const char* format, ...) __attribute__ ((format (printf, 2, 3))) {
+      char buf[1024];
+      va_list args;
+      va_start(args, format);
+      vsnprintf(buf, sizeof(buf), format, args);
+      va_end(args);
+      return write(buf);
+    }
+  private:
+    size_t printSigned(long n, int base) {
+      if ((base == DEC) && (n < 0)) return write('-') + printNumber(-n, base);
+      return printNumber((unsigned long) n, base);
+    }
+    size_t printNumber(unsigned long n, int base) {
+      char buf[8 * sizeof(long) + 1];
+      char* p = buf + sizeof(buf) - 1;
+      *p = '\0';
+      do {
+        byte d = n % base;
+        *--p = (d < 10) ? '0' + d : 'A' + d - 10;
+        n /= base;
+      } while (n);
+      return write(p);
+    }
+};
+
+// Serial connection to P1P2Monitor on the ATmega: a tty/pty file descriptor opened by the daemon (host_serial_open())
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long baud);
+    void end(void) {}
+    size_t setRxBufferSize(size_t n) { return n; } // input is buffered without limit
+    int available(void);
+    int read(void);
+    void flush(void) {}
+    virtual size_t write(uint8_t c) { return write(&c, 1); }
+    virtual size_t write(const uint8_t* buf, size_t n);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#include "IPAddress.h"
+#include "Esp.h"
+
+#endif /* Arduino_h */
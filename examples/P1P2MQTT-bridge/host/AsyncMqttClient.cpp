@@ -0,0 +1,431 @@
+/* AsyncMqttClient.cpp: MQTT 3.1.1 client for the bridge daemon, or publish capture for the decoder, see AsyncMqttClient.h */
+
+#include "AsyncMqttClient.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#define MQTT_CONNECT     0x10
+#define MQTT_CONNACK     0x20
+#define MQTT_PUBLISH     0x30
+#define MQTT_PUBACK      0x40
+#define MQTT_PUBREC      0x50
+#define MQTT_PUBREL      0x62
+#define MQTT_PUBCOMP     0x70
+#define MQTT_SUBSCRIBE   0x82
+#define MQTT_SUBACK      0x90
+#define MQTT_UNSUBSCRIBE 0xA2
+#define MQTT_UNSUBACK    0xB0
+#define MQTT_PINGREQ     0xC0
+#define MQTT_PINGRESP    0xD0
+#define MQTT_DISCONNECT  0xE0
+
+#define MQTT_CONNECT_TIMEOUT 5000 // ms for TCP connect and CONNACK
+
+HostMqttCapture host_mqtt_capture = NULL;
+static AsyncMqttClient* captureClient = NULL; // connected client in capture mode, receives host_mqtt_receive() messages
+
+static void putString(std::string& s, const char* v, size_t n)
+{
+  s += (char) (n >> 8);
+  s += (char) (n & 0xFF);
+  s.append(v, n);
+}
+
+static void putString(std::string& s, const std::string& v)
+{
+  putString(s, v.data(), v.size());
+}
+
+static void put16(std::string& s, uint16_t v)
+{
+  s += (char) (v >> 8);
+  s += (char) (v & 0xFF);
+}
+
+AsyncMqttClient::AsyncMqttClient() {}
+
+AsyncMqttClient::~AsyncMqttClient()
+{
+  if (_fd >= 0) ::close(_fd);
+  if (captureClient == this) captureClient = NULL;
+}
+
+AsyncMqttClient& AsyncMqttClient::setCredentials(const char* username, const char* password)
+{
+  _hasCredentials = (username != nullptr);
+  _username = username ? username : "";
+  _hasPassword = (password != nullptr);
+  _password = password ? password : "";
+  return *this;
+}
+
+AsyncMqttClient& AsyncMqttClient::setWill(const char* topic, uint8_t qos, bool retain, const char* payload, size_t length)
+{
+  _hasWill = true;
+  _willTopic = topic;
+  _willQos = qos;
+  _willRetain = retain;
+  _willPayload = payload ? std::string(payload, length ? length : strlen(payload)) : "";
+  return *this;
+}
+
+void AsyncMqttClient::connect(void)
+{
+  if (_state != DISCONNECTED) return;
+  if (host_mqtt_capture) {
+    _state = CONNECTED;
+    captureClient = this;
+    _events.push_back(Event{Event::CONNACK, 0, 0, {}, "", ""});
+    return;
+  }
+  struct addrinfo hints, *res;
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  char port[8];
+  snprintf(port, sizeof(port), "%u", _port);
+  if (getaddrinfo(_host.c_str(), port, &hints, &res)) {
+    host_log("MQTT server %s not found", _host.c_str());
+    _events.push_back(Event{Event::CLOSED, 0, (uint8_t) AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, {}, "", ""});
+    return;
+  }
+  _fd = socket(res->ai_family, res->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, res->ai_protocol);
+  if (_fd >= 0) {
+    int one = 1;
+    setsockopt(_fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if ((::connect(_fd, res->ai_addr, res->ai_addrlen) < 0) && (errno != EINPROGRESS)) {
+      ::close(_fd);
+      _fd = -1;
+    }
+  }
+  freeaddrinfo(res);
+  if (_fd < 0) {
+    _events.push_back(Event{Event::CLOSED, 0, (uint8_t) AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, {}, "", ""});
+    return;
+  }
+  _state = TCP_CONNECTING;
+  _connectStart = millis();
+  _in.clear();
+  _out.clear();
+}
+
+void AsyncMqttClient::sendConnect(void)
+{
+  std::string body;
+  putString(body, "MQTT", 4);
+  body += (char) 0x04; // protocol level 3.1.1
+  uint8_t flags = (_cleanSession ? 0x02 : 0x00);
+  if (_hasWill) flags |= 0x04 | (_willQos << 3) | (_willRetain ? 0x20 : 0x00);
+  if (_hasCredentials) flags |= 0x80;
+  if (_hasCredentials && _hasPassword) flags |= 0x40;
+  body += (char) flags;
+  put16(body, _keepAlive);
+  putString(body, _clientId);
+  if (_hasWill) {
+    putString(body, _willTopic);
+    putString(body, _willPayload);
+  }
+  if (_hasCredentials) putString(body, _username);
+  if (_hasCredentials && _hasPassword) putString(body, _password);
+  sendPacket(MQTT_CONNECT, body);
+}
+
+void AsyncMqttClient::sendPacket(uint8_t header, const std::string& body)
+{
+  _out += (char) header;
+  size_t n = body.size();
+  do {
+    uint8_t b = n & 0x7F;
+    n >>= 7;
+    if (n) b |= 0x80;
+    _out += (char) b;
+  } while (n);
+  _out += body;
+  _lastSent = millis();
+  flush();
+}
+
+void AsyncMqttClient::flush(void)
+{
+  while (!_out.empty() && (_fd >= 0) && (_state != TCP_CONNECTING)) {
+    ssize_t n = send(_fd, _out.data(), _out.size(), MSG_NOSIGNAL);
+    if (n > 0) {
+      _out.erase(0, n);
+    } else {
+      if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) return;
+      close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+      return;
+    }
+  }
+  if (_out.empty() && (_state == DISCONNECTING)) close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+}
+
+void AsyncMqttClient::disconnect(bool force)
+{
+  if (_state == DISCONNECTED) return;
+  if (force || (_state != CONNECTED) || host_mqtt_capture) {
+    close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+    return;
+  }
+  sendPacket(MQTT_DISCONNECT, "");
+  if (_state == CONNECTED) _state = DISCONNECTING;
+  flush();
+}
+
+void AsyncMqttClient::clearQueue(void)
+{
+  // a partially written packet cannot be dropped without breaking the stream
+  if ((_state == CONNECTED) || (_state == DISCONNECTING)) return;
+  _out.clear();
+}
+
+void AsyncMqttClient::close(AsyncMqttClientDisconnectReason reason, bool event)
+{
+  if (_fd >= 0) ::close(_fd);
+  _fd = -1;
+  _state = DISCONNECTED;
+  _out.clear();
+  _in.clear();
+  if (event) _events.push_back(Event{Event::CLOSED, 0, (uint8_t) reason, {}, "", ""});
+}
+
+void host_mqtt_receive(const char* topic, const char* payload, size_t length)
+{
+  AsyncMqttClient* c = captureClient;
+  if (!c || (c->_state != AsyncMqttClient::CONNECTED)) return;
+  c->_events.push_back(AsyncMqttClient::Event{AsyncMqttClient::Event::MESSAGE, 0, 0, {0, false, false}, topic, std::string(payload, length)});
+}
+
+uint16_t AsyncMqttClient::subscribe(const char* topic, uint8_t qos)
+{
+  if (_state != CONNECTED) return 0;
+  uint16_t id = nextPacketId();
+  if (host_mqtt_capture) {
+    _events.push_back(Event{Event::SUBSCRIBED, id, qos, {}, "", ""});
+    return id;
+  }
+  std::string body;
+  put16(body, id);
+  putString(body, topic, strlen(topic));
+  body += (char) qos;
+  sendPacket(MQTT_SUBSCRIBE, body);
+  return id;
+}
+
+uint16_t AsyncMqttClient::unsubscribe(const char* topic)
+{
+  if (_state != CONNECTED) return 0;
+  uint16_t id = nextPacketId();
+  if (host_mqtt_capture) {
+    _events.push_back(Event{Event::UNSUBSCRIBED, id, 0, {}, "", ""});
+    return id;
+  }
+  std::string body;
+  put16(body, id);
+  putString(body, topic, strlen(topic));
+  sendPacket(MQTT_UNSUBSCRIBE, body);
+  return id;
+}
+
+uint16_t AsyncMqttClient::publish(const char* topic, uint8_t qos, bool retain, const char* payload, size_t length, bool dup, uint16_t messageId)
+{
+  if (_state != CONNECTED) return 0;
+  if (qos > 2) qos = 2;
+  uint16_t id = qos ? (messageId ? messageId : nextPacketId()) : 1;
+  if (host_mqtt_capture) {
+    host_mqtt_capture(topic, qos, retain, payload ? payload : "", payload ? (length ? length : strlen(payload)) : 0);
+    if (qos) _events.push_back(Event{Event::PUBLISHED, id, 0, {}, "", ""});
+    return id;
+  }
+  std::string body;
+  putString(body, topic, strlen(topic));
+  if (qos) put16(body, id);
+  if (payload) body.append(payload, length ? length : strlen(payload));
+  sendPacket(MQTT_PUBLISH | (dup ? 0x08 : 0x00) | (qos << 1) | (retain ? 0x01 : 0x00), body);
+  return id;
+}
+
+void AsyncMqttClient::receive(void)
+{
+  char buf[4096];
+  for (;;) {
+    ssize_t n = recv(_fd, buf, sizeof(buf), 0);
+    if (n > 0) {
+      _in.append(buf, n);
+      if (n < (ssize_t) sizeof(buf)) break;
+    } else {
+      if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) break;
+      close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+      return;
+    }
+  }
+  parse();
+}
+
+void AsyncMqttClient::parse(void)
+{
+  for (;;) {
+    // fixed header: type/flags, remaining length (1-4 bytes)
+    if (_in.size() < 2) return;
+    size_t len = 0, i = 1;
+    uint8_t b;
+    do {
+      if (i >= _in.size()) return;
+      if (i > 4) {
+        close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+        return;
+      }
+      b = _in[i];
+      len |= (size_t) (b & 0x7F) << (7 * (i - 1));
+      i++;
+    } while (b & 0x80);
+    if (_in.size() < i + len) return;
+    uint8_t header = _in[0];
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(_in.data()) + i;
+    uint16_t id = (len >= 2) ? ((p[0] << 8) | p[1]) : 0;
+    switch (header & 0xF0) {
+      case MQTT_CONNACK     : if ((len >= 2) && (_state == MQTT_CONNECTING)) {
+                                if (p[1]) {
+                                  _in.erase(0, i + len);
+                                  close((AsyncMqttClientDisconnectReason) p[1], true);
+                                  return;
+                                }
+                                _state = CONNECTED;
+                                _events.push_back(Event{Event::CONNACK, 0, (uint8_t) (p[0] & 0x01), {}, "", ""});
+                              }
+                              break;
+      case MQTT_PUBLISH     : if (len >= 2) {
+                                AsyncMqttClientMessageProperties properties;
+                                properties.qos = (header >> 1) & 0x03;
+                                properties.dup = header & 0x08;
+                                properties.retain = header & 0x01;
+                                size_t tlen = (p[0] << 8) | p[1];
+                                size_t k = 2 + tlen;
+                                uint16_t mid = 0;
+                                if (properties.qos) {
+                                  mid = (k + 2 <= len) ? ((p[k] << 8) | p[k + 1]) : 0;
+                                  k += 2;
+                                }
+                                if (k <= len) {
+                                  _events.push_back(Event{Event::MESSAGE, mid, 0, properties,
+                                                          std::string(reinterpret_cast<const char*>(p) + 2, tlen),
+                                                          std::string(reinterpret_cast<const char*>(p) + k, len - k)});
+                                  if (properties.qos == 1) {
+                                    std::string body;
+                                    put16(body, mid);
+                                    sendPacket(MQTT_PUBACK, body);
+                                  } else if (properties.qos == 2) {
+                                    std::string body;
+                                    put16(body, mid);
+                                    sendPacket(MQTT_PUBREC, body);
+                                  }
+                                }
+                              }
+                              break;
+      case MQTT_PUBACK      :
+      case MQTT_PUBCOMP     : _events.push_back(Event{Event::PUBLISHED, id, 0, {}, "", ""});
+                              break;
+      case MQTT_PUBREC      : {
+                                std::string body;
+                                put16(body, id);
+                                sendPacket(MQTT_PUBREL, body);
+                              }
+                              break;
+      case MQTT_PUBREL & 0xF0 : {
+                                std::string body;
+                                put16(body, id);
+                                sendPacket(MQTT_PUBCOMP, body);
+                              }
+                              break;
+      case MQTT_SUBACK      : _events.push_back(Event{Event::SUBSCRIBED, id, (uint8_t) ((len >= 3) ? p[2] : 0x80), {}, "", ""});
+                              break;
+      case MQTT_UNSUBACK    : _events.push_back(Event{Event::UNSUBSCRIBED, id, 0, {}, "", ""});
+                              break;
+      case MQTT_PINGRESP    : break;
+      default               : break;
+    }
+    if (_fd < 0) return; // closed by sendPacket
+    _in.erase(0, i + len);
+  }
+}
+
+void AsyncMqttClient::dispatch(void)
+{
+  if (_dispatching) return;
+  _dispatching = true;
+  while (!_events.empty()) {
+    Event e = _events.front();
+    _events.pop_front();
+    switch (e.type) {
+      case Event::CONNACK      : if (_onConnect) _onConnect(e.code);
+                                 break;
+      case Event::MESSAGE      : if (_onMessage) {
+                                   size_t len = e.payload.size(), index = 0;
+                                   _onMessage(&e.topic[0], &e.payload[0], e.properties, len, index, len);
+                                 }
+                                 break;
+      case Event::PUBLISHED    : if (_onPublish) _onPublish(e.packetId);
+                                 break;
+      case Event::SUBSCRIBED   : if (_onSubscribe) _onSubscribe(e.packetId, e.code);
+                                 break;
+      case Event::UNSUBSCRIBED : if (_onUnsubscribe) _onUnsubscribe(e.packetId);
+                                 break;
+      case Event::CLOSED       : if (_onDisconnect) _onDisconnect((AsyncMqttClientDisconnectReason) e.code);
+                                 break;
+    }
+  }
+  _dispatching = false;
+}
+
+void AsyncMqttClient::pollFds(std::vector<struct pollfd> &fds)
+{
+  // always one entry (fd -1 is ignored by poll()), so pollService() finds it when the socket was opened in between
+  short events = POLLIN;
+  if ((_state == TCP_CONNECTING) || !_out.empty()) events |= POLLOUT;
+  fds.push_back({_fd, events, 0});
+}
+
+int AsyncMqttClient::pollTimeout(void)
+{
+  uint32_t now = millis();
+  switch (_state) {
+    case TCP_CONNECTING  :
+    case MQTT_CONNECTING : return max(0, (int) (MQTT_CONNECT_TIMEOUT - (now - _connectStart)));
+    case CONNECTED       : return _keepAlive ? max(0, (int) (_keepAlive * 1000U / 2 - (now - _lastSent))) : -1;
+    default              : return -1;
+  }
+}
+
+void AsyncMqttClient::pollService(const struct pollfd* fds)
+{
+  short revents = (fds[0].fd == _fd) ? fds[0].revents : 0;
+  uint32_t now = millis();
+  if (_state == TCP_CONNECTING) {
+    if (revents & (POLLOUT | POLLERR | POLLHUP)) {
+      int err = 0;
+      socklen_t len = sizeof(err);
+      getsockopt(_fd, SOL_SOCKET, SO_ERROR, &err, &len);
+      if (err) {
+        host_log("MQTT connect to %s:%u failed: %s", _host.c_str(), _port, strerror(err));
+        close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+        return;
+      }
+      _state = MQTT_CONNECTING;
+      sendConnect();
+    } else if (now - _connectStart > MQTT_CONNECT_TIMEOUT) {
+      close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+      return;
+    }
+  } else if (_fd >= 0) {
+    if (revents & (POLLIN | POLLERR | POLLHUP)) receive();
+    if ((_state == MQTT_CONNECTING) && (now - _connectStart > MQTT_CONNECT_TIMEOUT)) close(AsyncMqttClientDisconnectReason::TCP_DISCONNECTED, true);
+    if ((_state == CONNECTED) && _keepAlive && (now - _lastSent >= _keepAlive * 1000U / 2)) sendPacket(MQTT_PINGREQ, "");
+    if (revents & POLLOUT) flush();
+  }
+  dispatch();
+}
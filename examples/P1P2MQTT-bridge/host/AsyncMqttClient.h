@@ -0,0 +1,129 @@
+/* AsyncMqttClient.h: host replacement of the AsyncMqttClient library (same API subset), an MQTT 3.1.1 client on a POSIX socket
+ *
+ * As on the ESP8266, callbacks run asynchronously from the bridge's point of view: from delay()/yield() and between loop() calls.
+ * Outgoing messages are queued without limit (no MQTT_MIN_FREE_MEMORY constraint), while connected;
+ * clearQueue() drops messages not yet handed to the socket.
+ * Incoming messages are delivered in one piece (index 0, len == total), QoS 0/1/2 is acknowledged,
+ * outgoing QoS 1/2 messages are not retransmitted after a reconnect (as in AsyncMqttClient).
+ * With host_mqtt_capture set (host.h), there is no server: the client connects at once, publishes go to the capture function,
+ * and publishes, subscribes and unsubscribes are acknowledged at once; host_mqtt_receive() passes an incoming message to the client.
+ */
+
+#ifndef AsyncMqttClient_h
+#define AsyncMqttClient_h
+
+#include "Arduino.h"
+#include "host.h"
+#include <functional>
+#include <string>
+#include <deque>
+
+enum class AsyncMqttClientDisconnectReason : uint8_t {
+  TCP_DISCONNECTED = 0,
+  MQTT_UNACCEPTABLE_PROTOCOL_VERSION = 1,
+  MQTT_IDENTIFIER_REJECTED = 2,
+  MQTT_SERVER_UNAVAILABLE = 3,
+  MQTT_MALFORMED_CREDENTIALS = 4,
+  MQTT_NOT_AUTHORIZED = 5,
+  ESP8266_NOT_ENOUGH_SPACE = 6,
+  TLS_BAD_FINGERPRINT = 7
+};
+
+struct AsyncMqttClientMessageProperties {
+  uint8_t qos;
+  bool dup;
+  bool retain;
+};
+
+typedef std::function<void(bool sessionPresent)> AsyncMqttClientOnConnect;
+typedef std::function<void(AsyncMqttClientDisconnectReason reason)> AsyncMqttClientOnDisconnect;
+typedef std::function<void(uint16_t packetId, uint8_t qos)> AsyncMqttClientOnSubscribe;
+typedef std::function<void(uint16_t packetId)> AsyncMqttClientOnUnsubscribe;
+typedef std::function<void(char* topic, char* payload, const AsyncMqttClientMessageProperties& properties,
+                           const size_t& len, const size_t& index, const size_t& total)> AsyncMqttClientOnMessage;
+typedef std::function<void(uint16_t packetId)> AsyncMqttClientOnPublish;
+
+class AsyncMqttClient : public HostPollable {
+  public:
+    AsyncMqttClient();
+    ~AsyncMqttClient();
+
+    AsyncMqttClient& setKeepAlive(uint16_t keepAlive) { _keepAlive = keepAlive; return *this; }
+    AsyncMqttClient& setClientId(const char* clientId) { _clientId = clientId; return *this; }
+    AsyncMqttClient& setCleanSession(bool cleanSession) { _cleanSession = cleanSession; return *this; }
+    AsyncMqttClient& setCredentials(const char* username, const char* password = nullptr);
+    AsyncMqttClient& setWill(const char* topic, uint8_t qos, bool retain, const char* payload = nullptr, size_t length = 0);
+    AsyncMqttClient& setServer(IPAddress ip, uint16_t port) { _host = ip.toString().c_str(); _port = port; return *this; }
+    AsyncMqttClient& setServer(const char* host, uint16_t port) { _host = host; _port = port; return *this; }
+
+    AsyncMqttClient& onConnect(AsyncMqttClientOnConnect callback) { _onConnect = callback; return *this; }
+    AsyncMqttClient& onDisconnect(AsyncMqttClientOnDisconnect callback) { _onDisconnect = callback; return *this; }
+    AsyncMqttClient& onSubscribe(AsyncMqttClientOnSubscribe callback) { _onSubscribe = callback; return *this; }
+    AsyncMqttClient& onUnsubscribe(AsyncMqttClientOnUnsubscribe callback) { _onUnsubscribe = callback; return *this; }
+    AsyncMqttClient& onMessage(AsyncMqttClientOnMessage callback) { _onMessage = callback; return *this; }
+    AsyncMqttClient& onPublish(AsyncMqttClientOnPublish callback) { _onPublish = callback; return *this; }
+
+    bool connected(void) const { return _state == CONNECTED; }
+    void connect(void);
+    void disconnect(bool force = false);
+    void clearQueue(void);
+    uint16_t subscribe(const char* topic, uint8_t qos);
+    uint16_t unsubscribe(const char* topic);
+    uint16_t publish(const char* topic, uint8_t qos, bool retain, const char* payload = nullptr, size_t length = 0, bool dup = false, uint16_t messageId = 0);
+    const char* getClientId(void) const { return _clientId.c_str(); }
+
+    // HostPollable
+    void pollFds(std::vector<struct pollfd> &fds);
+    void pollService(const struct pollfd* fds);
+    int pollTimeout(void);
+
+  private:
+    enum { DISCONNECTED, TCP_CONNECTING, MQTT_CONNECTING, CONNECTED, DISCONNECTING } _state = DISCONNECTED;
+    int _fd = -1;
+    std::string _host;
+    uint16_t _port = 1883;
+    std::string _clientId;
+    bool _cleanSession = true;
+    uint16_t _keepAlive = 15;
+    bool _hasCredentials = false;
+    std::string _username, _password;
+    bool _hasPassword = false;
+    bool _hasWill = false;
+    std::string _willTopic, _willPayload;
+    uint8_t _willQos = 0;
+    bool _willRetain = false;
+    uint16_t _packetId = 0;
+    uint32_t _lastSent = 0;
+    uint32_t _connectStart = 0;
+    std::string _out;           // encoded packets not yet written to the socket
+    std::string _in;            // bytes received, not yet parsed
+    struct Event {
+      enum { CONNACK, MESSAGE, PUBLISHED, SUBSCRIBED, UNSUBSCRIBED, CLOSED } type;
+      uint16_t packetId;
+      uint8_t code;
+      AsyncMqttClientMessageProperties properties;
+      std::string topic, payload;
+    };
+    std::deque<Event> _events;  // dispatched to the callbacks, never nested
+    bool _dispatching = false;
+
+    AsyncMqttClientOnConnect _onConnect;
+    AsyncMqttClientOnDisconnect _onDisconnect;
+    AsyncMqttClientOnSubscribe _onSubscribe;
+    AsyncMqttClientOnUnsubscribe _onUnsubscribe;
+    AsyncMqttClientOnMessage _onMessage;
+    AsyncMqttClientOnPublish _onPublish;
+
+    uint16_t nextPacketId(void) { if (!++_packetId) _packetId = 1; return _packetId; }
+    void sendPacket(uint8_t header, const std::string& body);
+    void sendConnect(void);
+    void flush(void);
+    void receive(void);
+    void parse(void);
+    void close(AsyncMqttClientDisconnectReason reason, bool event);
+    void dispatch(void);
+
+    friend void host_mqtt_receive(const char* topic, const char* payload, size_t length);
+};
+
+#endif /* AsyncMqttClient_h */
@@ -0,0 +1,8 @@
+/* DNSServer.h: host replacement, the WiFiManager captive portal is not used by the daemon */
+
+#ifndef DNSServer_h
+#define DNSServer_h
+
+#include "Arduino.h"
+
+#endif /* DNSServer_h */
@@ -0,0 +1,8 @@
+/* EEPROM.h: host replacement, the bridge stores its EEPROM settings with ESP.flashWrite()/flashRead() (see Esp.h) */
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include "Arduino.h"
+
+#endif /* EEPROM_h */
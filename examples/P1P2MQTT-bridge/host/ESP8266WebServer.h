@@ -0,0 +1,8 @@
+/* ESP8266WebServer.h: host replacement, the web server (firmware update) is not built for the daemon */
+
+#ifndef ESP8266WebServer_h
+#define ESP8266WebServer_h
+
+#include "Arduino.h"
+
+#endif /* ESP8266WebServer_h */
@@ -0,0 +1,44 @@
+/* ESP8266WiFi.h: host replacement of the ESP8266 WiFi class
+ *
+ * The host network is always up: the daemon reports a connected station with the address of its first non-loopback interface.
+ * Commands changing the WiFi network have no effect.
+ */
+
+#ifndef ESP8266WiFi_h
+#define ESP8266WiFi_h
+
+#include "Arduino.h"
+
+typedef enum {
+  WL_IDLE_STATUS = 0,
+  WL_NO_SSID_AVAIL = 1,
+  WL_SCAN_COMPLETED = 2,
+  WL_CONNECTED = 3,
+  WL_CONNECT_FAILED = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_WRONG_PASSWORD = 6,
+  WL_DISCONNECTED = 7
+} wl_status_t;
+
+class ESP8266WiFiClass {
+  public:
+    bool isConnected(void) { return true; }
+    wl_status_t status(void) { return WL_CONNECTED; }
+    IPAddress localIP(void);
+    IPAddress softAPIP(void) { return IPAddress(); }
+    int32_t RSSI(void) { return 0; }
+    String SSID(void) { return String("host"); }
+    String psk(void) { return String(""); }
+    wl_status_t begin(const char* ssid, const char* psk = nullptr) { (void) ssid; (void) psk; return WL_CONNECTED; }
+    bool disconnect(bool wifioff = false) { (void) wifioff; return true; }
+    void persistent(bool persistent) { (void) persistent; }
+};
+
+extern ESP8266WiFiClass WiFi;
+
+// SDK (user_interface.h): STATION_IF reports the MAC address of the host interface of localIP(), SOFTAP_IF none
+#define STATION_IF 0
+#define SOFTAP_IF  1
+bool wifi_get_macaddr(uint8_t if_index, uint8_t* macaddr);
+
+#endif /* ESP8266WiFi_h */
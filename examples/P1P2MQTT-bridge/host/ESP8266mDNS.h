@@ -0,0 +1,17 @@
+/* ESP8266mDNS.h: host replacement of the ESP8266 mDNS responder (no-op, the daemon does not announce services) */
+
+#ifndef ESP8266mDNS_h
+#define ESP8266mDNS_h
+
+#include "Arduino.h"
+
+class MDNSResponder {
+  public:
+    bool begin(const char* hostname) { (void) hostname; return true; }
+    bool addService(const char* service, const char* proto, uint16_t port) { (void) service; (void) proto; (void) port; return true; }
+    bool update(void) { return true; }
+};
+
+extern MDNSResponder MDNS;
+
+#endif /* ESP8266mDNS_h */
@@ -0,0 +1,163 @@
+/* ESPTelnet.cpp: telnet server for the bridge daemon, see ESPTelnet.h */
+
+#include "ESPTelnet.h"
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+uint16_t host_telnet_port = 0;
+
+bool ESPTelnet::begin(uint16_t port, bool checkConnection)
+{
+  (void) port;
+  (void) checkConnection;
+  if (!host_telnet_port) return false;
+  server = socket(AF_INET6, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (server < 0) return false;
+  int one = 1, zero = 0;
+  setsockopt(server, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  setsockopt(server, IPPROTO_IPV6, IPV6_V6ONLY, &zero, sizeof(zero));
+  struct sockaddr_in6 addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sin6_family = AF_INET6;
+  addr.sin6_addr = in6addr_any;
+  addr.sin6_port = htons(host_telnet_port);
+  if ((bind(server, (struct sockaddr*) &addr, sizeof(addr)) < 0) || (listen(server, 2) < 0)) {
+    host_log("telnet port %u: %s", host_telnet_port, strerror(errno));
+    ::close(server);
+    server = -1;
+    return false;
+  }
+  return true;
+}
+
+void ESPTelnet::stop(void)
+{
+  closeClient();
+  if (server >= 0) ::close(server);
+  server = -1;
+}
+
+void ESPTelnet::closeClient(void)
+{
+  if (client >= 0) ::close(client);
+  client = -1;
+  input.clear();
+}
+
+void ESPTelnet::disconnectClient(void)
+{
+  if (client < 0) return;
+  closeClient();
+  events.push_back({Event::DISCONNECTED, ip});
+}
+
+void ESPTelnet::accept(void)
+{
+  struct sockaddr_storage addr;
+  socklen_t len = sizeof(addr);
+  int fd = ::accept4(server, (struct sockaddr*) &addr, &len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+  if (fd < 0) return;
+  char s[INET6_ADDRSTRLEN] = "";
+  const struct sockaddr_in6* a = reinterpret_cast<const struct sockaddr_in6*>(&addr);
+  if (IN6_IS_ADDR_V4MAPPED(&a->sin6_addr)) {
+    inet_ntop(AF_INET, &a->sin6_addr.s6_addr[12], s, sizeof(s));
+  } else {
+    inet_ntop(AF_INET6, &a->sin6_addr, s, sizeof(s));
+  }
+  if (client < 0) {
+    client = fd;
+    ip = s;
+    events.push_back({Event::CONNECTED, ip});
+  } else if (ip == s) {
+    closeClient();
+    client = fd;
+    events.push_back({Event::RECONNECTED, ip});
+  } else {
+    static const char busy[] = "Sorry, telnet is in use by another client\r\n";
+    send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+    ::close(fd);
+    events.push_back({Event::ATTEMPT, s});
+  }
+}
+
+void ESPTelnet::receive(void)
+{
+  char buf[512];
+  for (;;) {
+    ssize_t n = recv(client, buf, sizeof(buf), 0);
+    if (n > 0) {
+      for (ssize_t i = 0; i < n; i++) {
+        if (buf[i] == '\n') {
+          events.push_back({Event::RECEIVED, input});
+          input.clear();
+        } else if ((buf[i] >= 32) && (buf[i] < 127)) {
+          input += buf[i]; // as the library in line mode, drops control characters and telnet negotiation
+        }
+      }
+    } else {
+      if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) return;
+      disconnectClient();
+      return;
+    }
+  }
+}
+
+size_t ESPTelnet::write(const uint8_t* buf, size_t n)
+{
+  if (client < 0) return 0;
+  size_t m = 0;
+  while (m < n) {
+    ssize_t k = send(client, buf + m, n - m, MSG_NOSIGNAL);
+    if (k > 0) {
+      m += k;
+    } else if ((k < 0) && (errno == EAGAIN)) {
+      // synchronous output, as the library (slow clients slow down the bridge)
+      struct pollfd p = {client, POLLOUT, 0};
+      if (poll(&p, 1, 1000) <= 0) {
+        disconnectClient();
+        break;
+      }
+    } else if (!((k < 0) && (errno == EINTR))) {
+      disconnectClient();
+      break;
+    }
+  }
+  return m;
+}
+
+void ESPTelnet::pollFds(std::vector<struct pollfd> &fds)
+{
+  fds.push_back({server, POLLIN, 0});
+  fds.push_back({client, POLLIN, 0});
+}
+
+void ESPTelnet::pollService(const struct pollfd* fds)
+{
+  if ((fds[0].fd == server) && (fds[0].revents & POLLIN)) accept();
+  if ((fds[1].fd == client) && (fds[1].revents & (POLLIN | POLLERR | POLLHUP))) receive();
+}
+
+void ESPTelnet::loop(void)
+{
+  host_service(0);
+  while (!events.empty()) {
+    Event e = events.front();
+    events.pop_front();
+    String s(e.s.c_str());
+    switch (e.type) {
+      case Event::CONNECTED    : if (on_connect) on_connect(s);
+                                 break;
+      case Event::ATTEMPT      : if (on_connection_attempt) on_connection_attempt(s);
+                                 break;
+      case Event::RECONNECTED  : if (on_reconnect) on_reconnect(s);
+                                 break;
+      case Event::DISCONNECTED : if (on_disconnect) on_disconnect(s);
+                                 break;
+      case Event::RECEIVED     : if (on_input) on_input(s);
+                                 break;
+    }
+  }
+}
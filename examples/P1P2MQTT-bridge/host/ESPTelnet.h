@@ -0,0 +1,61 @@
+/* ESPTelnet.h: host replacement of the ESP_Telnet 2.0.0 library (same API subset), a single-client line-mode TCP server
+ *
+ * Connections are accepted and input is collected while the bridge waits (delay()/yield()), but as in the library,
+ * the callbacks run from telnet.loop() only. A second client from the same address replaces the first (onReconnect),
+ * a client from another address is refused (onConnectionAttempt).
+ * The port given to begin() is overruled by the daemon's per-bus telnet port (host_telnet_port, 0: telnet disabled).
+ */
+
+#ifndef ESPTelnet_h
+#define ESPTelnet_h
+
+#include "Arduino.h"
+#include "host.h"
+#include <deque>
+
+class ESPTelnet : public Print, public HostPollable {
+  public:
+    typedef void (*CallbackFunction)(String str);
+
+    bool begin(uint16_t port = 23, bool checkConnection = true);
+    void stop(void);
+    void loop(void);
+    String getIP(void) const { return String(ip.c_str()); }
+    void disconnectClient(void);
+
+    void onConnect(CallbackFunction f) { on_connect = f; }
+    void onConnectionAttempt(CallbackFunction f) { on_connection_attempt = f; }
+    void onReconnect(CallbackFunction f) { on_reconnect = f; }
+    void onDisconnect(CallbackFunction f) { on_disconnect = f; }
+    void onInputReceived(CallbackFunction f) { on_input = f; }
+
+    virtual size_t write(uint8_t c) { return write(&c, 1); }
+    virtual size_t write(const uint8_t* buf, size_t n);
+    using Print::write;
+
+    // HostPollable
+    void pollFds(std::vector<struct pollfd> &fds);
+    void pollService(const struct pollfd* fds);
+
+  private:
+    int server = -1;
+    int client = -1;
+    std::string ip;
+    std::string input;
+    struct Event {
+      enum { CONNECTED, ATTEMPT, RECONNECTED, DISCONNECTED, RECEIVED } type;
+      std::string s;
+    };
+    std::deque<Event> events;
+    CallbackFunction on_connect = nullptr;
+    CallbackFunction on_connection_attempt = nullptr;
+    CallbackFunction on_reconnect = nullptr;
+    CallbackFunction on_disconnect = nullptr;
+    CallbackFunction on_input = nullptr;
+
+    void accept(void);
+    void receive(void);
+    void closeClient(void);
+};
+
+#endif /* ESPTelnet_h */
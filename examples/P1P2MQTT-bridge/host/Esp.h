@@ -0,0 +1,33 @@
+/* Esp.h: host replacement of the ESP8266 core ESP object
+ *
+ * Flash holds a single sector (the bridge's EEPROM settings), stored in a file per bus.
+ * RTC user memory survives ESP.restart()/ESP.reset() (a restart of the worker process by the daemon), but not a restart of the daemon, as on the ESP8266 after power-up.
+ * There is no heap limit: getMaxFreeBlockSize() reports the maximum 16-bit value, so messages are never skipped for lack of memory.
+ */
+
+#ifndef Esp_h
+#define Esp_h
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define SPI_FLASH_SEC_SIZE 4096
+#define RTC_USER_MEMORY_SIZE 512
+
+class EspClass {
+  public:
+    uint32_t getMaxFreeBlockSize(void) { return 0xFFFF; }
+    uint32_t getFreeHeap(void) { return 0xFFFF; }
+    bool rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size);
+    bool rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size);
+    bool flashEraseSector(uint32_t sector);
+    bool flashWrite(uint32_t address, const uint32_t* data, size_t size);
+    bool flashRead(uint32_t address, uint32_t* data, size_t size);
+    bool eraseConfig(void) { return true; }
+    [[noreturn]] void restart(void);
+    [[noreturn]] void reset(void);
+};
+
+extern EspClass ESP;
+
+#endif /* Esp_h */
@@ -0,0 +1,35 @@
+/* IPAddress.h: host replacement of the ESP8266 core IPv4 address class
+ */
+
+#ifndef IPAddress_h
+#define IPAddress_h
+
+#include <stdint.h>
+#include <stdio.h>
+
+class IPAddress {
+  public:
+    IPAddress() : addr{0, 0, 0, 0} {}
+    IPAddress(uint8_t a, uint8_t b, uint8_t c, uint8_t d) : addr{a, b, c, d} {}
+    bool fromString(const char* s) {
+      unsigned int a, b, c, d;
+      char x;
+      if ((sscanf(s, "%u.%u.%u.%u%c", &a, &b, &c, &d, &x) != 4) || (a > 255) || (b > 255) || (c > 255) || (d > 255)) return false;
+      addr[0] = a;
+      addr[1] = b;
+      addr[2] = c;
+      addr[3] = d;
+      return true;
+    }
+    uint8_t operator[](int i) const { return addr[i]; }
+    uint8_t& operator[](int i) { return addr[i]; }
+    String toString(void) const {
+      char s[16];
+      snprintf(s, sizeof(s), "%u.%u.%u.%u", addr[0], addr[1], addr[2], addr[3]);
+      return String(s);
+    }
+  private:
+    uint8_t addr[4];
+};
+
+#endif /* IPAddress_h */
@@ -0,0 +1,182 @@
+/* P1P2MQTT-bridged: Linux daemon running P1P2MQTT-bridge for one or more P1P2Monitor serial devices
+ *
+ * Usage: P1P2MQTT-bridged [-m server[:port]] [-u user] [-p password] [-d dir] [-r s] -b name:device[:telnetport] [-b ...]
+ *
+ *   -b name:device[:telnetport]  bus with P1P2Monitor on serial device (tty or pty), telnet on telnetport (default none);
+ *                                name is used in log lines and for the EEPROM settings file dir/name.eeprom
+ *   -m server[:port]             MQTT server (IPv4 address or name of at most 15 characters) and port (1883),
+ *                                stored in the EEPROM settings of each bus as if entered in the WiFiManager portal;
+ *                                without -m, the stored settings are used
+ *   -u user, -p password         MQTT credentials with -m (default P1P2/P1P2 as in P1P2_NetworkParams.h, "" for none)
+ *   -d dir                       directory for the EEPROM settings files (default .)
+ *   -r s                         delay before a bus worker is restarted after a serial device failure or crash (default 5)
+ *
+ * Each bus runs the unmodified bridge (setup(), loop()) in a worker process of its own, as the bridge keeps its state in globals.
+ * The daemon restarts a worker after ESP.restart()/ESP.reset() (immediately) or a failure (after -r seconds),
+ * and keeps the worker's RTC user memory, so restart reasons, double-reset detection and RTC data behave as on the ESP8266.
+ * SIGINT/SIGTERM stop all workers; the MQTT server then publishes the will messages ("offline") of the buses.
+ */
+
+#include "Arduino.h"
+#include "host.h"
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+
+#define LOOP_IDLE 10 // ms to wait for input between loop() calls
+#define MQTT_SERVER_MAX 15
+
+struct Bus {
+  std::string name, device, eeprom;
+  uint16_t telnetPort;
+  uint32_t* rtc;
+  pid_t pid;
+};
+
+static std::vector<Bus> buses;
+static volatile sig_atomic_t stopping = 0;
+
+static void usage(void)
+{
+  fprintf(stderr, "Usage: P1P2MQTT-bridged [-m server[:port]] [-u user] [-p password] [-d dir] [-r s] -b name:device[:telnetport] [-b ...]\n");
+  exit(2);
+}
+
+static void onSignal(int sig)
+{
+  stopping = 1;
+}
+
+static void worker(Bus& bus, unsigned int startDelay)
+{
+  signal(SIGINT, SIG_DFL);
+  signal(SIGTERM, SIG_DFL);
+  if (startDelay) sleep(startDelay);
+  host_bus_name = bus.name.c_str();
+  host_flash_file(bus.eeprom.c_str());
+  host_rtc_memory(bus.rtc);
+  host_telnet_port = bus.telnetPort;
+  if (!host_serial_open(bus.device.c_str())) exit(HOST_EXIT_SERIAL);
+  host_log("started on %s", bus.device.c_str());
+  setup();
+  for (;;) {
+    loop();
+    host_service(host_serial_pending() ? 0 : LOOP_IDLE);
+  }
+}
+
+static void start(Bus& bus, unsigned int startDelay)
+{
+  fflush(stderr);
+  bus.pid = fork();
+  if (bus.pid < 0) {
+    fprintf(stderr, "%s: fork: %s\n", bus.name.c_str(), strerror(errno));
+    exit(1);
+  }
+  if (!bus.pid) worker(bus, startDelay);
+}
+
+int main(int argc, char** argv)
+{
+  std::string dir = ".";
+  unsigned int restartDelay = 5;
+  static std::string server, port;
+  int opt;
+  while ((opt = getopt(argc, argv, "b:m:u:p:d:r:")) != -1) {
+    switch (opt) {
+      case 'b' : {
+                   Bus bus;
+                   std::string s = optarg;
+                   size_t c1 = s.find(':');
+                   if ((c1 == std::string::npos) || !c1) usage();
+                   size_t c2 = s.find(':', c1 + 1);
+                   bus.name = s.substr(0, c1);
+                   bus.device = s.substr(c1 + 1, (c2 == std::string::npos) ? std::string::npos : c2 - c1 - 1);
+                   bus.telnetPort = (c2 == std::string::npos) ? 0 : atoi(s.c_str() + c2 + 1);
+                   if (bus.device.empty()) usage();
+                   buses.push_back(bus);
+                 }
+                 break;
+      case 'm' : server = optarg;
+                 if (server.find(':') != std::string::npos) {
+                   port = server.substr(server.find(':') + 1);
+                   server.erase(server.find(':'));
+                   host_mqtt_port = port.c_str();
+                 }
+                 if (server.empty() || (server.size() > MQTT_SERVER_MAX)) {
+                   fprintf(stderr, "MQTT server must be an IPv4 address or a name of at most %i characters\n", MQTT_SERVER_MAX);
+                   exit(2);
+                 }
+                 host_mqtt_server = server.c_str();
+                 break;
+      case 'u' : host_mqtt_user = optarg;
+                 break;
+      case 'p' : host_mqtt_password = optarg;
+                 break;
+      case 'd' : dir = optarg;
+                 break;
+      case 'r' : restartDelay = atoi(optarg);
+                 break;
+      default  : usage();
+    }
+  }
+  if ((optind != argc) || buses.empty()) usage();
+
+  for (Bus& bus : buses) {
+    bus.eeprom = dir + "/" + bus.name + ".eeprom";
+    // RTC user memory, shared with (and kept across restarts of) the worker
+    bus.rtc = (uint32_t*) mmap(NULL, RTC_USER_MEMORY_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (bus.rtc == MAP_FAILED) {
+      perror("mmap");
+      return 1;
+    }
+  }
+
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onSignal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+
+  for (Bus& bus : buses) start(bus, 0);
+
+  size_t running = buses.size();
+  bool stopped = false;
+  while (running) {
+    if (stopping && !stopped) {
+      for (Bus& bus : buses) if (bus.pid > 0) kill(bus.pid, SIGTERM);
+      stopped = true;
+    }
+    int status;
+    pid_t pid = waitpid(-1, &status, 0);
+    if (pid < 0) {
+      if (errno != EINTR) break;
+      continue;
+    }
+    for (Bus& bus : buses) {
+      if (bus.pid != pid) continue;
+      bus.pid = 0;
+      running--;
+      if (stopping) break;
+      if (WIFEXITED(status) && (WEXITSTATUS(status) == HOST_EXIT_STOP)) {
+        fprintf(stderr, "%s: stopped\n", bus.name.c_str());
+      } else if (WIFEXITED(status) && (WEXITSTATUS(status) == HOST_EXIT_RESTART)) {
+        start(bus, 0);
+        running++;
+      } else {
+        if (WIFSIGNALED(status)) {
+          fprintf(stderr, "%s: worker terminated by signal %i, restarting in %us\n", bus.name.c_str(), WTERMSIG(status), restartDelay);
+        } else {
+          fprintf(stderr, "%s: worker failed (exit code %i), restarting in %us\n", bus.name.c_str(), WEXITSTATUS(status), restartDelay);
+        }
+        start(bus, restartDelay);
+        running++;
+      }
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,467 @@
+/* P1P2MQTT-decode: offline decoder of raw-hex logs into per-entity time series, using the decoding of P1P2MQTT-bridge
+ *
+ * Usage: P1P2MQTT-decode [-j workers] [-s s] [-w s] [-e eeprom] [-o dir] log
+ *
+ *   -j workers  number of parallel workers (default: number of cores)
+ *   -s s        chunks start at a multiple of s seconds of log time (default 3600)
+ *   -w s        warm-up: each chunk is decoded from s seconds before its start, without output (default 300)
+ *   -e eeprom   bridge settings file of P1P2MQTT-bridged (read-only), default: the bridge's defaults
+ *   -o dir      output directory (default decoded)
+ *
+ * The log has one packet per line, in any of these formats (other lines are ignored):
+ *   P1P2/R/P1P2MQTT/bridge0 R 2024-01-31 23:59:59 T  0.105: 400010...   (mosquitto_sub -v P1P2/R/#)
+ *   R 2024-01-31 23:59:59 T  0.105: 400010...                           (payload of P1P2/R/#)
+ *   R T  0.105: 400010...                                               (P1P2Monitor serial output, not split in chunks)
+ *
+ * Each worker process runs the unmodified bridge (setup(), loop()) on a virtual clock driven by the packet delays,
+ * with the packets of a chunk as its serial input and the MQTT client capturing publishes (host.h).
+ * Every publish to <prefix>/P/<entity> becomes a row "time,value" in dir/<entity>.csv, if the value changed.
+ * Chunks are independent (the decoder state is rebuilt during the warm-up), so a log decodes in parallel;
+ * the rows are merged in log order, so the output does not depend on the number of workers,
+ * except for the timing of values the bridge computes on a timer (pseudo packets, such as power and COP),
+ * which can shift by up to their period.
+ */
+
+#include "Arduino.h"
+#include "host.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#define FIRST_LINE "* P1P2MQTT-decode\n" // the bridge ignores its first serial line
+
+struct Packet {
+  const char* hex;
+  size_t hexLen;
+  bool dated;
+  int64_t t;            // s, log time (dated) as if UTC
+  const char* date;     // "YYYY-MM-DD HH:MM:SS" (dated)
+  uint32_t delay;       // ms, packet delay from P1P2Monitor
+};
+
+struct Chunk {
+  size_t warm, start, end; // log offsets: decoding starts at warm, output starts at start
+};
+
+struct ChunkStats {     // shared with the workers
+  uint64_t packets;
+  uint64_t publishes;
+  uint64_t rows;
+};
+
+static const char* logData;
+static size_t logSize;
+static std::string outDir = "decoded";
+
+static inline int digits(const char* p, int n)
+{
+  int v = 0;
+  for (int i = 0; i < n; i++) {
+    if ((p[i] < '0') || (p[i] > '9')) return -1;
+    v = v * 10 + p[i] - '0';
+  }
+  return v;
+}
+
+static int64_t daysFromCivil(int y, int m, int d)
+{
+  y -= (m <= 2);
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = (unsigned) (y - era * 400);
+  const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + (int64_t) doe - 719468;
+}
+
+// parses a packet line [p, e), without '\n'
+static bool parseLine(const char* p, const char* e, Packet& pk)
+{
+  while ((e > p) && ((e[-1] == '\r') || (e[-1] == ' '))) e--;
+  if ((p < e) && (*p != 'R')) {
+    // topic prefix of mosquitto_sub -v
+    const char* sp = (const char*) memchr(p, ' ', e - p);
+    if (!sp || !memchr(p, '/', sp - p)) return false;
+    p = sp + 1;
+  }
+  if ((e - p < 2) || (p[0] != 'R') || (p[1] != ' ')) return false;
+  p += 2;
+  pk.dated = false;
+  if ((e - p >= 20) && (p[4] == '-') && (p[7] == '-') && (p[10] == ' ') && (p[13] == ':') && (p[16] == ':')) {
+    int y = digits(p, 4), mo = digits(p + 5, 2), d = digits(p + 8, 2), h = digits(p + 11, 2), mi = digits(p + 14, 2), s = digits(p + 17, 2);
+    if ((y < 0) || (mo < 1) || (d < 1) || (h < 0) || (mi < 0) || (s < 0)) return false;
+    pk.dated = true;
+    pk.date = p;
+    pk.t = daysFromCivil(y, mo, d) * 86400 + h * 3600 + mi * 60 + s;
+    p += 20;
+  }
+  if ((p < e) && (*p == 'T')) p++;
+  while ((p < e) && (*p == ' ')) p++;
+  uint32_t sec = 0, ms = 0;
+  int n = 0;
+  while ((p < e) && (*p >= '0') && (*p <= '9')) sec = sec * 10 + (*p++ - '0');
+  if ((p < e) && (*p == '.')) p++;
+  while ((p < e) && (*p >= '0') && (*p <= '9')) {
+    if (n++ < 3) ms = ms * 10 + (*p - '0');
+    p++;
+  }
+  while (n++ < 3) ms *= 10;
+  if ((p >= e) || (*p != ':')) return false;
+  p++;
+  while ((p < e) && (*p == ' ')) p++;
+  if (p >= e) return false;
+  pk.delay = sec * 1000 + ms;
+  pk.hex = p;
+  pk.hexLen = e - p;
+  return true;
+}
+
+static inline const char* lineEnd(const char* p)
+{
+  const char* e = (const char*) memchr(p, '\n', logData + logSize - p);
+  return e ? e : logData + logSize;
+}
+
+// first packet line at or after offset off (at a line start), returns false if none
+static bool packetAt(size_t off, Packet& pk, size_t* lineStart = NULL)
+{
+  const char* p = logData + off;
+  const char* end = logData + logSize;
+  while (p < end) {
+    const char* e = lineEnd(p);
+    if (parseLine(p, e, pk)) {
+      if (lineStart) *lineStart = p - logData;
+      return true;
+    }
+    p = e + 1;
+  }
+  return false;
+}
+
+static size_t nextLine(size_t off)
+{
+  if (!off) return 0;
+  const char* e = (const char*) memchr(logData + off - 1, '\n', logSize - off + 1);
+  return e ? e + 1 - logData : logSize;
+}
+
+static std::vector<Chunk> makeChunks(unsigned int workers, unsigned int split, unsigned int warm)
+{
+  std::vector<Chunk> chunks;
+  Packet pk;
+  size_t n = 1;
+  if ((workers > 1) && packetAt(0, pk) && pk.dated) n = min((size_t) workers * 4, logSize / (1 << 20) + 1);
+  std::vector<size_t> starts = {0};
+  for (size_t i = 1; i < n; i++) {
+    size_t off = nextLine(logSize / n * i), s;
+    if ((off <= starts.back()) || !packetAt(off, pk, &s) || !pk.dated) continue;
+    int64_t bucket = pk.t / split;
+    // first packet of the next time bucket
+    while (packetAt(nextLine(s + 1), pk, &s) && pk.dated && (pk.t / split == bucket));
+    if ((s > starts.back()) && packetAt(s, pk) && pk.dated && (pk.t / split != bucket)) starts.push_back(s);
+  }
+  for (size_t i = 0; i < starts.size(); i++) {
+    Chunk c;
+    c.start = starts[i];
+    c.end = (i + 1 < starts.size()) ? starts[i + 1] : logSize;
+    c.warm = c.start;
+    if (c.start && packetAt(c.start, pk)) {
+      // move back over the packets of the last warm seconds
+      int64_t t = pk.t;
+      size_t w = c.start;
+      while (w) {
+        const char* b = (const char*) memrchr(logData, '\n', w - 1);
+        size_t prev = b ? b + 1 - logData : 0;
+        Packet q;
+        if (parseLine(logData + prev, logData + w - 1, q) && q.dated && (q.t < t - (int64_t) warm)) break;
+        w = prev;
+      }
+      c.warm = w;
+    }
+    chunks.push_back(c);
+  }
+  return chunks;
+}
+
+// worker
+
+static FILE* rowFile;
+static bool recording;
+static char rowTime[24];
+static ChunkStats* stats;
+
+static void capture(const char* topic, uint8_t qos, bool retain, const char* payload, size_t length)
+{
+  stats->publishes++;
+  if (!recording) return;
+  const char* s = strchr(topic, '/');
+  if (!s || (s[1] != 'P') || (s[2] != '/')) return;
+  // row record: entity, time and value, each '\0'-terminated
+  fputs(s + 3, rowFile);
+  fputc('\0', rowFile);
+  fputs(rowTime, rowFile);
+  fputc('\0', rowFile);
+  fwrite(payload, 1, length, rowFile);
+  fputc('\0', rowFile);
+  stats->rows++;
+}
+
+static std::string chunkFile(size_t k)
+{
+  return outDir + "/.chunk-" + std::to_string(k);
+}
+
+static void worker(const Chunk& c, size_t k, const char* eeprom)
+{
+  rowFile = fopen(chunkFile(k).c_str(), "wb");
+  if (!rowFile) {
+    fprintf(stderr, "%s: %s\n", chunkFile(k).c_str(), strerror(errno));
+    exit(1);
+  }
+  host_bus_name = "decode";
+  host_flash_file(eeprom, true);
+  host_mqtt_capture = capture;
+  host_telnet_port = 0;
+  host_clock_advance(0);
+  host_serial_input(FIRST_LINE, strlen(FIRST_LINE));
+  setup();
+  std::string line;
+  uint64_t elapsed = 0;
+  for (const char* p = logData + c.warm; p < logData + c.end; ) {
+    const char* e = lineEnd(p);
+    Packet pk;
+    if (parseLine(p, e, pk)) {
+      recording = (p >= logData + c.start);
+      if (pk.dated) {
+        memcpy(rowTime, pk.date, 19);
+        rowTime[19] = '\0';
+      } else {
+        snprintf(rowTime, sizeof(rowTime), "%.3f", (elapsed += pk.delay) / 1000.0);
+      }
+      host_clock_advance(pk.delay);
+      line.assign("R T  0.000: ");
+      line.append(pk.hex, pk.hexLen);
+      line += '\n';
+      host_serial_input(line.data(), line.size());
+      for (int i = 0; host_serial_pending() && (i < 10); i++) {
+        loop();
+        host_service(0);
+      }
+      stats->packets++;
+    }
+    p = e + 1;
+  }
+  if (fclose(rowFile)) exit(1);
+  exit(0);
+}
+
+// merge
+
+struct Series {
+  FILE* f = NULL;
+  std::string last;
+};
+
+static bool makeDirs(const std::string& path)
+{
+  for (size_t i = path.find('/', 1); i != std::string::npos; i = path.find('/', i + 1)) {
+    if (mkdir(path.substr(0, i).c_str(), 0777) && (errno != EEXIST)) return false;
+  }
+  return true;
+}
+
+static void csvValue(FILE* f, const char* v)
+{
+  if (!strpbrk(v, ",\"\n\r")) {
+    fputs(v, f);
+    return;
+  }
+  fputc('"', f);
+  for (; *v; v++) {
+    if (*v == '"') fputc('"', f);
+    fputc(*v, f);
+  }
+  fputc('"', f);
+}
+
+static bool merge(size_t chunks, size_t* seriesCount, uint64_t* rows)
+{
+  std::unordered_map<std::string, Series> series;
+  *rows = 0;
+  for (size_t k = 0; k < chunks; k++) {
+    std::string name = chunkFile(k);
+    FILE* f = fopen(name.c_str(), "rb");
+    if (!f) return false;
+    std::string rec[3];
+    int field = 0;
+    int ch;
+    while ((ch = getc_unlocked(f)) != EOF) {
+      if (ch) {
+        rec[field] += (char) ch;
+        continue;
+      }
+      if (++field < 3) continue;
+      field = 0;
+      std::string& entity = rec[0];
+      if (entity.find("..") != std::string::npos) entity = "invalid";
+      Series& s = series[entity];
+      if (!s.f) {
+        std::string path = outDir + "/" + entity + ".csv";
+        if (!makeDirs(path) || !(s.f = fopen(path.c_str(), "w"))) {
+          fprintf(stderr, "%s: %s\n", path.c_str(), strerror(errno));
+          return false;
+        }
+        fputs("time,value\n", s.f);
+      } else if (s.last == rec[2]) {
+        // unchanged (republished, or published again at the start of a chunk)
+        rec[0].clear();
+        rec[1].clear();
+        rec[2].clear();
+        continue;
+      }
+      fputs(rec[1].c_str(), s.f);
+      fputc(',', s.f);
+      csvValue(s.f, rec[2].c_str());
+      fputc('\n', s.f);
+      (*rows)++;
+      s.last.swap(rec[2]);
+      rec[0].clear();
+      rec[1].clear();
+      rec[2].clear();
+    }
+    fclose(f);
+    unlink(name.c_str());
+  }
+  bool ok = true;
+  for (auto& s : series) ok = !fclose(s.second.f) && ok;
+  *seriesCount = series.size();
+  return ok;
+}
+
+static double now(void)
+{
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "Usage: P1P2MQTT-decode [-j workers] [-s s] [-w s] [-e eeprom] [-o dir] log\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  unsigned int workers = sysconf(_SC_NPROCESSORS_ONLN);
+  unsigned int split = 3600, warm = 300;
+  const char* eeprom = NULL;
+  int opt;
+  while ((opt = getopt(argc, argv, "j:s:w:e:o:")) != -1) {
+    switch (opt) {
+      case 'j' : workers = atoi(optarg);
+                 break;
+      case 's' : split = atoi(optarg);
+                 break;
+      case 'w' : warm = atoi(optarg);
+                 break;
+      case 'e' : eeprom = optarg;
+                 break;
+      case 'o' : outDir = optarg;
+                 break;
+      default  : usage();
+    }
+  }
+  if ((optind != argc - 1) || !workers || !split) usage();
+
+  int fd = open(argv[optind], O_RDONLY);
+  struct stat st;
+  if ((fd < 0) || fstat(fd, &st)) {
+    perror(argv[optind]);
+    return 1;
+  }
+  logSize = st.st_size;
+  logData = logSize ? (const char*) mmap(NULL, logSize, PROT_READ, MAP_PRIVATE, fd, 0) : "";
+  if (logData == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  if (mkdir(outDir.c_str(), 0777) && (errno != EEXIST)) {
+    perror(outDir.c_str());
+    return 1;
+  }
+  // one open file per series while merging
+  struct rlimit rl;
+  if (!getrlimit(RLIMIT_NOFILE, &rl)) {
+    rl.rlim_cur = rl.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &rl);
+  }
+
+  double t0 = now();
+  std::vector<Chunk> chunks = makeChunks(workers, split, warm);
+  ChunkStats* allStats = (ChunkStats*) mmap(NULL, chunks.size() * sizeof(ChunkStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (allStats == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  memset(allStats, 0, chunks.size() * sizeof(ChunkStats));
+  size_t next = 0, running = 0;
+  bool failed = false;
+  fflush(stderr);
+  while ((next < chunks.size()) || running) {
+    if ((next < chunks.size()) && (running < workers) && !failed) {
+      pid_t pid = fork();
+      if (pid < 0) {
+        perror("fork");
+        return 1;
+      }
+      if (!pid) {
+        stats = allStats + next;
+        worker(chunks[next], next, eeprom);
+      }
+      next++;
+      running++;
+      continue;
+    }
+    if (failed && !running) break;
+    int status;
+    if (wait(&status) < 0) break;
+    running--;
+    if (!WIFEXITED(status) || WEXITSTATUS(status)) failed = true;
+  }
+  double t1 = now();
+  if (failed) {
+    fprintf(stderr, "decoding failed\n");
+    return 1;
+  }
+
+  uint64_t packets = 0, publishes = 0, rows = 0;
+  for (size_t k = 0; k < chunks.size(); k++) {
+    packets += allStats[k].packets;
+    publishes += allStats[k].publishes;
+  }
+  size_t seriesCount;
+  if (!merge(chunks.size(), &seriesCount, &rows)) {
+    fprintf(stderr, "merging failed\n");
+    return 1;
+  }
+  double t2 = now();
+
+  struct rusage ru;
+  getrusage(RUSAGE_CHILDREN, &ru);
+  double cpu = ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1e6 + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1e6;
+  double mb = logSize / 1e6;
+  unsigned int used = min(workers, (unsigned int) chunks.size());
+  fprintf(stderr, "decoded %.1f MB, %llu packets (incl. warm-up), %llu publishes in %zu chunk%s by %u worker%s in %.2f s: %.1f MB/s, %.1f MB/s per core\n",
+                  mb, (unsigned long long) packets, (unsigned long long) publishes, chunks.size(), (chunks.size() == 1) ? "" : "s",
+                  used, (used == 1) ? "" : "s", t1 - t0, mb / (t1 - t0), cpu ? mb / cpu : 0);
+  fprintf(stderr, "merged %llu rows into %zu series in %s in %.2f s\n", (unsigned long long) rows, seriesCount, outDir.c_str(), t2 - t1);
+  return 0;
+}
@@ -0,0 +1,92 @@
+/* P1P2MQTT-fixedpoint: equivalence check of the integer fixed-point formatter of the value helpers
+ *
+ * Usage: P1P2MQTT-fixedpoint [-32]
+ *
+ * fixedPoint() and fixedPointFloat() (P1P2_ParameterConversion.h) replaced snprintf "%1.<decimals>f" on float and double
+ * expressions in the value helpers. This runner compares both outputs for every 16-bit input of each helper (the payload
+ * bytes it reads, or the 16-bit value range of the sdiv/udiv helpers), plus a sweep over float values for value_f,
+ * and exits with status 1 after reporting the first differences.
+ * The 32-bit counters (udiv10, u32div100, u32div1000 on 24- and 32-bit payloads) are checked on every 65521st value of the
+ * unsigned 32-bit range, or with -32 on all of them (about 13G values, about two hours; make check-fixedpoint32).
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef uint8_t byte;
+
+// in P1P2MQTT-bridge.o
+char* fixedPoint(char* s, int64_t num, uint32_t den, byte decimals, bool negativeZero);
+char* fixedPointFloat(char* s, float v, byte decimals);
+float FN_u8div10(uint8_t *b);
+float FN_u8div2min16(uint8_t *b);
+float FN_u16div10_LE(uint8_t *b);
+float FN_u16div100_LE(uint8_t *b);
+float FN_f8_8_BE(uint8_t *b);
+float FN_f8_8_LE(uint8_t *b);
+float FN_s_f8_8_LE(uint8_t *b);
+float FN_f8s8_LE(uint8_t *b);
+
+static const char* formats[] = { "%1.0f", "%1.1f", "%1.2f", "%1.3f" };
+static uint64_t checks = 0;
+static uint32_t differences = 0;
+
+static void compare(const char* helper, uint32_t input, const char* value, double reference, byte decimals)
+{
+  char s[32];
+  snprintf(s, sizeof(s), formats[decimals], reference);
+  checks++;
+  if (strcmp(s, value)) {
+    if (differences++ < 10) printf("%-16s input 0x%06X: fixedPoint %s, snprintf %s\n", helper, input, value, s);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  char s[32];
+  byte p[3];
+  uint32_t step = ((argc > 1) && !strcmp(argv[1], "-32")) ? 1 : 65521;
+  // helpers reading payload bytes, p[2] is the byte at payloadIndex
+  for (uint32_t i = 0; i < 0x20000; i++) {
+    p[0] = i >> 16;
+    p[1] = i >> 8;
+    p[2] = i;
+    int16_t v = (int16_t) ((p[1] << 8) | p[2]);
+    if (i < 0x100) {
+      compare("u8div10", i, fixedPoint(s, p[2], 10, 1, false), FN_u8div10(p + 2), 1);
+      compare("u8div2min16", i, fixedPoint(s, p[2] - 32, 2, 1, false), FN_u8div2min16(p + 2), 1);
+    }
+    if (i < 0x10000) {
+      compare("u16div10_LE", i, fixedPoint(s, (p[1] == 0xFF) ? 0 : (uint16_t) v, 10, 1, false), FN_u16div10_LE(p + 2), 1);
+      compare("u16div100_LE", i, fixedPoint(s, (p[1] == 0xFF) ? 0 : (uint16_t) v, 100, 2, false), FN_u16div100_LE(p + 2), 2);
+      compare("f8_8_LE", i, fixedPoint(s, v, 256, 3, false), FN_f8_8_LE(p + 2), 3);
+      compare("f8_8_BE", i, fixedPoint(s, (int16_t) ((p[2] << 8) | p[1]), 256, 3, false), FN_f8_8_BE(p + 2), 3);
+      compare("f8s8_LE", i, fixedPoint(s, ((int8_t) p[1]) * 10 + p[2], 10, 1, false), FN_f8s8_LE(p + 2), 1);
+    }
+    compare("s_f8_8_LE", i, p[0] ? fixedPoint(s, -v, 256, 3, !v) : fixedPoint(s, v, 256, 3, false), FN_s_f8_8_LE(p + 2), 3);
+  }
+  // sdiv/udiv and param_value_* helpers: signed and unsigned 16-bit values
+  for (int32_t v = -0x8000; v < 0x10000; v++) {
+    compare("div10", v, fixedPoint(s, v, 10, 1, false), v * 0.1, 1);
+    compare("div100", v, fixedPoint(s, v, 100, 2, false), v * 0.01, 2);
+    compare("div1000", v, fixedPoint(s, v, 1000, 3, false), v * 0.001, 3);
+    compare("div2", v, fixedPoint(s, v, 2, 1, false), v * 0.5, 1);
+    compare("div2min16", v, fixedPoint(s, (int64_t) v - 32, 2, 1, false), v * 0.5 - 16, 1);
+  }
+  // value_f: float values of all 16-bit fixed-point and decimal fractions, with each precision
+  for (int32_t v = -0x8000; v < 0x10000; v++) {
+    const float f[] = { v / 256.0f, v * 0.1f, v * 0.01f, v * 0.001f, v * 0.37f, (float) v };
+    for (byte k = 0; k < sizeof(f) / sizeof(f[0]); k++) {
+      for (byte d = 0; d < 4; d++) compare("value_f", v, fixedPointFloat(s, f[k], d), f[k], d);
+    }
+  }
+  // 32-bit counters: unsigned 32-bit values
+  for (uint64_t v = 0; v <= 0xFFFFFFFF; v += step) {
+    compare("udiv10_32", v, fixedPoint(s, v, 10, 1, false), v * 0.1, 1);
+    compare("udiv100_32", v, fixedPoint(s, v, 100, 2, false), v * 0.01, 2);
+    compare("udiv1000_32", v, fixedPoint(s, v, 1000, 3, false), v * 0.001, 3);
+  }
+  printf("%llu values checked, %u differences\n", (unsigned long long) checks, differences);
+  return differences ? 1 : 0;
+}
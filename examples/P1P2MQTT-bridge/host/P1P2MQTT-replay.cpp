@@ -0,0 +1,486 @@
+/* P1P2MQTT-replay: golden-trace regression runner, replays packet traces through the bridge and compares all publishes
+ *
+ * Usage: P1P2MQTT-replay [-u] trace...
+ *        P1P2MQTT-replay -b budget [-n runs] [-u] trace...
+ *
+ *   -u         update: write the golden files (or the budget file) instead of comparing with them
+ *   -b budget  benchmark: measure the decoding of the traces and compare with the budget file
+ *   -n runs    benchmark: runs per trace, the fastest counts (default 5)
+ *   -W fd      (internal) benchmark worker: replay one trace, statistics to fd
+ *
+ * A trace (name.trace) is P1P2Monitor serial output, one line per line, with comments and commands:
+ *   # text                     comment, not passed to the bridge
+ *   W payload                  command, received by the bridge as MQTT message on P1P2/W (as "mosquitto_pub -t P1P2/W -m payload")
+ *   R T  0.105: 400010...      packet: the virtual clock advances by the packet delay, then the line is passed to the bridge
+ *                              (also for delta-encoded "X T" and deduplicated "D T" packets)
+ *   any other line             passed to the bridge as is (such as ATmega pseudo packets "R P ..." or "*" output)
+ *
+ * Each trace is replayed in a process of its own, through the unmodified bridge (setup(), loop(), process_for_mqtt()),
+ * built for the series of the trace, with erased flash (default settings), on the virtual clock and without MQTT server (host.h).
+ * The golden file (name.golden) lists every publish, one per line:
+ *   <trace line> <qos><r if retained, else -> <topic> <payload>
+ * with '\', newline and other control characters in the payload escaped (\\, \n, \xNN).
+ * The trace line is the line (from 1) passed to the bridge before the publish, 0 for publishes during setup();
+ * publishes on a timer follow the line that advanced the clock.
+ * Output is reproducible: wall time, IP and MAC address are fixed, and the check target of the Makefile builds with a fixed
+ * SOURCE_DATE_EPOCH (compile date in the P1P2/S messages); replay runners built otherwise differ in these messages only.
+ * If the publishes differ from the golden file, the runner reports the first difference, writes them to name.golden.new,
+ * and exits with status 1.
+ *
+ * The benchmark replays the same way, without golden files, and measures over all traces (setup() excluded):
+ *   packets_per_s           packets decoded per CPU second (higher is better)
+ *   ns_per_byte             CPU time per packet byte
+ *   publishes_per_packet    MQTT publishes per packet
+ *   payload_bytes_per_hour  MQTT payload bytes per hour of bus time (virtual clock)
+ *   peak_topic_bytes        longest topic, written by the bridge in its topic buffers (MQTT_TOPIC_LEN, HA_KEY_LEN)
+ *   peak_payload_bytes      longest payload, written in its value buffers (MQTT_VALUE_LEN, HA_VALUE_LEN, SPRINT_VALUE_LEN)
+ * The budget file has a line "<metric> <baseline> <tolerance>%" per metric (and # comments); a deterministic metric (the
+ * last four) worse than its baseline by more than its tolerance is a regression, and the runner exits with status 1.
+ * With -u, the budget file is rewritten with the measured values as baselines, keeping the tolerances (defaults for a new file).
+ * The timing metrics (packets_per_s, ns_per_byte) are informational: they are compared with their baseline and marked
+ * "slower" beyond the tolerance, but never fail the benchmark, as the baseline is only meaningful on the machine that
+ * measured it, without other load. Decoding speed also depends on the address space layout (by up to 40% on x86-64),
+ * which forked workers share, so each benchmark run is a new executable (fresh random layout).
+ */
+
+#include "Arduino.h"
+#include "host.h"
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <string>
+
+#define FIRST_LINE "* P1P2MQTT-replay\n" // the bridge ignores its first serial line
+#define COMMAND_TOPIC "P1P2/W"
+#define BENCH_RUNS 5
+
+struct ReplayStats {    // shared with the workers
+  uint64_t packets;
+  uint64_t bytes;        // packet bytes (hex data of the R lines)
+  uint64_t publishes;
+  uint64_t payloadBytes;
+  uint64_t ms;           // bus time (virtual clock)
+  uint32_t peakTopic;
+  uint32_t peakPayload;
+  double cpu;            // s, replay without setup()
+};
+
+struct Metric {
+  const char* name;
+  bool higherIsBetter;
+  bool informational;    // CPU time: reported against its baseline, not a regression (depends on the machine and its load)
+  double tolerance;      // %, default for a new budget file
+  double baseline;
+  bool budgeted;
+};
+
+static Metric metrics[] = {
+  { "packets_per_s",          true,  true,  30, 0, false },
+  { "ns_per_byte",            false, true,  30, 0, false },
+  { "publishes_per_packet",   false, false,  5, 0, false },
+  { "payload_bytes_per_hour", false, false,  5, 0, false },
+  { "peak_topic_bytes",       false, false,  0, 0, false },
+  { "peak_payload_bytes",     false, false, 10, 0, false },
+};
+#define NR_METRICS (sizeof(metrics) / sizeof(metrics[0]))
+
+static std::string output;
+static ReplayStats* stats;
+static bool bench;
+static int statsFd = -1;    // benchmark worker: statistics to the runner
+static unsigned int lineNr; // trace line passed to the bridge last, 0 during setup()
+
+static void capture(const char* topic, uint8_t qos, bool retain, const char* payload, size_t length)
+{
+  size_t topicLength = strlen(topic);
+  stats->publishes++;
+  stats->payloadBytes += length;
+  if (topicLength > stats->peakTopic) stats->peakTopic = topicLength;
+  if (length > stats->peakPayload) stats->peakPayload = length;
+  if (bench) return;
+  char h[24];
+  snprintf(h, sizeof(h), "%u %u%c ", lineNr, qos, retain ? 'r' : '-');
+  output += h;
+  output += topic;
+  output += ' ';
+  for (size_t i = 0; i < length; i++) {
+    unsigned char c = payload[i];
+    if (c == '\\') {
+      output += "\\\\";
+    } else if (c == '\n') {
+      output += "\\n";
+    } else if ((c < 32) || (c == 127)) {
+      snprintf(h, sizeof(h), "\\x%02X", c);
+      output += h;
+    } else {
+      output += c;
+    }
+  }
+  output += '\n';
+}
+
+// process CPU time, exact (getrusage() can count in scheduler ticks, too coarse for short traces)
+static double cpuTime(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// packet delay in ms of a line "R T  0.105: ..." (or "R 0.105: ..."), false if none (such as a pseudo packet "R P ...")
+static bool packetDelay(const std::string& line, uint32_t* delay)
+{
+  const char* p = line.c_str();
+  if (((p[0] != 'R') && (p[0] != 'X') && (p[0] != 'D')) || (p[1] != ' ')) return false;
+  p += 2;
+  if (*p == 'T') p++;
+  while (*p == ' ') p++;
+  uint32_t sec = 0, ms = 0;
+  int n = 0;
+  if ((*p < '0') || (*p > '9')) return false;
+  while ((*p >= '0') && (*p <= '9')) sec = sec * 10 + (*p++ - '0');
+  if (*p == '.') p++;
+  while ((*p >= '0') && (*p <= '9')) {
+    if (n++ < 3) ms = ms * 10 + (*p - '0');
+    p++;
+  }
+  while (n++ < 3) ms *= 10;
+  if (*p != ':') return false;
+  *delay = sec * 1000 + ms;
+  return true;
+}
+
+// packet bytes of an R line: hex digits after the last ':' or, without, after the prefix (as read by the bridge at offset 12)
+static size_t packetBytes(const std::string& line)
+{
+  size_t p = line.rfind(':');
+  p = (p == std::string::npos) ? ((line.size() > 12) ? 12 : line.size()) : p + 1;
+  size_t n = 0;
+  for (; p < line.size(); p++) if (isxdigit((unsigned char) line[p])) n++;
+  return n >> 1;
+}
+
+static void run(void)
+{
+  for (int i = 0; i < 10; i++) {
+    loop();
+    host_service(0);
+    if (!host_serial_pending()) break;
+  }
+}
+
+static bool readFile(const std::string& path, std::string& s)
+{
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  char buf[65536];
+  size_t n;
+  s.clear();
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) s.append(buf, n);
+  bool ok = !ferror(f);
+  fclose(f);
+  return ok;
+}
+
+static bool writeFile(const std::string& path, const std::string& s)
+{
+  FILE* f = fopen(path.c_str(), "wb");
+  if (!f) return false;
+  bool ok = (fwrite(s.data(), 1, s.size(), f) == s.size());
+  return !fclose(f) && ok;
+}
+
+// first line where a and b differ, 0 if equal
+static size_t firstDifference(const std::string& a, const std::string& b, std::string& la, std::string& lb)
+{
+  size_t line = 1, i = 0, start = 0;
+  while ((i < a.size()) && (i < b.size()) && (a[i] == b[i])) {
+    if (a[i] == '\n') {
+      line++;
+      start = i + 1;
+    }
+    i++;
+  }
+  if ((i == a.size()) && (i == b.size())) return 0;
+  size_t ea = a.find('\n', start), eb = b.find('\n', start);
+  la = (start < a.size()) ? a.substr(start, (ea == std::string::npos) ? std::string::npos : ea - start) : "(end of file)";
+  lb = (start < b.size()) ? b.substr(start, (eb == std::string::npos) ? std::string::npos : eb - start) : "(end of file)";
+  return line;
+}
+
+// replays one trace (in a worker process) into *stats, exit status 0 if the publishes match the golden file (or it was updated),
+// for the benchmark (bench) without golden file
+static void replay(const std::string& trace, bool update)
+{
+  std::string golden = trace;
+  if ((golden.size() > 6) && !golden.compare(golden.size() - 6, 6, ".trace")) golden.resize(golden.size() - 6);
+  golden += ".golden";
+  std::string in;
+  if (!readFile(trace, in)) {
+    fprintf(stderr, "%s: %s\n", trace.c_str(), strerror(errno));
+    exit(2);
+  }
+
+  host_bus_name = "replay";
+  host_flash_file(NULL, true); // erased flash, settings kept in memory
+  host_mqtt_capture = capture;
+  host_telnet_port = 0;
+  host_clock_advance(0);
+  host_serial_input(FIRST_LINE, strlen(FIRST_LINE));
+  setup();
+  run();
+  stats->publishes = stats->payloadBytes = 0; // setup() excluded
+
+  double t0 = cpuTime();
+  std::string line;
+  unsigned int n = 0;
+  for (size_t p = 0; p < in.size(); ) {
+    size_t e = in.find('\n', p);
+    if (e == std::string::npos) e = in.size();
+    line.assign(in, p, e - p);
+    p = e + 1;
+    n++;
+    if (!line.empty() && (line.back() == '\r')) line.pop_back();
+    if (line.empty() || (line[0] == '#')) continue;
+    if ((line[0] == 'W') && (line[1] == ' ')) {
+      lineNr = n;
+      host_mqtt_receive(COMMAND_TOPIC, line.c_str() + 2, line.size() - 2);
+    } else {
+      uint32_t delay;
+      if (packetDelay(line, &delay)) {
+        host_clock_advance(delay);
+        stats->ms += delay;
+      }
+      if (((line[0] == 'R') || (line[0] == 'X')) && (line[1] == ' ')) {
+        stats->packets++;
+        stats->bytes += packetBytes(line);
+      }
+      lineNr = n;
+      line += '\n';
+      host_serial_input(line.data(), line.size());
+    }
+    run();
+  }
+  stats->cpu = cpuTime() - t0;
+  if (bench) exit((write(statsFd, stats, sizeof(*stats)) == sizeof(*stats)) ? 0 : 2);
+
+  const char* result = "ok";
+  std::string expected;
+  if (update) {
+    if (!writeFile(golden, output)) {
+      fprintf(stderr, "%s: %s\n", golden.c_str(), strerror(errno));
+      exit(2);
+    }
+    result = "updated";
+  } else if (!readFile(golden, expected)) {
+    fprintf(stderr, "%s: %s\n", golden.c_str(), strerror(errno));
+    exit(2);
+  } else {
+    std::string le, lo;
+    size_t line = firstDifference(expected, output, le, lo);
+    if (line) {
+      fprintf(stderr, "%s:%zu: publishes differ\n  expected: %s\n  actual:   %s\n", golden.c_str(), line, le.c_str(), lo.c_str());
+      writeFile(golden + ".new", output);
+      result = "FAILED";
+    }
+  }
+  fprintf(stderr, "%-40s %6llu packets %7llu publishes %8.0f packets/s  %s\n", trace.c_str(),
+                  (unsigned long long) stats->packets, (unsigned long long) stats->publishes,
+                  stats->cpu ? stats->packets / stats->cpu : 0, result);
+  exit(strcmp(result, "FAILED") ? 0 : 1);
+}
+
+// runs replay() in a worker process (the bridge keeps its state in global variables), false if it failed;
+// for the benchmark, the worker is a new executable (-W), with statistics through a pipe
+static bool worker(const char* trace, bool update)
+{
+  int fd[2] = { -1, -1 };
+  if (bench && pipe(fd)) {
+    perror("pipe");
+    exit(2);
+  }
+  memset(stats, 0, sizeof(*stats));
+  fflush(stderr);
+  pid_t pid = fork();
+  if (pid < 0) {
+    perror("fork");
+    exit(2);
+  }
+  if (!pid) {
+    if (!bench) replay(trace, update);
+    close(fd[0]);
+    char arg[16];
+    snprintf(arg, sizeof(arg), "%d", fd[1]);
+    execl("/proc/self/exe", "P1P2MQTT-replay", "-W", arg, trace, (char*) NULL);
+    perror("/proc/self/exe");
+    _exit(2);
+  }
+  bool ok = true;
+  if (bench) {
+    close(fd[1]);
+    ok = (read(fd[0], stats, sizeof(*stats)) == sizeof(*stats));
+    close(fd[0]);
+  }
+  int status;
+  if ((waitpid(pid, &status, 0) < 0) || !WIFEXITED(status) || WEXITSTATUS(status)) {
+    if (WIFSIGNALED(status)) fprintf(stderr, "%s: replay crashed (signal %d)\n", trace, WTERMSIG(status));
+    return false;
+  }
+  return ok;
+}
+
+static void measure(const ReplayStats& s, double* value)
+{
+  value[0] = s.cpu ? s.packets / s.cpu : 0;
+  value[1] = s.bytes ? s.cpu * 1e9 / s.bytes : 0;
+  value[2] = s.packets ? (double) s.publishes / s.packets : 0;
+  value[3] = s.ms ? s.payloadBytes * 3600e3 / s.ms : 0;
+  value[4] = s.peakTopic;
+  value[5] = s.peakPayload;
+}
+
+static void report(const char* name, const ReplayStats& s)
+{
+  double value[NR_METRICS];
+  measure(s, value);
+  fprintf(stderr, "%-40s %6llu packets %8.0f packets/s %6.1f ns/byte %6.3f publishes/packet %9.0f bytes/h  peak topic %u payload %u\n",
+                  name, (unsigned long long) s.packets, value[0], value[1], value[2], value[3], s.peakTopic, s.peakPayload);
+}
+
+static bool readBudget(const char* path)
+{
+  FILE* f = fopen(path, "r");
+  if (!f) return (errno == ENOENT);
+  char line[256], name[64];
+  double baseline, tolerance;
+  while (fgets(line, sizeof(line), f)) {
+    if ((line[0] == '#') || (sscanf(line, "%63s %lf %lf%%", name, &baseline, &tolerance) != 3)) continue;
+    for (size_t i = 0; i < NR_METRICS; i++) {
+      if (!strcmp(name, metrics[i].name)) {
+        metrics[i].baseline = baseline;
+        metrics[i].tolerance = tolerance;
+        metrics[i].budgeted = true;
+      }
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static bool writeBudget(const char* path, const double* value)
+{
+  std::string s = "# P1P2MQTT-replay benchmark budget: <metric> <baseline> <tolerance>%, written by make bench-update\n";
+  char line[128];
+  for (size_t i = 0; i < NR_METRICS; i++) {
+    snprintf(line, sizeof(line), "%-24s %12.3f %5.1f%%\n", metrics[i].name, value[i], metrics[i].tolerance);
+    s += line;
+  }
+  return writeFile(path, s);
+}
+
+// benchmark: fastest of runs per trace, totals over the traces compared with (or written to) the budget
+static int benchmark(const char* budget, int runs, char** traces, int n, bool update)
+{
+  ReplayStats total;
+  memset(&total, 0, sizeof(total));
+  for (int i = 0; i < n; i++) {
+    ReplayStats best;
+    for (int r = 0; r < runs; r++) {
+      if (!worker(traces[i], false)) return 2;
+      if (!r || (stats->cpu < best.cpu)) best = *stats;
+    }
+    report(traces[i], best);
+    total.packets += best.packets;
+    total.bytes += best.bytes;
+    total.publishes += best.publishes;
+    total.payloadBytes += best.payloadBytes;
+    total.ms += best.ms;
+    total.cpu += best.cpu;
+    if (best.peakTopic > total.peakTopic) total.peakTopic = best.peakTopic;
+    if (best.peakPayload > total.peakPayload) total.peakPayload = best.peakPayload;
+  }
+  if (n > 1) report("total", total);
+
+  double value[NR_METRICS];
+  measure(total, value);
+  if (!readBudget(budget)) {
+    fprintf(stderr, "%s: %s\n", budget, strerror(errno));
+    return 2;
+  }
+  if (update) {
+    if (!writeBudget(budget, value)) {
+      fprintf(stderr, "%s: %s\n", budget, strerror(errno));
+      return 2;
+    }
+    fprintf(stderr, "%s updated\n", budget);
+    return 0;
+  }
+  int regressions = 0, gated = 0;
+  for (size_t i = 0; i < NR_METRICS; i++) {
+    const Metric& m = metrics[i];
+    if (!m.informational) gated++;
+    if (!m.budgeted) {
+      fprintf(stderr, "  %-24s %12.3f  (no budget)\n", m.name, value[i]);
+      continue;
+    }
+    double limit = m.baseline * (m.higherIsBetter ? (100 - m.tolerance) : (100 + m.tolerance)) / 100;
+    bool regression = m.higherIsBetter ? (value[i] < limit) : (value[i] > limit);
+    fprintf(stderr, "  %-24s %12.3f  baseline %12.3f  limit %12.3f  %s\n", m.name, value[i], m.baseline, limit,
+                    m.informational ? (regression ? "slower (informational)" : "ok (informational)") : (regression ? "REGRESSION" : "ok"));
+    if (regression && !m.informational) regressions++;
+  }
+  if (regressions) fprintf(stderr, "%s: %d of %d deterministic metrics regressed\n", budget, regressions, gated);
+  return regressions ? 1 : 0;
+}
+
+static void usage(void)
+{
+  fprintf(stderr, "Usage: P1P2MQTT-replay [-u] trace...\n");
+  fprintf(stderr, "       P1P2MQTT-replay -b budget [-n runs] [-u] trace...\n");
+  exit(2);
+}
+
+int main(int argc, char** argv)
+{
+  bool update = false;
+  const char* budget = NULL;
+  int runs = BENCH_RUNS;
+  int opt;
+  while ((opt = getopt(argc, argv, "ub:n:W:")) != -1) {
+    switch (opt) {
+      case 'u' : update = true;
+                 break;
+      case 'b' : budget = optarg;
+                 break;
+      case 'n' : runs = atoi(optarg);
+                 break;
+      case 'W' : statsFd = atoi(optarg);
+                 break;
+      default  : usage();
+    }
+  }
+  if ((optind == argc) || (runs < 1)) usage();
+
+  stats = (ReplayStats*) mmap(NULL, sizeof(ReplayStats), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+  if (stats == MAP_FAILED) {
+    perror("mmap");
+    return 2;
+  }
+  if (statsFd >= 0) {
+    bench = true;
+    replay(argv[optind], false);
+  }
+  if (budget) {
+    bench = true;
+    return benchmark(budget, runs, argv + optind, argc - optind, update);
+  }
+
+  int failed = 0;
+  for (int i = optind; i < argc; i++) {
+    if (!worker(argv[i], update)) failed++;
+  }
+  if (failed) fprintf(stderr, "%d of %d traces failed\n", failed, argc - optind);
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+/* TZ.h: host replacement, the bridge uses its own POSIX TZ strings and configTime() */
+
+#ifndef TZ_h
+#define TZ_h
+
+#include "Arduino.h"
+
+void configTime(const char* tz, const char* server1, const char* server2 = nullptr, const char* server3 = nullptr);
+
+#endif /* TZ_h */
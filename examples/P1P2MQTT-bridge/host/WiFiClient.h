@@ -0,0 +1,11 @@
+/* WiFiClient.h: host replacement, the bridge only names the WiFiClient/WiFiServer types (telnet and MQTT use their own sockets) */
+
+#ifndef WiFiClient_h
+#define WiFiClient_h
+
+#include "Arduino.h"
+
+class WiFiClient {};
+class WiFiServer {};
+
+#endif /* WiFiClient_h */
@@ -0,0 +1,47 @@
+/* WiFiManager.h: host replacement of the WiFiManager library
+ *
+ * There is no access point or captive portal: autoConnect() succeeds immediately.
+ * If MQTT settings were given on the daemon command line, autoConnect() fills them in as if entered in the portal
+ * (parameters mqttserver/mqttport/mqttuser/mqttpassword) and calls the save-config callback, so the bridge stores them in its EEPROM settings.
+ */
+
+#ifndef WiFiManager_h
+#define WiFiManager_h
+
+#include "ESP8266WiFi.h"
+#include <string>
+#include <vector>
+
+class WiFiManagerParameter {
+  public:
+    WiFiManagerParameter(const char* custom) : id(nullptr), value("") { (void) custom; }
+    WiFiManagerParameter(const char* id, const char* label, const char* defaultValue, int length) : id(id), value(defaultValue ? defaultValue : "") { (void) label; (void) length; }
+    const char* getID(void) const { return id; }
+    const char* getValue(void) const { return value.c_str(); }
+    void setValue(const char* v) { value = v; }
+  private:
+    const char* id;
+    std::string value;
+};
+
+class WiFiManager {
+  public:
+    bool autoConnect(const char* apName, const char* apPassword = nullptr);
+    bool startConfigPortal(const char* apName, const char* apPassword = nullptr) { return autoConnect(apName, apPassword); }
+    void addParameter(WiFiManagerParameter* p) { params.push_back(p); }
+    void setSaveConfigCallback(void (*func)(void)) { saveCallback = func; }
+    void setAPCallback(void (*func)(WiFiManager*)) { (void) func; }
+    void setSTAStaticIPConfig(IPAddress ip, IPAddress gw, IPAddress sn) { (void) ip; (void) gw; (void) sn; }
+    void setAPStaticIPConfig(IPAddress ip, IPAddress gw, IPAddress sn) { (void) ip; (void) gw; (void) sn; }
+    void setConfigPortalTimeout(unsigned long seconds) { (void) seconds; }
+    void setDebugOutput(bool debug) { (void) debug; }
+    void resetSettings(void) {}
+    String getWiFiSSID(void) { return WiFi.SSID(); }
+    String getWiFiPass(void) { return WiFi.psk(); }
+    String getConfigPortalSSID(void) { return String(""); }
+  private:
+    std::vector<WiFiManagerParameter*> params;
+    void (*saveCallback)(void) = nullptr;
+};
+
+#endif /* WiFiManager_h */
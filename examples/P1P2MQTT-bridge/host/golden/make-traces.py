@@ -0,0 +1,302 @@
+#!/usr/bin/env python3
+# make-traces.py: generates the synthetic golden traces golden/<name>/synthetic.trace for P1P2MQTT-replay, see ../README.md
+#
+# Each trace is P1P2Monitor serial output for one series (or Hitachi model): a bus cycle of the packet types the bridge decodes,
+# with the checksum of the series, ATmega pseudo packets (00000E/00000F) once per second, and values that change every few
+# seconds, so HA discovery, first publishes, change-only publishes and the start-up throttling are all exercised.
+# Values are pseudo-random but reproducible (own generator, independent of the Python version);
+# they follow the packet layout, not the behaviour of a real heat pump.
+# golden/E/delta.trace is the start of the E trace as P1P2Monitor outputs it in dedup mode 3 (D and delta-encoded X lines),
+# followed by X lines with a corrupted check byte and without copy.
+# golden/ES/schedule.trace has the schedule memory transfers (packet type 3E) decoded with SAVESCHEDULE.
+# Recorded traces (P1P2Monitor serial output or the raw-hex R topic without its time stamp) can be added next to these
+# as <name>.trace, followed by "make check-update".
+#
+# Usage: ./make-traces.py (writes the traces in the directories next to this script)
+
+import os
+
+class Rng:
+    def __init__(self, seed):
+        self.x = seed & 0xFFFFFFFF or 1
+
+    def next(self):
+        # xorshift32
+        x = self.x
+        x ^= (x << 13) & 0xFFFFFFFF
+        x ^= x >> 17
+        x ^= (x << 5) & 0xFFFFFFFF
+        self.x = x
+        return x
+
+    def below(self, n):
+        return self.next() % n
+
+def crc_d9(b):
+    crc = 0
+    for c in b:
+        for _ in range(8):
+            crc = ((crc >> 1) ^ 0xD9) if ((crc ^ c) & 0x01) else (crc >> 1)
+            c >>= 1
+    return [crc]
+
+def xor_h(b):
+    x = 0
+    for c in b[1:]:
+        x ^= c
+    return [x]
+
+def sum_mhi(b):
+    return [sum(b) & 0xFF]
+
+def none(b):
+    return []
+
+class Bus:
+    def __init__(self, name, check, seed, churn=16):
+        self.name = name
+        self.churn = churn  # one value change per churn packets (on average)
+        self.check = check
+        self.rng = Rng(seed)
+        self.values = {}
+        self.lines = []
+
+    def payload(self, key, n, fixed):
+        # payload bytes per packet key, slowly changing
+        v = self.values.get(key)
+        if v is None:
+            v = [self.rng.below(256) for _ in range(n)]
+            self.values[key] = v
+        elif n and (self.rng.below(self.churn) == 0):
+            i = self.rng.below(n)
+            if self.rng.below(3):
+                v[i] = (v[i] + self.rng.below(5) - 2) & 0xFF  # small change
+            else:
+                v[i] ^= 1 << self.rng.below(8)                  # bit change
+        for i, b in fixed.items():
+            v[i] = b
+        return v
+
+    def packet(self, delay, header, n, fixed={}):
+        b = list(header) + self.payload(bytes(header), n, fixed)
+        b += self.check(b)
+        self.lines.append("R T %6.3f: %s" % (delay / 1000.0, bytes(b).hex().upper()))
+
+    def pseudo(self, header, payload):
+        b = list(header) + payload
+        b += self.check(b)
+        self.lines.append("R P         %s" % bytes(b).hex().upper())
+
+    def atmega(self, uptime):
+        # as written by P1P2Monitor: 00000E (16 bytes) version, hwID, brand/model, scope, options, sd/sdto, MCUSR, model suggestion;
+        # 00000F (23 bytes) read errors, budget and control state, uptime (BE) at 17..20, voltages at 21..22
+        self.pseudo([0x00, 0x00, 0x0E], [0, 9, 57, 1, 1, 1, 0, 0x3F, 0x00, 0x32, 0x00, 0x19, 0])
+        self.pseudo([0x00, 0x00, 0x0F], [0, 0, 3, 10, 0, 0, 0, 0x03, 0xE8, 0, 0, 0, 0, 0,
+                                         (uptime >> 24) & 0xFF, (uptime >> 16) & 0xFF, (uptime >> 8) & 0xFF, uptime & 0xFF, 0x66, 0x33])
+
+    def write(self, comment, trace="synthetic.trace"):
+        d = os.path.join(os.path.dirname(os.path.abspath(__file__)), self.name)
+        os.makedirs(d, exist_ok=True)
+        with open(os.path.join(d, trace), "w") as f:
+            f.write("# %s, generated by make-traces.py\n" % comment)
+            f.write("\n".join(self.lines) + "\n")
+
+def delta(old, new):
+    # X line as written by P1P2Monitor deltaEncode(): header, length, bitmap of the changed bytes after the header,
+    # changed bytes, check byte (CRC-8 of the full packet)
+    n = len(new)
+    x = list(new[:3]) + [n] + [0] * ((n - 3 + 7) >> 3)
+    for i in range(3, n):
+        if new[i] != old[i]:
+            x[4 + ((i - 3) >> 3)] |= 1 << ((i - 3) & 0x07)
+            x.append(new[i])
+    return x + crc_d9(new)
+
+def dedup3(bus, copies=4, refresh=60):
+    # bus lines as P1P2Monitor outputs them in dedup mode 3 (checkPacketDuplicate(), deltaEncode()): D line for a packet
+    # equal to the last one reported with its header, X line for a changed packet if one of the copies (DELTA_PACKETS,
+    # replaced round-robin) has its header, a full R line (keyframe) otherwise and every refresh seconds
+    full, fullTime, copy, copyTime, lines = {}, {}, [], {}, []
+    t, nxt = 0.0, 0
+    for line in bus.lines:
+        if not line.startswith("R T"):
+            lines.append(line)
+            continue
+        t += float(line[3:10])
+        b = list(bytes.fromhex(line[12:]))
+        h = bytes(b[:3])
+        if (full.get(h) == b) and (t - fullTime[h] < refresh):
+            lines.append("D" + line[1:12] + h.hex().upper())
+            continue
+        full[h], fullTime[h] = b, t
+        x = None
+        j = [i for i in range(len(copy)) if bytes(copy[i][:3]) == h]
+        if j:
+            j = j[0]
+            if (len(copy[j]) == len(b)) and (t - copyTime[h] < refresh) and (copy[j] != b):
+                x = delta(copy[j], b)
+                if len(x) >= len(b):
+                    x = None
+        elif len(copy) < copies:
+            copy.append(b)
+            j = len(copy) - 1
+        else:
+            j, nxt = nxt, (nxt + 1) % copies
+        if x is None:
+            copyTime[h] = t
+        copy[j] = b
+        lines.append(("X" + line[1:12] + bytes(x).hex().upper()) if x else line)
+    bus.lines = lines
+    return full
+
+def daikin_e_delta(seconds):
+    bus = daikin_e(seconds)
+    # leaving water temperature (400011 bytes 3-4, f8.8) of the last 400011 set to 31.0, 32.5 (corrupted) and 33.0
+    k = dedup3(bus)[bytes([0x40, 0x00, 0x11])]
+    def lwt(hi, lo):
+        b = k[:3] + [hi, lo] + k[5:-1]
+        return b + crc_d9(b)
+    a, b, c = lwt(0x1F, 0x00), lwt(0x20, 0x80), lwt(0x21, 0x00)
+    bad = delta(a, b)
+    bad[-1] ^= 0x5A
+    x = lambda b: "X T  0.025: " + bytes(b).hex().upper()
+    bus.lines += ["# leaving water temperature 31.0", x(delta(k, a)),
+                  "# corrupted check byte (32.5): not decoded, the bridge asks P1P2Monitor for keyframes (B9)", x(bad),
+                  "# no copy after the failed check: not decoded until the next keyframe (33.0)", x(delta(a, c)),
+                  "# keyframe (31.0), then 33.0", "R T  0.025: " + bytes(a).hex().upper(), x(delta(a, c))]
+    return bus
+
+def daikin_e(seconds):
+    bus = Bus("E", crc_d9, 0xE5E5)
+    for s in range(seconds):
+        for tp in range(0x10, 0x16):
+            bus.packet(40 if tp > 0x10 else 300, [0x00, 0x00, tp], 20)
+            # 400015 carries a parameter (number at 6, below nr_params 0x1A of this type)
+            bus.packet(25, [0x40, 0x00, tp], 20, {6: s % 0x1A} if tp == 0x15 else {})
+        bus.packet(40, [0x00, 0xF0, 0x30], 14)
+        bus.packet(25, [0x40, 0xF0, 0x30], 0)
+        bus.packet(40, [0x00, 0xF0, 0x31], 12)
+        bus.packet(25, [0x40, 0xF0, 0x31], 12)
+        # 8-bit and 16-bit parameters, 6 and 5 per packet, advancing through the parameter numbers
+        base = (s * 6) % 0x01F8  # nr_params 0x0203
+        bus.packet(40, [0x00, 0xF0, 0x35], 18, {3 * i: (base + i) & 0xFF for i in range(6)} | {3 * i + 1: (base + i) >> 8 for i in range(6)})
+        bus.packet(25, [0x40, 0xF0, 0x35], 18, {3 * i: (base + i) & 0xFF for i in range(6)} | {3 * i + 1: (base + i) >> 8 for i in range(6)})
+        base = (s * 5) % 0x00AA  # nr_params 0x00B1
+        bus.packet(40, [0x40, 0xF0, 0x36], 20, {4 * i: (base + i) & 0xFF for i in range(5)} | {4 * i + 1: 0 for i in range(5)})
+        if s % 10 == 0:
+            # counters
+            c = (s // 10) % 6
+            bus.packet(40, [0x00, 0x00, 0xB8], 1, {0: c})
+            bus.packet(25, [0x40, 0x00, 0xB8], 19, {0: c})
+        bus.atmega(s)
+    return bus
+
+def daikin_e_schedule():
+    # schedule memory transfers (3E, SAVESCHEDULE): 00F03E subtype 00 announces location and length, subtype 01 packets carry
+    # 18 bytes each (last one padded with FF); the auxiliary controller answers with FF only
+    bus = Bus("ES", crc_d9, 0x3E3E)
+    def r(delay, b):
+        bus.lines.append("R T %6.3f: %s" % (delay / 1000.0, bytes(b + crc_d9(b)).hex().upper()))
+    def transfer(comment, loc, data, delay=300):
+        bus.lines.append("# " + comment)
+        r(delay, [0x00, 0xF0, 0x3E, 0x00, loc & 0xFF, loc >> 8, len(data), 0x00])
+        r(25, [0x40, 0xF0, 0x3E, 0x00, 0xFF, 0xFF, 0xFF, 0xFF])
+        for seq in range((len(data) + 17) // 18):
+            chunk = data[18 * seq:18 * seq + 18]
+            r(40, [0x00, 0xF0, 0x3E, 0x01, seq] + chunk + [0xFF] * (18 - len(chunk)))
+            r(25, [0x40, 0xF0, 0x3E, 0x01] + [0xFF] * 19)
+    def week(moments, days):
+        # days: values of the moments of each day, moment times 6:00 8:00 12:00 17:00 22:00 23:00 (+10 min per day mod 3)
+        d = []
+        for day in range(7):
+            for m in range(moments):
+                d += [6 * [6, 8, 12, 17, 22, 23][m] + day % 3, days[day][m]] if m < len(days[day]) else [0xFF, 0xFF]
+        return d
+    hc = [[1, 0, 0x0C, 0x34, 1, 0]] * 6 + [[1, 0]]
+    transfer("silent mode schedule (0x0250, 2 moments/day), after the start-up MQTT readback of the bridge",
+             0x0250, week(2, [[1, 0]] * 5 + [[2, 0]] * 2), 6000)
+    transfer("schedule 0x026C (2 moments/day), Sunday without moments", 0x026C, week(2, [[1, 0]] * 6 + [[]]))
+    transfer("heating own program 2 (0x049C, 6 moments/day): Comfort/Eco/-10/+10", 0x049C, week(6, hc))
+    transfer("electricity price schedule (0x0640, 6 moments/day): Low/Med/High", 0x0640, week(6, [[0, 1, 2, 1, 0, 3]] * 7))
+    transfer("names of the heating schedules (0x06E1, not weekly)", 0x06E1, list(b"Winter program Summer program  Holiday        "[:45]))
+    transfer("same program again: unchanged, not published", 0x049C, week(6, hc))
+    transfer("same program with Saturday changed", 0x049C, week(6, hc[:5] + [[1, 1, 0, 0, 1, 0]] + hc[6:]))
+    transfer("fragment spanning several segments (0x0288, 224 bytes, 4 moments/day): rendering exceeds MQTT_VALUE_LEN, truncated",
+             0x0288, [0x8F, 0xC8] * 0x70)
+    return bus
+
+def daikin_f(seconds):
+    bus = Bus("F", crc_d9, 0xF5F5)
+    for s in range(seconds):
+        for tp, n00, n40 in ((0x10, 20, 20), (0x11, 17, 20), (0x38, 20, 20), (0x39, 14, 5), (0x3B, 20, 19), (0x3C, 12, 2)):
+            bus.packet(40 if tp > 0x10 else 300, [0x00, 0x00, tp], n00)
+            bus.packet(25, [0x40, 0x00, tp], n40)
+        bus.packet(40, [0x00, 0x00, 0x30], 20)
+        bus.packet(40, [0x40, 0x00, 0x1F], 20)
+        bus.packet(40, [0x40, 0x00, 0x20], 20)
+        bus.packet(40, [0x40, 0x00, 0xA3], 19)
+        bus.packet(40, [0x80, 0x00, 0x18], 11)
+        bus.atmega(s)
+    return bus
+
+def daikin_f1f2(seconds):
+    # F1/F2 (not decoded yet, only pseudo packets): bus packets of the same shape as F
+    bus = Bus("F1F2", none, 0xF1F2)
+    for s in range(seconds):
+        for tp in (0x10, 0x11, 0x20):
+            bus.packet(40 if tp > 0x10 else 300, [0x00, 0x00, tp], 16)
+            bus.packet(25, [0x40, 0x00, tp], 16)
+        bus.atmega(s)
+    return bus
+
+def hitachi(model, seconds):
+    # H-LINK: source, destination, frame length (including the XOR byte), payload
+    bus = Bus("H%d" % model, xor_h, 0x4800 + model, 64)
+    def frame(delay, src, length, fixed={}):
+        bus.packet(delay, [src, 0x00, length], length - 4, fixed)
+    for s in range(seconds):
+        if model == 3:
+            frame(300, 0x21, 0x1C)
+            frame(60, 0x89, 0x2D, {6: 0x01})
+            frame(60, 0x89, 0x2D, {6: 0x06})
+            frame(60, 0x41, 0x1E, {1: 0x01})
+        else:
+            frame(300, 0x89, 0x2D)
+            frame(60, 0x89, 0x27)
+            frame(60, 0x89, 0x29, {4: 0xE2})
+            frame(60, 0x21, 0x0B)
+            frame(60, 0x21, 0x12)
+            frame(60, 0x21, 0x1C)
+            frame(60, 0x41, 0x18)
+        bus.atmega(s)
+    return bus
+
+def mhi(seconds):
+    # MHI: source byte, 15 data bytes (incl. frame CRC), sum checksum; no ATmega pseudo packets (source conflict)
+    bus = Bus("MHI", sum_mhi, 0x3141, 64)
+    for s in range(seconds):
+        for i, src in enumerate((0x00, 0x01, 0x80, 0x81, 0x02 + s % 6)):
+            bus.packet(300 if not i else 60, [src], 15)
+    return bus
+
+def mitsubishi(seconds):
+    # M-NET: type, destination, source, flags, length, payload (not decoded yet, only pseudo packets), no checksum check
+    bus = Bus("M", none, 0x4D4D)
+    for s in range(seconds):
+        for dst in (0x01, 0x02):
+            bus.packet(300 if dst == 1 else 60, [0xBD, dst, 0xFB, 0x3F, 0x04], 5)
+            bus.packet(40, [0xBE, 0xFB, dst, 0x3F, 0x04], 5)
+        bus.atmega(s)
+    return bus
+
+if __name__ == "__main__":
+    daikin_e(240).write("Daikin E-series (E_SERIES), 240 s")
+    daikin_e_delta(110).write("Daikin E-series (E_SERIES), 110 s in dedup mode 3 (B3, 4 copies), X lines with corrupted check byte",
+                              "delta.trace")
+    daikin_e_schedule().write("Daikin E-series with SAVESCHEDULE (E_SERIES), schedule memory transfers (packet type 3E)", "schedule.trace")
+    daikin_f(240).write("Daikin F-series (F_SERIES), 240 s")
+    daikin_f1f2(120).write("Daikin F1/F2 (F1F2_SERIES), 120 s")
+    for model in (1, 2, 3):
+        hitachi(model, 30).write("Hitachi model %d (H_SERIES, HITACHI_MODEL=%d), 30 s" % (model, model))
+    mhi(30).write("MHI (MHI_SERIES), 30 s")
+    mitsubishi(120).write("Mitsubishi M-NET (M_SERIES), 120 s")
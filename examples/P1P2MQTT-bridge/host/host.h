@@ -0,0 +1,60 @@
+/* host.h: interface between the bridge daemon (P1P2MQTT-bridged.cpp), decoder (P1P2MQTT-decode.cpp) or replay runner (P1P2MQTT-replay.cpp) and the host replacements of the ESP8266 core and libraries */
+
+#ifndef host_h
+#define host_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <poll.h>
+#include <vector>
+
+// exit codes of a bus worker, restarted by the daemon unless HOST_EXIT_STOP
+#define HOST_EXIT_STOP    0
+#define HOST_EXIT_RESTART 3 // ESP.restart()/ESP.reset()
+#define HOST_EXIT_SERIAL  4 // serial device closed or failed
+
+// sockets and devices serviced while the bridge waits in delay()/yield() and between loop() calls, as the ESP8266 network stack
+class HostPollable {
+  public:
+    HostPollable();
+    virtual ~HostPollable();
+    virtual void pollFds(std::vector<struct pollfd> &fds) = 0; // append the descriptors to poll
+    virtual void pollService(const struct pollfd* fds) = 0;    // called after every poll() with the same descriptors, also to run timers
+    virtual int pollTimeout(void) { return -1; }               // ms until the next timer event, -1 if none
+};
+
+void host_service(int timeout);                        // poll all pollables, at most timeout ms
+
+// Arduino runtime (host_esp.cpp)
+bool host_serial_open(const char* path);               // ATmega serial device, tty (set to raw) or pty
+void host_serial_input(const char* data, size_t n);    // serial input without device (bridge output to the ATmega is discarded)
+void host_flash_file(const char* path, bool readOnly = false); // file holding the flash sector with EEPROM settings,
+                                                       // NULL for none (erased flash); readOnly keeps changes in memory
+bool host_serial_pending(void);                         // serial input received but not yet read by the bridge
+void host_clock_advance(uint32_t ms);                  // switch millis()/micros() to a virtual clock and advance it,
+                                                       // delay() then advances the clock instead of waiting
+void host_rtc_memory(uint32_t* rtc);                   // RTC user memory (RTC_USER_MEMORY_SIZE bytes), shared by worker restarts
+void host_log(const char* format, ...) __attribute__ ((format (printf, 1, 2))); // daemon log on stderr, prefixed with the bus name
+extern const char* host_bus_name;
+
+// MQTT settings from the command line, passed to the bridge as WiFiManager portal input (WiFiManager.h)
+extern const char* host_mqtt_server;                   // NULL: use EEPROM settings
+extern const char* host_mqtt_port;
+extern const char* host_mqtt_user;
+extern const char* host_mqtt_password;
+
+// MQTT capture (AsyncMqttClient.h): if set, connect() succeeds at once without server,
+// and each publish is passed to host_mqtt_capture instead
+typedef void (*HostMqttCapture)(const char* topic, uint8_t qos, bool retain, const char* payload, size_t length);
+extern HostMqttCapture host_mqtt_capture;
+void host_mqtt_receive(const char* topic, const char* payload, size_t length); // incoming message (QoS 0) in capture mode,
+                                                       // delivered from host_service() as from a server
+
+// telnet port of this bus (ESPTelnet.h), 0 disables telnet
+extern uint16_t host_telnet_port;
+
+// P1P2MQTT-bridge.ino
+void setup(void);
+void loop(void);
+
+#endif /* host_h */
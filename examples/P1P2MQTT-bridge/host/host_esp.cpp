@@ -0,0 +1,450 @@
+/* host_esp.cpp: host replacement of the ESP8266 runtime (time, pins, Serial, ESP, WiFi, mDNS, WiFiManager) for the bridge daemon and decoder */
+
+#include "Arduino.h"
+#include "ESP8266WiFi.h"
+#include "ESP8266mDNS.h"
+#include "WiFiManager.h"
+#include "TZ.h"
+#include "host.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <time.h>
+#include <ifaddrs.h>
+#include <netinet/in.h>
+#include <netpacket/packet.h>
+#include <string>
+
+HardwareSerial Serial;
+EspClass ESP;
+ESP8266WiFiClass WiFi;
+MDNSResponder MDNS;
+
+const char* host_bus_name = "bridge";
+const char* host_mqtt_server = NULL;
+const char* host_mqtt_port = NULL;
+const char* host_mqtt_user = NULL;
+const char* host_mqtt_password = NULL;
+
+void host_log(const char* format, ...)
+{
+  va_list args;
+  va_start(args, format);
+  fprintf(stderr, "%s: ", host_bus_name);
+  vfprintf(stderr, format, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// pollables
+
+static std::vector<HostPollable*>& pollables(void)
+{
+  static std::vector<HostPollable*> p; // constructed on first use, pollables are global objects
+  return p;
+}
+
+HostPollable::HostPollable()
+{
+  pollables().push_back(this);
+}
+
+HostPollable::~HostPollable()
+{
+  std::vector<HostPollable*>& p = pollables();
+  p.erase(std::remove(p.begin(), p.end(), this), p.end());
+}
+
+void host_service(int timeout)
+{
+  std::vector<struct pollfd> fds;
+  std::vector<size_t> first;
+  for (HostPollable* p : pollables()) {
+    first.push_back(fds.size());
+    p->pollFds(fds);
+    int t = p->pollTimeout();
+    if ((t >= 0) && ((timeout < 0) || (t < timeout))) timeout = t;
+  }
+  bool anyFd = false;
+  for (const struct pollfd& f : fds) anyFd |= (f.fd >= 0);
+  if ((anyFd || timeout) && (poll(fds.data(), fds.size(), timeout) < 0) && (errno != EINTR)) host_log("poll: %s", strerror(errno));
+  for (size_t i = 0; i < first.size(); i++) pollables()[i]->pollService(fds.data() + first[i]);
+}
+
+// time and pins
+
+#define HOST_CLOCK_EPOCH 1704067200 // wall clock at virtual clock 0: 2024-01-01 00:00:00 UTC
+
+static bool host_clock_virtual = false;
+static uint64_t host_clock_us = 0;
+
+void host_clock_advance(uint32_t ms)
+{
+  host_clock_virtual = true;
+  host_clock_us += ms * 1000ULL;
+}
+
+static uint64_t host_us(void)
+{
+  if (host_clock_virtual) return host_clock_us;
+  static struct timespec t0 = {0, 0};
+  struct timespec t;
+  clock_gettime(CLOCK_MONOTONIC, &t);
+  if (!t0.tv_sec && !t0.tv_nsec) t0 = t;
+  return (t.tv_sec - t0.tv_sec) * 1000000ULL + (t.tv_nsec - t0.tv_nsec) / 1000;
+}
+
+time_t host_time(time_t* t)
+{
+  time_t now = host_clock_virtual ? HOST_CLOCK_EPOCH + (time_t) (host_clock_us / 1000000) : (::time)(NULL);
+  if (t) *t = now;
+  return now;
+}
+
+unsigned long millis(void)
+{
+  return (uint32_t) (host_us() / 1000); // wraps as on the ESP8266
+}
+
+unsigned long micros(void)
+{
+  return (uint32_t) host_us();
+}
+
+void delay(unsigned long ms)
+{
+  if (host_clock_virtual) {
+    // no waiting for time that only passes by input
+    host_clock_advance(ms);
+    host_service(0);
+    return;
+  }
+  uint32_t start = millis();
+  do {
+    uint32_t elapsed = millis() - start;
+    host_service((elapsed < ms) ? ms - elapsed : 0);
+  } while (millis() - start < ms);
+}
+
+void yield(void)
+{
+  host_service(0);
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t val) {}
+
+int digitalRead(uint8_t pin)
+{
+  return HIGH;
+}
+
+size_t host_strlcpy(char* dst, const char* src, size_t size)
+{
+  size_t n = strlen(src);
+  if (size) {
+    size_t m = (n < size - 1) ? n : size - 1;
+    memcpy(dst, src, m);
+    dst[m] = '\0';
+  }
+  return n;
+}
+
+size_t host_strlcat(char* dst, const char* src, size_t size)
+{
+  size_t n = strnlen(dst, size);
+  if (n == size) return n + strlen(src);
+  return n + host_strlcpy(dst + n, src, size - n);
+}
+
+void configTime(const char* tz, const char* server1, const char* server2, const char* server3)
+{
+  // the host clock is kept by the operating system, only the time zone applies
+  setenv("TZ", tz, 1);
+  tzset();
+}
+
+// Serial: ATmega tty or pty, read without blocking into an unlimited input buffer, or input given by host_serial_input()
+
+class SerialPort : public HostPollable {
+  public:
+    int fd = -1;
+    std::string in;
+    size_t head = 0;
+    void fill(void) {
+      char buf[4096];
+      if (fd < 0) return;
+      for (;;) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n > 0) {
+          in.append(buf, n);
+        } else if ((n < 0) && ((errno == EAGAIN) || (errno == EINTR))) {
+          return;
+        } else {
+          host_log("serial device closed%s%s", n ? ": " : "", n ? strerror(errno) : "");
+          exit(HOST_EXIT_SERIAL);
+        }
+      }
+    }
+    void pollFds(std::vector<struct pollfd> &fds) { fds.push_back({fd, POLLIN, 0}); }
+    void pollService(const struct pollfd* fds) { if (fds[0].revents) fill(); }
+};
+
+static SerialPort serialPort;
+
+bool host_serial_open(const char* path)
+{
+  serialPort.fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (serialPort.fd < 0) {
+    host_log("%s: %s", path, strerror(errno));
+    return false;
+  }
+  struct termios t;
+  if (!tcgetattr(serialPort.fd, &t)) {
+    // raw 8N1, no flow control; speed set by Serial.begin(), a pty ignores the speed
+    cfmakeraw(&t);
+    t.c_cflag |= CLOCAL | CREAD;
+    t.c_cflag &= ~CRTSCTS;
+    tcsetattr(serialPort.fd, TCSANOW, &t);
+  }
+  return true;
+}
+
+void host_serial_input(const char* data, size_t n)
+{
+  serialPort.in.append(data, n);
+}
+
+bool host_serial_pending(void)
+{
+  return serialPort.head < serialPort.in.size();
+}
+
+void HardwareSerial::begin(unsigned long baud)
+{
+  speed_t speed;
+  if (serialPort.fd < 0) return;
+  switch (baud) {
+    case 9600   : speed = B9600;
+                  break;
+    case 115200 : speed = B115200;
+                  break;
+#ifdef B250000
+    case 250000 : speed = B250000; // P1P2-ESP-Interface (not a POSIX speed, available on some platforms)
+                  break;
+#endif /* B250000 */
+    default     : host_log("serial speed %lu not available, using 230400 (see README.md)", baud);
+                  speed = B230400;
+  }
+  struct termios t;
+  if (!tcgetattr(serialPort.fd, &t)) {
+    cfsetispeed(&t, speed);
+    cfsetospeed(&t, speed);
+    tcsetattr(serialPort.fd, TCSANOW, &t);
+  }
+}
+
+int HardwareSerial::available(void)
+{
+  if (!host_serial_pending()) serialPort.fill();
+  return serialPort.in.size() - serialPort.head;
+}
+
+int HardwareSerial::read(void)
+{
+  if (!available()) return -1;
+  int c = (uint8_t) serialPort.in[serialPort.head++];
+  if (serialPort.head == serialPort.in.size()) {
+    serialPort.in.clear();
+    serialPort.head = 0;
+  }
+  return c;
+}
+
+size_t HardwareSerial::write(const uint8_t* buf, size_t n)
+{
+  size_t m = 0;
+  if (serialPort.fd < 0) return n; // no ATmega to write to
+  while (m < n) {
+    ssize_t k = ::write(serialPort.fd, buf + m, n - m);
+    if (k > 0) {
+      m += k;
+    } else if ((k < 0) && (errno == EAGAIN)) {
+      struct pollfd p = {serialPort.fd, POLLOUT, 0};
+      poll(&p, 1, 100);
+    } else if (!((k < 0) && (errno == EINTR))) {
+      host_log("serial write: %s", strerror(errno));
+      exit(HOST_EXIT_SERIAL);
+    }
+  }
+  return m;
+}
+
+// ESP: RTC user memory (shared with the daemon, survives worker restarts) and one flash sector in a file
+
+static uint32_t host_rtc_local[RTC_USER_MEMORY_SIZE / 4];
+static uint32_t* host_rtc = host_rtc_local;
+static std::string host_flash_path = "P1P2MQTT-bridge.eeprom";
+static bool host_flash_readonly = false;
+static bool host_flash_loaded = false;
+static uint8_t host_flash_sector[SPI_FLASH_SEC_SIZE]; // copy of the file if read-only
+
+void host_rtc_memory(uint32_t* rtc)
+{
+  host_rtc = rtc;
+}
+
+void host_flash_file(const char* path, bool readOnly)
+{
+  host_flash_path = path ? path : "";
+  host_flash_readonly = readOnly;
+  host_flash_loaded = false;
+}
+
+bool EspClass::rtcUserMemoryRead(uint32_t offset, uint32_t* data, size_t size)
+{
+  if (offset * 4 + size > RTC_USER_MEMORY_SIZE) return false;
+  memcpy(data, host_rtc + offset, size);
+  return true;
+}
+
+bool EspClass::rtcUserMemoryWrite(uint32_t offset, uint32_t* data, size_t size)
+{
+  if (offset * 4 + size > RTC_USER_MEMORY_SIZE) return false;
+  memcpy(host_rtc + offset, data, size);
+  return true;
+}
+
+static bool flashLoad(uint8_t* sector)
+{
+  if (host_flash_readonly && host_flash_loaded) {
+    memcpy(sector, host_flash_sector, SPI_FLASH_SEC_SIZE);
+    return true;
+  }
+  memset(sector, 0xFF, SPI_FLASH_SEC_SIZE); // erased flash
+  FILE* f = host_flash_path.empty() ? NULL : fopen(host_flash_path.c_str(), "rb");
+  if (f) {
+    size_t n = fread(sector, 1, SPI_FLASH_SEC_SIZE, f); // a short file reads as erased flash
+    (void) n;
+    fclose(f);
+  } else if (!host_flash_path.empty() && (errno != ENOENT)) {
+    return false;
+  }
+  if (host_flash_readonly) {
+    memcpy(host_flash_sector, sector, SPI_FLASH_SEC_SIZE);
+    host_flash_loaded = true;
+  }
+  return true;
+}
+
+static bool flashStore(const uint8_t* sector)
+{
+  if (host_flash_readonly) {
+    memcpy(host_flash_sector, sector, SPI_FLASH_SEC_SIZE);
+    host_flash_loaded = true;
+    return true;
+  }
+  // write and rename, so a crash leaves the previous settings
+  std::string tmp = host_flash_path + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (!f) {
+    host_log("%s: %s", tmp.c_str(), strerror(errno));
+    return false;
+  }
+  bool ok = (fwrite(sector, 1, SPI_FLASH_SEC_SIZE, f) == SPI_FLASH_SEC_SIZE);
+  ok = !fclose(f) && ok;
+  return ok && !rename(tmp.c_str(), host_flash_path.c_str());
+}
+
+bool EspClass::flashEraseSector(uint32_t sector)
+{
+  uint8_t s[SPI_FLASH_SEC_SIZE];
+  if (sector) return false;
+  memset(s, 0xFF, SPI_FLASH_SEC_SIZE);
+  return flashStore(s);
+}
+
+bool EspClass::flashWrite(uint32_t address, const uint32_t* data, size_t size)
+{
+  uint8_t s[SPI_FLASH_SEC_SIZE];
+  if ((address + size > SPI_FLASH_SEC_SIZE) || !flashLoad(s)) return false;
+  const uint8_t* d = reinterpret_cast<const uint8_t*>(data);
+  for (size_t i = 0; i < size; i++) s[address + i] &= d[i]; // flash writes can only clear bits
+  return flashStore(s);
+}
+
+bool EspClass::flashRead(uint32_t address, uint32_t* data, size_t size)
+{
+  uint8_t s[SPI_FLASH_SEC_SIZE];
+  if ((address + size > SPI_FLASH_SEC_SIZE) || !flashLoad(s)) return false;
+  memcpy(data, s + address, size);
+  return true;
+}
+
+void EspClass::restart(void)
+{
+  host_log("ESP restart");
+  exit(HOST_EXIT_RESTART);
+}
+
+void EspClass::reset(void)
+{
+  host_log("ESP reset");
+  exit(HOST_EXIT_RESTART);
+}
+
+// WiFi, WiFiManager
+
+// first interface with a non-loopback IPv4 address
+static bool hostInterface(IPAddress* ip, uint8_t* mac)
+{
+  struct ifaddrs* ifa;
+  bool found = false;
+  if (getifaddrs(&ifa)) return false;
+  for (struct ifaddrs* i = ifa; i && !found; i = i->ifa_next) {
+    if (!i->ifa_addr || (i->ifa_addr->sa_family != AF_INET)) continue;
+    uint32_t a = ntohl(reinterpret_cast<struct sockaddr_in*>(i->ifa_addr)->sin_addr.s_addr);
+    if ((a >> 24) == 127) continue;
+    found = true;
+    if (ip) *ip = IPAddress(a >> 24, (a >> 16) & 0xFF, (a >> 8) & 0xFF, a & 0xFF);
+    if (mac) for (struct ifaddrs* j = ifa; j; j = j->ifa_next) {
+      if (j->ifa_addr && (j->ifa_addr->sa_family == AF_PACKET) && !strcmp(j->ifa_name, i->ifa_name)) {
+        memcpy(mac, reinterpret_cast<struct sockaddr_ll*>(j->ifa_addr)->sll_addr, 6);
+      }
+    }
+  }
+  freeifaddrs(ifa);
+  return found;
+}
+
+// without MQTT server (capture), a fixed documentation address (RFC 5737) and zero MAC, for reproducible output
+IPAddress ESP8266WiFiClass::localIP(void)
+{
+  IPAddress ip(192, 0, 2, 1);
+  if (!host_mqtt_capture) hostInterface(&ip, NULL);
+  return ip;
+}
+
+bool wifi_get_macaddr(uint8_t if_index, uint8_t* macaddr)
+{
+  memset(macaddr, 0, 6);
+  return ((if_index == STATION_IF) && !host_mqtt_capture) ? hostInterface(NULL, macaddr) : true;
+}
+
+bool WiFiManager::autoConnect(const char* apName, const char* apPassword)
+{
+  if (!host_mqtt_server) return true;
+  for (WiFiManagerParameter* p : params) {
+    const char* id = p->getID();
+    if (!id) continue;
+    if (!strcmp(id, "mqttserver")) p->setValue(host_mqtt_server);
+    if (!strcmp(id, "mqttport") && host_mqtt_port) p->setValue(host_mqtt_port);
+    if (!strcmp(id, "mqttuser") && host_mqtt_user) p->setValue(host_mqtt_user);
+    if (!strcmp(id, "mqttpassword") && host_mqtt_password) p->setValue(host_mqtt_password);
+    if (!strcmp(id, "use_static_ip")) p->setValue("0"); // the host network is configured by the operating system
+  }
+  if (saveCallback) saveCallback();
+  return true;
+}
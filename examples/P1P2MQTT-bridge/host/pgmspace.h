@@ -0,0 +1,8 @@
+/* pgmspace.h: host replacement, PROGMEM data and the _P functions are defined in Arduino.h */
+
+#ifndef pgmspace_h
+#define pgmspace_h
+
+#include "Arduino.h"
+
+#endif /* pgmspace_h */
@@ -35,6 +35,10 @@
 #define PSEUDO_PACKETS   // adds pseudopacket to serial output with ATmega status info
 #endif
 
+#ifdef EF_SERIES
+#define OUTPUT_RING 128  // size (power of 2, max 256) of non-blocking prioritized serial output buffer, undefine for blocking output
+#endif                   // (not by default on other systems, which need their RAM for long packets)
+
 //#include "Arduino.h"
 
 // Define serial speed
@@ -187,6 +191,7 @@
 
 #define EEPROM_ADDRESS_VERSION             0x09
 #define EEPROM_ADDRESS_SIGNATURE           0x10 // should be last, in view of unspecified strlen(EEPROM_SIGNATURE)
+#define EEPROM_ADDRESS_BUDGET              0x20 // 4 bytes per budget class (period LSB/MSB, add, burst), after signature (max 16 bytes)
 
 #ifdef E_SERIES
 #define INIT_BRAND 1
@@ -217,12 +222,49 @@
 #define INIT_MODEL 0
 #endif
 
+// Packet deduplication: unchanged packets are reported as short D lines (1) or suppressed (2), except every INIT_DEDUP_REFRESH seconds
+#ifdef EF_SERIES
+#define DEDUP_SLOTS 24          // number of packet headers tracked (8 bytes each)
+#else
+#define DEDUP_SLOTS 8           // fewer packet types on other systems
+#endif
+#define INIT_DEDUP 0            // 0 off, 1 D lines, 2 suppress, 3 D lines plus delta-encoded X lines (change with command B)
+#define INIT_DEDUP_REFRESH 60   // forced full report interval in seconds (0 = never), minimum 10 when set with command B
+#ifdef PSEUDO_PACKETS
+// Bus statistics: bus utilisation, per-header gap histogram and minimum reply latency, exported as pseudo packets 00000D
+//#define BUS_STATS 16          // number of (src, type) header slots (12 bytes each, the last one collects all further headers as FF FF), uncomment to enable
+#define BUS_STATS_PERIOD 60     // export interval in seconds
+#define BUS_BITS_PER_BYTE 11    // start bit, 8 data bits, parity bit, stop bit
+#define BUS_BITRATE 9600
+// Command tracing: commands "@tt <command>" from the bridge are reported back with per-hop timestamps as pseudo packets 00000A
+#ifdef EF_SERIES
+#define COMMAND_TRACE 4             // number of traced commands in flight (20 bytes each), undefine to save RAM
+#else
+#define COMMAND_TRACE 1             // without parameter writes, each traced command is reported immediately
+#endif
+#define COMMAND_TRACE_TIMEOUT 30    // seconds after which a queued but unconfirmed parameter write is reported as timed out
+// Command acknowledgement: commands "#ss <command>" from the bridge are acknowledged with reason code and credits in pseudo packets 00000B
+#define CMD_ACK                     // undefine for unacknowledged commands only
+#define CMD_WINDOW 2                // number of command lines the bridge may send unacknowledged (the serial input buffer is 64 bytes)
+#define CMD_CREDIT_REFRESH 30       // interval (s) of credit announcements
+// Write queue report (E/F series): each parameter write leaving the queue (written or superseded) is reported in pseudo packets 000009
+#define WR_REPORT                   // undefine to save serial bandwidth
+#endif /* PSEUDO_PACKETS */
+// Signal quality (library option SIGNAL_QUALITY, v1.1+ hardware with ADC): reported by command V, V1 also resets the statistics
+#define SQ_MV_FULL_SCALE 20900L // bus voltage (mV) at ADC count 1023, as used for pseudo packet 0F
+#define SQ_WARN_PCT 50          // flag a source as degraded if its eye opening (mean distance low-high minus 3 sigma on both sides)
+                                // is below this percentage of the mean distance
+#if (defined M_SERIES || defined TH_SERIES)
+#define DELTA_PACKETS 2         // long-packet systems: number of packet copies kept for delta-encoded output (RB_SIZE bytes each)
+#endif                          // (also for F1F2 and MHI, if RAM permits: see make ram in host/)
+
 #ifdef EF_SERIES
 // Write budget: thottle parameter writes to limit flash memory wear
 #define INIT_WRITE_BUDGET_PERIOD 60 // on avg max one write per 60m allowed
 #define MAX_WRITE_BUDGET        100 // budget never incremented beyond this value (so don't allow to burn more than 100 writes at once)
 #define INIT_WRITE_BUDGET        10 // initial write budget upon boot (255 = unlimited; recommended: 10)
 #define WR_CNT 1                    // number of write repetitions for writing a paramter. 1 should work reliably, no real need for higher value
+#define WR_COALESCE                 // a new write to a parameter with a write still pending replaces that write (latest value wins)
 
 // Error budget: P1P2Monitor should not see any errors except upon start falling into a packet
 // so if P1P2Monitor sees see too many errors, it stops writing
@@ -240,6 +282,22 @@
 #define RB_SIZE 33
 #endif /* EF_SERIES */
 
+// Budget manager: one token bucket per class of bus writes and serial output, as { period (s), tokens added per period,
+// burst (max tokens; 255 = unlimited), initial tokens (255 = unlimited) }; period/add/burst can be changed with command I
+// and are saved in EEPROM; current state is reported in pseudo packets 00000C
+#ifdef EF_SERIES
+#define BUDGET_PARAM_INIT   { INIT_WRITE_BUDGET_PERIOD * 60, 1, MAX_WRITE_BUDGET, INIT_WRITE_BUDGET } // parameter writes
+#define BUDGET_ERROR_INIT   { TIME_ERRORS_PERMITTED, 1, MAX_ERRORS_PERMITTED, INIT_ERRORS_PERMITTED }  // read errors before writing stops
+#else /* EF_SERIES */
+#define BUDGET_PARAM_INIT   { 0, 0, 0, 0 }
+#define BUDGET_ERROR_INIT   { 0, 0, 0, 0 }
+#endif /* EF_SERIES */
+#define BUDGET_COUNTER_INIT { 60, 6, 12, 12 }   // counter request packets, one full cycle (6 packets) per minute
+#define BUDGET_AUX_INIT     { 1, 10, 255, 255 } // auxiliary controller replies, unlimited unless configured
+#define BUDGET_SCOPE_INIT   { 1, 15, 200, 200 } // scope lines (c/C) cost SCOPE_COST tokens each, so ~3 lines/s
+#define BUDGET_STATUS_INIT  { 1, 10, 255, 255 } // status lines (via output ring), unlimited unless configured
+#define SCOPE_COST 5
+
 #ifdef F1F2_SERIES
 // for now: 80 bytes
 #define RS_SIZE 170
@@ -282,24 +340,18 @@
 #define INIT_SDTO 2500    // (uint16_t) time-out delay in ms (applies both to manual instructed writes and controller writes)
 #endif /* H_SERIES */
 
-// CRC settings
-#ifdef EF_SERIES
-#define CRC_GEN 0xD9    // Default generator/Feed for CRC check; these values work at least for the Daikin hybrid
-#else /* EF_SERIES */
-#define CRC_GEN 0x00    // No CRC check for Hitachi/Toshiba/Mitsubishi/MHI
-#endif /* EF_SERIES */
-#define CRC_CS_FEED 0x00   // Define CRC_GEN to 0x00 means no CRC is checked when reading or added when writing (in case of Hitachi/Toshiba/Mitsubishi/MHI)
-
-#ifdef MHI_SERIES
-#define CS_GEN 1        // Use (addition) checksum generator/verification for MHI
-#else
-#define CS_GEN 0        // No checksum for Mitsubishi (TODO: for now)
-#endif /* MHI_SERIES */
+// Checksum settings
+// The checksum (CRC, sum, xor or none) of each series is selected at compile time in P1P2Checksum.h (library)
+#define CS_GEN 1        // Checksum generation/verification on at start (can be switched off by G command for MHI)
 
 #ifdef EF_SERIES
 // auxiliary controller timings
+#ifndef F030DELAY       // may be defined as build flag, e.g. to compare settings in the bus simulator (host/README.md)
 #define F030DELAY 100   // Time delay for in ms auxiliary controller simulation, should be larger than any response of other auxiliary controllers (which is typically 25-80 ms)
+#endif /* F030DELAY */
+#ifndef F03XDELAY
 #define F03XDELAY  30   // Time delay for in ms auxiliary controller simulation, should preferably be a bit larger than any regular response from auxiliary controllers (which is typically 25 ms)
+#endif /* F03XDELAY */
 #define F0THRESHOLD 5   // Number of 00Fx30 messages to remain unanswered before we feel safe to act as auxiliary controller
 
 // L99 command inserts messages to restart Daikin system
@@ -103,6 +103,7 @@
 
 #include "P1P2Config.h"
 #include <P1P2MQTT.h>
+#include <util/crc16.h>
 
 #define SPI_CLK_PIN_VALUE (PINB & 0x20)
 
@@ -114,7 +115,6 @@ static byte model = INIT_MODEL;
 static byte readErrors = 0;
 static byte readErrorLast = 0;
 static byte writeRefusedBusy = 0;
-static byte writeRefusedBudget = 0;
 #ifdef EF_SERIES
 static byte insertMessageCnt = 0;
 static byte insertMessage[RB_SIZE];
@@ -133,6 +133,9 @@ const byte Compile_Options = 0 // multi-line statement
 #ifdef MONITORCONTROL
 +0x01
 #endif
+#ifdef OUTPUT_RING
++0x02
+#endif
 #ifdef PSEUDO_PACKETS
 +0x04
 #endif
@@ -158,6 +161,85 @@ const byte Compile_Options = 0 // multi-line statement
 ;
 
 #include <EEPROM.h>
+
+// Budget manager: each class of bus writes and serial output has a token bucket which gains add tokens every period seconds,
+// up to burst. An action takes tokens, or is refused (and counted) if not enough tokens are left. Tokens 255 means unlimited
+// (set directly, or reached by refill if burst is 255). Period, add and burst are stored in EEPROM.
+#define BUDGET_PARAM   0 // parameter writes (E/F)
+#define BUDGET_ERROR   1 // read errors tolerated before control and counter requests are switched off (E/F)
+#define BUDGET_COUNTER 2 // counter request packets (E)
+#define BUDGET_AUX     3 // auxiliary controller replies (E/F)
+#define BUDGET_SCOPE   4 // scope lines
+#define BUDGET_STATUS  5 // status lines (output ring)
+#define BUDGET_CLASSES 6
+#define BUDGET_UNLIMITED 0xFF
+
+typedef struct {
+  uint16_t period; // in s, 0 = no refill
+  uint8_t add;
+  uint8_t burst;
+  uint8_t tokens;
+} budgetInit_t;
+
+const budgetInit_t budgetInit[BUDGET_CLASSES] PROGMEM = { BUDGET_PARAM_INIT, BUDGET_ERROR_INIT, BUDGET_COUNTER_INIT, BUDGET_AUX_INIT, BUDGET_SCOPE_INIT, BUDGET_STATUS_INIT };
+
+typedef struct {
+  uint16_t period;
+  uint8_t add;
+  uint8_t burst;
+  uint8_t tokens;
+  int32_t next;     // uptime (s) of next refill
+  uint16_t used;    // # actions permitted
+  uint16_t refused; // # actions refused
+} budget_t;
+
+budget_t budget[BUDGET_CLASSES];
+
+void budgetStore(byte c, uint16_t period, byte add, byte burst) {
+  EEPROM.update(EEPROM_ADDRESS_BUDGET + 4 * c, period & 0xFF);
+  EEPROM.update(EEPROM_ADDRESS_BUDGET + 4 * c + 1, period >> 8);
+  EEPROM.update(EEPROM_ADDRESS_BUDGET + 4 * c + 2, add);
+  EEPROM.update(EEPROM_ADDRESS_BUDGET + 4 * c + 3, burst);
+}
+
+void budgetLoad(void) {
+  for (byte c = 0; c < BUDGET_CLASSES; c++) {
+    budget[c].period = EEPROM.read(EEPROM_ADDRESS_BUDGET + 4 * c) | (EEPROM.read(EEPROM_ADDRESS_BUDGET + 4 * c + 1) << 8);
+    budget[c].add = EEPROM.read(EEPROM_ADDRESS_BUDGET + 4 * c + 2);
+    budget[c].burst = EEPROM.read(EEPROM_ADDRESS_BUDGET + 4 * c + 3);
+    budget[c].tokens = pgm_read_byte(&budgetInit[c].tokens);
+    budget[c].next = budget[c].period;
+    budget[c].used = 0;
+    budget[c].refused = 0;
+  }
+#ifdef EF_SERIES
+  budget[BUDGET_PARAM].tokens = EEPROM.read(EEPROM_ADDRESS_INITIAL_WRITE_BUDGET);
+#endif /* EF_SERIES */
+}
+
+bool budgetTake(byte c, byte n) {
+  budget_t &b = budget[c];
+  if (b.tokens != BUDGET_UNLIMITED) {
+    if (b.tokens < n) {
+      if (b.refused < 0xFFFF) b.refused++;
+      return false;
+    }
+    b.tokens -= n;
+  }
+  if (b.used < 0xFFFF) b.used++;
+  return true;
+}
+
+void budgetRefill(int32_t now) {
+  for (byte c = 0; c < BUDGET_CLASSES; c++) {
+    budget_t &b = budget[c];
+    if (b.period && (now >= b.next)) {
+      b.next += b.period;
+      if (b.tokens < b.burst) b.tokens = (b.burst - b.tokens > b.add) ? b.tokens + b.add : b.burst;
+    }
+  }
+}
+
 void initEEPROM() {
   // Serial.println(F("* EEPROM check"));
   bool sigMatch = 1;
@@ -212,6 +294,14 @@ void initEEPROM() {
     EEPROM.update(EEPROM_ADDRESS_ROOM_TEMPERATURE_MSB, INIT_ROOM_TEMPERATURE_MSB);
 #endif /* E_SERIES */
   }
+  // EEPROM_version 3 adds budget manager settings, write budget period is taken over from EEPROM_ADDRESS_WRITE_BUDGET_PERIOD
+  if (EEPROM.read(EEPROM_ADDRESS_VERSION) < 3) {
+    EEPROM.update(EEPROM_ADDRESS_VERSION, 3);
+    for (byte c = 0; c < BUDGET_CLASSES; c++) budgetStore(c, pgm_read_word(&budgetInit[c].period), pgm_read_byte(&budgetInit[c].add), pgm_read_byte(&budgetInit[c].burst));
+#ifdef EF_SERIES
+    budgetStore(BUDGET_PARAM, EEPROM.read(EEPROM_ADDRESS_WRITE_BUDGET_PERIOD) * 60, pgm_read_byte(&budgetInit[BUDGET_PARAM].add), pgm_read_byte(&budgetInit[BUDGET_PARAM].burst));
+#endif /* EF_SERIES */
+  }
 }
 
 P1P2MQTT P1P2MQTT;
@@ -253,15 +343,23 @@ uint8_t wr_val[WR_MAX] = { 0 };
 uint8_t wr_mask[WR_MAX] = { 0 }; // determines which bits are copied from 00F03x to 40F03x message (1=copy, 0=overwrite with new value), default 0x00
 #endif /* F_SERIES */
 
+// outcome of the last serial command, for command acknowledgement (CMD_ACK) and tracing (COMMAND_TRACE)
+#define CMD_OK 0
+#define CMD_UNKNOWN 1      // command not understood
+#define CMD_NO_CONTROL 2   // requires L1
+#define CMD_BUFFER_FULL 3  // parameter write buffer full
+#define CMD_INVALID 4      // invalid or missing arguments
+#define CMD_BUDGET 5       // no parameter write budget left
+#define CMD_TOO_LONG 6     // line longer than RS_SIZE
+byte cmdReason = CMD_OK;
+
 byte Tmin = 0;
 byte Tminprev = 61;
 int32_t upt_prev_pseudo = 0;
-int32_t upt_prev_write = 0;
-int32_t upt_prev_error = 0;
+#ifdef BUS_STATS
+int32_t upt_prev_bus_stats = 0;
+#endif /* BUS_STATS */
 #ifdef EF_SERIES
-uint8_t writeBudget = INIT_WRITE_BUDGET;
-uint8_t writeBudgetPeriod = INIT_WRITE_BUDGET_PERIOD;
-uint8_t errorsPermitted = INIT_ERRORS_PERMITTED;
 uint16_t parameterWritesDone = 0;
 
 // FxAbsentCnt[x] counts number of unanswered 00Fx30 messages (only for x=0,1,F (mapped to 0,1,3));
@@ -431,10 +529,9 @@ void setup() {
   Serial.begin(SERIALSPEED);
   while (!Serial);      // wait for Arduino Serial Monitor to open
   initEEPROM();
+  budgetLoad();
 #ifdef EF_SERIES
   CONTROL_ID = EEPROM.read(EEPROM_ADDRESS_CONTROL_ID);
-  writeBudgetPeriod = EEPROM.read(EEPROM_ADDRESS_WRITE_BUDGET_PERIOD);
-  writeBudget = EEPROM.read(EEPROM_ADDRESS_INITIAL_WRITE_BUDGET);
 #endif /* EF_SERIES */
 #ifdef E_SERIES
   counterRepeatingRequest = EEPROM.read(EEPROM_ADDRESS_COUNTER_STATUS);
@@ -496,51 +593,114 @@ int scanhex(char* s, uint16_t &b) {
 static byte cs_gen = CS_GEN;
 
 static byte suppressSerial = 0;
+
+#ifdef OUTPUT_RING
+// Non-blocking prioritized serial output: output is queued in a ring buffer which is drained to the UART whenever it has room,
+// so the packet loop does not block once the 64-byte hardware TX buffer is full.
+// Each line has a priority class, set at its start and reset to OUT_STATUS after '\n'. A line of lower priority is dropped
+// from the point where the ring lacks room for its class (its newline is kept); packet data waits for room as before.
+#define OUT_PACKET 0
+#define OUT_ERROR  1
+#define OUT_SCOPE  2
+#define OUT_STATUS 3
+
+class OutputRing : public Print {
+  public:
+    uint16_t dropped = 0; // number of bytes dropped
+    uint16_t blocked = 0; // number of packet output bytes which had to wait for room
+    byte peak = 0;        // max ring fill since boot
+    void priority(byte p) { if (!dropping) prio = p; }
+    void drain(void) {
+      while ((head != tail) && Serial.availableForWrite()) pop();
+    }
+    void drainAll(void) {
+      while (head != tail) pop();
+    }
+    bool room(byte p, byte n) { // whether a line of n bytes of class p fits without being dropped
+      drain();
+      return ((head - tail) & (OUTPUT_RING - 1)) + n + reserve(p) < OUTPUT_RING - 1;
+    }
+    virtual size_t write(uint8_t c) {
+      drain();
+      if (lineStart) {
+        // status lines take a token from the status budget, and are skipped entirely (including newline) if none is left
+        lineStart = 0;
+        skipping = (prio == OUT_STATUS) && !budgetTake(BUDGET_STATUS, 1);
+      }
+      if (c == '\n') lineStart = 1;
+      byte used = (head - tail) & (OUTPUT_RING - 1);
+      if (used > peak) peak = used;
+      if (skipping || ((head == tail) && !dropping && Serial.availableForWrite())) {
+        if (c == '\n') prio = OUT_STATUS;
+        return skipping ? 1 : Serial.write(c);
+      }
+      if (!dropping && (prio != OUT_PACKET) && (used + reserve(prio) >= OUTPUT_RING - 1)) dropping = 1;
+      if (dropping && (c != '\n')) {
+        if (dropped < 0xFFFF) dropped++;
+        return 1;
+      }
+      if (used >= OUTPUT_RING - 1) {
+        if ((prio == OUT_PACKET) && (blocked < 0xFFFF)) blocked++;
+        pop(); // blocking
+      }
+      buf[head] = c;
+      head = (head + 1) & (OUTPUT_RING - 1);
+      if (c == '\n') {
+        dropping = 0;
+        prio = OUT_STATUS;
+      }
+      return 1;
+    }
+  private:
+    byte buf[OUTPUT_RING];
+    byte head = 0;
+    byte tail = 0;
+    byte prio = OUT_STATUS;
+    bool dropping = 0;
+    bool lineStart = 1;
+    bool skipping = 0;
+    byte reserve(byte p) { return (p == OUT_ERROR) ? (OUTPUT_RING >> 2) : (OUTPUT_RING >> 1); }
+    void pop(void) {
+      Serial.write(buf[tail]);
+      tail = (tail + 1) & (OUTPUT_RING - 1);
+    }
+};
+
+OutputRing serialOut;
+#define SERIAL_OUT serialOut
+#define Serial_priority(p) serialOut.priority(p)
+#define Serial_drain() if (!suppressSerial) serialOut.drain()
+#define Serial_drainAll() serialOut.drainAll()
+#define Serial_room(p, n) serialOut.room(p, n)
+#else /* OUTPUT_RING */
+#define SERIAL_OUT Serial
+#define Serial_priority(p)
+#define Serial_drain()
+#define Serial_drainAll()
+#define Serial_room(p, n) true
+#endif /* OUTPUT_RING */
+
 #define Serial_read(...) (suppressSerial ? -1 : Serial.read(__VA_ARGS__))
-#define Serial_print(...) if (!suppressSerial) Serial.print(__VA_ARGS__)
-#define Serial_println(...) if (!suppressSerial) Serial.println(__VA_ARGS__)
+#define Serial_print(...) if (!suppressSerial) SERIAL_OUT.print(__VA_ARGS__)
+#define Serial_println(...) if (!suppressSerial) SERIAL_OUT.println(__VA_ARGS__)
 
 void writePseudoPacket(byte* WB, byte rh)
 {
   if (!suppressSerial) {
-    Serial.print(F("R P         "));
-#ifdef MHI_SERIES
-    uint8_t cs = CRC_CS_FEED;
-#elif defined H_SERIES
-    uint8_t cxor = 0;
-#else /* MHI_SERIES, H_SERIES */
-    uint8_t crc = CRC_CS_FEED;
-#endif /* MHI_SERIES, H_SERIES */
+    Serial_priority(OUT_PACKET);
+    SERIAL_OUT.print(F("R P         "));
+    P1P2Checksum cs;
     for (uint8_t i = 0; i < rh; i++) {
       uint8_t c = WB[i];
-      if (c <= 0x0F) Serial.print('0');
-      Serial.print(c, HEX);
-#ifdef MHI_SERIES
-      if (cs_gen != 0) cs += c;
-#elif defined H_SERIES
-      if (i > 0) cxor ^= c;
-#else /* MHI_SERIES, H_SERIES */
-      if (CRC_GEN != 0) for (uint8_t i = 0; i < 8; i++) {
-        crc = ((crc ^ c) & 0x01 ? ((crc >> 1) ^ CRC_GEN) : (crc >> 1));
-        c >>= 1;
-      }
-#endif /* MHI_SERIES, H_SERIES */
+      if (c <= 0x0F) SERIAL_OUT.print('0');
+      SERIAL_OUT.print(c, HEX);
+      cs.add(i, c);
     }
-#ifdef MHI_SERIES
-    if (cs_gen) {
-      if (cs <= 0x0F) Serial.print(F("0"));
-      Serial.print(cs, HEX);
+    if (P1P2Checksum::enabled && cs_gen) {
+      if (cs.value() <= 0x0F) SERIAL_OUT.print(F("0"));
+      SERIAL_OUT.print(cs.value(), HEX);
     }
-#elif defined H_SERIES
-    if (cxor <= 0x0F) Serial.print(F("0"));
-    Serial.print(cxor, HEX);
-#else /* MHI_SERIES, H_SERIES */
-    if (CRC_GEN) {
-      if (crc <= 0x0F) Serial.print(F("0"));
-      Serial.print(crc, HEX);
-    }
-#endif /* MHI_SERIES, H_SERIES */
-    Serial.println();
+    SERIAL_OUT.println();
   }
 }
 
@@ -578,7 +738,262 @@ int32_t upt = 0;
 static byte pseudo0E = 0;
 static byte pseudo0F = 0;
 
-uint8_t scope_budget = 200;
+#ifdef BIT_CALIBRATION
+// bit timing calibration is controlled via the X command: X100 one-shot, X101 continuous, X102 stop (back to nominal timing)
+#define CALIBRATION_CMD 100
+
+bool calibrationCommand(uint16_t v) {
+  if ((v < CALIBRATION_CMD) || (v > CALIBRATION_CMD + 2)) return false;
+  byte mode = (v == CALIBRATION_CMD + 2) ? 0 : v - CALIBRATION_CMD + 1;
+  P1P2MQTT.calibrate(mode);
+  Serial_print(F("* Bit timing calibration "));
+  switch (mode) {
+    case 0 : Serial_println(F("stopped, nominal timing restored")); break;
+    case 1 : Serial_println(F("one-shot started")); break;
+    case 2 : Serial_println(F("continuous started")); break;
+  }
+  return true;
+}
+
+void calibrationReport(void) {
+  uint16_t ticks;
+  uint16_t nominal;
+  uint8_t maxPause;
+  uint8_t newAllow;
+  byte result = P1P2MQTT.calibrationUpdate(ticks, nominal, maxPause, newAllow);
+  if (!result) return;
+  Serial_print(F("* Bit timing calibration: bit period "));
+  Serial_print(ticks);
+  Serial_print(F(" ticks (nominal "));
+  Serial_print(nominal);
+  Serial_print((result == 1) ? F("), applied") : F("), out of range, not applied"));
+  Serial_print(F(", max inter-byte pause "));
+  Serial_print(maxPause);
+  Serial_print(F(" bits, Allow "));
+  Serial_println(newAllow);
+#if defined MHI_SERIES || defined TH_SERIES
+  if (allow != newAllow) {
+    allow = newAllow; // reported in pseudo packet, not saved in EEPROM (use X command to save)
+    pseudo0F = 9;
+  }
+#endif /* MHI || TH_SERIES */
+}
+#endif /* BIT_CALIBRATION */
+
+#ifdef SIGNAL_QUALITY
+// statistics are computed in 1/16 ADC counts, in integer math
+#define SQ_FRAC 16
+
+int16_t signalQualityMilliVolt(int32_t v) {
+// v in 1/16 ADC counts
+  return v * SQ_MV_FULL_SCALE / (1023L * SQ_FRAC);
+}
+
+uint16_t signalQualitySqrt(uint32_t v) {
+  uint32_t r = 0;
+  for (uint32_t b = 1UL << 30; b; b >>= 2) {
+    if (v >= r + b) {
+      v -= r + b;
+      r = (r >> 1) + b;
+    } else {
+      r >>= 1;
+    }
+  }
+  return r;
+}
+
+void signalQualityPrintStat(const __FlashStringHelper* label, sq_stat_t &st, int32_t &mean, int32_t &sd) {
+// mean and sd in 1/16 ADC counts
+  mean = 0;
+  sd = 0;
+  if (st.cnt) {
+    mean = (st.sum * SQ_FRAC) / st.cnt;
+    // sum of squared deviations from m = floor(sum / cnt); it fits in 32 bits, so the wrap-around in computing it is harmless
+    uint32_t m = st.sum / st.cnt;
+    uint32_t r = st.sum % st.cnt;
+    uint32_t dev = st.sumsq - 2 * m * st.sum + st.cnt * m * m;
+    // variance: (dev - r^2 / cnt) / cnt
+    uint32_t var = (dev / st.cnt) * (SQ_FRAC * SQ_FRAC) + ((dev % st.cnt) * (SQ_FRAC * SQ_FRAC)) / st.cnt;
+    uint32_t corr = (r * r * (SQ_FRAC * SQ_FRAC) / st.cnt) / st.cnt;
+    if (var > corr) sd = signalQualitySqrt(var - corr);
+  }
+  Serial_print(label);
+  Serial_print(F(" n="));
+  Serial_print(st.cnt);
+  if (!st.cnt) return;
+  Serial_print(F(" mean="));
+  Serial_print(signalQualityMilliVolt(mean));
+  Serial_print(F("mV sd="));
+  Serial_print(signalQualityMilliVolt(sd));
+  Serial_print(F("mV range="));
+  Serial_print(signalQualityMilliVolt((int32_t) st.min * SQ_FRAC));
+  Serial_print(F(".."));
+  Serial_print(signalQualityMilliVolt((int32_t) st.max * SQ_FRAC));
+  Serial_print(F("mV"));
+}
+
+void signalQualityReport(bool reset) {
+// bus voltage statistics of idle bus and of low/high half-bits per packet source, and a
+// margin (eye opening) estimate: |mean high - mean low| - 3 * (sd high + sd low) and worst case (closest observed samples)
+  if (!ATmegaHwID) return;
+  sq_stat_t idle;
+  sq_stat_t low;
+  sq_stat_t high;
+  int32_t meanLow, sdLow, meanHigh, sdHigh;
+  uint8_t src;
+  P1P2MQTT.signalQualityIdle(idle);
+  signalQualityPrintStat(F("* SQ idle"), idle, meanHigh, sdHigh);
+  Serial_println();
+  for (byte i = 0; P1P2MQTT.signalQuality(i, src, low, high); i++) {
+    Serial_print(F("* SQ src "));
+    if (src < 0x10) Serial_print('0');
+    Serial_print(src, HEX);
+    signalQualityPrintStat(F(" low"), low, meanLow, sdLow);
+    signalQualityPrintStat(F(" high"), high, meanHigh, sdHigh);
+    if (low.cnt && high.cnt) {
+      bool highAbove = (meanHigh > meanLow);
+      int32_t dist = highAbove ? meanHigh - meanLow : meanLow - meanHigh;
+      int32_t eye = dist - 3 * (sdHigh + sdLow);
+      int16_t worst = highAbove ? (int16_t) high.min - (int16_t) low.max : (int16_t) low.min - (int16_t) high.max;
+      Serial_print(F(" eye="));
+      Serial_print(signalQualityMilliVolt(eye));
+      Serial_print(F("mV ("));
+      Serial_print(dist ? (int16_t) (eye * 100 / dist) : 0);
+      Serial_print(F("%) worst="));
+      Serial_print(signalQualityMilliVolt((int32_t) worst * SQ_FRAC));
+      Serial_print(F("mV"));
+      if (!dist || (eye * 100 < dist * SQ_WARN_PCT)) Serial_print(F(" degraded"));
+    }
+    Serial_println();
+  }
+  uint16_t hist[SQ_HIST_BINS];
+  for (byte c = SQ_IDLE; c <= SQ_HIGH; c++) {
+    P1P2MQTT.signalQualityHistogram(c, hist);
+    Serial_print(F("* SQ hist "));
+    Serial_print((c == SQ_IDLE) ? F("idle") : ((c == SQ_LOW) ? F("low ") : F("high")));
+    for (byte j = 0; j < SQ_HIST_BINS; j++) {
+      Serial_print(' ');
+      Serial_print(hist[j]);
+    }
+    Serial_println();
+  }
+  if (reset) {
+    P1P2MQTT.signalQualityReset();
+    Serial_println(F("* SQ statistics reset"));
+  }
+}
+#endif /* SIGNAL_QUALITY */
+
+#ifdef PSEUDO_PACKETS
+static byte budgetPage = 0;
+#endif /* PSEUDO_PACKETS */
+
+void budgetPrint(byte c) {
+  Serial_print(F("* Budget "));
+  Serial_print(c);
+  switch (c) {
+    case BUDGET_PARAM   : Serial_print(F(" param-write")); break;
+    case BUDGET_ERROR   : Serial_print(F(" error")); break;
+    case BUDGET_COUNTER : Serial_print(F(" counter")); break;
+    case BUDGET_AUX     : Serial_print(F(" aux-reply")); break;
+    case BUDGET_SCOPE   : Serial_print(F(" scope")); break;
+    case BUDGET_STATUS  : Serial_print(F(" status")); break;
+  }
+  Serial_print(F(" period "));
+  Serial_print(budget[c].period);
+  Serial_print(F("s add "));
+  Serial_print(budget[c].add);
+  Serial_print(F(" burst "));
+  Serial_print(budget[c].burst);
+  Serial_print(F(" tokens "));
+  Serial_print(budget[c].tokens);
+  Serial_print(F(" used "));
+  Serial_print(budget[c].used);
+  Serial_print(F(" refused "));
+  Serial_println(budget[c].refused);
+}
+
+void budgetCommand(char* s) {
+// I                          lists all budgets
+// I <class> <period> <add> <burst>  sets and saves bucket of class (burst 255 = unlimited)
+// I <minutes>                (E/F) sets parameter write budget increment period (15-255 minutes), as before
+// I <class>                  (other) lists budget of class
+  uint16_t v[4];
+  int n = sscanf(s, "%hu %hu %hu %hu", &v[0], &v[1], &v[2], &v[3]);
+  if (n <= 0) {
+    for (byte c = 0; c < BUDGET_CLASSES; c++) budgetPrint(c);
+    return;
+  }
+  if (n == 1) {
+#ifdef EF_SERIES
+    Serial_print(F("* Write budget increment period "));
+    if (v[0] > 255) {
+      Serial_print(F("(max 255) "));
+      v[0] = 255;
+    }
+    if (v[0] < 15) {
+      Serial_print(F("(min 15) "));
+      v[0] = 15;
+    }
+    budget[BUDGET_PARAM].period = v[0] * 60;
+    budget[BUDGET_PARAM].next = upt + budget[BUDGET_PARAM].period;
+    budgetStore(BUDGET_PARAM, budget[BUDGET_PARAM].period, budget[BUDGET_PARAM].add, budget[BUDGET_PARAM].burst);
+    pseudo0F = 9;
+    Serial_print(F("set to "));
+    Serial_print(v[0]);
+    Serial_println(F(" minutes"));
+#else /* EF_SERIES */
+    if (v[0] < BUDGET_CLASSES) budgetPrint(v[0]);
+#endif /* EF_SERIES */
+    return;
+  }
+  if ((n != 4) || (v[0] >= BUDGET_CLASSES) || (v[2] > 255) || (v[3] > 255)) {
+    Serial_println(F("* Usage: I <class 0-5> <period s> <tokens added per period> <burst, 255=unlimited>"));
+    return;
+  }
+  budget_t &b = budget[v[0]];
+  b.period = v[1];
+  b.add = v[2];
+  b.burst = v[3];
+  if ((b.burst == BUDGET_UNLIMITED) || (b.tokens > b.burst)) b.tokens = b.burst;
+  b.next = upt + b.period;
+  budgetStore(v[0], b.period, b.add, b.burst);
+  pseudo0F = 9;
+  budgetPrint(v[0]);
+}
+
+#ifdef SW_SCOPE_STREAM
+static uint16_t sws_stream_lost_reported = 0;
+
+void scopeStreamDrain()
+// outputs the oldest full half of the streaming scope buffer as an "s" line (scope mode 2),
+// only if the output ring has room for the whole line; otherwise the library keeps filling the other half
+{
+  byte h = sws_stream_fill ^ 1;
+  if (!(sws_stream_full & (1 << h))) h ^= 1;
+  if (!(sws_stream_full & (1 << h))) return;
+  byte n = sws_stream_len[h];
+  if (!Serial_room(OUT_SCOPE, n + 10)) return;
+  uint8_t sreg = SREG;
+  cli();
+  uint16_t lost = sws_stream_lost;
+  SREG = sreg;
+  Serial_priority(OUT_SCOPE);
+  Serial_print(F("s "));
+  if (lost != sws_stream_lost_reported) {
+    Serial_print('~');
+    Serial_print(lost - sws_stream_lost_reported);
+    Serial_print(' ');
+    sws_stream_lost_reported = lost;
+  }
+  for (byte i = 0; i < n; i++) Serial_print((char) sws_stream[h][i]);
+  Serial_println();
+  sws_stream_len[h] = 0;
+  cli();
+  sws_stream_full &= ~(1 << h);
+  SREG = sreg;
+}
+#endif /* SW_SCOPE_STREAM */
 
 #define SKIP_PACKETS 10
 byte skipPackets = SKIP_PACKETS; // skip at most SKIP_PACKETS initial packets with errors; and always skip first packet if delta < 1
@@ -634,8 +1049,7 @@ bool writeParam(void) {
     Serial_println(wr_val[wr_n], HEX);
     return 0;
   }
-  if (writeBudget) {
-    if (writeBudget != 255) writeBudget--;
+  if (budgetTake(BUDGET_PARAM, 1)) {
     wr_cnt[wr_n] = WR_CNT;
 /*
     Serial_print(F("* +b 0x"));
@@ -648,7 +1062,7 @@ bool writeParam(void) {
     return 1;
   } else {
     Serial_println(F("* No write budget left"));
-    if (writeRefusedBudget < 0xFF) writeRefusedBudget++;
+    cmdReason = CMD_BUDGET;
     return 0;
   }
 }
@@ -744,8 +1158,7 @@ bool writeParam(void) {
     Serial_println(F(") must be zero"));
     return 0;
   }
-  if (writeBudget) {
-    if (writeBudget != 255) writeBudget--;
+  if (budgetTake(BUDGET_PARAM, 1)) {
     wr_cnt[wr_n] = WR_CNT;
     Serial_print(F("* Initiating write "));
     Serial_print(wr_n);
@@ -758,9 +1171,10 @@ bool writeParam(void) {
     Serial_print(F(" mask 0x"));
     Serial_print(wr_mask[wr_n], HEX);
     Serial_println();
+    return 1;
   } else {
     Serial_println(F("* No write budget left"));
-    if (writeRefusedBudget < 0xFF) writeRefusedBudget++;
+    cmdReason = CMD_BUDGET;
     return 0;
   }
 }
@@ -775,57 +1189,6 @@ const int8_t expectedLength[3][16] ={{ 20, -1, -1, -1, -1, -1, -1, -1, 16, 11, -
 
 #ifdef EF_SERIES
 
-#define PCKTP_START  0x10
-#define PCKTP_END    0x15 // 0x0D-0x15
-#define PCKTP_ARR_SZ (2 * (PCKTP_END - PCKTP_START + 1))
-const byte nr_bytes[PCKTP_ARR_SZ]     =
-// 10,  11,  12,  13,  14,  15,  10,  11,  12,  13,  14,  15,
-{  20,   8,  15,   3,  15,   6,  20,  20,  20,  14,  19,   6 };
-
-const byte bytestart[PCKTP_ARR_SZ]     =
-{   0,  20,  28,  43,  46,  61,  67,  87, 107, 127, 141, 160 /* , sizeValSeen = 166 */ };
-#define sizeValSeen 166
-byte payloadByteVal[sizeValSeen]  = { 0 };
-byte packetSeen[PCKTP_ARR_SZ] = { 0 };
-byte dedup = 0;
-
-bool checkPacketDuplicate(const byte n) {
-  bool duplicate = 1;
-  byte pti = 0;
-  if (!dedup) return 0;
-  switch (RB[1]) {
-    case 0x00 : break;
-    default   : return 0;
-  }
-  switch (RB[2]) {
-    case 0x10 ... 0x15 : pti = RB[2] - 0x10; break;
-    default            : return 0;
-  }
-  switch (RB[0]) {
-    case 0x00 : break;
-    case 0x40 : pti += 6; break;
-    default   : return 0;
-  }
-  if (n > nr_bytes[pti] + 4) return 0;
-  if (packetSeen[pti]) {
-    for (byte i = 3; i < n - 1; i++) {
-      if (RB[i] != payloadByteVal[bytestart[pti] + i - 3]) {
-        duplicate = 0;
-        break;
-      }
-    }
-  } else {
-    duplicate = 0;
-    packetSeen[pti] = 1;
-  }
-  for (byte i = 3; i < n - 1; i++) payloadByteVal[bytestart[pti] + i - 3] = RB[i];
-  return duplicate;
-}
-
-void restartData() {
-  for (byte i = 0; i < 12; i++) packetSeen[i] = 0;
-}
-
 void shiftCountWrites(void) {
   uint8_t countBusy = 0;
   for (byte i = 0; i < wr_n; i++) {
@@ -854,17 +1217,462 @@ void shiftCountWrites(void) {
   wr_n = countBusy;
 }
 
-#else
+#endif /* EF_SERIES */
+
+// Packet deduplication (all series): for each packet header (first DEDUP_SIG bytes) the length and a CRC-16 hash of the
+// remainder of the last fully reported packet are stored. A packet identical to its predecessor is reported as a short
+// D line (dedup 1 or 3) or not at all (dedup 2), unless dedupRefresh seconds have passed since it was last reported in full.
 
-bool checkPacketDuplicate(const byte n) {
+#define DEDUP_SIG 3
+byte dedup = INIT_DEDUP;
+uint16_t dedupRefresh = INIT_DEDUP_REFRESH;
+byte dedupUsed = 0;
+byte dedupNext = 0;
+byte dedupHeader[DEDUP_SLOTS][DEDUP_SIG];
+byte dedupLength[DEDUP_SLOTS];
+uint16_t dedupHash[DEDUP_SLOTS];
+uint16_t dedupTime[DEDUP_SLOTS]; // uptime (s, modulo 65536) of last full report
+
+byte checkPacketDuplicate(const byte n) {
+// returns 0 if packet is new or changed, 1 if packet is a duplicate to be reported as D line, 2 if it is to be suppressed
+  if (!dedup || (n <= DEDUP_SIG)) return 0;
+  uint16_t hash = 0xFFFF;
+  // the checksum byte (if any) follows from the other bytes
+  byte m = P1P2Checksum::enabled ? n - 1 : n;
+  for (byte i = DEDUP_SIG; i < m; i++) hash = _crc_ccitt_update(hash, RB[i]);
+  uint16_t now = P1P2MQTT.uptime_sec();
+  byte j;
+  for (j = 0; j < dedupUsed; j++) {
+    if ((dedupHeader[j][0] == RB[0]) && (dedupHeader[j][1] == RB[1]) && (dedupHeader[j][2] == RB[2])) break;
+  }
+  if (j < dedupUsed) {
+    if ((dedupHash[j] == hash) && (dedupLength[j] == n) && (!dedupRefresh || ((uint16_t) (now - dedupTime[j]) < dedupRefresh))) return (dedup == 2) ? 2 : 1;
+  } else if (dedupUsed < DEDUP_SLOTS) {
+    j = dedupUsed++;
+  } else {
+    // store full, replace slots round-robin
+    j = dedupNext;
+    if (++dedupNext >= DEDUP_SLOTS) dedupNext = 0;
+  }
+  for (byte i = 0; i < DEDUP_SIG; i++) dedupHeader[j][i] = RB[i];
+  dedupLength[j] = n;
+  dedupHash[j] = hash;
+  dedupTime[j] = now;
   return 0;
 }
 
-void restartData() {
+#ifdef BUS_STATS
+// Bus statistics: for each (src, type) header the number of packets, the minimum gap (delta) before it, a histogram of
+// gaps, and the minimum reply latency (gap before a packet following a packet of the same type from another source),
+// together with the bus utilisation, are exported every BUS_STATS_PERIOD seconds as pseudo packets 00000D, one per header.
+// These show the free slots available for writing, for tuning F030DELAY, F03XDELAY and counterCycleStealDelay.
+#define BUS_STATS_BINS 6 // gap histogram bins: <10, <20, <40, <80, <160, >=160 ms
+byte busStatsUsed = 0;
+byte busStatsKey[BUS_STATS][2];      // src, type; the last slot collects all further headers as FF FF
+uint16_t busStatsCount[BUS_STATS];
+byte busStatsMinGap[BUS_STATS];      // ms, 0xFF for >= 255
+byte busStatsMinReply[BUS_STATS];    // ms, 0xFF if none seen (or >= 255)
+byte busStatsHist[BUS_STATS][BUS_STATS_BINS];
+uint32_t busStatsBits = 0;           // bits on bus in current period
+uint16_t busStatsBusy = 0;           // bus utilisation (per mille) in last period
+byte busStatsPage = 0;               // if > 0, slot busStatsPage - 1 is to be exported next
+byte busStatsPrevSrc = 0xFF;
+byte busStatsPrevType = 0xFF;
+
+void busStatsClear(const byte j) {
+  busStatsCount[j] = 0;
+  busStatsMinGap[j] = 0xFF;
+  busStatsMinReply[j] = 0xFF;
+  for (byte b = 0; b < BUS_STATS_BINS; b++) busStatsHist[j][b] = 0;
+}
+
+void busStatsUpdate(const byte n, const uint16_t delta, const errorbuf_t readError) {
+  busStatsBits += n * BUS_BITS_PER_BYTE;
+  if (readError || (n < 3)) {
+    busStatsPrevType = 0xFF;
+    return;
+  }
+  byte j;
+  for (j = 0; j < busStatsUsed; j++) {
+    if ((busStatsKey[j][0] == RB[0]) && (busStatsKey[j][1] == RB[2])) break;
+  }
+  if (j == busStatsUsed) {
+    if (busStatsUsed < BUS_STATS - 1) {
+      busStatsUsed++;
+      busStatsKey[j][0] = RB[0];
+      busStatsKey[j][1] = RB[2];
+      busStatsClear(j);
+    } else {
+      // last slot is reserved for overflow, opened (and cleared) on first use
+      j = BUS_STATS - 1;
+      if (busStatsUsed < BUS_STATS) {
+        busStatsUsed = BUS_STATS;
+        busStatsKey[j][0] = busStatsKey[j][1] = 0xFF;
+        busStatsClear(j);
+      }
+    }
+  }
+  byte d = (delta < 0xFF) ? delta : 0xFF;
+  if (busStatsCount[j] < 0xFFFF) busStatsCount[j]++;
+  if (d < busStatsMinGap[j]) busStatsMinGap[j] = d;
+  if ((RB[2] == busStatsPrevType) && (RB[0] != busStatsPrevSrc) && (d < busStatsMinReply[j])) busStatsMinReply[j] = d;
+  busStatsPrevSrc = RB[0];
+  busStatsPrevType = RB[2];
+  byte b = 0;
+  for (uint16_t limit = 10; (b < BUS_STATS_BINS - 1) && (delta >= limit); limit <<= 1) b++;
+  if (busStatsHist[j][b] == 0xFF) {
+    // keep histogram shape, halve all bins
+    for (byte k = 0; k < BUS_STATS_BINS; k++) busStatsHist[j][k] >>= 1;
+  }
+  busStatsHist[j][b]++;
 }
+#endif /* BUS_STATS */
 
+#ifdef COMMAND_TRACE
+// Command tracing: a serial command "@tt <command>" (tt: 2-digit hex tag 01-FF, assigned by the bridge) is handled as
+// <command>, and its outcome is reported as pseudo packet 00000A with the tag and timestamps in ms since reception of the
+// line: immediately for a command without parameter write, otherwise once its (first) parameter write is written on the
+// bus (F series) or is confirmed in the next 00F035-00F03D packet of the main controller (E series),
+// or after COMMAND_TRACE_TIMEOUT seconds.
+#define TRACE_DONE 0      // handled, no parameter write
+#define TRACE_REJECTED 1  // command not accepted (cmdReason)
+#define TRACE_QUEUED 2    // internal state only
+#define TRACE_WRITTEN 3
+#define TRACE_CONFIRMED 4
+#define TRACE_TIMEOUT 5
+byte traceTag[COMMAND_TRACE] = { 0 };   // 0: slot free
+byte traceCmd[COMMAND_TRACE];
+byte traceState[COMMAND_TRACE];
+int32_t traceStart[COMMAND_TRACE];      // uptime_millisec() at reception
+uint16_t traceQueued[COMMAND_TRACE];
+uint16_t traceWritten[COMMAND_TRACE];
+uint16_t traceConfirmed[COMMAND_TRACE];
+#ifdef EF_SERIES
+byte tracePt[COMMAND_TRACE];
+uint16_t traceNr[COMMAND_TRACE];
+uint32_t traceVal[COMMAND_TRACE];
 #endif /* EF_SERIES */
 
+uint16_t traceMs(const byte j) {
+  int32_t d = P1P2MQTT.uptime_millisec() - traceStart[j];
+  return (d < 0xFFFF) ? d : 0xFFFE;
+}
+
+byte traceOpen(const byte tag, const byte cmd) {
+// returns slot for tag, or COMMAND_TRACE if none free (command is handled, but not traced)
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if (!traceTag[j]) {
+      traceTag[j] = tag;
+      traceCmd[j] = cmd;
+      traceState[j] = TRACE_DONE;
+      traceStart[j] = P1P2MQTT.uptime_millisec();
+      traceQueued[j] = traceWritten[j] = traceConfirmed[j] = 0xFFFF;
+      return j;
+    }
+  }
+  Serial_println(F("* Command trace slots full, not traced"));
+  return COMMAND_TRACE;
+}
+
+void traceReport(const byte j, const byte state) {
+  byte TB[14];
+  uint16_t now = traceMs(j);
+  TB[0]  = 0x00;
+  TB[1]  = 0x00;
+  TB[2]  = 0x0A;
+  TB[3]  = traceTag[j];
+  TB[4]  = state;
+  TB[5]  = traceCmd[j];
+  TB[6]  = (traceQueued[j] >> 8) & 0xFF;
+  TB[7]  = traceQueued[j] & 0xFF;
+  TB[8]  = (traceWritten[j] >> 8) & 0xFF;
+  TB[9]  = traceWritten[j] & 0xFF;
+  TB[10] = (traceConfirmed[j] >> 8) & 0xFF;
+  TB[11] = traceConfirmed[j] & 0xFF;
+  TB[12] = (now >> 8) & 0xFF;
+  TB[13] = now & 0xFF;
+  writePseudoPacket(TB, 14);
+  traceTag[j] = 0;
+}
+
+#ifdef EF_SERIES
+void traceWrite(const byte pt, const uint16_t nr, const uint32_t val) {
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if (traceTag[j] && (traceState[j] == TRACE_QUEUED) && (tracePt[j] == pt) && (traceNr[j] == nr) && (traceVal[j] == val)) {
+      traceWritten[j] = traceMs(j);
+#ifdef E_SERIES
+      traceState[j] = TRACE_WRITTEN;
+#else /* E_SERIES */
+      traceReport(j, TRACE_WRITTEN);
+#endif /* E_SERIES */
+    }
+  }
+}
+
+void traceSupersede(const byte pt, const uint16_t nr, const uint32_t val, const uint32_t newVal) {
+// a queued write replaced by a later write to the same parameter is traced further with the new value
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if (traceTag[j] && (traceState[j] == TRACE_QUEUED) && (tracePt[j] == pt) && (traceNr[j] == nr) && (traceVal[j] == val)) traceVal[j] = newVal;
+  }
+}
+#endif /* EF_SERIES */
+
+#ifdef E_SERIES
+void traceConfirm(const byte n) {
+// checks whether main controller packet 00F035-00F03D (n bytes excluding checksum) contains a written parameter value
+  if ((RB[0] != 0x00) || ((RB[1] & 0xF0) != 0xF0) || (RB[2] < 0x35) || (RB[2] > 0x3D)) return;
+  byte nrb;
+  switch (RB[2]) {
+    case 0x35 :
+    case 0x3A : nrb = 1; break;
+    case 0x36 :
+    case 0x3B : nrb = 2; break;
+    case 0x37 :
+    case 0x3C : nrb = 3; break;
+    default   : nrb = 4; break;
+  }
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if (!traceTag[j] || (traceState[j] != TRACE_WRITTEN) || (tracePt[j] != RB[2])) continue;
+    for (byte i = 3; i + 2 + nrb <= n; i += 2 + nrb) {
+      uint16_t nr = RB[i] | (RB[i + 1] << 8);
+      uint32_t val = 0;
+      for (byte k = nrb; k; k--) val = (val << 8) | RB[i + 1 + k];
+      if ((nr == traceNr[j]) && (val == traceVal[j])) {
+        traceConfirmed[j] = traceMs(j);
+        traceReport(j, TRACE_CONFIRMED);
+        break;
+      }
+    }
+  }
+}
+#endif /* E_SERIES */
+
+void traceTimeouts(void) {
+  for (byte j = 0; j < COMMAND_TRACE; j++) {
+    if (traceTag[j] && (traceMs(j) >= COMMAND_TRACE_TIMEOUT * 1000U)) traceReport(j, TRACE_TIMEOUT);
+  }
+}
+#endif /* COMMAND_TRACE */
+
+#ifdef CMD_ACK
+// Command acknowledgement: a serial command "#ss <command>" (ss: 2-digit hex sequence number 01-FF, assigned by the bridge)
+// is handled as <command> and acknowledged by pseudo packet 00000B with the sequence number, the reason code (CMD_OK or
+// CMD_* error), the number of command lines the bridge may send unacknowledged (CMD_WINDOW), the number of parameter writes
+// that can still be accepted (free write slots, limited by the write budget), RS_SIZE and the command character.
+// A retransmitted command (sequence number among the last CMD_WINDOW ones) is acknowledged again but not handled again.
+// An unsequenced comment line ('*', such as the bridge's dummy lines at its start-up) starts a new session: the sequence
+// numbers handled before are forgotten, as a restarted bridge numbers its commands from 01 again.
+// The credits are also announced with sequence number 00 when the write credits change and every CMD_CREDIT_REFRESH s.
+#define CMD_NEW (!cmdRepeated)
+byte cmdSeqHist[CMD_WINDOW] = { 0 };
+byte cmdReasonHist[CMD_WINDOW];
+byte cmdHistNext = 0;
+byte cmdWriteCreditsReported = 0xFF;
+int32_t upt_prev_credits = 0;
+
+byte cmdWriteCredits(void) {
+#ifdef EF_SERIES
+  byte credits = WR_MAX;
+  for (byte i = 0; i < wr_n; i++) if (wr_cnt[i]) credits--;
+  if (budget[BUDGET_PARAM].tokens < credits) credits = budget[BUDGET_PARAM].tokens;
+  return credits;
+#else /* EF_SERIES */
+  return 0;
+#endif /* EF_SERIES */
+}
+
+void cmdAck(const byte seq, const byte reason, const byte cmd) {
+  byte AB[9];
+  AB[0] = 0x00;
+  AB[1] = 0x00;
+  AB[2] = 0x0B;
+  AB[3] = seq;
+  AB[4] = reason;
+  AB[5] = CMD_WINDOW;
+  AB[6] = cmdWriteCreditsReported = cmdWriteCredits();
+  AB[7] = RS_SIZE;
+  AB[8] = cmd;
+  writePseudoPacket(AB, 9);
+}
+
+void cmdSessionReset(void) {
+  for (byte j = 0; j < CMD_WINDOW; j++) cmdSeqHist[j] = 0;
+}
+
+bool cmdRetransmission(const byte seq) {
+// returns whether seq was handled already; if so, cmdReason is set to its outcome
+  for (byte j = 0; j < CMD_WINDOW; j++) {
+    if (cmdSeqHist[j] == seq) {
+      cmdReason = cmdReasonHist[j];
+      return true;
+    }
+  }
+  return false;
+}
+
+void cmdAcknowledge(const byte seq, const bool repeated, const byte cmd) {
+  if (!repeated) {
+    cmdSeqHist[cmdHistNext] = seq;
+    cmdReasonHist[cmdHistNext] = cmdReason;
+    if (++cmdHistNext == CMD_WINDOW) cmdHistNext = 0;
+  }
+  cmdAck(seq, cmdReason, cmd);
+}
+
+void cmdAckTooLong(void) {
+// negative acknowledgement of a line longer than RS_SIZE, if its (retained) start has a sequence number
+  byte seq;
+#ifdef SERIAL_MAGICSTRING
+  const char* s = RS + strlen(SERIAL_MAGICSTRING);
+  if (strncmp(RS, SERIAL_MAGICSTRING, strlen(SERIAL_MAGICSTRING))) return;
+#else /* SERIAL_MAGICSTRING */
+  const char* s = RS;
+#endif /* SERIAL_MAGICSTRING */
+  if ((*s == '#') && (sscanf(s + 1, "%2hhx", &seq) == 1) && seq) {
+    cmdReason = CMD_TOO_LONG;
+    cmdAcknowledge(seq, false, s[4]);
+  }
+}
+
+void cmdCredits(const int32_t upt) {
+  if ((cmdWriteCredits() != cmdWriteCreditsReported) || (upt >= upt_prev_credits + CMD_CREDIT_REFRESH)) {
+    upt_prev_credits = upt;
+    cmdAck(0x00, CMD_OK, 0x00);
+  }
+}
+#else /* CMD_ACK */
+#define CMD_NEW true
+#endif /* CMD_ACK */
+
+#ifdef EF_SERIES
+// Write queue: pending parameter writes are slots i < wr_n with wr_cnt[i] != 0. With WR_COALESCE, a new write to a parameter
+// (same packet type and number) with a write still pending replaces that write, so only the latest value is written and its
+// budget token is returned. Writes to the same packet type are packed together in one reply of the auxiliary controller.
+// With WR_REPORT, each write leaving the queue is reported by pseudo packet 000009 with its status (WR_SUPERSEDED or
+// WR_WRITTEN), packet type, parameter number (2 bytes), value (4 bytes) and the number of writes still pending.
+#define WR_SUPERSEDED 0
+#define WR_WRITTEN 1
+
+byte wrPending(void) {
+  byte n = 0;
+  for (byte i = 0; i < wr_n; i++) if (wr_cnt[i]) n++;
+  return n;
+}
+
+void wrReport(const byte i, const byte status) {
+#ifdef WR_REPORT
+  byte QB[12];
+  QB[0]  = 0x00;
+  QB[1]  = 0x00;
+  QB[2]  = 0x09;
+  QB[3]  = status;
+  QB[4]  = wr_pt[i];
+  QB[5]  = (wr_nr[i] >> 8) & 0xFF;
+  QB[6]  = wr_nr[i] & 0xFF;
+  QB[7]  = (wr_val[i] >> 24) & 0xFF;
+  QB[8]  = (wr_val[i] >> 16) & 0xFF;
+  QB[9]  = (wr_val[i] >> 8) & 0xFF;
+  QB[10] = wr_val[i] & 0xFF;
+  QB[11] = wrPending();
+  writePseudoPacket(QB, 12);
+#endif /* WR_REPORT */
+}
+
+#ifdef WR_COALESCE
+void coalesceWrites(const byte first) {
+// new writes first..wr_n-1 replace pending writes to the same parameter
+  for (byte i = first; i < wr_n; i++) {
+    for (byte j = 0; j < i; j++) {
+      if (wr_cnt[j] && (wr_pt[j] == wr_pt[i]) && (wr_nr[j] == wr_nr[i])) {
+#ifdef COMMAND_TRACE
+        traceSupersede(wr_pt[j], wr_nr[j], wr_val[j], wr_val[i]);
+#endif /* COMMAND_TRACE */
+        wr_cnt[j] = 0;
+        if ((budget[BUDGET_PARAM].tokens != BUDGET_UNLIMITED) && (budget[BUDGET_PARAM].tokens < budget[BUDGET_PARAM].burst)) budget[BUDGET_PARAM].tokens++;
+        if (budget[BUDGET_PARAM].used) budget[BUDGET_PARAM].used--;
+        wrReport(j, WR_SUPERSEDED);
+      }
+    }
+  }
+}
+#endif /* WR_COALESCE */
+#endif /* EF_SERIES */
+
+#ifdef DELTA_PACKETS
+// Delta-encoded output (dedup 3): a changed packet is reported as an X line with the header, the packet length, a bitmap
+// of the bytes after the header that changed, the changed bytes, and a check byte (CRC-8 of the full packet, also for
+// series without checksum), relative to the copy last reported for that header.
+// A full R line (keyframe) is sent for a new header, after a length change, every dedupRefresh seconds, if no byte changed
+// (a forced refresh of checkPacketDuplicate), or if the delta would not be shorter. The bridge reconstructs the full packet
+// and verifies the check byte before decoding.
+typedef P1P2ChecksumCRC<0xD9, 0x00> P1P2DeltaCheck;
+byte deltaHeader[DELTA_PACKETS][DEDUP_SIG];
+byte deltaLength[DELTA_PACKETS];
+byte deltaCopy[DELTA_PACKETS][RB_SIZE];
+uint16_t deltaTime[DELTA_PACKETS]; // uptime (s, modulo 65536) of last keyframe
+byte deltaUsed = 0;
+byte deltaNext = 0;
+// the X line is built in WB, which only holds a packet while it is handed to writepacket()
+#if WB_SIZE < RB_SIZE
+#error "DELTA_PACKETS requires WB_SIZE >= RB_SIZE"
+#endif
+#define DB WB
+
+byte deltaEncode(const byte n) {
+// returns length of delta encoding in DB, or 0 if packet is to be reported in full
+  if ((n <= DEDUP_SIG) || (n > RB_SIZE)) return 0;
+  uint16_t now = P1P2MQTT.uptime_sec();
+  byte len = 0;
+  byte j;
+  for (j = 0; j < deltaUsed; j++) {
+    if ((deltaHeader[j][0] == RB[0]) && (deltaHeader[j][1] == RB[1]) && (deltaHeader[j][2] == RB[2])) break;
+  }
+  if (j < deltaUsed) {
+    if ((deltaLength[j] == n) && (!dedupRefresh || ((uint16_t) (now - deltaTime[j]) < dedupRefresh))) {
+      byte nb = (n - DEDUP_SIG + 7) >> 3;
+      for (byte i = 0; i < DEDUP_SIG; i++) DB[i] = RB[i];
+      DB[DEDUP_SIG] = n;
+      len = DEDUP_SIG + 1;
+      for (byte i = 0; i < nb; i++) DB[len++] = 0;
+      for (byte i = DEDUP_SIG; i < n; i++) {
+        if (RB[i] != deltaCopy[j][i]) {
+          if (len + 2 >= n) {
+            len = 0;
+            break;
+          }
+          DB[DEDUP_SIG + 1 + ((i - DEDUP_SIG) >> 3)] |= (1 << ((i - DEDUP_SIG) & 0x07));
+          DB[len++] = RB[i];
+        }
+      }
+      if (len == DEDUP_SIG + 1 + nb) {
+        len = 0;
+      } else if (len) {
+        DB[len++] = P1P2ChecksumOf<P1P2DeltaCheck>(RB, n);
+      }
+    }
+  } else if (deltaUsed < DELTA_PACKETS) {
+    j = deltaUsed++;
+  } else {
+    j = deltaNext;
+    if (++deltaNext >= DELTA_PACKETS) deltaNext = 0;
+  }
+  if (!len) deltaTime[j] = now;
+  for (byte i = 0; i < DEDUP_SIG; i++) deltaHeader[j][i] = RB[i];
+  deltaLength[j] = n;
+  for (byte i = 0; i < n; i++) deltaCopy[j][i] = RB[i];
+  return len;
+}
+#endif /* DELTA_PACKETS */
+
+void restartData() {
+  dedupUsed = 0;
+  dedupNext = 0;
+#ifdef DELTA_PACKETS
+  deltaUsed = 0;
+  deltaNext = 0;
+#endif /* DELTA_PACKETS */
+}
+
 void loop() {
   uint16_t temp;
   uint16_t temphex;
@@ -877,6 +1685,14 @@ void loop() {
   static bool wrongLengthReported[16] = { false };
   byte packetDuplicate = 0;
 
+  Serial_drain();
+#ifdef BIT_CALIBRATION
+  calibrationReport();
+#endif /* BIT_CALIBRATION */
+#ifdef SW_SCOPE_STREAM
+  if (scope == 2) scopeStreamDrain();
+#endif /* SW_SCOPE_STREAM */
+
 // if GPIO0 = PB4 = L, do nothing, and disable serial input/output, to enable ESP programming
 // MISO GPIO0  pin 18 // PB4 // pull-up   // P=Power // white // DS18B20                                            V10/V11
 // MOSI GPIO2  pin 17 // PB3 // pull-up   // R=Read  // green // low-during-programming // blue-LED on ESP12F       V12/V13
@@ -888,6 +1704,7 @@ void loop() {
                suppressSerial = 1;
                P1P2MQTT.ledPower(1);
                P1P2MQTT.ledError(0);
+               Serial_drainAll();
                Serial.println("* Pausing serial");
                Serial.end();
                break;
@@ -896,6 +1713,7 @@ void loop() {
                suppressSerial = 2;
                P1P2MQTT.ledPower(0);
                P1P2MQTT.ledError(1);
+               Serial_drainAll();
                Serial.println("* Pausing serial");
                delay(10);
                Serial.end();
@@ -941,6 +1759,9 @@ void loop() {
       //  (c != '\n' ||  rs == RS_SIZE)
       char lst = *(RSp - 1);
       *(RSp - 1) = '\0';
+#ifdef CMD_ACK
+      cmdAckTooLong();
+#endif /* CMD_ACK */
       if (c != '\n') {
         if (!reportedTooLong) {
           Serial_println(F("* Line too long, ignored"));
@@ -987,22 +1808,55 @@ byte scannedLength2 = 0;
 int8_t scannedParams = 0;
 byte wr_n_prev = 0;
 byte writeBudget_prev = 0;
-          switch (*(RSp - 1)) { // in use by ESP: adhjps(v), in use by ATmega: cefgiklmnoqtuvwx, available: bryz
+          cmdReason = CMD_OK;
+#ifdef CMD_ACK
+byte cmdSeq = 0;
+bool cmdRepeated = false;
+          if ((*(RSp - 1) == '#') && (sscanf(RSp, "%2hhx%hhn", &cmdSeq, &scannedLength) == 1) && cmdSeq) {
+            RSp += scannedLength;
+            while (*RSp == ' ') RSp++;
+            if (*RSp) RSp++;
+            cmdRepeated = cmdRetransmission(cmdSeq);
+          }
+#endif /* CMD_ACK */
+#ifdef COMMAND_TRACE
+byte traceSlot = COMMAND_TRACE;
+byte traceTagIn;
+          if ((*(RSp - 1) == '@') && CMD_NEW && (sscanf(RSp, "%2hhx%hhn", &traceTagIn, &scannedLength) == 1) && traceTagIn) {
+            RSp += scannedLength;
+            while (*RSp == ' ') RSp++;
+            if (*RSp) RSp++;
+            traceSlot = traceOpen(traceTagIn, *(RSp - 1));
+          }
+#ifdef EF_SERIES
+          wr_n_prev = wr_n;
+#endif /* EF_SERIES */
+#endif /* COMMAND_TRACE */
+#ifdef CMD_ACK
+byte cmdLetter = *(RSp - 1); // RSp may advance while the command is parsed
+          if (cmdRepeated && (cmdLetter == '@') && (strlen(RSp) > 3)) cmdLetter = RSp[3]; // skip trace tag of retransmission
+#endif /* CMD_ACK */
+          switch (CMD_NEW ? *(RSp - 1) : '*') { // in use by ESP: adhjps(v), in use by ATmega: cefgiklmnoqtuvwx, available: bryz
             case '\0': // Serial_println(F("* Empty line received"));
                       break;
             case '*': // Serial_print(F("* Received: "));
                       // Serial_println(RSp);
+#ifdef CMD_ACK
+                      if (!cmdSeq) cmdSessionReset();
+#endif /* CMD_ACK */
                       break;
 #ifdef E_SERIES
             case 'e':
             case 'E': if (!CONTROL_ID) {
                         Serial_println(F("* Requires L1"));
+                        cmdReason = CMD_NO_CONTROL;
                         break;
                       }
                       shiftCountWrites(); // shift writes in buffer, may change wr_n
                       if (wr_n == WR_MAX) {
                         // previous writes still being processed, buffer full
                         Serial_println(F("* Buffer full"));
+                        cmdReason = CMD_BUFFER_FULL;
                         break;
                       } else if (wr_n) {
                         // previous write(s) still being processed
@@ -1011,14 +1865,15 @@ byte writeBudget_prev = 0;
                         Serial_println(F("), trying to add write(s)"));
                       }
                       wr_n_prev = wr_n;
-                      writeBudget_prev = writeBudget;
+                      writeBudget_prev = budget[BUDGET_PARAM].tokens;
                       while ((wr_n < WR_MAX) && ((scannedParams = sscanf(RSp, (const char*) "%2hhx%4x%8lx%hhn", &wr_pt[wr_n], &wr_nr[wr_n], &wr_val[wr_n], &scannedLength)) > 0)) {
                         RSp += scannedLength;
                         if (scannedParams >= 3) {
                           if (!writeParam()) {
                             // writeParam indicates error or lack of write budget -> cancel newly scheduled writes, error already reported in writeParam
+                            if (!cmdReason) cmdReason = CMD_INVALID;
                             wr_n = wr_n_prev;
-                            writeBudget = writeBudget_prev;
+                            budget[BUDGET_PARAM].tokens = writeBudget_prev;
                             break;
                           }
                           wr_n++;
@@ -1041,16 +1896,21 @@ byte writeBudget_prev = 0;
                           Serial_println();
 */
                           wr_n = wr_n_prev;
-                          writeBudget = writeBudget_prev;
+                          budget[BUDGET_PARAM].tokens = writeBudget_prev;
+                          cmdReason = CMD_INVALID;
                           break;
                         }
                       }
                       if ((wr_n == WR_MAX) && ((scannedParams = sscanf(RSp, (const char*) "%2hhx", &wbtemp)) > 0)) {
                         Serial_println(F("* Too many arguments or too many writes to add, cancelling all new writes"));
+                        cmdReason = CMD_BUFFER_FULL;
                         wr_n = wr_n_prev;
-                        writeBudget = writeBudget_prev;
+                        budget[BUDGET_PARAM].tokens = writeBudget_prev;
                         break;
                       }
+#ifdef WR_COALESCE
+                      coalesceWrites(wr_n_prev);
+#endif /* WR_COALESCE */
                       break;
             case 'f':
             case 'F': Serial_print(F("* Room Temp insertion "));
@@ -1102,12 +1962,12 @@ byte writeBudget_prev = 0;
                           Serial_print(F("* Counter cycle stealing will be active with delay set to (recommended: 9) "));
                           Serial_println(counterCycleStealDelay);
                           Serial_println(F("* Setting max errors permitted to minimum for safety"));
-                          errorsPermitted = MIN_ERRORS_PERMITTED;
+                          budget[BUDGET_ERROR].tokens = MIN_ERRORS_PERMITTED;
                           counterRequest = 1;
                         } else {
                           Serial_println(F("* Counter cycle stealing is or will be switched off"));
                           Serial_println(F("* Setting max errors permitted back to initial value"));
-                          errorsPermitted = INIT_ERRORS_PERMITTED;
+                          budget[BUDGET_ERROR].tokens = INIT_ERRORS_PERMITTED;
                           counterRequest = 0;
                         }
                         EEPROM.update(EEPROM_ADDRESS_COUNTER_CYCLE_STEAL_DELAY, counterCycleStealDelay);
@@ -1138,12 +1998,14 @@ byte writeBudget_prev = 0;
             case 'f':
             case 'F': if (!(CONTROL_ID && controlLevel)) {
                         Serial_println(F("* Command requires operation as auxiliary controller (L1)"));
+                        cmdReason = CMD_NO_CONTROL;
                         break;
                       }
                       shiftCountWrites(); // shift writes in buffer, may change wr_n
                       if (wr_n == WR_MAX) {
                         // previous writes still being processed, buffer full
                         Serial_println(F("* Parameter write buffer full, command ignored"));
+                        cmdReason = CMD_BUFFER_FULL;
                         break;
                       } else if (wr_n) {
                         // previous write(s) still being processed
@@ -1152,13 +2014,14 @@ byte writeBudget_prev = 0;
                         Serial_println(F("), but will attempt to add write(s)"));
                       }
                       wr_n_prev = wr_n;
-                      writeBudget_prev = writeBudget;
+                      writeBudget_prev = budget[BUDGET_PARAM].tokens;
                       while ((wr_n < WR_MAX) && ((scannedParams = sscanf(RSp, (const char*) "%2hhx%2hhx%2hhx%hhnM%2hhx%hhn", &wr_pt[wr_n], &wr_nr[wr_n], &wr_val[wr_n], &scannedLength, &wr_mask[wr_n], &scannedLength2)) > 0)) {
                         if (scannedParams >= 3) {
                           if (!writeParam()) {
                             // writeParam indicates error or lack of write budget -> cancel newly scheduled writes, error already reported in writeParam
+                            if (!cmdReason) cmdReason = CMD_INVALID;
                             wr_n = wr_n_prev;
-                            writeBudget = writeBudget_prev;
+                            budget[BUDGET_PARAM].tokens = writeBudget_prev;
                             break;
                           }
                           if (scannedParams == 3) {
@@ -1181,16 +2044,21 @@ byte writeBudget_prev = 0;
                           }
                           Serial_println();
                           wr_n = wr_n_prev;
-                          writeBudget = writeBudget_prev;
+                          budget[BUDGET_PARAM].tokens = writeBudget_prev;
+                          cmdReason = CMD_INVALID;
                           break;
                         }
                       }
                       if ((wr_n == WR_MAX) && ((scannedParams = sscanf(RSp, (const char*) "%2hhx", &wbtemp)) > 0)) {
                         Serial_println(F("* Too many arguments or too many writes to add, cancelling all new writes"));
+                        cmdReason = CMD_BUFFER_FULL;
                         wr_n = wr_n_prev;
-                        writeBudget = writeBudget_prev;
+                        budget[BUDGET_PARAM].tokens = writeBudget_prev;
                         break;
                       }
+#ifdef WR_COALESCE
+                      coalesceWrites(wr_n_prev);
+#endif /* WR_COALESCE */
                       break;
 #endif /* F_SERIES */
 #ifdef MHI_SERIES
@@ -1214,7 +2082,32 @@ byte writeBudget_prev = 0;
                       break;
 #endif /* MHI_SERIES */
             case 'v':
-            case 'V': printWelcomeString(false);
+            case 'V': Serial_drainAll();
+                      printWelcomeString(false);
+#ifdef SIGNAL_QUALITY
+                      // V1: also reset signal quality statistics
+                      signalQualityReport((scanint(RSp, temp) == 1) && (temp == 1));
+#endif /* SIGNAL_QUALITY */
+                      break;
+            case 'b': // set packet deduplication: 0 off, 1 D lines, 2 suppress, 3 D lines and delta-encoded X lines (if DELTA_PACKETS),
+                      // 9 restart (send keyframes), values >= 10 set forced-refresh interval in s
+            case 'B': Serial_print(F("* Dedup "));
+                      if (scanint(RSp, temp) == 1) {
+                        if (temp >= 10) {
+                          dedupRefresh = temp;
+                        } else {
+#ifdef DELTA_PACKETS
+                          if (temp <= 3) dedup = temp;
+#else /* DELTA_PACKETS */
+                          if (temp <= 3) dedup = (temp == 3) ? 1 : temp;
+#endif /* DELTA_PACKETS */
+                          restartData();
+                        }
+                        Serial_print(F("set to "));
+                      }
+                      Serial_print(dedup);
+                      Serial_print(F(" refresh "));
+                      Serial_println(dedupRefresh);
                       break;
             case 't':
             case 'T': Serial_print(F("* Delay "));
@@ -1243,17 +2136,25 @@ byte writeBudget_prev = 0;
                       if (scanint(RSp, temp) == 1) {
                         scope = temp;
                         pseudo0E = 9;
+#ifdef SW_SCOPE_STREAM
+                        if (scope > 2) scope = 2;
+#else /* SW_SCOPE_STREAM */
                         if (scope > 1) scope = 1;
+#endif /* SW_SCOPE_STREAM */
                         P1P2MQTT.setScope(scope);
                         Serial_print(F("set to "));
                       }
                       Serial_println(scope);
-                      scope_budget = 200;
+                      budget[BUDGET_SCOPE].tokens = budget[BUDGET_SCOPE].burst;
                       break;
 #endif
 #if defined MHI_SERIES || defined TH_SERIES
             case 'x':
-            case 'X': Serial_print(F("* Allow (bits pause) "));
+            case 'X':
+#ifdef BIT_CALIBRATION
+                      if ((scanint(RSp, temp) == 1) && calibrationCommand(temp)) break;
+#endif /* BIT_CALIBRATION */
+                      Serial_print(F("* Allow (bits pause) "));
                       if (scanint(RSp, temp) == 1) {
                         allow = temp;
                         if (allow > 76) allow = 76;
@@ -1265,7 +2166,11 @@ byte writeBudget_prev = 0;
                       break;
 #else /* MHI_SERIES || TH_SERIES */
             case 'x':
-            case 'X': Serial_print(F("* Echo "));
+            case 'X':
+#ifdef BIT_CALIBRATION
+                      if ((scanint(RSp, temp) == 1) && calibrationCommand(temp)) break;
+#endif /* BIT_CALIBRATION */
+                      Serial_print(F("* Echo "));
                       if (scanint(RSp, temp) == 1) {
                         if (temp) temp = 1;
                         echo = temp;
@@ -1333,38 +2238,16 @@ byte writeBudget_prev = 0;
                         break;
                       }
                       Serial_println();
-#ifdef MHI_SERIES
                       P1P2MQTT.writepacket(WB, wb, sd, cs_gen);
-#else /* MHI_SERIES */
-                      P1P2MQTT.writepacket(WB, wb, sd, CRC_GEN, CRC_CS_FEED);
-#endif /* MHI_SERIES */
                       break;
             case 'k': // soft-reset ESP
             case 'K': Serial_println(F("* Resetting ATmega ...."));
                       resetFunc(); // call reset
                       break;
-#ifdef EF_SERIES
-            case 'i':
-            case 'I': Serial_print(F("* Write budget increment period "));
-                      if (scanint(RSp, temp) == 1) {
-                        if (temp > 255) {
-                          Serial_print(F("(max 255) "));
-                          temp = 255;
-                        }
-                        if (temp < 15) {
-                          Serial_print(F("(min 15) "));
-                          temp = 15;
-                        }
-                        writeBudgetPeriod = temp;
-                        Serial_print(F("set to "));
-                        EEPROM.update(EEPROM_ADDRESS_WRITE_BUDGET_PERIOD, writeBudgetPeriod);
-                        pseudo0F = 9;
-                      } else {
-                        Serial_print(F("is "));
-                      }
-                      Serial_print(writeBudgetPeriod);
-                      Serial_println(" minutes");
+            case 'i': // budget manager
+            case 'I': budgetCommand(RSp);
                       break;
+#ifdef EF_SERIES
             case 'n':
             case 'N': Serial_print(F("* Current write budget "));
                       if (scanint(RSp, temp) == 1) {
@@ -1372,17 +2255,17 @@ byte writeBudget_prev = 0;
                           Serial_print(F("(max 255 = unlimited) "));
                           temp = 255;
                         }
-                        writeBudget = temp;
+                        budget[BUDGET_PARAM].tokens = temp;
                         Serial_print(F("and initial write budget set to "));
-                        EEPROM.update(EEPROM_ADDRESS_INITIAL_WRITE_BUDGET, writeBudget);
+                        EEPROM.update(EEPROM_ADDRESS_INITIAL_WRITE_BUDGET, temp);
                         pseudo0F = 9;
                       } else {
                         Serial_print(F("is "));
                       }
-                      if (writeBudget == 255) {
+                      if (budget[BUDGET_PARAM].tokens == BUDGET_UNLIMITED) {
                         Serial_println(F("unlimited"));
                       } else {
-                        Serial_println(writeBudget);
+                        Serial_println(budget[BUDGET_PARAM].tokens);
                       }
                       break;
 #endif /* EF_SERIES */
@@ -1534,7 +2417,7 @@ byte writeBudget_prev = 0;
                           case  5 : 
 #endif /* F_SERIES */
                                     if (temp & 0x01) {
-                                      if ((errorsPermitted < MIN_ERRORS_PERMITTED) && (model != 4)) {
+                                      if ((budget[BUDGET_ERROR].tokens < MIN_ERRORS_PERMITTED) && (model != 4)) {
                                         Serial_println(F("* Errorspermitted (error budget) too low; control not enabled"));
                                         break;
                                       }
@@ -1660,7 +2543,7 @@ byte writeBudget_prev = 0;
                             Serial_println(F("* No free controller slot found (yet). Counter functionality will not enabled"));
                             break;
                           }
-                          if ((errorsPermitted < MIN_ERRORS_PERMITTED) && (model != 4)) {
+                          if ((budget[BUDGET_ERROR].tokens < MIN_ERRORS_PERMITTED) && (model != 4)) {
                             Serial_println(F("* Errorspermitted too low; counter functionality will not enabled"));
                             break;
                           }
@@ -1720,8 +2603,27 @@ byte writeBudget_prev = 0;
 #endif /* E_SERIES */
             default:  Serial_print(F("* Command not understood: "));
                       Serial_println(RSp - 1);
+                      cmdReason = CMD_UNKNOWN;
                       break;
           }
+#ifdef COMMAND_TRACE
+          if (traceSlot < COMMAND_TRACE) {
+#ifdef EF_SERIES
+            if (wr_n > wr_n_prev) {
+              // trace first parameter write queued by this command
+              tracePt[traceSlot] = wr_pt[wr_n_prev];
+              traceNr[traceSlot] = wr_nr[wr_n_prev];
+              traceVal[traceSlot] = wr_val[wr_n_prev];
+              traceQueued[traceSlot] = traceMs(traceSlot);
+              traceState[traceSlot] = TRACE_QUEUED;
+            } else
+#endif /* EF_SERIES */
+            traceReport(traceSlot, cmdReason ? TRACE_REJECTED : TRACE_DONE);
+          }
+#endif /* COMMAND_TRACE */
+#ifdef CMD_ACK
+          if (cmdSeq) cmdAcknowledge(cmdSeq, cmdRepeated, cmdLetter);
+#endif /* CMD_ACK */
 #ifdef SERIAL_MAGICSTRING
 /*
         } else {
@@ -1744,25 +2646,26 @@ byte writeBudget_prev = 0;
     pseudo0E++;
     pseudo0F++;
     upt_prev_pseudo = upt;
+#ifdef BUS_STATS
+    if ((upt >= upt_prev_bus_stats + BUS_STATS_PERIOD) && !busStatsPage) {
+      busStatsBusy = (busStatsBits * 1000) / ((uint32_t) BUS_BITRATE * (upt - upt_prev_bus_stats));
+      busStatsBits = 0;
+      upt_prev_bus_stats = upt;
+      if (busStatsUsed) busStatsPage = 1;
+    }
+#endif /* BUS_STATS */
+#ifdef COMMAND_TRACE
+    traceTimeouts();
+#endif /* COMMAND_TRACE */
+#ifdef CMD_ACK
+    cmdCredits(upt);
+#endif /* CMD_ACK */
   }
-#ifdef EF_SERIES
-  if (upt >= upt_prev_write + 60 * writeBudgetPeriod) {
-    if (writeBudget < MAX_WRITE_BUDGET) writeBudget++;
-    upt_prev_write += 60 * writeBudgetPeriod;
-  }
-  if (upt >= upt_prev_error + TIME_ERRORS_PERMITTED) {
-    if (errorsPermitted < MAX_ERRORS_PERMITTED) errorsPermitted++;
-    upt_prev_error += TIME_ERRORS_PERMITTED;
-  }
-#endif /* EF_SERIES */
+  budgetRefill(upt);
   while (P1P2MQTT.packetavailable()) {
     uint16_t delta;
     errorbuf_t readError = 0;
-#ifdef MHI_SERIES
     uint16_t nread = P1P2MQTT.readpacket(RB, delta, EB, RB_SIZE, cs_gen);
-#else /* MHI_SERIES */
-    int nread = P1P2MQTT.readpacket(RB, delta, EB, RB_SIZE, CRC_GEN, CRC_CS_FEED);
-#endif /* MHI_SERIES */
     if (nread > RB_SIZE) {
       Serial_println(F("* Received packet longer than RB_SIZE"));
       nread = RB_SIZE;
@@ -1784,6 +2687,12 @@ byte writeBudget_prev = 0;
         skipPackets = 0;
       }
     }
+#ifdef BUS_STATS
+    busStatsUpdate(nread, delta, readError);
+#endif /* BUS_STATS */
+#if defined COMMAND_TRACE && defined E_SERIES
+    if (!readError && (nread > 3)) traceConfirm(nread - 1);
+#endif /* COMMAND_TRACE && E_SERIES */
 #ifdef SW_SCOPE
 
 #if F_CPU > 8000000L
@@ -1792,14 +2701,17 @@ byte writeBudget_prev = 0;
 #define FREQ_DIV 3 // 8 MHz
 #endif
 
-    if (scope
+#ifdef SW_SCOPE_STREAM
+    if (scope == 2) P1P2MQTT.scopeStreamFlush(); // output tail of this packet without waiting for the next packet
+#endif /* SW_SCOPE_STREAM */
+    if ((scope == 1)
 #ifdef EF_SERIES
-              && ((readError && (scope_budget > 5)) || (((RB[0] == 0x40) && (RB[1] == 0xF0)) && (scope_budget > 50)) || (scope_budget > 150))
+              && ((readError && (budget[BUDGET_SCOPE].tokens > 5)) || (((RB[0] == 0x40) && (RB[1] == 0xF0)) && (budget[BUDGET_SCOPE].tokens > 50)) || (budget[BUDGET_SCOPE].tokens > 150))
       // always keep scope budget for 40F0 and expecially for readErrors
 #endif /* EF_SERIES */
                                                                                                                                              ) {
-      if (sws_cnt || (sws_event[SWS_MAX - 1] != SWS_EVENT_LOOP)) {
-        scope_budget -= 5;
+      if ((sws_cnt || (sws_event[SWS_MAX - 1] != SWS_EVENT_LOOP)) && budgetTake(BUDGET_SCOPE, SCOPE_COST)) {
+        Serial_priority(OUT_SCOPE);
         if (readError) {
           Serial_print(F("C "));
         } else {
@@ -1885,7 +2797,6 @@ byte writeBudget_prev = 0;
         Serial_println();
       }
     }
-    if (++scope_budget > 200) scope_budget = 200;
     sws_block = 0; // release SW_SCOPE for next log operation
 #endif /* SW_SCOPE */
 #ifdef MEASURE_LOAD
@@ -1920,9 +2831,8 @@ byte writeBudget_prev = 0;
         readErrorLast = readError;
       }
 #ifdef EF_SERIES
-      if (errorsPermitted) {
-        errorsPermitted--;
-        if ((!errorsPermitted) && (model != 4)) {
+      if (budgetTake(BUDGET_ERROR, 1)) {
+        if ((!budget[BUDGET_ERROR].tokens) && (model != 4)) {
           Serial_println(F("* WARNING: too many read errors detected"));
           stopControlAndCounters(1);
         }
@@ -1937,7 +2847,7 @@ byte writeBudget_prev = 0;
         WB[0] = 0x41;
         WB[1] = 0x06;
         if (P1P2MQTT.writeready()) {
-          P1P2MQTT.writepacket(WB, 2, 5, CRC_GEN, CRC_CS_FEED);
+          P1P2MQTT.writepacket(WB, 2, 5);
         } else {
           Serial_println(F("* Refusing to write ack packet while previous packet wasn't finished"));
           if (writeRefusedBusy < 0xFF) writeRefusedBusy++;
@@ -1970,7 +2880,7 @@ byte writeBudget_prev = 0;
       if (counterCycleStealDelay) {
         // request one counter per cycle in short pause after first 0012 msg at start of each minute
         if ((nread > 4) && (RB[0] == 0x40) && (RB[1] == 0x00) && (RB[2] == 0x12)) {
-          if (counterRequest) {
+          if (counterRequest && budgetTake(BUDGET_COUNTER, 1)) {
             WB[0] = 0x00;
             WB[1] = 0x00;
             WB[2] = 0xB8;
@@ -1982,7 +2892,7 @@ byte writeBudget_prev = 0;
               //      in which case the 4000B* reply arrives after the 000013* request
               //      (and in thoses cases the 000013* request is ignored)
               //      (NOTE!: if counterCycleStealDelay is chosen incorrectly, such as 5 ms in some example systems, this results in incidental bus collisions)
-              P1P2MQTT.writepacket(WB, 4, counterCycleStealDelay, CRC_GEN, CRC_CS_FEED);
+              P1P2MQTT.writepacket(WB, 4, counterCycleStealDelay);
             } else {
               Serial_println(F("* Refusing to write counter-request packet while previous packet wasn't finished"));
               if (writeRefusedBusy < 0xFF) writeRefusedBusy++;
@@ -2022,14 +2932,14 @@ byte writeBudget_prev = 0;
           // For CONTROL_ID != 0 and F_max==1, use 1-in-4 mechanism
           if (div4) {
             div4--;
-          } else {
+          } else if (budgetTake(BUDGET_COUNTER, 1)) {
             WB[0] = 0x00;
             WB[1] = 0x00;
             WB[2] = 0xB8;
             WB[3] = (counterRequest - 1);
             F030forcounter = true;
             if (P1P2MQTT.writeready()) {
-              P1P2MQTT.writepacket(WB, 4, F03XDELAY, CRC_GEN, CRC_CS_FEED);
+              P1P2MQTT.writepacket(WB, 4, F03XDELAY);
             } else {
               Serial_println(F("* Refusing to write counter-request packet while previous packet wasn't finished"));
               if (writeRefusedBusy < 0xFF) writeRefusedBusy++;
@@ -2138,7 +3048,7 @@ byte writeBudget_prev = 0;
           nwrite = 24;
         }
 */
-        if (CRC_GEN) nwrite--; // omit CRC from received-byte-counter
+        if (P1P2Checksum::enabled) nwrite--; // omit CRC from received-byte-counter
         // insert user-specified message or restart Daikin message
         if ((FxAbsentCnt[RB[1] & 0x01] == F0THRESHOLD) && (insertMessageCnt
 #ifdef E_SERIES
@@ -2555,9 +3465,14 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
           }
 #endif /* F_SERIES */
         }
+        if (writeAction && (writeAction != 2) && !budgetTake(BUDGET_AUX, 1)) {
+          // reply refused by the auxiliary budget: parameters flagged for it stay scheduled for a later reply
+          for (byte i = 0; i < wr_n; i++) { wr_cnt[i] &= 0x7F; }
+          writeAction = 0;
+        }
         if (writeAction) {
           if (P1P2MQTT.writeready()) {
-            P1P2MQTT.writepacket(WB, nwrite, d, CRC_GEN, CRC_CS_FEED);
+            P1P2MQTT.writepacket(WB, nwrite, d);
             // report action
 #ifdef E_SERIES
             if (writeAction == 1) {
@@ -2566,7 +3481,11 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
                 if (wr_cnt[i] & 0x80) {
                   wr_cnt[i]--;
                   wr_cnt[i] &= 0x7F;
+                  if (!wr_cnt[i]) wrReport(i, WR_WRITTEN);
                   parameterWritesDone ++;
+#ifdef COMMAND_TRACE
+                  traceWrite(wr_pt[i], wr_nr[i], wr_val[i]);
+#endif /* COMMAND_TRACE */
                   Serial_print(F("* wr 0x"));
                   Serial_print(wr_pt[i], HEX);
                   Serial_print(" 0x");
@@ -2598,6 +3517,9 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
                   Serial_print(wr_nr[i]);
                   Serial_print(" set to 0x");
                   Serial_print(wr_val[i], HEX);
+#ifdef COMMAND_TRACE
+                  traceWrite(wr_pt[i], wr_nr[i], wr_val[i]);
+#endif /* COMMAND_TRACE */
                   if (writeAction == 3) {
                     Serial_println(", to be repeated");
                   } else {
@@ -2606,6 +3528,7 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
                     wr_cnt[i]--;
                   }
                   wr_cnt[i] &= 0x7F;
+                  if (!wr_cnt[i]) wrReport(i, WR_WRITTEN);
                 }
               }
             }
@@ -2635,96 +3558,111 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
 #endif /* EF_SERIES */
 #endif /* PSEUDO_PACKETS */
 
-    packetDuplicate = 0;
-    if (readError) {
-      // error, so output data on line starting with E
-      Serial_print(F("E "));
-    } else if ((nread >= 3) && (packetDuplicate = checkPacketDuplicate(nread))) {
-      Serial_print(F("D "));
-    } else {
-      // no error, so output data on line starting with R
-      Serial_print(F("R "));
-    }
-    // 3nd-12th characters show length of bus pause (max "R T 65.535: ")
-    Serial_print(F("T "));
-    if (delta < 10000) Serial_print(' ');
-    if (delta < 1000) {
-      Serial_print('0');
-    } else {
-      Serial_print(delta / 1000); delta %= 1000;
-    }
-    Serial_print(F("."));
-    if (delta < 100) Serial_print('0');
-    if (delta < 10) Serial_print('0');
-    Serial_print(delta);
-    Serial_print(F(": "));
-    byte cs = 0;
-    for (int i = 0; i < (packetDuplicate ? 3 : nread); i++) {
-      if (EB[i] & ERROR_SB) {
-        // collision suspicion due to data verification error in reading back written data
-        Serial_print(F("-SB:"));
-      }
-      if (EB[i] & ERROR_BE) { // or BE3 (duplicate code)
-        // collision suspicion due to data verification error in reading back written data
-        Serial_print(F("-XX:"));
-      }
-      if (EB[i] & ERROR_BC) {
-        // collision suspicion due to 0 during 2nd half bit signal read back
-        Serial_print(F("-BC:"));
+    packetDuplicate = readError ? 0 : checkPacketDuplicate(nread);
+#ifdef DELTA_PACKETS
+    byte deltaLen = (readError || packetDuplicate || (dedup != 3)) ? 0 : deltaEncode(nread);
+#else /* DELTA_PACKETS */
+    const byte deltaLen = 0;
+#endif /* DELTA_PACKETS */
+    if (packetDuplicate < 2) {
+      Serial_priority(readError ? OUT_ERROR : OUT_PACKET);
+      if (readError) {
+        // error, so output data on line starting with E
+        Serial_print(F("E "));
+      } else if (packetDuplicate) {
+        Serial_print(F("D "));
+      } else if (deltaLen) {
+        // changed bytes only, on line starting with X
+        Serial_print(F("X "));
+      } else {
+        // no error, so output data on line starting with R
+        Serial_print(F("R "));
       }
-      if (EB[i] & ERROR_PE) {
-        // parity error detected
-        Serial_print(F("-PE:"));
+      // 3nd-12th characters show length of bus pause (max "R T 65.535: ")
+      Serial_print(F("T "));
+      if (delta < 10000) Serial_print(' ');
+      if (delta < 1000) {
+        Serial_print('0');
+      } else {
+        Serial_print(delta / 1000); delta %= 1000;
       }
+      Serial_print(F("."));
+      if (delta < 100) Serial_print('0');
+      if (delta < 10) Serial_print('0');
+      Serial_print(delta);
+      Serial_print(F(": "));
+      byte cs = 0;
+      for (int i = 0; i < (packetDuplicate ? 3 : (deltaLen ? deltaLen : nread)); i++) {
+        if (EB[i] & ERROR_SB) {
+          // collision suspicion due to data verification error in reading back written data
+          Serial_print(F("-SB:"));
+        }
+        if (EB[i] & ERROR_BE) { // or BE3 (duplicate code)
+          // collision suspicion due to data verification error in reading back written data
+          Serial_print(F("-XX:"));
+        }
+        if (EB[i] & ERROR_BC) {
+          // collision suspicion due to 0 during 2nd half bit signal read back
+          Serial_print(F("-BC:"));
+        }
+        if (EB[i] & ERROR_PE) {
+          // parity error detected
+          Serial_print(F("-PE:"));
+        }
 #ifdef H_SERIES
-      if (EB[i] & SIGNAL_UC) {
-        // 11/12 bit uncertainty detected
-        Serial_print(F("-UC:"));
-      }
+        if (EB[i] & SIGNAL_UC) {
+          // 11/12 bit uncertainty detected
+          Serial_print(F("-UC:"));
+        }
 #endif /* H_SERIES */
 #ifdef MHI_SERIES
-      if (EB[i] & ERROR_INCOMPLETE) {
-        // 11/12 bit uncertainty detected
-        Serial_print(F("-IC:"));
-      }
+        if (EB[i] & ERROR_INCOMPLETE) {
+          // 11/12 bit uncertainty detected
+          Serial_print(F("-IC:"));
+        }
 #endif /* H_SERIES */
 #ifdef GENERATE_FAKE_ERRORS
-      if (EB[i] & (ERROR_SB << 8)) {
-        // collision suspicion due to data verification error in reading back written data
-        Serial_print(F("-sb:"));
-      }
-      if (EB[i] & (ERROR_BE << 8)) {
-        // collision suspicion due to data verification error in reading back written data
-        Serial_print(F("-xx:"));
-      }
-      if (EB[i] & (ERROR_BC << 8)) {
-        // collision suspicion due to 0 during 2nd half bit signal read back
-        Serial_print(F("-bc:"));
-      }
-      if (EB[i] & (ERROR_PE << 8)) {
-        // parity error detected
-        Serial_print(F("-pe:"));
-      }
+        if (EB[i] & (ERROR_SB << 8)) {
+          // collision suspicion due to data verification error in reading back written data
+          Serial_print(F("-sb:"));
+        }
+        if (EB[i] & (ERROR_BE << 8)) {
+          // collision suspicion due to data verification error in reading back written data
+          Serial_print(F("-xx:"));
+        }
+        if (EB[i] & (ERROR_BC << 8)) {
+          // collision suspicion due to 0 during 2nd half bit signal read back
+          Serial_print(F("-bc:"));
+        }
+        if (EB[i] & (ERROR_PE << 8)) {
+          // parity error detected
+          Serial_print(F("-pe:"));
+        }
 #endif /* GENERATE_FAKE_ERRORS */
-      byte c = RB[i];
-      if (c < 0x10) Serial_print('0');
-      Serial_print(c, HEX);
-      if (EB[i] & ERROR_OR) {
-        // buffer overrun detected (overrun is after, not before, the read byte)
-        Serial_print(F(":OR-"));
-      }
-      if (EB[i] & ERROR_CRC_CS) {
-        // CS or CRC error detected in readpacket
+#ifdef DELTA_PACKETS
+        byte c = deltaLen ? DB[i] : RB[i];
+#else /* DELTA_PACKETS */
+        byte c = RB[i];
+#endif /* DELTA_PACKETS */
+        if (c < 0x10) Serial_print('0');
+        Serial_print(c, HEX);
+        if (EB[i] & ERROR_OR) {
+          // buffer overrun detected (overrun is after, not before, the read byte)
+          Serial_print(F(":OR-"));
+        }
+        if (EB[i] & ERROR_CRC_CS) {
+          // CS or CRC error detected in readpacket
 #ifdef MHI_SERIES
-        Serial_print(F(" CS error"));
+          Serial_print(F(" CS error"));
 #elif defined H_SERIES
-        Serial_print(F(" XOR error"));
+          Serial_print(F(" XOR error"));
 #else /* MHI_SERIES, H_SERIES */
-        Serial_print(F(" CRC error"));
+          Serial_print(F(" CRC error"));
 #endif /* MHI_SERIES, H_SERIES */
+        }
       }
+      Serial_println();
     }
-    Serial_println();
   }
 #ifdef PSEUDO_PACKETS
   if (pseudo0E > 4) {
@@ -2747,10 +3685,21 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
     WB[15] = save_MCUSR;
 #ifdef F_SERIES
     WB[16] = modelSuggestion;
+#else /* F_SERIES */
+    WB[16] = 0;
+#endif /* F_SERIES */
+#ifdef OUTPUT_RING
+    WB[17] = (serialOut.dropped >> 8) & 0xFF;
+    WB[18] = serialOut.dropped & 0xFF;
+    WB[19] = (serialOut.blocked >> 8) & 0xFF;
+    WB[20] = serialOut.blocked & 0xFF;
+    WB[21] = serialOut.peak;
+    writePseudoPacket(WB, 22);
+#elif defined F_SERIES
     writePseudoPacket(WB, 17);
 #else
     writePseudoPacket(WB, 16);
-#endif /* F_SERIES */
+#endif /* OUTPUT_RING */
   }
   if (pseudo0F > 4) {
     pseudo0F = 0;
@@ -2765,11 +3714,11 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
     for (byte i = 7; i < 17; i++) WB[i] = 0x00;
 #endif /* MHI_SERIES || TH_SERIES */
 #ifdef EF_SERIES
-    WB[5]  = writeBudget;
-    WB[6]  = writeBudgetPeriod;
+    WB[5]  = budget[BUDGET_PARAM].tokens;
+    WB[6]  = budget[BUDGET_PARAM].period / 60;
     WB[7]  = writeRefusedBusy;
-    WB[8]  = writeRefusedBudget;
-    WB[9]  = errorsPermitted;
+    WB[8]  = (budget[BUDGET_PARAM].refused < 0xFF) ? budget[BUDGET_PARAM].refused : 0xFF;
+    WB[9]  = budget[BUDGET_ERROR].tokens;
     WB[10] = (parameterWritesDone >> 8) & 0xFF;
     WB[11] = parameterWritesDone & 0xFF;
 #ifdef F_SERIES
@@ -2807,6 +3756,48 @@ For FDYQ-like systems, try using the same commands with packet type 38 replaced
       WB[22] = (uint8_t) (V1_avg * (10 * 3.773 / 1023 / (1 << (16 - ADC_CNT_SHIFT))));
     }
     writePseudoPacket(WB, 23);
+    budgetPage = 1;
+  } else if (budgetPage) {
+    // budget manager state, one class per loop() after each 00000F
+    byte c = budgetPage - 1;
+    WB[0]  = 0x00;
+    WB[1]  = 0x00;
+    WB[2]  = 0x0C;
+    WB[3]  = c;
+    WB[4]  = budget[c].tokens;
+    WB[5]  = budget[c].burst;
+    WB[6]  = budget[c].add;
+    WB[7]  = (budget[c].period >> 8) & 0xFF;
+    WB[8]  = budget[c].period & 0xFF;
+    WB[9]  = (budget[c].used >> 8) & 0xFF;
+    WB[10] = budget[c].used & 0xFF;
+    WB[11] = (budget[c].refused >> 8) & 0xFF;
+    WB[12] = budget[c].refused & 0xFF;
+    writePseudoPacket(WB, 13);
+    if (++budgetPage > BUDGET_CLASSES) budgetPage = 0;
+  }
+#ifdef BUS_STATS
+  if (busStatsPage) {
+    // one pseudo packet per loop() to spread serial output
+    byte j = busStatsPage - 1;
+    WB[0]  = 0x00;
+    WB[1]  = 0x00;
+    WB[2]  = 0x0D;
+    WB[3]  = j;
+    WB[4]  = busStatsUsed;
+    WB[5]  = (busStatsBusy >> 8) & 0xFF;
+    WB[6]  = busStatsBusy & 0xFF;
+    WB[7]  = busStatsKey[j][0];
+    WB[8]  = busStatsKey[j][1];
+    WB[9]  = (busStatsCount[j] >> 8) & 0xFF;
+    WB[10] = busStatsCount[j] & 0xFF;
+    WB[11] = busStatsMinGap[j];
+    WB[12] = busStatsMinReply[j];
+    for (byte b = 0; b < BUS_STATS_BINS; b++) WB[13 + b] = busStatsHist[j][b];
+    writePseudoPacket(WB, 13 + BUS_STATS_BINS);
+    busStatsClear(j);
+    if (++busStatsPage > busStatsUsed) busStatsPage = 0;
   }
+#endif /* BUS_STATS */
 #endif /* PSEUDO_PACKETS */
 }
@@ -0,0 +1,123 @@
+/* Arduino.h: minimal host (Linux) replacement of the Arduino/AVR API used by P1P2Monitor and P1P2MQTT.h
+ *
+ * Part of the host-native build of P1P2Monitor, see README.md in this directory.
+ * AVR registers are declared in avr_io.h, Serial reads from an input queue and writes to stdout.
+ * Integer sizes differ from AVR (int is 32-bit here), so sscanf is wrapped to convert AVR-style formats.
+ */
+
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <stdarg.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef F_CPU
+#define F_CPU 8000000L
+#endif
+
+#define DEC 10
+#define HEX 16
+
+#define LOW  0
+#define HIGH 1
+#define INPUT        0
+#define OUTPUT       1
+#define INPUT_PULLUP 2
+
+#define PB0 0
+#define PB1 1
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PC2 2
+#define PC4 4
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define LED_BUILTIN 13
+
+#define PROGMEM __attribute__((section(".progmem.data"))) // kept apart, for the RAM estimate (make ram)
+#define pgm_read_byte(p) (*(const uint8_t*) (p))
+#define pgm_read_word(p) (*(const uint16_t*) (p))
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+#include "avr_io.h"
+
+inline void cli(void) {}
+inline void sei(void) {}
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+void delay(unsigned long ms);
+
+// AVR int is 16-bit and long is 32-bit: convert %d/%u/%x/%i/%n to %h. and %l. to % . before calling vsscanf
+int host_sscanf(const char* s, const char* format, ...);
+#define sscanf host_sscanf
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    size_t write(const char* s) { size_t n = 0; while (*s) n += write((uint8_t) *s++); return n; }
+    size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+    size_t print(const char* s) { return write(s); }
+    size_t print(char c) { return write((uint8_t) c); }
+    size_t print(unsigned char n, int base = DEC) { return printNumber(n, base); }
+    size_t print(int n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned int n, int base = DEC) { return printNumber(n, base); }
+    size_t print(short n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned short n, int base = DEC) { return printNumber(n, base); }
+    size_t print(long n, int base = DEC) { return printSigned(n, base); }
+    size_t print(unsigned long n, int base = DEC) { return printNumber(n, base); }
+    size_t print(double d, int digits = 2) {
+      char buf[32];
+      snprintf(buf, sizeof(buf), "%.*f", digits, d);
+      return write(buf);
+    }
+    template <typename T> size_t println(T v) { size_t n = print(v); return n + println(); }
+    template <typename T> size_t println(T v, int base) { size_t n = print(v, base); return n + println(); }
+    size_t println(void) { return write("\r\n"); }
+  private:
+    size_t printSigned(long n, int base) {
+      if ((base == DEC) && (n < 0)) return write('-') + printNumber(-n, base);
+      return printNumber((unsigned long) n, base);
+    }
+    size_t printNumber(unsigned long n, int base) {
+      char buf[8 * sizeof(long) + 1];
+      char* p = buf + sizeof(buf) - 1;
+      *p = '\0';
+      do {
+        byte d = n % base;
+        *--p = (d < 10) ? '0' + d : 'A' + d - 10;
+        n /= base;
+      } while (n);
+      return write(p);
+    }
+};
+
+class HardwareSerial : public Print {
+  public:
+    void begin(unsigned long) {}
+    void end(void) {}
+    int available(void);
+    int read(void);
+    int availableForWrite(void) { return 63; }
+    virtual size_t write(uint8_t c);
+    using Print::write;
+    operator bool() { return true; }
+};
+
+extern HardwareSerial Serial;
+
+#endif /* Arduino_h */
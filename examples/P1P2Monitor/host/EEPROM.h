@@ -0,0 +1,26 @@
+/* EEPROM.h: host replacement of the Arduino EEPROM library for the host-native build of P1P2Monitor
+ *
+ * 1 kB of erased (0xFF) EEPROM; optionally loaded from and saved to a file by the replay driver (-e option).
+ */
+
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <stdint.h>
+
+#define E2END 0x3FF
+
+class EEPROMClass {
+  public:
+    EEPROMClass() { for (uint16_t i = 0; i <= E2END; i++) data[i] = 0xFF; }
+    uint8_t read(int idx) { return data[idx & E2END]; }
+    void write(int idx, uint8_t val) { data[idx & E2END] = val; writes++; }
+    void update(int idx, uint8_t val) { if (read(idx) != val) write(idx, val); }
+    uint16_t length(void) { return E2END + 1; }
+    uint8_t data[E2END + 1];
+    uint32_t writes = 0; // number of EEPROM cell writes, to check for EEPROM wear
+};
+
+extern EEPROMClass EEPROM;
+
+#endif /* EEPROM_h */
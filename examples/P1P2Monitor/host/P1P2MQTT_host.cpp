@@ -0,0 +1,172 @@
+/* P1P2MQTT_host.cpp: packet-level host replacement of the P1P2MQTT library for the host-native build of P1P2Monitor
+ *
+ * The bus is a queue of complete packets: packets from the replayed trace are added by host_bus_receive(),
+ * packets written by P1P2Monitor are recorded (host_write_log) and, if echo is on, read back like on a real bus.
+ * Time is virtual: it only advances by host_time_advance() (pause before each packet plus packet transmission time).
+ */
+
+#include "Arduino.h"
+#include "P1P2Config.h"
+#include <P1P2MQTT.h>
+#include "host.h"
+
+// virtual time and bus
+
+static uint32_t host_millis = 0;
+FILE* host_write_log = stderr;
+uint32_t host_packets_written = 0;
+
+void host_init(void)
+{
+  sws_event[SWS_MAX - 1] = SWS_EVENT_LOOP; // no scope events recorded
+}
+
+void host_time_advance(uint32_t ms)
+{
+  host_millis += ms;
+}
+
+uint32_t host_time(void)
+{
+  return host_millis;
+}
+
+#define HOST_BUS_QUEUE 8
+#define HOST_BYTE_TIME_US 1146 // 11 bits at 9600 baud
+
+typedef struct {
+  uint8_t data[RB_SIZE + 1];
+  uint8_t n;
+  uint8_t error;
+  uint16_t delta;
+} host_packet_t;
+
+static host_packet_t host_bus[HOST_BUS_QUEUE];
+static uint8_t host_bus_head = 0;
+static uint8_t host_bus_tail = 0;
+static uint8_t host_echo = 1;
+
+bool host_bus_receive(const uint8_t* data, uint8_t n, uint16_t delta, uint8_t error)
+{
+  uint8_t h = (host_bus_head + 1) % HOST_BUS_QUEUE;
+  if (h == host_bus_tail) return false;
+  host_packet_t &p = host_bus[host_bus_head];
+  if (n > sizeof(p.data)) n = sizeof(p.data);
+  memcpy(p.data, data, n);
+  p.n = n;
+  p.error = error;
+  p.delta = delta;
+  host_bus_head = h;
+  return true;
+}
+
+bool host_bus_pending(void)
+{
+  return host_bus_head != host_bus_tail;
+}
+
+// P1P2MQTT library
+
+volatile uint16_t sws_capture[SWS_MAX];
+volatile uint8_t sws_event[SWS_MAX];
+volatile uint8_t sws_cnt = 0;
+volatile uint8_t sws_overflow = 0;
+volatile byte sws_block = 0;
+volatile byte sw_scope = 0;
+#ifdef SW_SCOPE_STREAM
+volatile uint8_t sws_stream[2][SW_SCOPE_STREAM];
+volatile uint8_t sws_stream_len[2];
+volatile uint8_t sws_stream_full = 0;
+volatile uint8_t sws_stream_fill = 0;
+volatile uint16_t sws_stream_lost = 0;
+#endif /* SW_SCOPE_STREAM */
+#ifdef MEASURE_LOAD
+volatile uint16_t irq_w, irq_r, irq_lapsed_w, irq_lapsed_r;
+volatile uint8_t irq_busy;
+#endif /* MEASURE_LOAD */
+
+void P1P2MQTT::begin(uint32_t baud, bool use_ADC, uint8_t ADC_pin0, uint8_t ADC_pin1, bool ledRW_reverse) {}
+void P1P2MQTT::end() {}
+uint8_t P1P2MQTT::read() { return 0; }
+errorbuf_t P1P2MQTT::read_error() { return SIGNAL_EOP; }
+uint16_t P1P2MQTT::read_delta() { return 0; }
+bool P1P2MQTT::available() { return host_bus_pending(); }
+bool P1P2MQTT::packetavailable() { return host_bus_pending(); }
+void P1P2MQTT::flushInput() { host_bus_tail = host_bus_head; }
+void P1P2MQTT::flushOutput() {}
+bool P1P2MQTT::writeready() { return true; }
+void P1P2MQTT::write(uint8_t b) {}
+void P1P2MQTT::setDelay(uint16_t t) {}
+void P1P2MQTT::setDelayTimeout(uint16_t t) {}
+#ifdef SW_SCOPE
+void P1P2MQTT::setScope(byte b) {}
+#ifdef SW_SCOPE_STREAM
+void P1P2MQTT::scopeStreamFlush() {}
+#endif /* SW_SCOPE_STREAM */
+#endif /* SW_SCOPE */
+void P1P2MQTT::setEcho(uint8_t b) { host_echo = b; }
+void P1P2MQTT::setAllow(uint8_t b) {}
+#ifdef BIT_CALIBRATION
+void P1P2MQTT::calibrate(uint8_t mode) {}
+uint8_t P1P2MQTT::calibrationUpdate(uint16_t &ticksPerBit, uint16_t &nominalTicksPerBit, uint8_t &maxPause, uint8_t &allow) { return 0; }
+#endif /* BIT_CALIBRATION */
+void P1P2MQTT::setErrorMask(uint8_t b) {}
+#ifdef MHI_SERIES
+void P1P2MQTT::setMHI(uint8_t b) {}
+#endif /* MHI_SERIES */
+
+uint16_t P1P2MQTT::readpacket(uint8_t* readbuf, uint16_t &delta, errorbuf_t* errorbuf, uint8_t maxlen, uint8_t checksum)
+// returns next packet from the bus queue; trace packets are assumed to carry a valid CRC/checksum already
+{
+  if (!host_bus_pending()) return 0;
+  host_packet_t &p = host_bus[host_bus_tail];
+  host_bus_tail = (host_bus_tail + 1) % HOST_BUS_QUEUE;
+  for (uint8_t i = 0; (i < p.n) && (i < maxlen); i++) {
+    readbuf[i] = p.data[i];
+    if (errorbuf) errorbuf[i] = i ? 0 : p.error;
+  }
+  delta = p.delta;
+  return p.n;
+}
+
+void P1P2MQTT::writepacket(uint8_t* writebuf, uint8_t l, uint16_t t, uint8_t checksum)
+// records the written packet (with CRC/checksum as added by the library), and reads it back if echo is on
+{
+  uint8_t wb[RB_SIZE + 1];
+  uint8_t n = 0;
+  for (uint8_t i = 0; (i < l) && (n < RB_SIZE); i++) wb[n++] = writebuf[i];
+  if (P1P2Checksum::enabled && checksum && !P1P2Checksum::bare(writebuf, l)) wb[n++] = P1P2ChecksumOf<P1P2Checksum>(writebuf, l);
+  host_packets_written++;
+  if (host_write_log) {
+    fprintf(host_write_log, "W %10.3f +%3u:", host_millis / 1000.0, t);
+    for (uint8_t i = 0; i < n; i++) fprintf(host_write_log, " %02X", wb[i]);
+    fprintf(host_write_log, "\n");
+  }
+  if (host_echo) host_bus_receive(wb, n, t, 0);
+}
+
+int32_t P1P2MQTT::uptime_sec(void)
+{
+  return host_millis / 1000;
+}
+
+int32_t P1P2MQTT::uptime_millisec(void)
+{
+  return host_millis;
+}
+
+void P1P2MQTT::ADC_results(uint16_t &V0_min, uint16_t &V0_max, uint32_t &V0_avg, uint16_t &V1_min, uint16_t &V1_max, uint32_t &V1_avg)
+{
+  V0_min = V0_max = V1_min = V1_max = 0;
+  V0_avg = V1_avg = 0;
+}
+
+#ifdef SIGNAL_QUALITY
+bool P1P2MQTT::signalQuality(uint8_t slot, uint8_t &src, sq_stat_t &low, sq_stat_t &high) { return false; }
+void P1P2MQTT::signalQualityIdle(sq_stat_t &idle) { memset(&idle, 0, sizeof(idle)); }
+void P1P2MQTT::signalQualityHistogram(uint8_t sqClass, uint16_t* hist) { memset(hist, 0, SQ_HIST_BINS * sizeof(uint16_t)); }
+void P1P2MQTT::signalQualityReset(void) {}
+#endif /* SIGNAL_QUALITY */
+
+void P1P2MQTT::ledPower(bool ledOn) {}
+void P1P2MQTT::ledError(bool ledOn) {}
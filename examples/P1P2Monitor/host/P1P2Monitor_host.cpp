@@ -0,0 +1,161 @@
+/* P1P2Monitor_host.cpp: replay driver for the host-native build of P1P2Monitor
+ *
+ * Usage: P1P2Monitor_host [-q] [-w writelog] [-e eeprom.bin] [trace]
+ *
+ * Reads a trace (file or stdin) and feeds it to setup()/loop() of P1P2Monitor.ino:
+ *   "R T 0.105: 000010..."  packet received with 0.105s pause before it (P1P2Monitor R-line format)
+ *   "000010..."             packet received with default pause (TRACE_DEFAULT_DELTA ms)
+ *   "E T 0.105: 000010..."  packet received with (CRC) error flag
+ *   "> L1"                  serial input line (command) to P1P2Monitor (SERIAL_MAGICSTRING is added if defined)
+ * other lines are ignored (so P1P2Monitor serial output can be replayed directly).
+ *
+ * P1P2Monitor serial output goes to stdout (or is discarded with -q), written packets to stderr or the -w file.
+ * At the end, the number of packets, loop() calls, loop time per packet, bus writes, serial output bytes
+ * and EEPROM writes are reported on stderr.
+ */
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "P1P2Config.h"
+#include "host.h"
+#include <time.h>
+#include <ctype.h>
+
+#define TRACE_LINE 1024
+#define TRACE_DEFAULT_DELTA 50     // ms
+#define TRACE_LOOP_MAX 200         // max loop() calls to process one trace line
+#define TRACE_COMMAND_LOOPS 10     // loop() calls after a serial command
+
+static uint32_t loopCalls = 0;
+static uint64_t loopNanos = 0;
+
+static uint64_t nanos(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void runLoop(uint16_t minCalls)
+// calls loop() at least minCalls times and until bus and serial input are processed
+{
+  for (uint16_t i = 0; i < TRACE_LOOP_MAX; i++) {
+    if ((i >= minCalls) && !host_bus_pending() && !host_serial_pending()) break;
+    uint64_t t = nanos();
+    loop();
+    loopNanos += nanos() - t;
+    loopCalls++;
+  }
+}
+
+static uint8_t parseHex(const char* s, uint8_t* data, uint8_t maxlen)
+{
+  uint8_t n = 0;
+  while (n < maxlen) {
+    while (*s == ' ') s++;
+    if (!isxdigit(s[0]) || !isxdigit(s[1])) break;
+    char hex[3] = { s[0], s[1], '\0' };
+    data[n++] = strtoul(hex, NULL, 16);
+    s += 2;
+  }
+  return n;
+}
+
+static bool eepromLoad(const char* fn)
+{
+  FILE* f = fopen(fn, "rb");
+  if (!f) return false;
+  size_t n = fread(EEPROM.data, 1, sizeof(EEPROM.data), f);
+  fclose(f);
+  return n == sizeof(EEPROM.data);
+}
+
+static bool eepromSave(const char* fn)
+{
+  FILE* f = fopen(fn, "wb");
+  if (!f) return false;
+  size_t n = fwrite(EEPROM.data, 1, sizeof(EEPROM.data), f);
+  fclose(f);
+  return n == sizeof(EEPROM.data);
+}
+
+int main(int argc, char** argv)
+{
+  const char* eepromFile = NULL;
+  FILE* trace = stdin;
+  int i;
+  for (i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-q")) {
+      host_serial_out = NULL;
+    } else if (!strcmp(argv[i], "-w") && (i + 1 < argc)) {
+      host_write_log = fopen(argv[++i], "w");
+      if (!host_write_log) {
+        perror(argv[i]);
+        return 1;
+      }
+    } else if (!strcmp(argv[i], "-e") && (i + 1 < argc)) {
+      eepromFile = argv[++i];
+    } else if (argv[i][0] == '-') {
+      fprintf(stderr, "Usage: %s [-q] [-w writelog] [-e eeprom.bin] [trace]\n", argv[0]);
+      return 1;
+    } else {
+      trace = fopen(argv[i], "r");
+      if (!trace) {
+        perror(argv[i]);
+        return 1;
+      }
+    }
+  }
+  if (eepromFile) eepromLoad(eepromFile);
+
+  host_init();
+  host_serial_input("\n"); // P1P2Monitor ignores the first serial line
+  setup();
+  runLoop(1);
+
+  char line[TRACE_LINE];
+  uint32_t packets = 0;
+  uint32_t writesBefore = host_packets_written;
+  while (fgets(line, sizeof(line), trace)) {
+    line[strcspn(line, "\r\n")] = '\0';
+    if (line[0] == '>') {
+      const char* cmd = line + 1;
+      while (*cmd == ' ') cmd++;
+#ifdef SERIAL_MAGICSTRING
+      host_serial_input(SERIAL_MAGICSTRING);
+#endif /* SERIAL_MAGICSTRING */
+      host_serial_input(cmd);
+      host_serial_input("\n");
+      runLoop(TRACE_COMMAND_LOOPS);
+      continue;
+    }
+    uint8_t error = 0;
+    uint16_t delta = TRACE_DEFAULT_DELTA;
+    const char* hex = line;
+    if (((line[0] == 'R') || (line[0] == 'E')) && (line[1] == ' ')) {
+      const char* colon = strchr(line, ':');
+      if (!colon) continue;
+      double d;
+      if (sscanf(line + 2, "T %lf", &d) == 1) delta = (d < 65.535) ? (uint16_t) (d * 1000 + 0.5) : 0xFFFF;
+      error = (line[0] == 'E');
+      hex = colon + 1;
+    }
+    uint8_t data[255];
+    uint8_t n = parseHex(hex, data, sizeof(data));
+    if (!n) continue;
+    // wait for the pause, receive the packet, then let P1P2Monitor process it (and possibly write a reply)
+    host_time_advance(delta + (n * 1146UL) / 1000);
+    host_bus_receive(data, n, delta, error);
+    packets++;
+    runLoop(1);
+  }
+  runLoop(TRACE_COMMAND_LOOPS);
+
+  if (eepromFile) eepromSave(eepromFile);
+  fprintf(stderr, "* packets %u, loop calls %u, %.0f ns/packet, %.0f ns/loop, bus writes %u, serial output %u bytes, EEPROM writes %u\n",
+          packets, loopCalls,
+          packets ? (double) loopNanos / packets : 0.0,
+          loopCalls ? (double) loopNanos / loopCalls : 0.0,
+          host_packets_written - writesBefore, host_serial_bytes, EEPROM.writes);
+  return 0;
+}
@@ -0,0 +1,486 @@
+/* P1P2Monitor_sim.cpp: bus simulator driver for P1P2Monitor with the real P1P2MQTT library (E and F series)
+ *
+ * Usage: P1P2Monitor_sim [options]
+ *   -d seconds      simulated time (default 60)
+ *   -s seed         random seed (default 1)
+ *   -m ms           main controller pause after a reply before its next request (default 40)
+ *   -r ms           heat pump reply delay (default 25)
+ *   -a ms           main controller timeout for a missing aux controller reply (default 140)
+ *   -p ms           main controller pause after each cycle (default 200)
+ *   -f Fx[,Fx..]    aux controller addresses polled by the main controller (default F0,F1)
+ *   -x Fx:ms[:s]    external aux controller replying on address Fx after ms, from time s on (may be repeated)
+ *   -j ms           random jitter (+/-) of heat pump and external aux controller reply delays (default 2)
+ *   -b ppm          bit rate deviation of the other devices (default 0)
+ *   -c s:cmd        serial command to P1P2Monitor at time s (may be repeated, default 10:L1)
+ *   -e file         payload templates (and E_SERIES parameter/counter values) for main controller and heat pump from a recorded trace
+ *   -k s            E_SERIES clock of the main controller at start, in seconds since Monday 00:00 (default 0)
+ *   -l us           loop() period of P1P2Monitor (default 100)
+ *   -i cycles       interrupt latency (default 50)
+ *   -t file         write all bus packets as seen by the reference receiver (replay format of P1P2Monitor_host)
+ *   -v              show P1P2Monitor serial output
+ *
+ * The main controller (device 1) and heat pump (device 2) are modelled by emul.cpp: the main controller polls the heat pump
+ * with 00001x requests and the aux controllers with 00Fx30 and 00Fx3y requests, the heat pump answers any error-free 0000xx
+ * request (including 0000B8 counter requests from P1P2Monitor). A request from another device makes the main controller wait
+ * for the heat pump reply before it continues. P1P2Monitor (device 0) becomes aux controller on F0 after the L1 command.
+ * At the end, bus statistics, aux controller slot use and reply latency, counter requests, latency of parameter writes
+ * (E commands) to the bus and to their confirmation by the main controller, and P1P2Monitor read-back errors are reported.
+ */
+
+#include "Arduino.h"
+#include "P1P2Config.h"
+#include "host.h"
+#include <P1P2Checksum.h>
+#include "sim.h"
+#include "emul.h"
+#include <ctype.h>
+#include <unistd.h>
+
+#if !defined E_SERIES && !defined F_SERIES
+#error The bus simulator supports E_SERIES and F_SERIES only
+#endif /* E_SERIES, F_SERIES */
+
+#define DEV_MAIN 1
+#define DEV_HP   2
+#define DEV_AUX  3              // first external aux controller
+#define AUX_MAX  (SIM_DEVICES - DEV_AUX)
+
+#define TIMER_MAIN 0
+#define TIMER_HP   1
+#define TIMER_AUX  2            // first external aux controller timer
+
+#define PAUSE_BITS 0            // pause between bytes within a packet (bits)
+#define COMMANDS_MAX 16
+#define FX_MAX EMUL_FX_MAX
+#define WRITES_MAX 16
+
+static uint32_t duration = 60;   // s
+static uint16_t mainGap = 40;    // ms
+static uint16_t hpDelay = 25;    // ms
+static uint16_t auxTimeout = 140; // ms
+static uint16_t cyclePause = 200; // ms
+static uint16_t jitter = 2;      // ms
+static double bitCycles = SIM_BIT;
+static FILE* traceFile = NULL;
+
+static uint8_t fx[FX_MAX] = { 0xF0, 0xF1 };
+static uint8_t fxN = 2;
+
+static bool mainWaiting = false; // waiting for reply
+static bool mainPause = false;   // pause at end of cycle
+
+// external aux controllers
+static uint8_t auxAddr[AUX_MAX];
+static uint16_t auxDelay[AUX_MAX];
+static sim_time_t auxStart[AUX_MAX];
+static uint8_t auxN = 0;
+static uint8_t auxPending[AUX_MAX][3];
+static uint8_t auxPendingLen[AUX_MAX];
+
+static uint8_t hpPending[EMUL_PACKET_MAX];
+static uint8_t hpPendingLen = 0;
+
+// statistics
+typedef struct {
+  uint32_t n;
+  double sum, min, max;          // ms
+} latency_t;
+
+typedef struct {
+  uint32_t polls, replies, collisions;
+  uint32_t misplaced;            // P1P2Monitor packet in this slot not matching the poll (late reply to an earlier poll)
+  latency_t latency;             // from end of poll to start of reply
+} slot_stat_t;
+
+static uint32_t packets = 0, errorPackets = 0, collisionPackets = 0, dutPackets = 0;
+static sim_time_t busyCycles = 0;
+static sim_time_t lastEnd = 0;
+static slot_stat_t slotStat[FX_MAX][2];  // per polled address, for 00Fx30 and 00Fx3y polls
+static slot_stat_t* pollStat = NULL;     // slot of the last 00Fx3x poll
+static sim_time_t pollEnd;
+static uint8_t pollHeader[3];
+static uint32_t dutLines = 0, dutSB = 0, dutBE = 0, dutBC = 0, dutPE = 0, dutCRC = 0;
+static uint32_t counterRequests = 0, counterCollisions = 0;
+
+// parameter writes (E commands) waiting for their write on the bus and confirmation by the main controller
+typedef struct {
+  uint8_t pt;
+  uint16_t nr;
+  uint32_t val;
+  uint32_t ms;                   // time of the E command
+  bool written;
+} write_t;
+
+static write_t writes[WRITES_MAX];
+static uint8_t writesN = 0;
+static uint32_t writeCommands = 0, writesWritten = 0, writesConfirmed = 0;
+static latency_t writeLatency, confirmLatency;
+
+static uint32_t simMillis(sim_time_t t)
+{
+  return t / SIM_MS;
+}
+
+static sim_time_t msJitter(uint16_t ms)
+{
+  int32_t j = jitter ? (int32_t) (sim_random() % (2 * jitter * 1000 + 1)) - jitter * 1000 : 0; // us
+  return (sim_time_t) ((int32_t) ms * 1000 + j) * (F_CPU / 1000000);
+}
+
+static void sendPacket(uint8_t dev, const uint8_t* header, uint8_t payload, sim_time_t t)
+// external aux controller reply: header and zero payload
+{
+  uint8_t data[SIM_PACKET_MAX];
+  uint8_t n = 0;
+  data[n++] = header[0];
+  data[n++] = header[1];
+  data[n++] = header[2];
+  for (uint8_t i = 0; (i < payload) && (n < SIM_PACKET_MAX - 1); i++) data[n++] = (i == 4) && (header[2] == 0x31) ? 0xB4 : 0x00;
+  data[n] = P1P2ChecksumOf<P1P2Checksum>(data, n);
+  n++;
+  sim_send(dev, data, n, t, bitCycles, PAUSE_BITS);
+}
+
+static void mainNext(void)
+// main controller sends its next request (or pauses at the end of a cycle)
+{
+  uint8_t pkt[EMUL_PACKET_MAX];
+  uint8_t n = emul_request(pkt, simMillis(sim_now));
+  if (!n) {
+    mainPause = true;
+    sim_timer(TIMER_MAIN, sim_now + cyclePause * SIM_MS);
+    return;
+  }
+  mainPause = false;
+  mainWaiting = true;
+  sim_send(DEV_MAIN, pkt, n, sim_now, bitCycles, PAUSE_BITS);
+}
+
+static void timerFired(uint8_t timer)
+{
+  if (timer == TIMER_MAIN) {
+    mainNext();
+  } else if (timer == TIMER_HP) {
+    sim_send(DEV_HP, hpPending, hpPendingLen, sim_now, bitCycles, PAUSE_BITS);
+  } else {
+    uint8_t a = timer - TIMER_AUX;
+    sendPacket(DEV_AUX + a, auxPending[a], auxPendingLen[a], sim_now);
+  }
+}
+
+static void latencyAdd(latency_t &l, double latency)
+{
+  if (!l.n || (latency < l.min)) l.min = latency;
+  if (!l.n || (latency > l.max)) l.max = latency;
+  l.sum += latency;
+  l.n++;
+}
+
+static void latencyReport(const char* name, const latency_t &l)
+{
+  if (l.n) fprintf(stderr, ", %s min/avg/max %.1f/%.1f/%.1f ms", name, l.min, l.sum / l.n, l.max);
+}
+
+static void paramWritten(uint8_t pt, uint16_t nr, uint32_t val, uint32_t ms)
+{
+  for (uint8_t i = 0; i < writesN; i++) {
+    if (writes[i].written || (writes[i].pt != pt) || (writes[i].nr != nr) || (writes[i].val != val)) continue;
+    writes[i].written = true;
+    writesWritten++;
+    latencyAdd(writeLatency, ms - writes[i].ms);
+    return;
+  }
+}
+
+static void paramConfirmed(uint8_t pt, uint16_t nr, uint32_t val, uint32_t ms)
+{
+  for (uint8_t i = 0; i < writesN; i++) {
+    if (!writes[i].written || (writes[i].pt != pt) || (writes[i].nr != nr) || (writes[i].val != val)) continue;
+    writesConfirmed++;
+    latencyAdd(confirmLatency, ms - writes[i].ms);
+    writes[i] = writes[--writesN];
+    return;
+  }
+}
+
+static uint32_t hexField(const char* &s, uint8_t digits)
+{
+  uint32_t v = 0;
+  while (*s == ' ') s++;
+  for (uint8_t i = 0; (i < digits) && isxdigit(*s); i++, s++) v = (v << 4) | (isdigit(*s) ? *s - '0' : (*s | 0x20) - 'a' + 10);
+  return v;
+}
+
+static void commandSent(const char* cmd, uint32_t ms)
+// records parameter write commands ("E35 0031 01", or traced "@07 E35 0031 01") for the write and confirmation latency
+{
+  if (cmd[0] == '@') {
+    // skip trace tag, P1P2Monitor reports the traced command as pseudo packet 00000A
+    cmd++;
+    while (isxdigit(*cmd)) cmd++;
+    while (*cmd == ' ') cmd++;
+  }
+  if (((cmd[0] != 'E') && (cmd[0] != 'e')) || (writesN == WRITES_MAX)) return;
+  const char* s = cmd + 1;
+  write_t &w = writes[writesN];
+  w.pt = hexField(s, 2);
+  w.nr = hexField(s, 4);
+  w.val = hexField(s, 8);
+  w.ms = ms;
+  w.written = false;
+  writesN++;
+  writeCommands++;
+}
+
+static void packetStart(sim_time_t t)
+{
+  // any bus activity means the main controller is no longer waiting for the reply timeout
+  if (mainWaiting && (t > lastEnd)) sim_timer(TIMER_MAIN, SIM_NEVER);
+}
+
+static void packetEnd(const sim_packet_t &p)
+{
+  packets++;
+  busyCycles += p.end - p.start;
+  uint8_t drivers = p.drivers;
+  uint8_t ndrivers = 0;
+  while (drivers) {
+    ndrivers += drivers & 1;
+    drivers >>= 1;
+  }
+  if (p.errors) errorPackets++;
+  if (ndrivers > 1) collisionPackets++;
+  if (p.drivers & (1 << SIM_DUT)) dutPackets++;
+  if (traceFile) {
+    double delta = (p.start - lastEnd) / (double) F_CPU;
+    fprintf(traceFile, "%c T %6.3f:", p.errors ? 'E' : 'R', (delta < 65.535) ? delta : 65.535);
+    for (uint8_t i = 0; i < p.n; i++) fprintf(traceFile, " %02X", p.data[i]);
+    fprintf(traceFile, "\n");
+  }
+  lastEnd = p.end;
+
+  bool request = (p.n >= 3) && (p.data[0] == 0x00);
+  bool counterRequest = (p.drivers & (1 << SIM_DUT)) && request && (p.data[1] == 0x00) && (p.data[2] == 0xB8);
+  if (counterRequest) {
+    counterRequests++;
+    if (ndrivers > 1) counterCollisions++;
+  }
+
+  // reply statistics of P1P2Monitor for the last 00Fx3x poll (a counter request in the slot is not a reply)
+  if (pollStat) {
+    if ((p.drivers & (1 << SIM_DUT)) && !counterRequest) {
+      if (ndrivers > 1) pollStat->collisions++;
+      if ((p.n < 3) || (p.data[1] != pollHeader[1]) || (p.data[2] != pollHeader[2])) {
+        pollStat->misplaced++;
+      } else {
+        pollStat->replies++;
+        latencyAdd(pollStat->latency, (p.start - pollEnd) / (double) SIM_MS);
+      }
+    }
+    pollStat = NULL;
+  }
+
+  if (!p.errors) {
+    emul_receive(p.data, p.n, simMillis(p.end));
+    if (request && (p.data[1] == 0x00)) {
+      hpPendingLen = emul_reply(p.data, p.n, hpPending, simMillis(p.end));
+      if (hpPendingLen) sim_timer(TIMER_HP, p.end + msJitter(hpDelay));
+    }
+  }
+
+  if (p.drivers == (1 << DEV_MAIN)) {
+    // request from main controller: schedule aux controller replies and reply timeout
+    if (p.n < 3) return;
+    if (p.data[1] != 0x00) {
+      for (uint8_t a = 0; a < auxN; a++) {
+        if ((auxAddr[a] != p.data[1]) || (p.end < auxStart[a])) continue;
+        auxPending[a][0] = 0x40;
+        auxPending[a][1] = p.data[1];
+        auxPending[a][2] = p.data[2];
+        auxPendingLen[a] = p.n - 4;
+        sim_timer(TIMER_AUX + a, p.end + msJitter(auxDelay[a]));
+      }
+      for (uint8_t f = 0; f < fxN; f++) {
+        if (fx[f] != p.data[1]) continue;
+        pollStat = &slotStat[f][p.data[2] != 0x30];
+        pollStat->polls++;
+        pollEnd = p.end;
+        memcpy(pollHeader, p.data, 3);
+      }
+    }
+    sim_timer(TIMER_MAIN, p.end + auxTimeout * SIM_MS);
+  } else if (request && (p.data[1] == 0x00) && !p.errors && !mainPause) {
+    // request to the heat pump from another device: main controller waits for the heat pump reply
+    mainWaiting = true;
+    sim_timer(TIMER_MAIN, p.end + auxTimeout * SIM_MS);
+  } else if (mainWaiting) {
+    // reply (or collision): main controller continues after its pause
+    mainWaiting = false;
+    sim_timer(TIMER_MAIN, p.end + mainGap * SIM_MS);
+  }
+}
+
+static void serialLine(const char* line)
+// counts P1P2Monitor's read-back error markers in its R/E packet output lines
+{
+  if (((line[0] != 'R') && (line[0] != 'E')) || (line[1] != ' ') || (line[2] != 'T')) return;
+  dutLines++;
+  if (strstr(line, "-SB:")) dutSB++;
+  if (strstr(line, "-XX:")) dutBE++;
+  if (strstr(line, "-BC:")) dutBC++;
+  if (strstr(line, "-PE:")) dutPE++;
+  if (strstr(line, " CRC error")) dutCRC++;
+}
+
+static void slotReport(uint8_t addr, const char* type, const slot_stat_t &s)
+{
+  fprintf(stderr, "*   00%02X%s polls %u, replies %u (%.1f%%), collisions %u, misplaced %u", addr, type, s.polls, s.replies,
+          s.polls ? 100.0 * s.replies / s.polls : 0.0, s.collisions, s.misplaced);
+  latencyReport("latency", s.latency);
+  fprintf(stderr, "\n");
+}
+
+static void usage(const char* name)
+{
+  fprintf(stderr, "Usage: %s [-d s] [-s seed] [-m ms] [-r ms] [-a ms] [-p ms] [-f Fx[,Fx..]] [-x Fx:ms[:s]] [-j ms] [-b ppm] [-c s:cmd] [-e file] [-k s] [-l us] [-i cycles] [-t file] [-v]\n", name);
+}
+
+int main(int argc, char** argv)
+{
+  double commandTime[COMMANDS_MAX];
+  const char* command[COMMANDS_MAX];
+  uint8_t commands = 0;
+  bool verbose = false;
+  emul_init();
+  for (int i = 1; i < argc; i++) {
+    const char* arg = (i + 1 < argc) ? argv[i + 1] : NULL;
+    if (!strcmp(argv[i], "-v")) {
+      verbose = true;
+      continue;
+    }
+    if ((argv[i][0] != '-') || !arg) {
+      usage(argv[0]);
+      return 1;
+    }
+    i++;
+    switch (argv[i - 1][1]) {
+      case 'd' : duration = atoi(arg); break;
+      case 's' : sim_seed(strtoul(arg, NULL, 0)); break;
+      case 'm' : mainGap = atoi(arg); break;
+      case 'r' : hpDelay = atoi(arg); break;
+      case 'a' : auxTimeout = atoi(arg); break;
+      case 'p' : cyclePause = atoi(arg); break;
+      case 'j' : jitter = atoi(arg); break;
+      case 'b' : bitCycles = SIM_BIT * (1.0 - atof(arg) / 1e6); break;
+      case 'k' : emul_clock(strtoul(arg, NULL, 0)); break;
+      case 'l' : sim_config.loopPeriod = atoi(arg) * (F_CPU / 1000000); break;
+      case 'i' : sim_config.isrLatency = atoi(arg); break;
+      case 'f' : fxN = 0;
+                 for (const char* s = arg; *s && (fxN < FX_MAX); s++) {
+                   fx[fxN++] = strtoul(s, (char**) &s, 16);
+                   if (!*s) break;
+                 }
+                 break;
+      case 'x' : {
+                   char* colon;
+                   auxAddr[auxN] = strtoul(arg, &colon, 16);
+                   if ((*colon != ':') || (auxN == AUX_MAX)) {
+                     usage(argv[0]);
+                     return 1;
+                   }
+                   auxDelay[auxN] = strtoul(colon + 1, &colon, 10);
+                   auxStart[auxN++] = (*colon == ':') ? (sim_time_t) (atof(colon + 1) * 1000) * SIM_MS : 0;
+                   break;
+                 }
+      case 'c' : {
+                   const char* colon = strchr(arg, ':');
+                   if (!colon || (commands == COMMANDS_MAX)) {
+                     usage(argv[0]);
+                     return 1;
+                   }
+                   commandTime[commands] = atof(arg);
+                   command[commands++] = colon + 1;
+                   break;
+                 }
+      case 'e' : {
+                   FILE* f = fopen(arg, "r");
+                   if (!f || !emul_load(f)) {
+                     perror(arg);
+                     return 1;
+                   }
+                   fclose(f);
+                   break;
+                 }
+      case 't' : traceFile = fopen(arg, "w");
+                 if (!traceFile) {
+                   perror(arg);
+                   return 1;
+                 }
+                 break;
+      default  : usage(argv[0]);
+                 return 1;
+    }
+  }
+  if (!commands) {
+    commandTime[commands] = 10;
+    command[commands++] = "L1";
+  }
+  if (!verbose) host_serial_out = NULL;
+  host_serial_line = serialLine;
+  sim_packet_start = packetStart;
+  sim_packet_end = packetEnd;
+  sim_timer_fired = timerFired;
+  emul_fx(fx, fxN);
+  emul_write = paramWritten;
+  emul_confirm = paramConfirmed;
+
+  sim_init();
+  host_serial_input("\n"); // P1P2Monitor ignores the first serial line
+  setup();
+  sim_loop_enable(true);
+  mainPause = true;
+  sim_timer(TIMER_MAIN, sim_now + cyclePause * SIM_MS);
+
+  sim_time_t start = sim_now;
+  sim_time_t end = start + duration * 1000 * SIM_MS;
+  for (uint8_t c = 0; c <= commands; c++) {
+    // commands in order of time
+    uint8_t next = commands;
+    for (uint8_t k = 0; k < commands; k++) if (command[k] && ((next == commands) || (commandTime[k] < commandTime[next]))) next = k;
+    sim_time_t t = (next < commands) ? start + (sim_time_t) (commandTime[next] * 1000) * SIM_MS : end;
+    if (t > end) t = end;
+    sim_run_until(t);
+    if (next == commands) break;
+#ifdef SERIAL_MAGICSTRING
+    host_serial_input(SERIAL_MAGICSTRING);
+#endif /* SERIAL_MAGICSTRING */
+    host_serial_input(command[next]);
+    host_serial_input("\n");
+    commandSent(command[next], simMillis(sim_now));
+    command[next] = NULL;
+  }
+  sim_run_until(end);
+  if (traceFile) fclose(traceFile);
+
+  fprintf(stderr, "* F030DELAY %u ms, F03XDELAY %u ms, %u s simulated, main controller timeout %u ms, heat pump delay %u ms, %u templates\n",
+          F030DELAY, F03XDELAY, duration, auxTimeout, hpDelay, emul_templates);
+  fprintf(stderr, "* bus packets %u, with errors %u, collisions %u, bus utilisation %.1f%%\n",
+          packets, errorPackets, collisionPackets, 100.0 * busyCycles / (end - start));
+  fprintf(stderr, "* P1P2Monitor packets written %u, aux controller replies:\n", dutPackets);
+  for (uint8_t f = 0; f < fxN; f++) {
+    slotReport(fx[f], "30", slotStat[f][0]);
+    slotReport(fx[f], "3y", slotStat[f][1]);
+  }
+  fprintf(stderr, "* P1P2Monitor counter requests %u (collisions %u), heat pump counter replies %u\n",
+          counterRequests, counterCollisions, emul_counter_replies);
+  fprintf(stderr, "* parameter write commands %u, written %u, confirmed %u (main controller: writes %u, confirmations %u)",
+          writeCommands, writesWritten, writesConfirmed, emul_param_writes, emul_param_confirms);
+  latencyReport("command-to-write", writeLatency);
+  latencyReport("command-to-confirmation", confirmLatency);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "* P1P2Monitor packets read %u, -SB: %u, -XX: %u, -BC: %u, -PE: %u, CRC error %u\n",
+          dutLines, dutSB, dutBE, dutBC, dutPE, dutCRC);
+  // the destructor of the library object waits for a packet write in progress, which never ends once the simulation stopped
+  fflush(stdout);
+  _exit(0);
+}
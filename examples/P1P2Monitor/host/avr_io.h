@@ -0,0 +1,92 @@
+/* avr_io.h: host replacement of the ATmega328P registers and interrupt vectors used by P1P2Monitor and P1P2MQTT
+ *
+ * Registers are objects with optional read/write hooks: without hooks they behave as plain memory (host build with stubbed library),
+ * the bus simulator installs hooks to model timers, input capture, output compare, ADC and the bus input pin (see sim.cpp).
+ * Interrupt service routines become plain functions which the simulator calls when a flag is set and the interrupt is enabled.
+ */
+
+#ifndef avr_io_h
+#define avr_io_h
+
+#include <stdint.h>
+
+class avr_reg8 {
+  public:
+    avr_reg8(uint8_t v = 0) : val(v) {}
+    operator uint8_t() const { return read ? read() : val; }
+    avr_reg8& operator=(uint8_t v) { if (write) write(v); else val = v; return *this; }
+    avr_reg8& operator|=(uint8_t v) { return *this = (uint8_t) (*this | v); } // read-modify-write, as on AVR (clears all set flags in TIFRx)
+    avr_reg8& operator&=(uint8_t v) { return *this = (uint8_t) (*this & v); }
+    uint8_t val;
+    uint8_t (*read)(void) = 0;
+    void (*write)(uint8_t v) = 0;
+};
+
+class avr_reg16 {
+  public:
+    avr_reg16(uint16_t v = 0) : val(v) {}
+    operator uint16_t() const { return read ? read() : val; }
+    avr_reg16& operator=(uint16_t v) { if (write) write(v); else val = v; return *this; }
+    uint16_t val;
+    uint16_t (*read)(void) = 0;
+    void (*write)(uint16_t v) = 0;
+};
+
+// general
+extern avr_reg8 MCUSR, SREG, GTCCR;
+extern avr_reg8 PINB, PORTB, PORTC, PORTD;
+// timer0 (seconds timer), timer2 (milliseconds timer)
+extern avr_reg8 TCCR0A, TCCR0B, TCNT0, OCR0A, TIFR0, TIMSK0;
+extern avr_reg8 TCCR2A, TCCR2B, TCNT2, OCR2A, TIFR2, TIMSK2;
+// timer1 (bit timing, input capture, output compare)
+extern avr_reg8 TCCR1A, TCCR1B, TCCR1C, TIFR1, TIMSK1;
+extern avr_reg16 TCNT1, OCR1A, OCR1B, ICR1;
+// ADC
+extern avr_reg8 ADMUX, ADCSRA, ADCSRB, ADCL, ADCH, DIDR0;
+
+#define PORF   0
+#define EXTRF  1
+#define BORF   2
+
+#define CS10   0
+#define ICES1  6
+#define ICNC1  7
+#define COM1A0 6
+#define COM1A1 7
+#define FOC1A  7
+#define TOV1   0
+#define OCF1A  1
+#define OCF1B  2
+#define ICF1   5
+#define TOIE1  0
+#define OCIE1A 1
+#define OCIE1B 2
+#define ICIE1  5
+#define OCF0A  1
+#define OCIE0A 1
+#define OCF2A  1
+#define OCIE2A 1
+#define ADEN   7
+#define ADSC   6
+#define ADIF   4
+#define ADIE   3
+
+#define ISR(vect) void vect(void)
+
+#define TIMER2_COMPA_vect host_isr_timer2_compa
+#define TIMER1_CAPT_vect  host_isr_timer1_capt
+#define TIMER1_COMPA_vect host_isr_timer1_compa
+#define TIMER1_COMPB_vect host_isr_timer1_compb
+#define TIMER1_OVF_vect   host_isr_timer1_ovf
+#define TIMER0_COMPA_vect host_isr_timer0_compa
+#define ADC_vect          host_isr_adc
+
+ISR(TIMER2_COMPA_vect);
+ISR(TIMER1_CAPT_vect);
+ISR(TIMER1_COMPA_vect);
+ISR(TIMER1_COMPB_vect);
+ISR(TIMER1_OVF_vect);
+ISR(TIMER0_COMPA_vect);
+ISR(ADC_vect);
+
+#endif /* avr_io_h */
@@ -0,0 +1,360 @@
+/* emul.cpp: rule-based model of a Daikin main controller and heat pump, see emul.h */
+
+#include "P1P2Config.h"
+#include <P1P2Checksum.h>
+#include "emul.h"
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#define EMUL_TEMPLATES 64
+#define EMUL_LINE 1024
+
+void (*emul_confirm)(uint8_t pt, uint16_t nr, uint32_t val, uint32_t ms) = NULL;
+void (*emul_write)(uint8_t pt, uint16_t nr, uint32_t val, uint32_t ms) = NULL;
+uint32_t emul_param_writes = 0, emul_param_confirms = 0, emul_counter_replies = 0, emul_templates = 0;
+
+// default request cycle and payload lengths (without CRC), used for packets without template
+static const uint8_t hpTypes[] = { 0x10, 0x11, 0x12, 0x13, 0x14, 0x15 };
+static const uint8_t hpRequestLen[] = { 20, 8, 15, 3, 15, 3 };
+static const uint8_t hpReplyLen[] = { 20, 19, 19, 16, 19, 6 };
+static const uint8_t auxTypes[] = { 0x31, 0x32, 0x35, 0x36, 0x37, 0x39, 0x3A, 0x3B, 0x3C, 0x3D };
+static const uint8_t auxLen[] = { 11, 15, 17, 19, 19, 17, 17, 19, 19, 17 };
+#define AUX_LEN_30 13
+#define AUX_LEN_DEFAULT 17
+
+typedef struct {
+  uint8_t header[3];
+  uint8_t n;                     // payload bytes
+  uint8_t payload[EMUL_PACKET_MAX];
+} emul_template_t;
+
+static emul_template_t templates[EMUL_TEMPLATES];
+
+static uint8_t fx[EMUL_FX_MAX] = { 0xF0, 0xF1 };
+static uint8_t fxN = 2;
+static uint8_t fxAnswered[EMUL_FX_MAX];  // 40Fx30 seen in this cycle
+static uint8_t auxTypeIndex[EMUL_FX_MAX];
+static uint8_t step = 0;                 // 0..5 heat pump requests, then 2 steps per polled Fx address (Fx30, Fx3y)
+
+#ifdef E_SERIES
+#define PT_FIRST 0x35
+#define PT_LAST  0x3D
+#define PT_N     (PT_LAST - PT_FIRST + 1)
+#define PARAM_MAX 0x180
+#define CONFIRM_MAX 16
+#define COUNTERS 6
+
+static const uint16_t nrParams[PT_N] = { 0x017C, 0x002F, 0x0002, 0x001F, 0x00F0, 0x006C, 0x00AF, 0x0002, 0x0020 }; // as nr_params in P1P2Monitor.ino
+static const uint8_t paramBytes[PT_N] = { 1, 2, 3, 4, 4, 1, 2, 3, 4 };
+
+static uint32_t paramVal[PT_N][PARAM_MAX];
+static uint16_t paramNext[PT_N];         // round-robin position of the announcements
+static uint16_t pollFlags[EMUL_FX_MAX];  // parameter types requested by aux controller (bit pt - PT_FIRST)
+static struct {
+  uint8_t pt;
+  uint16_t nr;
+} confirmQueue[CONFIRM_MAX];             // written parameters to be announced first
+static uint8_t confirmN = 0;
+static uint32_t counterBase[COUNTERS][COUNTERS];
+static uint32_t clockStart = 0;          // s since Monday 00:00
+#endif /* E_SERIES */
+
+static uint8_t crcAdd(uint8_t* pkt, uint8_t n)
+{
+  if (P1P2Checksum::enabled) {
+    pkt[n] = P1P2ChecksumOf<P1P2Checksum>(pkt, n);
+    n++;
+  }
+  return n;
+}
+
+static emul_template_t* templateFind(uint8_t h0, uint8_t h1, uint8_t h2)
+{
+  for (uint8_t i = 0; i < emul_templates; i++) {
+    if ((templates[i].header[0] == h0) && (templates[i].header[1] == h1) && (templates[i].header[2] == h2)) return &templates[i];
+  }
+  return NULL;
+}
+
+static uint8_t build(uint8_t* pkt, uint8_t h0, uint8_t h1, uint8_t h2, uint8_t len)
+// header plus template payload (or len zero bytes), returns length without CRC
+{
+  pkt[0] = h0;
+  pkt[1] = h1;
+  pkt[2] = h2;
+  emul_template_t* t = templateFind(h0, h1, h2);
+  if (t) {
+    memcpy(pkt + 3, t->payload, t->n);
+    return 3 + t->n;
+  }
+  if (len > EMUL_PACKET_MAX - 4) len = EMUL_PACKET_MAX - 4;
+  memset(pkt + 3, 0x00, len);
+  if ((h2 == 0x31) && (len > 4)) pkt[7] = 0xB4; // aux controller type (LAN adapter)
+  return 3 + len;
+}
+
+static uint8_t auxLenFor(uint8_t type)
+{
+  for (uint8_t i = 0; i < sizeof(auxTypes); i++) if (auxTypes[i] == type) return auxLen[i];
+  return AUX_LEN_DEFAULT;
+}
+
+static int8_t fxIndex(uint8_t addr)
+{
+  for (uint8_t f = 0; f < fxN; f++) if (fx[f] == addr) return f;
+  return -1;
+}
+
+#ifdef E_SERIES
+static void announce(uint8_t* pkt, uint8_t n, uint32_t ms)
+// fills the entries of a 00Fx35-00Fx3D request: written parameters first, then the next parameters of the table
+{
+  uint8_t p = pkt[2] - PT_FIRST;
+  uint8_t w = 2 + paramBytes[p];
+  for (uint8_t i = 3; i < n; i++) pkt[i] = 0xFF;
+  for (uint8_t i = 3; i + w <= n; i += w) {
+    uint16_t nr = 0xFFFF;
+    for (uint8_t k = 0; k < confirmN; k++) {
+      if (confirmQueue[k].pt != pkt[2]) continue;
+      nr = confirmQueue[k].nr;
+      memmove(&confirmQueue[k], &confirmQueue[k + 1], (confirmN - k - 1) * sizeof(confirmQueue[0]));
+      confirmN--;
+      emul_param_confirms++;
+      if (emul_confirm) emul_confirm(pkt[2], nr, paramVal[p][nr], ms);
+      break;
+    }
+    if (nr == 0xFFFF) {
+      nr = paramNext[p];
+      if (++paramNext[p] == nrParams[p]) paramNext[p] = 0;
+    }
+    pkt[i] = nr & 0xFF;
+    pkt[i + 1] = nr >> 8;
+    for (uint8_t b = 0; b < paramBytes[p]; b++) pkt[i + 2 + b] = (paramVal[p][nr] >> (8 * b)) & 0xFF;
+  }
+}
+
+static void paramsLearn(const uint8_t* pkt, uint8_t n)
+// parameter values from a 00Fx35-00Fx3D request of a trace
+{
+  uint8_t p = pkt[2] - PT_FIRST;
+  uint8_t w = 2 + paramBytes[p];
+  for (uint8_t i = 3; i + w <= n; i += w) {
+    uint16_t nr = pkt[i] | (pkt[i + 1] << 8);
+    if (nr >= nrParams[p]) continue;
+    uint32_t v = 0;
+    for (uint8_t b = 0; b < paramBytes[p]; b++) v |= (uint32_t) pkt[i + 2 + b] << (8 * b);
+    paramVal[p][nr] = v;
+  }
+}
+
+static void paramsWrite(uint8_t f, const uint8_t* pkt, uint8_t n, uint32_t ms)
+// parameter writes in a 40Fx35-40Fx3D aux controller reply
+{
+  uint8_t p = pkt[2] - PT_FIRST;
+  uint8_t w = 2 + paramBytes[p];
+  for (uint8_t i = 3; i + w <= n; i += w) {
+    uint16_t nr = pkt[i] | (pkt[i + 1] << 8);
+    if (nr >= nrParams[p]) continue; // 0xFFFF: no write
+    uint32_t v = 0;
+    for (uint8_t b = 0; b < paramBytes[p]; b++) v |= (uint32_t) pkt[i + 2 + b] << (8 * b);
+    paramVal[p][nr] = v;
+    emul_param_writes++;
+    if (emul_write) emul_write(pkt[2], nr, v, ms);
+    uint8_t k;
+    for (k = 0; k < confirmN; k++) if ((confirmQueue[k].pt == pkt[2]) && (confirmQueue[k].nr == nr)) break;
+    if ((k == confirmN) && (confirmN < CONFIRM_MAX)) {
+      confirmQueue[confirmN].pt = pkt[2];
+      confirmQueue[confirmN++].nr = nr;
+    }
+    pollFlags[f] |= (1 << p); // announce new value in the next cycle
+  }
+}
+
+static uint32_t counter(uint8_t s, uint8_t c, uint32_t ms)
+{
+  return (counterBase[s][c] + (ms / 60000) * (c + 1)) & 0xFFFFFF;
+}
+#endif /* E_SERIES */
+
+void emul_init(void)
+{
+  step = 0;
+  memset(fxAnswered, 0, sizeof(fxAnswered));
+  memset(auxTypeIndex, 0, sizeof(auxTypeIndex));
+#ifdef E_SERIES
+  memset(pollFlags, 0, sizeof(pollFlags));
+  memset(paramNext, 0, sizeof(paramNext));
+  confirmN = 0;
+#endif /* E_SERIES */
+}
+
+void emul_fx(const uint8_t* addr, uint8_t n)
+{
+  fxN = (n < EMUL_FX_MAX) ? n : EMUL_FX_MAX;
+  memcpy(fx, addr, fxN);
+}
+
+void emul_clock(uint32_t s)
+{
+#ifdef E_SERIES
+  clockStart = s;
+#endif /* E_SERIES */
+}
+
+bool emul_param(uint8_t pt, uint16_t nr, uint32_t &val)
+{
+#ifdef E_SERIES
+  if ((pt < PT_FIRST) || (pt > PT_LAST) || (nr >= nrParams[pt - PT_FIRST])) return false;
+  val = paramVal[pt - PT_FIRST][nr];
+  return true;
+#else /* E_SERIES */
+  return false;
+#endif /* E_SERIES */
+}
+
+bool emul_load(FILE* trace)
+// accepts P1P2Monitor R-lines ("R T 0.105: 000010..." or "R 000010..."), simulator traces and plain hex lines; E-lines are skipped
+{
+  char line[EMUL_LINE];
+  while (fgets(line, sizeof(line), trace)) {
+    const char* s = line;
+    if (((line[0] == 'R') || (line[0] == 'E')) && (line[1] == ' ')) {
+      if (line[0] == 'E') continue;
+      const char* colon = strchr(line, ':');
+      s = colon ? colon + 1 : line + 2;
+    } else if (!isxdigit(line[0])) {
+      continue;
+    }
+    uint8_t pkt[EMUL_PACKET_MAX + 1];
+    uint8_t n = 0;
+    while (n < sizeof(pkt)) {
+      while (*s == ' ') s++;
+      if (!isxdigit(s[0]) || !isxdigit(s[1])) break;
+      char hex[3] = { s[0], s[1], '\0' };
+      pkt[n++] = strtoul(hex, NULL, 16);
+      s += 2;
+    }
+    if (n < 4) continue;
+    if (P1P2Checksum::enabled) {
+      uint8_t c[EMUL_PACKET_MAX + 1];
+      memcpy(c, pkt, n - 1);
+      if (crcAdd(c, n - 1) && (c[n - 1] == pkt[n - 1])) n--; // strip CRC byte if present
+    }
+    if (n - 3 > EMUL_PACKET_MAX - 4) continue;
+    emul_template_t* t = templateFind(pkt[0], pkt[1], pkt[2]);
+    if (!t && (emul_templates < EMUL_TEMPLATES)) {
+      t = &templates[emul_templates++];
+      memcpy(t->header, pkt, 3);
+    }
+    if (t) {
+      t->n = n - 3;
+      memcpy(t->payload, pkt + 3, n - 3);
+    }
+#ifdef E_SERIES
+    if ((pkt[0] == 0x00) && ((pkt[1] & 0xF0) == 0xF0) && (pkt[2] >= PT_FIRST) && (pkt[2] <= PT_LAST)) paramsLearn(pkt, n);
+    if ((pkt[0] == 0x40) && (pkt[1] == 0x00) && (pkt[2] == 0xB8) && (pkt[3] < COUNTERS)) {
+      for (uint8_t c = 0; (c < COUNTERS) && (6 + 3 * c < n); c++) {
+        counterBase[pkt[3]][c] = ((uint32_t) pkt[4 + 3 * c] << 16) | (pkt[5 + 3 * c] << 8) | pkt[6 + 3 * c];
+      }
+    }
+#endif /* E_SERIES */
+  }
+  return !ferror(trace);
+}
+
+uint8_t emul_request(uint8_t* pkt, uint32_t ms)
+{
+  uint8_t steps = sizeof(hpTypes) + 2 * fxN;
+  while (step >= sizeof(hpTypes)) {
+    if (step >= steps) {
+      step = 0;
+      return 0;
+    }
+    uint8_t f = (step - sizeof(hpTypes)) >> 1;
+    if (!((step - sizeof(hpTypes)) & 1) || fxAnswered[f]) break;
+    step++; // Fx3y only polled if Fx30 was answered
+  }
+  uint8_t n;
+  if (step < sizeof(hpTypes)) {
+    n = build(pkt, 0x00, 0x00, hpTypes[step], hpRequestLen[step]);
+#ifdef E_SERIES
+    if ((pkt[2] == 0x12) && (n > 6)) {
+      uint32_t t = clockStart + ms / 1000;
+      pkt[4] = (t / 86400) % 7;
+      pkt[5] = (t / 3600) % 24;
+      pkt[6] = (t / 60) % 60;
+    }
+#endif /* E_SERIES */
+  } else {
+    uint8_t f = (step - sizeof(hpTypes)) >> 1;
+    if (!((step - sizeof(hpTypes)) & 1)) {
+      n = build(pkt, 0x00, fx[f], 0x30, AUX_LEN_30);
+      fxAnswered[f] = 0;
+    } else {
+      uint8_t type = 0;
+#ifdef E_SERIES
+      for (uint8_t p = 0; p < PT_N; p++) {
+        if (pollFlags[f] & (1 << p)) {
+          pollFlags[f] &= ~(1 << p);
+          type = PT_FIRST + p;
+          break;
+        }
+      }
+#endif /* E_SERIES */
+      if (!type) {
+        type = auxTypes[auxTypeIndex[f]];
+        if (++auxTypeIndex[f] == sizeof(auxTypes)) auxTypeIndex[f] = 0;
+      }
+      n = build(pkt, 0x00, fx[f], type, auxLenFor(type));
+#ifdef E_SERIES
+      if ((type >= PT_FIRST) && (type <= PT_LAST)) announce(pkt, n, ms);
+#endif /* E_SERIES */
+    }
+  }
+  step++;
+  return crcAdd(pkt, n);
+}
+
+uint8_t emul_reply(const uint8_t* req, uint8_t n, uint8_t* pkt, uint32_t ms)
+{
+  if ((n < 3) || (req[0] != 0x00) || (req[1] != 0x00)) return 0;
+  uint8_t len = 0;
+  for (uint8_t i = 0; i < sizeof(hpTypes); i++) if (hpTypes[i] == req[2]) len = hpReplyLen[i];
+#ifdef E_SERIES
+  if ((req[2] == 0xB8) && (n > 3)) {
+    uint8_t s = req[3];
+    n = build(pkt, 0x40, 0x00, 0xB8, 20);
+    pkt[3] = s;
+    if (s < COUNTERS) {
+      for (uint8_t c = 0; (c < COUNTERS) && (6 + 3 * c < n); c++) {
+        uint32_t v = counter(s, c, ms);
+        pkt[4 + 3 * c] = v >> 16;
+        pkt[5 + 3 * c] = (v >> 8) & 0xFF;
+        pkt[6 + 3 * c] = v & 0xFF;
+      }
+    }
+    emul_counter_replies++;
+    return crcAdd(pkt, n);
+  }
+#endif /* E_SERIES */
+  if (!len && !templateFind(0x40, 0x00, req[2])) return 0;
+  return crcAdd(pkt, build(pkt, 0x40, 0x00, req[2], len));
+}
+
+void emul_receive(const uint8_t* pkt, uint8_t n, uint32_t ms)
+{
+  if (P1P2Checksum::enabled && n) n--;
+  if ((n < 4) || (pkt[0] != 0x40)) return;
+  int8_t f = fxIndex(pkt[1]);
+  if (f < 0) return;
+  if (pkt[2] == 0x30) {
+    fxAnswered[f] = 1;
+#ifdef E_SERIES
+    for (uint8_t pt = PT_FIRST; pt <= PT_LAST; pt++) if ((pt - 0x2E < n) && (pkt[pt - 0x2E] == 0x01)) pollFlags[f] |= (1 << (pt - PT_FIRST));
+#endif /* E_SERIES */
+  }
+#ifdef E_SERIES
+  if ((pkt[2] >= PT_FIRST) && (pkt[2] <= PT_LAST)) paramsWrite(f, pkt, n, ms);
+#endif /* E_SERIES */
+}
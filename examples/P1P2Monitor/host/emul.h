@@ -0,0 +1,41 @@
+/* emul.h: rule-based model of a Daikin main controller and heat pump, for closed-loop tests of P1P2Monitor and the bridge (emul.cpp)
+ *
+ * The model generates the main controller request cycle (0000xx to the heat pump, 00Fx30/00Fx3y to the aux controllers)
+ * and the heat pump replies. Payloads come from templates learned from a recorded trace (emul_load()), or are zero.
+ * For E_SERIES, rules on top of the templates make the control path work as on a real system:
+ *   - 000012 carries a clock (day-of-week, hour, minute) derived from the time argument,
+ *   - 0000B8 counter requests (from any device) are answered with time-increasing counters,
+ *   - the main controller keeps a parameter table (types 0x35-0x3D), which it announces in its 00Fx3y requests,
+ *   - a 40Fx30 reply flagging a parameter type makes the main controller poll that type in the next cycle,
+ *   - parameter writes in 40Fx3y replies are applied to the table and confirmed (emul_confirm) when announced
+ *     with the new value in the next 00Fx3y request of that type.
+ * The model has no dependency on the Arduino environment and is driven with time in ms by the caller.
+ * Packets passed to and returned by the model include the CRC byte.
+ */
+
+#ifndef emul_h
+#define emul_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define EMUL_PACKET_MAX 32
+#define EMUL_FX_MAX 4
+
+void emul_init(void);
+bool emul_load(FILE* trace);                          // learns payload templates (and parameter/counter values) from an R-line trace
+void emul_fx(const uint8_t* fx, uint8_t n);           // aux controller addresses polled by the main controller (default F0, F1)
+void emul_clock(uint32_t s);                          // E_SERIES clock at time 0, in seconds since Monday 00:00
+
+uint8_t emul_request(uint8_t* pkt, uint32_t ms);      // next main controller request, 0 at end of cycle (next call starts a new cycle)
+uint8_t emul_reply(const uint8_t* req, uint8_t n, uint8_t* pkt, uint32_t ms); // heat pump reply to a 0000xx request, 0 if none
+void emul_receive(const uint8_t* pkt, uint8_t n, uint32_t ms); // other (error-free) packets seen on the bus
+
+bool emul_param(uint8_t pt, uint16_t nr, uint32_t &val); // current value in the parameter table (E_SERIES)
+
+extern void (*emul_confirm)(uint8_t pt, uint16_t nr, uint32_t val, uint32_t ms); // parameter write announced by main controller
+extern void (*emul_write)(uint8_t pt, uint16_t nr, uint32_t val, uint32_t ms);   // parameter write received from an aux controller
+
+extern uint32_t emul_param_writes, emul_param_confirms, emul_counter_replies, emul_templates;
+
+#endif /* emul_h */
@@ -0,0 +1,31 @@
+/* host.h: interface between the host drivers (replay, simulator) and the host replacements of Arduino and P1P2MQTT */
+
+#ifndef host_h
+#define host_h
+
+#include <stdio.h>
+#include <stdint.h>
+
+// Arduino runtime (host_arduino.cpp)
+extern FILE* host_serial_out;       // P1P2Monitor serial output (NULL to discard)
+extern void (*host_serial_line)(const char* line); // if set, called for each line of P1P2Monitor serial output
+extern uint32_t host_serial_bytes;  // # bytes of serial output
+void host_serial_input(const char* s);
+bool host_serial_pending(void);
+
+// virtual time, implemented by the backend (P1P2MQTT_host.cpp or sim.cpp), used by delay()
+void host_time_advance(uint32_t ms);
+uint32_t host_time(void);
+
+// packet-level P1P2MQTT replacement (P1P2MQTT_host.cpp)
+extern FILE* host_write_log;        // packets written to the bus (NULL to discard)
+extern uint32_t host_packets_written;
+void host_init(void);
+bool host_bus_receive(const uint8_t* data, uint8_t n, uint16_t delta, uint8_t error);
+bool host_bus_pending(void);
+
+// P1P2Monitor.ino
+void setup(void);
+void loop(void);
+
+#endif /* host_h */
@@ -0,0 +1,116 @@
+/* host_arduino.cpp: host replacement of the Arduino runtime (registers, pins, Serial, sscanf) for the host-native builds of P1P2Monitor */
+
+#include "Arduino.h"
+#include "EEPROM.h"
+#include "host.h"
+
+FILE* host_serial_out = stdout;
+void (*host_serial_line)(const char* line) = NULL;
+uint32_t host_serial_bytes = 0;
+
+avr_reg8 MCUSR, SREG, GTCCR;
+avr_reg8 PINB(0xFF), PORTB, PORTC, PORTD; // GPIO0 and GPIO15 (ESP programming signals) high
+avr_reg8 TCCR0A, TCCR0B, TCNT0, OCR0A, TIFR0, TIMSK0;
+avr_reg8 TCCR2A, TCCR2B, TCNT2, OCR2A, TIFR2, TIMSK2;
+avr_reg8 TCCR1A, TCCR1B, TCCR1C, TIFR1, TIMSK1;
+avr_reg16 TCNT1, OCR1A, OCR1B, ICR1;
+avr_reg8 ADMUX, ADCSRA, ADCSRB, ADCL, ADCH, DIDR0;
+
+HardwareSerial Serial;
+EEPROMClass EEPROM;
+
+static uint8_t host_pin_level = LOW;
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  host_pin_level = val;
+}
+
+int digitalRead(uint8_t pin)
+// V1.2/V1.3 hardware detection: the test pins are connected, so a read returns the level last written (reports v1.3 hardware)
+{
+  return host_pin_level;
+}
+
+void delay(unsigned long ms)
+{
+  host_time_advance(ms);
+}
+
+int host_sscanf(const char* s, const char* format, ...)
+{
+  char fmt[128];
+  uint8_t j = 0;
+  for (uint8_t i = 0; format[i] && (j < sizeof(fmt) - 3); i++) {
+    fmt[j++] = format[i];
+    if (format[i] != '%') continue;
+    if (format[i + 1] == '%') {
+      fmt[j++] = format[++i];
+      continue;
+    }
+    while ((format[i + 1] >= '0') && (format[i + 1] <= '9')) fmt[j++] = format[++i]; // field width
+    if ((format[i + 1] == 'l') && strchr("diuxXon", format[i + 2])) {
+      i++; // AVR long is 32-bit, host int
+    } else if (format[i + 1] != 'h') {
+      if (strchr("diuxXon", format[i + 1])) fmt[j++] = 'h'; // AVR int is 16-bit
+    }
+  }
+  fmt[j] = '\0';
+  va_list ap;
+  va_start(ap, format);
+  int n = vsscanf(s, fmt, ap);
+  va_end(ap);
+  return n;
+}
+
+static char host_serial_in[1024];
+static uint16_t host_serial_in_head = 0;
+static uint16_t host_serial_in_tail = 0;
+
+void host_serial_input(const char* s)
+{
+  while (*s) {
+    host_serial_in[host_serial_in_head] = *s++;
+    host_serial_in_head = (host_serial_in_head + 1) % sizeof(host_serial_in);
+  }
+}
+
+bool host_serial_pending(void)
+{
+  return host_serial_in_head != host_serial_in_tail;
+}
+
+int HardwareSerial::available(void)
+{
+  return (host_serial_in_head + sizeof(host_serial_in) - host_serial_in_tail) % sizeof(host_serial_in);
+}
+
+int HardwareSerial::read(void)
+{
+  if (!host_serial_pending()) return -1;
+  char c = host_serial_in[host_serial_in_tail];
+  host_serial_in_tail = (host_serial_in_tail + 1) % sizeof(host_serial_in);
+  return (uint8_t) c;
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+  static char line[256];
+  static uint8_t n = 0;
+  host_serial_bytes++;
+  if (c == '\r') return 1;
+  if (host_serial_out) fputc(c, host_serial_out);
+  if (host_serial_line) {
+    if (c == '\n') {
+      line[n] = '\0';
+      host_serial_line(line);
+      n = 0;
+    } else if (n < sizeof(line) - 1) {
+      line[n++] = c;
+    }
+  }
+  return 1;
+}
+
@@ -0,0 +1,522 @@
+/* sim.cpp: timing-accurate virtual P1/P2 bus with the P1P2MQTT library under test, see sim.h
+ *
+ * Discrete-event simulation in CPU cycles. The ATmega peripherals used by the library are modelled through register hooks:
+ * - timer1: free-running TCNT1, output compare A drives the bus output (COM1A set/clear/toggle, FOC1A), compare B and
+ *   overflow set their flags, input capture stores the (noise-cancelled) edge time in ICR1 for the selected edge (ICES1)
+ * - timer2 (ms) and timer0 (s): CTC mode timers restarted by writing TCNTx
+ * - ADC: single conversions of 13 ADC clocks; even channels sample the bus level, odd channels the supply voltage
+ * - PINB bit 0: bus level as seen through the receiver (rxDelay cycles late)
+ * Flags are set when the event occurs; interrupt routines are called in AVR vector priority order when enabled, isrLatency
+ * cycles after the event. loop() runs every loopPeriod cycles and is never interrupted (interrupts are handled in between).
+ */
+
+#include "Arduino.h"
+#include "P1P2Config.h"
+#include <P1P2MQTT.h>
+#include "host.h"
+#include "sim.h"
+#include <queue>
+#include <vector>
+
+sim_config_t sim_config = {
+  50,                        // isrLatency
+  8,                         // rxDelay
+  800,                       // loopPeriod (100us)
+  (uint16_t) (SIM_BIT * 10), // eopGap
+  0x2C0, 0x1C0, 8, 0x300     // adcHigh, adcLow, adcNoise, adcSupply
+};
+sim_time_t sim_now = 0;
+
+void (*sim_packet_start)(sim_time_t t) = NULL;
+void (*sim_packet_end)(const sim_packet_t &p) = NULL;
+void (*sim_timer_fired)(uint8_t timer) = NULL;
+
+// event queue
+
+#define EV_DRIVE  0 // device a sets its output to level b
+#define EV_EDGE   1 // device under test sees bus level b
+#define EV_DECODE 2 // reference receiver decodes byte
+#define EV_EOP    3 // reference receiver end-of-packet check
+#define EV_TIMER  4 // device model timer a
+
+typedef struct {
+  sim_time_t t;
+  uint32_t seq;
+  uint32_t gen;
+  uint8_t type;
+  uint8_t a;
+  uint8_t b;
+} sim_event_t;
+
+struct sim_event_later {
+  bool operator()(const sim_event_t &x, const sim_event_t &y) const { return (x.t > y.t) || ((x.t == y.t) && (x.seq > y.seq)); }
+};
+
+static std::priority_queue<sim_event_t, std::vector<sim_event_t>, sim_event_later> sim_events;
+static uint32_t sim_seq = 0;
+
+static void sim_push(sim_time_t t, uint8_t type, uint8_t a, uint8_t b, uint32_t gen = 0)
+{
+  sim_event_t e = { t, sim_seq++, gen, type, a, b };
+  sim_events.push(e);
+}
+
+static uint32_t sim_rnd = 1;
+
+void sim_seed(uint32_t seed)
+{
+  sim_rnd = seed ? seed : 1;
+}
+
+uint32_t sim_random(void)
+{
+  sim_rnd ^= sim_rnd << 13;
+  sim_rnd ^= sim_rnd >> 17;
+  sim_rnd ^= sim_rnd << 5;
+  return sim_rnd;
+}
+
+// bus
+
+#define SIM_HISTORY 1024 // bus level changes kept for delayed/past sampling
+
+static uint8_t sim_low = 0; // bit mask of devices driving the bus low
+static sim_time_t hist_t[SIM_HISTORY];
+static uint8_t hist_level[SIM_HISTORY];
+static uint16_t hist_head = 0;
+static uint16_t hist_n = 0;
+
+static uint8_t level_at(sim_time_t t)
+{
+  for (uint16_t i = 0; i < hist_n; i++) {
+    uint16_t j = (hist_head - i) & (SIM_HISTORY - 1);
+    if (hist_t[j] <= t) return hist_level[j];
+  }
+  return 1;
+}
+
+uint8_t sim_bus_level(void)
+{
+  return !sim_low;
+}
+
+// reference receiver
+
+static sim_packet_t rx_packet;
+static uint8_t rx_in_packet = 0;
+static uint8_t rx_busy = 0;
+static sim_time_t rx_byte_start;
+static uint32_t rx_eop_gen = 0;
+
+static void rx_falling(sim_time_t t)
+{
+  if (rx_busy) return;
+  rx_busy = 1;
+  rx_byte_start = t;
+  rx_eop_gen++;
+  if (!rx_in_packet) {
+    rx_in_packet = 1;
+    rx_packet.n = 0;
+    rx_packet.errors = 0;
+    rx_packet.drivers = 0;
+    rx_packet.start = t;
+    if (sim_packet_start) sim_packet_start(t);
+  }
+  rx_packet.drivers |= sim_low;
+  sim_push(t + (sim_time_t) (10.5 * SIM_BIT), EV_DECODE, 0, 0);
+}
+
+static sim_time_t falling_between(sim_time_t a, sim_time_t b)
+// first falling bus edge in [a, b), or SIM_NEVER
+{
+  sim_time_t t = SIM_NEVER;
+  for (uint16_t i = 0; i < hist_n; i++) {
+    uint16_t j = (hist_head - i) & (SIM_HISTORY - 1);
+    if (hist_t[j] < a) break;
+    if ((hist_t[j] < b) && !hist_level[j]) t = hist_t[j];
+  }
+  return t;
+}
+
+static void rx_decode(void)
+// decodes start, data, parity and stop bit; a 0 bit is a falling edge within half a bit of its expected start,
+// which re-synchronizes the bit timing, so transmitters with a deviating bit rate are decoded as by a real receiver
+{
+  uint8_t b = 0;
+  uint8_t parity = 0;
+  uint8_t errors = 0;
+  sim_time_t tb = rx_byte_start;
+  for (uint8_t i = 0; i < 11; i++) {
+    if (i) {
+      sim_time_t e = falling_between(tb + (sim_time_t) (0.5 * SIM_BIT), tb + (sim_time_t) (1.5 * SIM_BIT));
+      tb = (e != SIM_NEVER) ? e : tb + (sim_time_t) SIM_BIT;
+    }
+    uint8_t level = level_at(tb + (sim_time_t) (0.25 * SIM_BIT));
+    if (i == 0) {
+      if (level) errors |= SIM_ERR_START;
+    } else if (i < 9) {
+      b |= level << (i - 1);
+      parity ^= level;
+    } else if (i == 9) {
+      if (parity != level) errors |= SIM_ERR_PARITY;
+    } else if (!level) {
+      errors |= SIM_ERR_STOP;
+    }
+    if ((i < 10) && !level_at(tb + (sim_time_t) (0.75 * SIM_BIT))) errors |= SIM_ERR_HALF;
+  }
+  if (rx_packet.n < SIM_PACKET_MAX) {
+    rx_packet.data[rx_packet.n++] = b;
+  } else {
+    errors |= SIM_ERR_LONG;
+  }
+  rx_packet.errors |= errors;
+  rx_packet.end = rx_byte_start + (sim_time_t) (11 * SIM_BIT);
+  rx_busy = 0;
+  sim_push(rx_packet.end + sim_config.eopGap, EV_EOP, 0, 0, rx_eop_gen);
+}
+
+static void rx_eop(uint32_t gen)
+{
+  if ((gen != rx_eop_gen) || rx_busy || !rx_in_packet) return;
+  rx_in_packet = 0;
+  if (P1P2Checksum::enabled && (rx_packet.n > 1) && !P1P2Checksum::bare(rx_packet.data, rx_packet.n)) {
+    if (P1P2ChecksumOf<P1P2Checksum>(rx_packet.data, rx_packet.n - 1) != rx_packet.data[rx_packet.n - 1]) rx_packet.errors |= SIM_ERR_CRC;
+  }
+  if (sim_packet_end) sim_packet_end(rx_packet);
+}
+
+static void bus_drive(uint8_t dev, uint8_t level, sim_time_t t)
+{
+  uint8_t before = !sim_low;
+  if (level) {
+    sim_low &= ~(1 << dev);
+  } else {
+    sim_low |= (1 << dev);
+    if (rx_in_packet) rx_packet.drivers |= (1 << dev);
+  }
+  uint8_t after = !sim_low;
+  if (after == before) return;
+  hist_head = (hist_head + 1) & (SIM_HISTORY - 1);
+  hist_t[hist_head] = t;
+  hist_level[hist_head] = after;
+  if (hist_n < SIM_HISTORY) hist_n++;
+  sim_push(t + sim_config.rxDelay, EV_EDGE, 0, after);
+  if (!after) rx_falling(t);
+}
+
+sim_time_t sim_send(uint8_t dev, const uint8_t* data, uint8_t n, sim_time_t t, double bitCycles, uint8_t pauseBits)
+// schedules the waveform of a packet: per byte a start bit, 8 data bits (LSB first), even parity bit, stop bit and pauseBits
+{
+  if (t < sim_now) t = sim_now;
+  double tb = t;
+  for (uint8_t k = 0; k < n; k++) {
+    uint16_t bits = data[k] << 1; // start bit 0
+    uint8_t parity = 0;
+    for (uint8_t i = 0; i < 8; i++) parity ^= (data[k] >> i) & 1;
+    bits |= parity << 9;
+    for (uint8_t i = 0; i < 10; i++) {
+      if (!((bits >> i) & 1)) {
+        sim_push((sim_time_t) (tb + i * bitCycles), EV_DRIVE, dev, 0);
+        sim_push((sim_time_t) (tb + (i + 0.5) * bitCycles), EV_DRIVE, dev, 1);
+      }
+    }
+    tb += (11 + pauseBits) * bitCycles;
+  }
+  return (sim_time_t) (tb - pauseBits * bitCycles);
+}
+
+// device model timers
+
+static uint32_t timer_gen[SIM_TIMERS];
+
+void sim_timer(uint8_t timer, sim_time_t t)
+{
+  timer_gen[timer]++;
+  if (t != SIM_NEVER) sim_push((t < sim_now) ? sim_now : t, EV_TIMER, timer, 0, timer_gen[timer]);
+}
+
+// ATmega peripherals
+
+static sim_time_t t1_fromA = 0;   // compare A/B match search starts after this time
+static sim_time_t t1_fromB = 0;
+static sim_time_t t1_fromOvf = 0;
+static sim_time_t t0_next = SIM_NEVER;
+static sim_time_t t2_next = SIM_NEVER;
+static sim_time_t adc_start;
+static sim_time_t adc_done = SIM_NEVER;
+static uint8_t adc_channel;
+static sim_time_t loop_next = SIM_NEVER;
+static bool loop_on = false;
+static bool in_loop = false;
+
+static const uint16_t t0_prescale[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+static const uint16_t t2_prescale[8] = { 0, 1, 8, 32, 64, 128, 256, 1024 };
+
+static sim_time_t match_after(sim_time_t from, uint16_t ocr)
+// first time after from at which the 16-bit timer1 equals ocr
+{
+  return from + (uint16_t) (ocr - (uint16_t) from - 1) + 1;
+}
+
+static void oc1a_action(sim_time_t t)
+{
+  switch ((TCCR1A.val >> COM1A0) & 0x03) {
+    case 1 : bus_drive(SIM_DUT, (sim_low >> SIM_DUT) & 1, t); break; // toggle
+    case 2 : bus_drive(SIM_DUT, 0, t); break; // clear
+    case 3 : bus_drive(SIM_DUT, 1, t); break; // set
+    default: break;
+  }
+}
+
+static uint16_t tcnt1_read(void)
+{
+  return (uint16_t) sim_now;
+}
+
+static void ocr1a_write(uint16_t v)
+{
+  OCR1A.val = v;
+  t1_fromA = sim_now;
+}
+
+static void ocr1b_write(uint16_t v)
+{
+  OCR1B.val = v;
+  t1_fromB = sim_now;
+}
+
+static void tccr1c_write(uint8_t v)
+{
+  if (v & (1 << FOC1A)) oc1a_action(sim_now); // forced output compare, no flag
+}
+
+static void tifr0_write(uint8_t v)
+{
+  TIFR0.val &= ~v;
+}
+
+static void tifr1_write(uint8_t v)
+{
+  TIFR1.val &= ~v;
+}
+
+static void tifr2_write(uint8_t v)
+{
+  TIFR2.val &= ~v;
+}
+
+static sim_time_t ctc_next(uint8_t tcnt, uint8_t ocr, uint16_t prescale)
+{
+  if (!prescale) return SIM_NEVER;
+  uint8_t steps = ocr - tcnt;
+  return sim_now + (steps ? steps : (uint16_t) ocr + 1) * prescale;
+}
+
+static void tcnt0_write(uint8_t v)
+{
+  TCNT0.val = v;
+  t0_next = ctc_next(v, OCR0A.val, t0_prescale[TCCR0B.val & 0x07]);
+}
+
+static void tccr0b_write(uint8_t v)
+{
+  TCCR0B.val = v;
+  if (!t0_prescale[v & 0x07]) {
+    t0_next = SIM_NEVER;
+  } else if (t0_next == SIM_NEVER) {
+    t0_next = ctc_next(TCNT0.val, OCR0A.val, t0_prescale[v & 0x07]);
+  }
+}
+
+static void tcnt2_write(uint8_t v)
+{
+  TCNT2.val = v;
+  t2_next = ctc_next(v, OCR2A.val, t2_prescale[TCCR2B.val & 0x07]);
+}
+
+static void tccr2b_write(uint8_t v)
+{
+  TCCR2B.val = v;
+  if (!t2_prescale[v & 0x07]) {
+    t2_next = SIM_NEVER;
+  } else if (t2_next == SIM_NEVER) {
+    t2_next = ctc_next(TCNT2.val, OCR2A.val, t2_prescale[v & 0x07]);
+  }
+}
+
+static void adcsra_write(uint8_t v)
+{
+  uint8_t flag = (v & (1 << ADIF)) ? 0 : (ADCSRA.val & (1 << ADIF)); // write 1 to clear
+  ADCSRA.val = (v & ~((1 << ADIF) | (1 << ADSC))) | flag | ((adc_done != SIM_NEVER) ? (1 << ADSC) : 0);
+  if ((v & (1 << ADSC)) && (v & (1 << ADEN)) && (adc_done == SIM_NEVER)) {
+    adc_start = sim_now;
+    adc_channel = ADMUX.val & 0x0F;
+    adc_done = sim_now + 13 * (2 << ((v & 0x07) ? (v & 0x07) - 1 : 0));
+    ADCSRA.val |= (1 << ADSC);
+  }
+}
+
+static uint8_t pinb_read(void)
+{
+  // bit 0: bus input (ICP1), other inputs high (GPIO0 and GPIO15 of the ESP)
+  return 0xFE | level_at((sim_now > sim_config.rxDelay) ? sim_now - sim_config.rxDelay : 0);
+}
+
+static void adc_complete(void)
+{
+  uint16_t prescale = 2 << ((ADCSRA.val & 0x07) ? (ADCSRA.val & 0x07) - 1 : 0);
+  int16_t v;
+  if (adc_channel & 0x01) {
+    v = sim_config.adcSupply;
+  } else {
+    // sample-and-hold 1.5 ADC clocks after start of conversion
+    v = level_at(adc_start + (3 * prescale) / 2) ? sim_config.adcHigh : sim_config.adcLow;
+  }
+  if (sim_config.adcNoise) v += (int16_t) (sim_random() % (2 * sim_config.adcNoise + 1)) - sim_config.adcNoise;
+  if (v < 0) v = 0;
+  if (v > 0x3FF) v = 0x3FF;
+  ADCL.val = v & 0xFF;
+  ADCH.val = v >> 8;
+  ADCSRA.val = (ADCSRA.val & ~(1 << ADSC)) | (1 << ADIF);
+  adc_done = SIM_NEVER;
+}
+
+static bool dispatch(void)
+// calls the highest priority pending and enabled interrupt routine
+{
+  void (*isr)(void) = NULL;
+  if ((TIFR2.val & (1 << OCF2A)) && (TIMSK2.val & (1 << OCIE2A))) {
+    TIFR2.val &= ~(1 << OCF2A);
+    isr = host_isr_timer2_compa;
+  } else if ((TIFR1.val & (1 << ICF1)) && (TIMSK1.val & (1 << ICIE1))) {
+    TIFR1.val &= ~(1 << ICF1);
+    isr = host_isr_timer1_capt;
+  } else if ((TIFR1.val & (1 << OCF1A)) && (TIMSK1.val & (1 << OCIE1A))) {
+    TIFR1.val &= ~(1 << OCF1A);
+    isr = host_isr_timer1_compa;
+  } else if ((TIFR1.val & (1 << OCF1B)) && (TIMSK1.val & (1 << OCIE1B))) {
+    TIFR1.val &= ~(1 << OCF1B);
+    isr = host_isr_timer1_compb;
+#ifdef MEASURE_LOAD
+  } else if ((TIFR1.val & (1 << TOV1)) && (TIMSK1.val & (1 << TOIE1))) {
+    TIFR1.val &= ~(1 << TOV1);
+    isr = host_isr_timer1_ovf;
+#endif /* MEASURE_LOAD */
+#ifdef S_TIMER
+  } else if ((TIFR0.val & (1 << OCF0A)) && (TIMSK0.val & (1 << OCIE0A))) {
+    TIFR0.val &= ~(1 << OCF0A);
+    isr = host_isr_timer0_compa;
+#endif /* S_TIMER */
+  } else if ((ADCSRA.val & (1 << ADIF)) && (ADCSRA.val & (1 << ADIE))) {
+    ADCSRA.val &= ~(1 << ADIF);
+    isr = host_isr_adc;
+  }
+  if (!isr) return false;
+  sim_now += sim_config.isrLatency;
+  isr();
+  return true;
+}
+
+void sim_init(void)
+{
+  TCNT1.read = tcnt1_read;
+  OCR1A.write = ocr1a_write;
+  OCR1B.write = ocr1b_write;
+  TCCR1C.write = tccr1c_write;
+  TIFR0.write = tifr0_write;
+  TIFR1.write = tifr1_write;
+  TIFR2.write = tifr2_write;
+  TCNT0.write = tcnt0_write;
+  TCCR0B.write = tccr0b_write;
+  TCNT2.write = tcnt2_write;
+  TCCR2B.write = tccr2b_write;
+  ADCSRA.write = adcsra_write;
+  PINB.read = pinb_read;
+}
+
+void sim_loop_enable(bool on)
+{
+  loop_on = on;
+  if (on && (loop_next == SIM_NEVER)) loop_next = sim_now;
+}
+
+#define SIM_NEXT(time, what) if ((time) < te) { te = (time); next = (what); }
+
+void sim_run_until(sim_time_t t_end)
+{
+  enum { NONE, QUEUE, CMPA, CMPB, OVF, T0, T2, ADC_DONE, LOOP } next;
+  for (;;) {
+    sim_time_t te = SIM_NEVER;
+    next = NONE;
+    if (!sim_events.empty()) SIM_NEXT(sim_events.top().t, QUEUE);
+    SIM_NEXT(match_after(t1_fromA, OCR1A.val), CMPA);
+    SIM_NEXT(match_after(t1_fromB, OCR1B.val), CMPB);
+    SIM_NEXT(match_after(t1_fromOvf, 0), OVF);
+    SIM_NEXT(t0_next, T0);
+    SIM_NEXT(t2_next, T2);
+    SIM_NEXT(adc_done, ADC_DONE);
+    if (loop_on && !in_loop) SIM_NEXT(loop_next, LOOP);
+    if ((next == NONE) || (te > t_end)) break;
+    if (te > sim_now) sim_now = te;
+    switch (next) {
+      case QUEUE    : {
+                        sim_event_t e = sim_events.top();
+                        sim_events.pop();
+                        switch (e.type) {
+                          case EV_DRIVE  : bus_drive(e.a, e.b, e.t);
+                                           break;
+                          case EV_EDGE   : if ((e.b == 0) == !(TCCR1B.val & (1 << ICES1))) {
+                                             ICR1.val = (uint16_t) (e.t + ((TCCR1B.val & (1 << ICNC1)) ? 4 : 0));
+                                             TIFR1.val |= (1 << ICF1);
+                                           }
+                                           break;
+                          case EV_DECODE : rx_decode();
+                                           break;
+                          case EV_EOP    : rx_eop(e.gen);
+                                           break;
+                          case EV_TIMER  : if ((e.gen == timer_gen[e.a]) && sim_timer_fired) sim_timer_fired(e.a);
+                                           break;
+                        }
+                        break;
+                      }
+      case CMPA     : t1_fromA = te;
+                      TIFR1.val |= (1 << OCF1A);
+                      oc1a_action(te);
+                      break;
+      case CMPB     : t1_fromB = te;
+                      TIFR1.val |= (1 << OCF1B);
+                      break;
+      case OVF      : t1_fromOvf = te;
+                      TIFR1.val |= (1 << TOV1);
+                      break;
+      case T0       : t0_next += ((uint16_t) OCR0A.val + 1) * t0_prescale[TCCR0B.val & 0x07];
+                      TIFR0.val |= (1 << OCF0A);
+                      break;
+      case T2       : t2_next += ((uint16_t) OCR2A.val + 1) * t2_prescale[TCCR2B.val & 0x07];
+                      TIFR2.val |= (1 << OCF2A);
+                      break;
+      case ADC_DONE : adc_complete();
+                      break;
+      case LOOP     : in_loop = true;
+                      loop();
+                      in_loop = false;
+                      loop_next = sim_now + sim_config.loopPeriod;
+                      break;
+      default       : break;
+    }
+    while (dispatch()) ;
+  }
+  if (sim_now < t_end) sim_now = t_end;
+}
+
+// virtual time for delay()
+
+void host_time_advance(uint32_t ms)
+{
+  sim_run_until(sim_now + ms * SIM_MS);
+}
+
+uint32_t host_time(void)
+{
+  return sim_now / SIM_MS;
+}
@@ -0,0 +1,68 @@
+/* sim.h: timing-accurate virtual P1/P2 bus with the P1P2MQTT library under test (sim.cpp)
+ *
+ * Time is counted in CPU cycles of the ATmega under test (F_CPU). The bus is the wired-AND of the outputs of all devices:
+ * a 0 bit is a low first half-bit followed by a high second half-bit, a 1 bit is high during the whole bit.
+ * Device 0 is the real P1P2MQTT library (driven through emulated timer1/timer2/timer0/ADC registers and interrupt routines),
+ * the other devices are models which transmit packets with sim_send(). A reference receiver decodes the bus and reports
+ * each packet (with errors and the set of devices that drove the bus during the packet) to the simulator driver.
+ */
+
+#ifndef sim_h
+#define sim_h
+
+#include <stdint.h>
+
+typedef uint64_t sim_time_t;
+
+#define SIM_NEVER ((sim_time_t) -1)
+#define SIM_MS ((sim_time_t) (F_CPU / 1000))
+#define SIM_BIT ((double) F_CPU / 9600)    // nominal bit time in cycles
+
+#define SIM_DUT 0                          // device number of the library under test
+#define SIM_DEVICES 8
+#define SIM_TIMERS 8                       // timers for device models
+#define SIM_PACKET_MAX 64
+
+// errors detected by the reference receiver
+#define SIM_ERR_START  0x01                // start bit not low
+#define SIM_ERR_STOP   0x02                // stop bit not high (framing)
+#define SIM_ERR_PARITY 0x04
+#define SIM_ERR_HALF   0x08                // second half of a bit low (overlapping transmissions)
+#define SIM_ERR_CRC    0x10
+#define SIM_ERR_LONG   0x20                // packet longer than SIM_PACKET_MAX
+
+typedef struct {
+  uint8_t data[SIM_PACKET_MAX];
+  uint8_t n;
+  uint8_t errors;
+  uint8_t drivers;                         // bit mask of devices that pulled the bus low during the packet
+  sim_time_t start;                        // falling edge of first start bit
+  sim_time_t end;                          // end of stop bit of last byte
+} sim_packet_t;
+
+typedef struct {
+  uint16_t isrLatency;                     // cycles from interrupt flag to start of interrupt routine
+  uint16_t rxDelay;                        // cycles from bus level change to input pin change of the device under test
+  uint16_t loopPeriod;                     // cycles between calls of loop()
+  uint16_t eopGap;                         // bus idle time (cycles) after which the reference receiver ends a packet
+  uint16_t adcHigh, adcLow, adcNoise, adcSupply; // ADC counts of bus high/low level, noise amplitude, and supply voltage
+} sim_config_t;
+
+extern sim_config_t sim_config;
+extern sim_time_t sim_now;
+
+// callbacks for the simulator driver
+extern void (*sim_packet_start)(sim_time_t t);
+extern void (*sim_packet_end)(const sim_packet_t &p);
+extern void (*sim_timer_fired)(uint8_t timer);
+
+void sim_init(void);                       // installs the register hooks; call before setup()
+void sim_loop_enable(bool on);             // call loop() every loopPeriod cycles
+void sim_run_until(sim_time_t t);
+sim_time_t sim_send(uint8_t dev, const uint8_t* data, uint8_t n, sim_time_t t, double bitCycles, uint8_t pauseBits); // returns end time
+void sim_timer(uint8_t timer, sim_time_t t); // (re)starts device model timer, SIM_NEVER to stop
+uint32_t sim_random(void);
+void sim_seed(uint32_t seed);
+uint8_t sim_bus_level(void);
+
+#endif /* sim_h */
@@ -0,0 +1,15 @@
+/* util/crc16.h: host replacement of the avr-libc CRC routine used by P1P2Monitor */
+
+#ifndef _UTIL_CRC16_H_
+#define _UTIL_CRC16_H_
+
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+  data ^= (crc & 0xFF);
+  data ^= data << 4;
+  return ((((uint16_t) data << 8) | (crc >> 8)) ^ (uint8_t) (data >> 4) ^ ((uint16_t) data << 3));
+}
+
+#endif /* _UTIL_CRC16_H_ */
@@ -0,0 +1,124 @@
+#!/usr/bin/env python3
+#
+# scope_stream.py: decodes and renders streaming scope output ("s" lines, scope mode U2) of P1P2Monitor
+#
+# Usage: scope_stream.py [-w] [logfile ...]   (reads stdin if no file given)
+#          -w  also render an ASCII waveform for each packet
+#
+# Input lines may come directly from the ATmega serial output ("s ..."), from the bridge telnet output, or from
+# the R topic (where a time stamp follows the 's'); the last word of each line holds the encoded data.
+#
+# Each event is a varint, 5 bits per character, least significant group first; '0'..'O' continue, 'P'..'o' end
+# a value. value = (interval_us << 3) | (event >> 5); events with code 7 (errors, and the start-of-packet marker)
+# are followed by a second value holding event & 0x1F.
+
+import sys
+
+BIT_US = 1000000.0 / 9600
+
+EVENTS = { 0: 'low', 2: 'fall-w', 3: 'rise', 4: 'high-r', 5: 'spike', 6: 'fall-r' }
+ERRORS = { 0x1F: 'SB', 0x1E: 'BC', 0x1D: 'PE', 0x1C: 'BE', 0x1B: 'sb', 0x1A: 'bc', 0x19: 'pe', 0x18: 'be', 0x17: 'lw' }
+START = 0x10
+
+def values(data):
+    v = 0
+    shift = 0
+    for ch in data:
+        c = ord(ch)
+        if 0x30 <= c < 0x50:
+            v |= (c - 0x30) << shift
+            shift += 5
+        elif 0x50 <= c < 0x70:
+            yield v | ((c - 0x50) << shift)
+            v = 0
+            shift = 0
+        else:
+            raise ValueError("invalid character %r" % ch)
+
+def events(lines, stats):
+    pending = None
+    for line in lines:
+        words = line.split()
+        if not words or words[0][0] != 's':
+            continue
+        for w in words[1:-1]:
+            if w[0] == '~':
+                stats['lost'] += int(w[1:])
+                yield (0, 'lost', None)
+        try:
+            for v in values(words[-1]):
+                if pending is not None:
+                    yield (pending, 'start' if v == START else ERRORS.get(v, 'err%02X' % v), None)
+                    pending = None
+                elif (v & 7) == 7:
+                    pending = v >> 3
+                else:
+                    yield (v >> 3, EVENTS.get(v & 7, '?'), v & 7)
+        except ValueError:
+            stats['bad'] += 1
+            pending = None
+
+def render(packet):
+    level = '‾'
+    out = []
+    for dt, ev in packet:
+        out.append(level * max(1, int(round(dt / (BIT_US / 4)))))
+        if ev in ('fall-w', 'fall-r', 'low'):
+            level = '_'
+        elif ev in ('rise', 'high-r'):
+            level = '‾'
+        elif ev not in ('spike',):
+            out.append('[%s]' % ev)
+    return ''.join(out)
+
+def main(argv):
+    wave = '-w' in argv
+    files = [a for a in argv if a != '-w']
+    lines = []
+    for f in files or ['-']:
+        lines.extend((sys.stdin if f == '-' else open(f, errors='replace')).readlines())
+    stats = { 'lost': 0, 'bad': 0 }
+    packets = 0
+    errors = {}
+    falls = []
+    highs = []
+    packet = []
+    since_fall = None
+    for dt, ev, code in events(lines, stats):
+        if ev in ('start', 'lost'):
+            if packet and wave:
+                print(render(packet))
+            packet = []
+            since_fall = None
+            packets += (ev == 'start')
+            continue
+        packet.append((dt, ev))
+        if since_fall is not None:
+            since_fall += dt
+        if code is None:
+            errors[ev] = errors.get(ev, 0) + 1
+        elif ev in ('fall-w', 'fall-r'):
+            # falling-to-falling distance in bit times measures the bit clock of the sender
+            if since_fall is not None:
+                nbits = int(round(since_fall / BIT_US))
+                if 0 < nbits <= 10:
+                    falls.append(since_fall / nbits)
+            since_fall = 0
+        elif ev == 'rise':
+            highs.append(dt)
+    if packet and wave:
+        print(render(packet))
+    print("packets: %d  lost events: %d  undecodable lines: %d" % (packets, stats['lost'], stats['bad']))
+    if falls:
+        falls.sort()
+        print("bit time (us, from falling edges): min %.1f  median %.1f  max %.1f  (nominal %.1f, n=%d)" %
+              (falls[0], falls[len(falls) // 2], falls[-1], BIT_US, len(falls)))
+    if highs:
+        highs.sort()
+        print("low pulse width before rising edge (us, writes): min %d  median %d  max %d" %
+              (highs[0], highs[len(highs) // 2], highs[-1]))
+    for e in sorted(errors):
+        print("%s: %d" % (e, errors[e]))
+
+if __name__ == '__main__':
+    main(sys.argv[1:])